@@ -0,0 +1,576 @@
+/**
+ ****************************************************************************************
+ *
+ * @file bond_bench.c
+ *
+ * @brief Bond lookup benchmark of app_multi_bond on a model of the I2C EEPROM.
+ *
+ * app_multi_bond.c runs unchanged on a model of the 8K EEPROM of the keyboard (32 byte
+ * pages, fast mode). The model counts the reads and their time on the bus: 9 bit times
+ * per byte at 400kbit/s, the device and the memory address are sent before the data. It
+ * counts the page writes, each one followed by a write cycle of the EEPROM.
+ *
+ * For 1 to MAX_BOND_PEER bonds, the bonds are stored, then each one is looked up with
+ * app_alt_pair_load_bond_data() (the LTK request of a reconnection), and so is a key that
+ * is not bonded. The read time on the bus, the reads and the host time of a lookup are
+ * printed next to the ones of the reference, the lookup of the original code that reads
+ * the records one after the other from the first slot. A lookup also writes the index
+ * entry of the bond found, to keep the least recently used order: the page writes per
+ * lookup are printed, their write cycle (5ms) does not hold the LTK reply with the
+ * interrupt driven driver. Every bond must be found with its record, the unknown key
+ * must not, and the EEPROM must hold the records stored. Then MAX_BOND_PEER / 4 more hosts
+ * bond and the least recently used bonds must be the ones evicted. Last, the EEPROM stops
+ * responding: no lookup may return keys, a host bonding then must not be stored, and
+ * once the EEPROM is back the bonds must all be found again.
+ *
+ * With CFG_I2C_EEPROM_ASYNC the model of the interrupt driven driver queues the
+ * operations and only runs them from i2c_eeprom_async_flush() or when its queue is full,
+ * reading the data of a write when it runs: a write whose data changes while it is
+ * queued stores the new data. The operations fail with I2C_EEPROM_ASYNC_ERR_TIMEOUT while
+ * the EEPROM does not respond.
+ *
+ * Usage: bond_bench [repeat]
+ *
+ ****************************************************************************************
+ */
+
+/*
+ * INCLUDE FILES
+ ****************************************************************************************
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "rwip_config.h"
+#include "app.h"
+#include "app_sec.h"
+#include "app_multi_bond.h"
+#include "periph_setup.h"
+#include "i2c_eeprom.h"
+#include "i2c_eeprom_async.h"
+
+
+/*
+ * DEFINES
+ ****************************************************************************************
+ */
+
+/// Default number of timed passes over the bonds
+#define BENCH_REPEAT            (1000)
+
+/// Time of a byte on the bus: 9 bits at 400kbit/s (ns)
+#define BENCH_BYTE_NS           (22500)
+
+/// Bytes of the device and memory addresses sent before the data
+#define BENCH_ADDR_BYTES        (1 + I2C_ADRESS_BYTES_CNT + 1)
+
+/// Slot of a bond in the EEPROM (app_multi_bond.c)
+#define BENCH_SLOT_ADDR(slot)   (EEPROM_BOND_DATA_ADDR + (slot) * sizeof(struct app_sec_env_tag))
+
+
+/*
+ * GLOBAL VARIABLES
+ ****************************************************************************************
+ */
+
+/// Application environments (app.c, app_sec.c)
+struct app_env_tag app_env;
+struct app_sec_env_tag app_sec_env;
+
+/// EEPROM content
+static uint8_t bench_eeprom[I2C_EEPROM_SIZE];
+
+/// Bus statistics
+static struct
+{
+    /// Read transactions
+    uint32_t reads;
+    /// Bytes on the bus of the reads, addresses included
+    uint32_t rd_bytes;
+    /// Page writes, each followed by a write cycle
+    uint32_t pages;
+} bench_bus;
+
+/// The EEPROM does not acknowledge anything
+static bool bench_eeprom_dead;
+
+/// Records of the bonds stored, by host number (the last host bonds while the EEPROM does
+/// not respond)
+static struct app_sec_env_tag bench_bond[MAX_BOND_PEER + MAX_BOND_PEER / 4 + 1];
+
+#if (I2C_EEPROM_ASYNC)
+/// Queued operation of the model of the interrupt driven driver
+struct bench_async_req
+{
+    i2c_eeprom_async_cb_t cb;
+    uint8_t *rd_ptr;
+    uint8_t const *wr_ptr;
+    uint32_t address;
+    uint32_t size;
+};
+
+/// Queue of the model
+static struct bench_async_req bench_async_queue[I2C_EEPROM_ASYNC_QUEUE_SIZE];
+static int bench_async_count;
+#endif // I2C_EEPROM_ASYNC
+
+
+/*
+ * STUBS OF THE APPLICATION
+ ****************************************************************************************
+ */
+
+void app_disconnect(void)
+{
+}
+
+void app_timer_set(ke_msg_id_t const timer_id, ke_task_id_t const task_id, uint16_t delay)
+{
+}
+
+
+/*
+ * MODEL OF THE I2C EEPROM
+ ****************************************************************************************
+ */
+
+/// Read: the addresses, a repeated start with the device address, then the data
+static void bench_eeprom_read(uint8_t *data, uint32_t address, uint32_t size)
+{
+    memcpy(data, &bench_eeprom[address], size);
+
+    bench_bus.reads++;
+    bench_bus.rd_bytes += BENCH_ADDR_BYTES + 1 + size;
+}
+
+/// Write: one transaction and one write cycle per page
+static void bench_eeprom_write(uint8_t const *data, uint32_t address, uint32_t size)
+{
+    while (size)
+    {
+        uint32_t chunk = I2C_EEPROM_PAGE - (address % I2C_EEPROM_PAGE);
+
+        if (chunk > size)
+            chunk = size;
+
+        memcpy(&bench_eeprom[address], data, chunk);
+
+        bench_bus.pages++;
+
+        data += chunk;
+        address += chunk;
+        size -= chunk;
+    }
+}
+
+void i2c_eeprom_init(uint16_t dev_address, uint8_t speed, uint8_t address_mode, uint8_t address_size)
+{
+}
+
+void i2c_eeprom_release(void)
+{
+}
+
+uint32_t i2c_eeprom_read_data(uint8_t *rd_data_ptr, uint32_t address, uint32_t size)
+{
+    if (bench_eeprom_dead)
+        return 0;
+
+    bench_eeprom_read(rd_data_ptr, address, size);
+
+    return size;
+}
+
+uint32_t i2c_eeprom_write_data(uint8_t *wr_data_ptr, uint32_t address, uint32_t size)
+{
+    if (bench_eeprom_dead)
+        return 0;
+
+    bench_eeprom_write(wr_data_ptr, address, size);
+
+    return size;
+}
+
+#if (I2C_EEPROM_ASYNC)
+void i2c_eeprom_async_config(uint16_t dev_address, uint8_t speed, uint8_t address_mode, uint8_t address_size)
+{
+}
+
+bool i2c_eeprom_async_busy(void)
+{
+    return (bench_async_count != 0);
+}
+
+int8_t i2c_eeprom_async_flush(void)
+{
+    int8_t error = I2C_EEPROM_ASYNC_OK;
+
+    // Run in order, a callback may queue the next operation
+    while (bench_async_count != 0)
+    {
+        struct bench_async_req req = bench_async_queue[0];
+        int32_t status = req.size;
+
+        // The data of a write is read when the write runs
+        if (bench_eeprom_dead)
+            status = error = I2C_EEPROM_ASYNC_ERR_TIMEOUT;
+        else if (req.rd_ptr != NULL)
+            bench_eeprom_read(req.rd_ptr, req.address, req.size);
+        else
+            bench_eeprom_write(req.wr_ptr, req.address, req.size);
+
+        memmove(&bench_async_queue[0], &bench_async_queue[1], (bench_async_count - 1) * sizeof(struct bench_async_req));
+        bench_async_count--;
+
+        if (req.cb != NULL)
+            req.cb(status);
+    }
+
+    return error;
+}
+
+static int8_t bench_async_submit(uint8_t *rd_ptr, uint8_t const *wr_ptr, uint32_t address, uint32_t size,
+                                 i2c_eeprom_async_cb_t cb)
+{
+    struct bench_async_req *req;
+
+    if (bench_async_count == I2C_EEPROM_ASYNC_QUEUE_SIZE)
+        return I2C_EEPROM_ASYNC_ERR_BUSY;
+
+    req = &bench_async_queue[bench_async_count++];
+    req->cb = cb;
+    req->rd_ptr = rd_ptr;
+    req->wr_ptr = wr_ptr;
+    req->address = address;
+    req->size = size;
+
+    return I2C_EEPROM_ASYNC_OK;
+}
+
+int8_t i2c_eeprom_async_read(uint8_t *rd_data_ptr, uint32_t address, uint32_t size, i2c_eeprom_async_cb_t cb)
+{
+    return bench_async_submit(rd_data_ptr, NULL, address, size, cb);
+}
+
+int8_t i2c_eeprom_async_write(uint8_t const *wr_data_ptr, uint32_t address, uint32_t size, i2c_eeprom_async_cb_t cb)
+{
+    return bench_async_submit(NULL, wr_data_ptr, address, size, cb);
+}
+#endif // I2C_EEPROM_ASYNC
+
+
+/*
+ * LOCAL FUNCTION DEFINITIONS
+ ****************************************************************************************
+ */
+
+static uint64_t bench_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/// Bus time of the reads counted since the statistics were cleared (us)
+static double bench_read_us(void)
+{
+    return (double) bench_bus.rd_bytes * BENCH_BYTE_NS / 1000;
+}
+
+/// Record of host number h: distinct keys and public address
+static void bench_bond_make(uint32_t h, struct app_sec_env_tag *sec_env)
+{
+    uint32_t i;
+
+    memset(sec_env, 0, sizeof(struct app_sec_env_tag));
+
+    for (i = 0; i < KEY_LEN; i++)
+        sec_env->ltk.key[i] = (uint8_t)(h * 31 + i);
+    for (i = 0; i < RAND_NB_LEN; i++)
+        sec_env->rand_nb.nb[i] = (uint8_t)(h * 7 + i * 13);
+    // a few hosts share their EDIV
+    sec_env->ediv = (uint16_t)(0x1000 + h % 5);
+    sec_env->key_size = KEY_LEN;
+    sec_env->peer_addr_type = 0;
+    for (i = 0; i < BD_ADDR_LEN; i++)
+        sec_env->peer_addr.addr[i] = (uint8_t)(h + i * 3);
+    sec_env->auth = GAP_AUTH_REQ_MITM_BOND;
+}
+
+/// Bond host number h, as the pairing of a new host does
+static void bench_bond_store(uint32_t h)
+{
+    bench_bond_make(h, &bench_bond[h]);
+
+    memcpy(&app_sec_env, &bench_bond[h], sizeof(struct app_sec_env_tag));
+    app_env.peer_addr_type = app_sec_env.peer_addr_type;
+    app_env.peer_addr = app_sec_env.peer_addr;
+
+    app_alt_pair_store_bond_data();
+}
+
+/// Lookup of the original code: every record from the first slot until a match
+static int bench_ref_lookup(struct rand_nb *rand_nb, uint16_t ediv)
+{
+    struct app_sec_env_tag tmp_sec_env;
+    uint32_t i;
+
+    for (i = 0; i < MAX_BOND_PEER; i++)
+    {
+        i2c_eeprom_read_data( (uint8_t *) &tmp_sec_env, BENCH_SLOT_ADDR(i), sizeof(struct app_sec_env_tag));
+
+        if ((tmp_sec_env.ediv == ediv) && (!memcmp(rand_nb, &tmp_sec_env.rand_nb, RAND_NB_LEN))
+                && (tmp_sec_env.auth & GAP_AUTH_BOND))
+        {
+            memcpy(&app_sec_env, &tmp_sec_env, sizeof(struct app_sec_env_tag));
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/// Check that host h is bonded with its record, in the EEPROM and through a lookup
+static int bench_bond_check(uint32_t h)
+{
+    struct app_sec_env_tag stored;
+    uint32_t slot;
+
+#if (I2C_EEPROM_ASYNC)
+    // the writes still queued
+    i2c_eeprom_async_flush();
+#endif
+
+    for (slot = 0; slot < MAX_BOND_PEER; slot++)
+    {
+        memcpy(&stored, &bench_eeprom[BENCH_SLOT_ADDR(slot)], sizeof(struct app_sec_env_tag));
+        if (!memcmp(&stored, &bench_bond[h], sizeof(struct app_sec_env_tag)))
+            break;
+    }
+
+    if (slot == MAX_BOND_PEER)
+    {
+        printf("  FAILED: record of host %u not in the EEPROM\n", h);
+        return 1;
+    }
+
+    memset(&app_sec_env, 0, sizeof(struct app_sec_env_tag));
+    if ((app_alt_pair_load_bond_data(&bench_bond[h].rand_nb, bench_bond[h].ediv) == 0)
+            || memcmp(&app_sec_env, &bench_bond[h], sizeof(struct app_sec_env_tag)))
+    {
+        printf("  FAILED: host %u not found\n", h);
+        return 1;
+    }
+
+    return 0;
+}
+
+/**
+ ****************************************************************************************
+ * @brief Store n bonds on a cleared EEPROM, then time their lookups.
+ *
+ * @param[in] n       Number of bonds.
+ * @param[in] repeat  Timed passes over the bonds.
+ *
+ * @return 0 if all checks passed, 1 otherwise
+ ****************************************************************************************
+ */
+static int bench_run(uint32_t n, uint32_t repeat)
+{
+    struct app_sec_env_tag unknown;
+    double idx_hit_us, idx_miss_us, ref_hit_us, ref_miss_us;
+    uint32_t idx_hit_reads, idx_hit_pages, ref_hit_reads;
+    uint64_t idx_ns, ref_ns, t0;
+    uint32_t h, r;
+    int err = 0;
+
+    memset(bench_eeprom, 0xFF, sizeof(bench_eeprom));
+    app_alt_pair_clear_all_bond_data();
+
+    for (h = 0; h < n; h++)
+        bench_bond_store(h);
+
+    for (h = 0; h < n; h++)
+        err |= bench_bond_check(h);
+
+    if (__builtin_popcount(multi_bond_status) != n)
+    {
+        printf("  FAILED: status %08X for %u bonds\n", multi_bond_status, n);
+        err = 1;
+    }
+
+    bench_bond_make(MAX_BOND_PEER + MAX_BOND_PEER / 4, &unknown);
+    if (app_alt_pair_load_bond_data(&unknown.rand_nb, unknown.ediv) != 0)
+    {
+        printf("  FAILED: unknown key found\n");
+        err = 1;
+    }
+
+    // Bus cost of one lookup per bond, and of a miss
+#if (I2C_EEPROM_ASYNC)
+    i2c_eeprom_async_flush();
+#endif
+    memset(&bench_bus, 0, sizeof(bench_bus));
+    for (h = 0; h < n; h++)
+        app_alt_pair_load_bond_data(&bench_bond[h].rand_nb, bench_bond[h].ediv);
+#if (I2C_EEPROM_ASYNC)
+    // the index updates still queued
+    i2c_eeprom_async_flush();
+#endif
+    idx_hit_us = bench_read_us() / n;
+    idx_hit_reads = bench_bus.reads;
+    idx_hit_pages = bench_bus.pages;
+
+    memset(&bench_bus, 0, sizeof(bench_bus));
+    app_alt_pair_load_bond_data(&unknown.rand_nb, unknown.ediv);
+    idx_miss_us = bench_read_us();
+
+    memset(&bench_bus, 0, sizeof(bench_bus));
+    for (h = 0; h < n; h++)
+        err |= !bench_ref_lookup(&bench_bond[h].rand_nb, bench_bond[h].ediv);
+    ref_hit_us = bench_read_us() / n;
+    ref_hit_reads = bench_bus.reads;
+
+    memset(&bench_bus, 0, sizeof(bench_bus));
+    bench_ref_lookup(&unknown.rand_nb, unknown.ediv);
+    ref_miss_us = bench_read_us();
+
+    // Host time, the model of the EEPROM included
+    t0 = bench_now_ns();
+    for (r = 0; r < repeat; r++)
+        for (h = 0; h < n; h++)
+            app_alt_pair_load_bond_data(&bench_bond[h].rand_nb, bench_bond[h].ediv);
+    idx_ns = bench_now_ns() - t0;
+
+    t0 = bench_now_ns();
+    for (r = 0; r < repeat; r++)
+        for (h = 0; h < n; h++)
+            bench_ref_lookup(&bench_bond[h].rand_nb, bench_bond[h].ediv);
+    ref_ns = bench_now_ns() - t0;
+
+    printf("%5u %8.0f %8.0f %6.2f %6.2f %8.0f %8.0f %6.2f %8.0f %8.0f\n", n,
+           idx_hit_us, idx_miss_us, (double) idx_hit_reads / n, (double) idx_hit_pages / n,
+           ref_hit_us, ref_miss_us, (double) ref_hit_reads / n,
+           (double) idx_ns / ((uint64_t) repeat * n), (double) ref_ns / ((uint64_t) repeat * n));
+
+    return err;
+}
+
+/// Bond MAX_BOND_PEER / 4 more hosts, the least recently used bonds must be evicted
+static int bench_evict(void)
+{
+    uint32_t first = MAX_BOND_PEER / 2;
+    uint32_t extra = MAX_BOND_PEER / 4;
+    uint32_t h;
+    int err = 0;
+
+    // All the slots are taken, the hosts from first on are used again, in order
+    for (h = first; h < MAX_BOND_PEER; h++)
+        err |= bench_bond_check(h);
+    for (h = 0; h < first - extra; h++)
+        err |= bench_bond_check(h);
+
+    for (h = MAX_BOND_PEER; h < MAX_BOND_PEER + extra; h++)
+        bench_bond_store(h);
+
+    // Evicted: the hosts not used since they were stored, from first - extra on
+    for (h = 0; h < MAX_BOND_PEER + extra; h++)
+    {
+        bool evicted = (h >= first - extra) && (h < first);
+
+        if (evicted)
+        {
+            if (app_alt_pair_load_bond_data(&bench_bond[h].rand_nb, bench_bond[h].ediv) != 0)
+            {
+                printf("  FAILED: host %u not evicted\n", h);
+                err = 1;
+            }
+        }
+        else
+        {
+            err |= bench_bond_check(h);
+        }
+    }
+
+    printf("eviction: %u hosts bonded on %u slots, %s\n", MAX_BOND_PEER + extra, MAX_BOND_PEER,
+           err ? "FAILED" : "least recently used bonds evicted");
+
+    return err;
+}
+
+/// The EEPROM stops responding after bench_evict()
+static int bench_dead(void)
+{
+    struct app_sec_env_tag marker;
+    uint32_t extra = MAX_BOND_PEER / 4;
+    uint32_t h = MAX_BOND_PEER + extra;
+    int err = 0;
+
+#if (I2C_EEPROM_ASYNC)
+    i2c_eeprom_async_flush();
+#endif
+    bench_eeprom_dead = true;
+
+    // a read that fails must not bring keys
+    memset(&marker, 0xA5, sizeof(marker));
+    memcpy(&app_sec_env, &marker, sizeof(marker));
+    if ((app_alt_pair_load_bond_data(&bench_bond[0].rand_nb, bench_bond[0].ediv) != 0)
+            || memcmp(&app_sec_env, &marker, sizeof(marker)))
+    {
+        printf("  FAILED: keys of host 0 returned by a failed read\n");
+        err = 1;
+    }
+
+    // not stored, the bond index in RAM is dropped with the writes that failed
+    bench_bond_store(h);
+    if (app_alt_pair_load_bond_data(&bench_bond[h].rand_nb, bench_bond[h].ediv) != 0)
+    {
+        printf("  FAILED: host %u found while the EEPROM does not respond\n", h);
+        err = 1;
+    }
+
+    // the bond index is read again, the bonds left by bench_evict() are all there
+    bench_eeprom_dead = false;
+    for (h = 0; h < MAX_BOND_PEER + extra; h++)
+    {
+        if ((h < MAX_BOND_PEER / 2 - extra) || (h >= MAX_BOND_PEER / 2))
+            err |= bench_bond_check(h);
+    }
+
+    printf("dead EEPROM: %s\n", err ? "FAILED" : "no keys returned, bonds found again once it responds");
+
+    return err;
+}
+
+
+/*
+ * MAIN
+ ****************************************************************************************
+ */
+
+int main(int argc, char **argv)
+{
+    uint32_t repeat = (argc > 1) ? strtoul(argv[1], NULL, 0) : BENCH_REPEAT;
+    uint32_t n;
+    int err = 0;
+
+    printf("bond_bench: %u slots, %u byte records, %d byte EEPROM pages, %s driver\n",
+           MAX_BOND_PEER, (uint32_t) sizeof(struct app_sec_env_tag), I2C_EEPROM_PAGE,
+           I2C_EEPROM_ASYNC ? "interrupt driven" : "blocking");
+    printf("                   index                       reference           host ns/lookup\n");
+    printf("bonds   hit_us  miss_us  reads  pages   hit_us  miss_us  reads    index      ref\n");
+
+    // all the slots are taken by the last run
+    for (n = 1; n < MAX_BOND_PEER; n *= 2)
+        err |= bench_run(n, repeat);
+    err |= bench_run(MAX_BOND_PEER, repeat);
+
+    err |= bench_evict();
+    err |= bench_dead();
+
+    return err;
+}
@@ -0,0 +1,51 @@
+/**
+ ****************************************************************************************
+ *
+ * @file da14580_config.h
+ *
+ * @brief Compile configuration file of the bond storage benchmark (host build).
+ *
+ * Same profile set as the keyboard application, with multiple bonding and the largest
+ * bond store, app_multi_bond.c is built unchanged.
+ *
+ ****************************************************************************************
+ */
+
+#ifndef DA14580_CONFIG_H_
+#define DA14580_CONFIG_H_
+
+/////////////////////////////////////////////////////////////
+/*Host (off-target) build of the kernel*/
+#define CFG_KE_HOST
+/////////////////////////////////////////////////////////////
+
+/*Peripheral role with the host and the controller*/
+#define CFG_BLE
+#define CFG_HOST
+#define CFG_EMB
+#define CFG_APP
+#define CFG_PERIPHERAL          1
+#define CFG_CON                 1
+#define CFG_ATTS
+#define CFG_BLECORE_11
+#define CFG_SLEEP
+
+/*Security*/
+#define CFG_SECURITY_ON         1
+#define CFG_APP_SEC
+
+/*Keyboard application with the HID profile*/
+#define CFG_APP_KEYBOARD
+#define CFG_PRF_HOGPD           1
+
+/*Multiple bonding, 32 bonds in the 8K EEPROM*/
+#define CFG_MULTI_BOND
+#define CFG_MAX_BOND_PEER       32
+
+/*Maximum user connections*/
+#define BLE_CONNECTION_MAX_USER 1
+
+/*No breakpoints in the application code*/
+#define DEVELOPMENT__NO_OTP     0
+
+#endif // DA14580_CONFIG_H_
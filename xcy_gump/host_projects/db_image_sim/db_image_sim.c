@@ -0,0 +1,1026 @@
+/**
+ ****************************************************************************************
+ *
+ * @file db_image_sim.c
+ *
+ * @brief Attribute database image of app_db_image.c on a model of ATTM DB and of the NVDS
+ * log.
+ *
+ * app_db_image.c runs unchanged on a model of the ATTM DB functions of the ROM and of the
+ * read-write NVDS (the TAGs are kept in memory, nvds_flash.c itself is tested by
+ * nvds_sim). The profile tasks of the keyboard (DISS, BASS, HOGPD) are modelled: each one
+ * adds its service when it receives its create request and answers the application, one
+ * kernel message exchange per profile as app_db_init_func() does. A few attributes use 32
+ * and 128 bits UUIDs, the report map spans several chunks of the image.
+ *
+ * Each boot starts from an empty database holding the GAP and GATT services and runs the
+ * sequence of app_db_init() until the database is complete, when the advertising starts:
+ *  - without image: the services are created by the profiles (firmware without
+ *    CFG_APP_DB_IMAGE, the reference)
+ *  - first boot: there is no image yet, the services are created then saved
+ *  - restore: the database is rebuilt from the image
+ * For each one the kernel messages, the ATTM DB calls, the NVDS TAGs and bytes read and
+ * written, the time of the flash reads on target (SPI at 2MHz, the slowest divider) and
+ * the host time are printed. The firmware built with CFG_APP_DB_TIMING and CFG_PRINTF
+ * prints the time from app_init() to that point on target.
+ *
+ * The restored database (services, handles, UUIDs, permissions, maximum lengths, values)
+ * and the environments and states of the profile tasks must be the ones created. Then the
+ * image must be refused, and the services created and saved again, when a chunk is
+ * corrupted, when a chunk is missing, when the header is from another version and when
+ * the GAP and GATT services end at another handle. Last, a database that does not fit in
+ * the image must be created at each boot without writing any chunk.
+ *
+ * Usage: db_image_sim [repeat]
+ *
+ ****************************************************************************************
+ */
+
+/*
+ * INCLUDE FILES
+ ****************************************************************************************
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "rwip_config.h"
+#include "co_utils.h"
+#include "ke_task.h"
+#include "ke_msg.h"
+#include "ke_event.h"
+#include "ke.h"
+#include "attm.h"
+#include "attm_db.h"
+#include "nvds.h"
+#include "diss.h"
+#include "bass.h"
+#include "hogpd.h"
+#include "app_db_image.h"
+
+
+/*
+ * DEFINES
+ ****************************************************************************************
+ */
+
+/// Default number of timed boots of each kind
+#define SIM_REPEAT              (1000)
+
+/// Handles of the model
+#define SIM_HDL_MAX             (256)
+
+/// Attributes of the GAP and GATT services
+#define SIM_GAP_NB_ATT          (7)
+#define SIM_GATT_NB_ATT         (4)
+
+/// Time of a byte on the SPI bus at 2MHz (ns)
+#define SIM_SPI_BYTE_NS         (4000)
+
+/// Bytes of the command and address of a flash read
+#define SIM_SPI_CMD_BYTES       (4)
+
+/// Header of a record of the NVDS log
+#define SIM_NVDS_REC_HDR        (4)
+
+/// Messages between the application and the profile tasks
+enum
+{
+    SIM_CREATE_DB_REQ = KE_FIRST_MSG(TASK_APP) + 0x80,
+    SIM_CREATE_DB_CFM,
+};
+
+/// Kind of boot
+enum
+{
+    /// Firmware without the image
+    SIM_BOOT_NO_IMAGE,
+    /// Firmware with the image
+    SIM_BOOT_IMAGE,
+};
+
+
+/*
+ * TYPE DEFINITIONS
+ ****************************************************************************************
+ */
+
+/// Attribute of a modelled service
+struct sim_att_desc
+{
+    /// UUID length
+    uint8_t uuid_len;
+    /// 16 bits UUID, or the one the 32 and 128 bits UUIDs are derived from
+    uint16_t uuid;
+    /// Permission
+    uint16_t perm;
+    /// Maximum length of the value
+    uint16_t max_length;
+    /// Length of the initial value, 0 if none
+    uint16_t length;
+};
+
+/// Modelled profile task
+struct sim_prf
+{
+    /// Task
+    ke_task_id_t task;
+    /// Attributes of its service
+    const struct sim_att_desc *atts;
+    uint8_t nb_att;
+    /// Environment
+    void *env;
+    uint16_t env_size;
+};
+
+/// Service of the model: the counters declared by attmdb_add_service()
+struct sim_svc
+{
+    uint8_t nb_att_uuid[3];
+    uint8_t added_uuid[3];
+    uint16_t total_size;
+    uint16_t used_size;
+};
+
+/// Statistics of a boot
+struct sim_stats
+{
+    uint32_t msgs;
+    uint32_t attm;
+    uint32_t nvds_gets;
+    uint32_t nvds_rd_bytes;
+    uint32_t nvds_puts;
+    uint32_t nvds_wr_bytes;
+    uint32_t spi_rd_bytes;
+};
+
+/// Snapshot of the database and of the profile tasks
+struct sim_snapshot
+{
+    uint8_t data[8192];
+    uint32_t len;
+};
+
+
+/*
+ * GLOBAL VARIABLES
+ ****************************************************************************************
+ */
+
+/// ATTM environment (ROM)
+struct attm_env_tag attm_env;
+
+/// Profile environments (diss.c, bass.c, hogpd.c)
+struct diss_env_tag diss_env;
+struct bass_env_tag bass_env;
+struct hogpd_env_tag hogpd_env;
+
+/// UUIDs of the attributes of the model, by handle
+static struct
+{
+    uint8_t len;
+    uint8_t uuid[ATT_UUID_128_LEN];
+} sim_uuid[SIM_HDL_MAX];
+
+/// Counters of the services of the model, by start handle
+static struct sim_svc sim_svc[SIM_HDL_MAX];
+
+/// NVDS TAGs written at run time
+static struct
+{
+    bool set;
+    uint8_t len;
+    uint8_t data[255];
+} sim_nvds[256];
+
+/// TAGs that can be written
+static const uint8_t sim_nvds_tags[] = {NVDS_FLASH_TAGS};
+
+/// Statistics of the current boot
+static struct sim_stats sim_stats;
+
+/// Application: next profile to create, kind of boot, database complete and restored
+static struct
+{
+    uint8_t next_prf;
+    uint8_t boot;
+    bool done;
+    bool restored;
+} sim_app;
+
+/// Attributes added to the GAP service (GAP and GATT end at another handle)
+static uint8_t sim_gap_extra;
+
+/// Maximum length added to the report map (database too big for the image)
+static uint16_t sim_report_map_extra;
+
+/// Device Information Service: manufacturer, model, serial, firmware and software
+/// revisions, system ID, PnP ID, and a 32 bits UUID characteristic
+static const struct sim_att_desc sim_diss_atts[] =
+{
+    {ATT_UUID_16_LEN,  0x2800, PERM(RD, ENABLE), 2, 2},
+    {ATT_UUID_16_LEN,  0x2803, PERM(RD, ENABLE), 5, 5},
+    {ATT_UUID_16_LEN,  0x2A29, PERM(RD, ENABLE), 20, 14},
+    {ATT_UUID_16_LEN,  0x2803, PERM(RD, ENABLE), 5, 5},
+    {ATT_UUID_16_LEN,  0x2A24, PERM(RD, ENABLE), 20, 12},
+    {ATT_UUID_16_LEN,  0x2803, PERM(RD, ENABLE), 5, 5},
+    {ATT_UUID_16_LEN,  0x2A25, PERM(RD, ENABLE), 20, 8},
+    {ATT_UUID_16_LEN,  0x2803, PERM(RD, ENABLE), 5, 5},
+    {ATT_UUID_16_LEN,  0x2A26, PERM(RD, ENABLE), 20, 6},
+    {ATT_UUID_16_LEN,  0x2803, PERM(RD, ENABLE), 5, 5},
+    {ATT_UUID_16_LEN,  0x2A28, PERM(RD, ENABLE), 20, 6},
+    {ATT_UUID_16_LEN,  0x2803, PERM(RD, ENABLE), 5, 5},
+    {ATT_UUID_16_LEN,  0x2A23, PERM(RD, ENABLE), 8, 8},
+    {ATT_UUID_16_LEN,  0x2803, PERM(RD, ENABLE), 5, 5},
+    {ATT_UUID_16_LEN,  0x2A50, PERM(RD, ENABLE), 7, 7},
+    {ATT_UUID_32_LEN,  0x2A51, PERM(RD, ENABLE), 4, 0},
+};
+
+/// Battery Service: level with notifications and presentation format, and a 128 bits
+/// UUID characteristic
+static const struct sim_att_desc sim_bass_atts[] =
+{
+    {ATT_UUID_16_LEN,  0x2800, PERM(RD, ENABLE), 2, 2},
+    {ATT_UUID_16_LEN,  0x2803, PERM(RD, ENABLE), 5, 5},
+    {ATT_UUID_16_LEN,  0x2A19, PERM(RD, ENABLE) | PERM(NTF, ENABLE), 1, 1},
+    {ATT_UUID_16_LEN,  0x2902, PERM(RD, ENABLE) | PERM(WR, ENABLE), 2, 0},
+    {ATT_UUID_16_LEN,  0x2904, PERM(RD, ENABLE), 7, 7},
+    {ATT_UUID_128_LEN, 0x0001, PERM(RD, ENABLE) | PERM(WR, UNAUTH), 20, 0},
+};
+
+/// HID Service: protocol mode, report map, input, output and feature reports, boot
+/// keyboard reports, information and control point
+static const struct sim_att_desc sim_hogpd_atts[] =
+{
+    {ATT_UUID_16_LEN,  0x2800, PERM(RD, ENABLE), 2, 2},
+    {ATT_UUID_16_LEN,  0x2803, PERM(RD, ENABLE), 5, 5},
+    {ATT_UUID_16_LEN,  0x2A4E, PERM(RD, UNAUTH) | PERM(WR, UNAUTH), 1, 1},
+    {ATT_UUID_16_LEN,  0x2803, PERM(RD, ENABLE), 5, 5},
+    {ATT_UUID_16_LEN,  0x2A4B, PERM(RD, UNAUTH), 512, 140},
+    {ATT_UUID_16_LEN,  0x2907, PERM(RD, ENABLE), 2, 0},
+    {ATT_UUID_16_LEN,  0x2803, PERM(RD, ENABLE), 5, 5},
+    {ATT_UUID_16_LEN,  0x2A4D, PERM(RD, UNAUTH) | PERM(NTF, UNAUTH), 8, 0},
+    {ATT_UUID_16_LEN,  0x2902, PERM(RD, UNAUTH) | PERM(WR, UNAUTH), 2, 0},
+    {ATT_UUID_16_LEN,  0x2908, PERM(RD, UNAUTH), 2, 2},
+    {ATT_UUID_16_LEN,  0x2803, PERM(RD, ENABLE), 5, 5},
+    {ATT_UUID_16_LEN,  0x2A4D, PERM(RD, UNAUTH) | PERM(WR, UNAUTH), 1, 0},
+    {ATT_UUID_16_LEN,  0x2908, PERM(RD, UNAUTH), 2, 2},
+    {ATT_UUID_16_LEN,  0x2803, PERM(RD, ENABLE), 5, 5},
+    {ATT_UUID_16_LEN,  0x2A4D, PERM(RD, UNAUTH) | PERM(WR, UNAUTH), 8, 0},
+    {ATT_UUID_16_LEN,  0x2908, PERM(RD, UNAUTH), 2, 2},
+    {ATT_UUID_16_LEN,  0x2803, PERM(RD, ENABLE), 5, 5},
+    {ATT_UUID_16_LEN,  0x2A22, PERM(RD, UNAUTH) | PERM(NTF, UNAUTH), 8, 0},
+    {ATT_UUID_16_LEN,  0x2902, PERM(RD, UNAUTH) | PERM(WR, UNAUTH), 2, 0},
+    {ATT_UUID_16_LEN,  0x2803, PERM(RD, ENABLE), 5, 5},
+    {ATT_UUID_16_LEN,  0x2A32, PERM(RD, UNAUTH) | PERM(WR, UNAUTH), 1, 0},
+    {ATT_UUID_16_LEN,  0x2803, PERM(RD, ENABLE), 5, 5},
+    {ATT_UUID_16_LEN,  0x2A4A, PERM(RD, UNAUTH), 4, 4},
+    {ATT_UUID_16_LEN,  0x2803, PERM(RD, ENABLE), 5, 5},
+    {ATT_UUID_16_LEN,  0x2A4C, PERM(WR, UNAUTH), 1, 0},
+};
+
+/// Profile tasks, in the order of app_db_init_func() of the keyboard
+static const struct sim_prf sim_prfs[] =
+{
+    {TASK_DISS,  sim_diss_atts,  sizeof(sim_diss_atts) / sizeof(sim_diss_atts[0]),
+                 &diss_env,  sizeof(diss_env)},
+    {TASK_BASS,  sim_bass_atts,  sizeof(sim_bass_atts) / sizeof(sim_bass_atts[0]),
+                 &bass_env,  sizeof(bass_env)},
+    {TASK_HOGPD, sim_hogpd_atts, sizeof(sim_hogpd_atts) / sizeof(sim_hogpd_atts[0]),
+                 &hogpd_env, sizeof(hogpd_env)},
+};
+
+#define SIM_PRF_NB              (sizeof(sim_prfs) / sizeof(sim_prfs[0]))
+
+
+/*
+ * MODEL OF ATTM DB
+ ****************************************************************************************
+ */
+
+static struct attm_svc_db *sim_svc_find(uint16_t handle)
+{
+    struct attm_svc_db *svc;
+
+    for (svc = attm_env.db; svc != NULL; svc = svc->next_db)
+    {
+        if ((handle >= svc->start_hdl) && (handle <= svc->last_hdl))
+            return svc;
+    }
+
+    return NULL;
+}
+
+uint8_t attmdb_add_service(uint16_t *start_hdl, uint16_t task_id,
+                           uint8_t nb_att_uuid_16, uint8_t nb_att_uuid_32,
+                           uint8_t nb_att_uuid_128, uint16_t total_size)
+{
+    uint8_t nb_att = nb_att_uuid_16 + nb_att_uuid_32 + nb_att_uuid_128;
+    struct attm_svc_db *svc, **prev;
+    uint16_t hdl;
+
+    sim_stats.attm++;
+
+    if (*start_hdl == 0)
+    {
+        *start_hdl = 1;
+        for (svc = attm_env.db; svc != NULL; svc = svc->next_db)
+            *start_hdl = svc->last_hdl + 1;
+    }
+
+    if ((nb_att == 0) || (*start_hdl + nb_att > SIM_HDL_MAX))
+        return ATT_ERR_INSUFF_RESOURCE;
+
+    for (hdl = *start_hdl; hdl < *start_hdl + nb_att; hdl++)
+    {
+        if (sim_svc_find(hdl) != NULL)
+            return ATT_ERR_INVALID_HANDLE;
+    }
+
+    svc = calloc(1, sizeof(*svc) + nb_att * sizeof(svc->att_elems[0]));
+    svc->start_hdl = *start_hdl;
+    svc->last_hdl = *start_hdl + nb_att - 1;
+    svc->task_id = task_id;
+    svc->nb_att = nb_att;
+
+    for (prev = &attm_env.db; (*prev != NULL) && ((*prev)->start_hdl < svc->start_hdl);
+         prev = &(*prev)->next_db)
+        ;
+    svc->next_db = *prev;
+    *prev = svc;
+
+    memset(&sim_svc[svc->start_hdl], 0, sizeof(sim_svc[0]));
+    sim_svc[svc->start_hdl].nb_att_uuid[0] = nb_att_uuid_16;
+    sim_svc[svc->start_hdl].nb_att_uuid[1] = nb_att_uuid_32;
+    sim_svc[svc->start_hdl].nb_att_uuid[2] = nb_att_uuid_128;
+    sim_svc[svc->start_hdl].total_size = total_size;
+
+    return ATT_ERR_NO_ERROR;
+}
+
+uint8_t attmdb_add_attribute(uint16_t start_hdl, att_size_t max_length,
+                             uint8_t uuid_len, uint8_t* uuid, uint16_t perm,
+                             uint16_t *handle)
+{
+    struct attm_svc_db *svc = sim_svc_find(start_hdl);
+    struct sim_svc *info;
+    struct attm_elmt *elmt;
+    uint8_t type, i;
+
+    sim_stats.attm++;
+
+    if ((svc == NULL) || (svc->start_hdl != start_hdl))
+        return ATT_ERR_INVALID_HANDLE;
+
+    info = &sim_svc[start_hdl];
+
+    switch (uuid_len)
+    {
+        case ATT_UUID_16_LEN:  type = 0; break;
+        case ATT_UUID_32_LEN:  type = 1; break;
+        case ATT_UUID_128_LEN: type = 2; break;
+        default: return ATT_ERR_INVALID_HANDLE;
+    }
+
+    // The ROM reserves the memory of the service with the counters given at its creation
+    if ((info->added_uuid[type] == info->nb_att_uuid[type])
+        || (info->used_size + max_length > info->total_size))
+        return ATT_ERR_INSUFF_RESOURCE;
+
+    for (i = 0; (i < svc->nb_att) && (svc->att_elems[i] != NULL); i++)
+        ;
+
+    elmt = calloc(1, sizeof(*elmt) + max_length);
+    elmt->uuid = (uuid_len == ATT_UUID_16_LEN) ? co_read16p(uuid) : 0;
+    elmt->perm = perm;
+    elmt->max_length = max_length & ATT_MAX_LENGTH_MASK;
+    svc->att_elems[i] = elmt;
+
+    info->added_uuid[type]++;
+    info->used_size += max_length;
+
+    *handle = start_hdl + i;
+    memset(&sim_uuid[*handle], 0, sizeof(sim_uuid[0]));
+    sim_uuid[*handle].len = uuid_len;
+    memcpy(sim_uuid[*handle].uuid, uuid, uuid_len);
+
+    return ATT_ERR_NO_ERROR;
+}
+
+struct attm_elmt * attmdb_get_attribute(uint16_t handle)
+{
+    struct attm_svc_db *svc = sim_svc_find(handle);
+
+    sim_stats.attm++;
+
+    return (svc != NULL) ? svc->att_elems[handle - svc->start_hdl] : NULL;
+}
+
+uint8_t attmdb_att_get_uuid(uint16_t handle, uint8_t* uuid_len, uint8_t* uuid)
+{
+    struct attm_svc_db *svc = sim_svc_find(handle);
+
+    sim_stats.attm++;
+
+    if ((svc == NULL) || (svc->att_elems[handle - svc->start_hdl] == NULL))
+        return ATT_ERR_INVALID_HANDLE;
+
+    *uuid_len = sim_uuid[handle].len;
+    memcpy(uuid, sim_uuid[handle].uuid, *uuid_len);
+
+    return ATT_ERR_NO_ERROR;
+}
+
+uint8_t attmdb_att_get_value(uint16_t handle, att_size_t* length, uint8_t** value)
+{
+    struct attm_svc_db *svc = sim_svc_find(handle);
+    struct attm_elmt *elmt = (svc != NULL) ? svc->att_elems[handle - svc->start_hdl] : NULL;
+
+    sim_stats.attm++;
+
+    if (elmt == NULL)
+        return ATT_ERR_INVALID_HANDLE;
+
+    *length = elmt->length;
+    *value = elmt->value;
+
+    return ATT_ERR_NO_ERROR;
+}
+
+static uint8_t sim_value_write(uint16_t handle, att_size_t length, att_size_t offset, uint8_t *value)
+{
+    struct attm_svc_db *svc = sim_svc_find(handle);
+    struct attm_elmt *elmt = (svc != NULL) ? svc->att_elems[handle - svc->start_hdl] : NULL;
+
+    if (elmt == NULL)
+        return ATT_ERR_INVALID_HANDLE;
+
+    if (offset + length > ATTM_GET_MAX_LENGTH(elmt))
+        return ATT_ERR_INVALID_ATTRIBUTE_VAL_LEN;
+
+    memcpy(&elmt->value[offset], value, length);
+    elmt->length = offset + length;
+
+    return ATT_ERR_NO_ERROR;
+}
+
+uint8_t attmdb_att_update_value(uint16_t handle, att_size_t length, att_size_t offset,
+                                uint8_t* value)
+{
+    sim_stats.attm++;
+
+    return sim_value_write(handle, length, offset, value);
+}
+
+uint8_t attmdb_att_set_value(uint16_t handle, att_size_t length, uint8_t* value)
+{
+    sim_stats.attm++;
+
+    return sim_value_write(handle, length, 0, value);
+}
+
+uint8_t attmdb_svc_set_permission(uint16_t handle, uint8_t perm)
+{
+    struct attm_svc_db *svc = sim_svc_find(handle);
+
+    sim_stats.attm++;
+
+    if (svc == NULL)
+        return ATT_ERR_INVALID_HANDLE;
+
+    svc->perm = perm;
+
+    return ATT_ERR_NO_ERROR;
+}
+
+/// Empty the database
+static void sim_db_destroy(void)
+{
+    while (attm_env.db != NULL)
+    {
+        struct attm_svc_db *svc = attm_env.db;
+        uint8_t i;
+
+        attm_env.db = svc->next_db;
+        for (i = 0; i < svc->nb_att; i++)
+            free(svc->att_elems[i]);
+        free(svc);
+    }
+}
+
+
+/*
+ * MODEL OF THE NVDS LOG
+ ****************************************************************************************
+ */
+
+static bool sim_nvds_writable(uint8_t tag)
+{
+    uint32_t i;
+
+    for (i = 0; i < sizeof(sim_nvds_tags); i++)
+    {
+        if (sim_nvds_tags[i] == tag)
+            return true;
+    }
+
+    return false;
+}
+
+uint8_t nvds_flash_get(uint8_t tag, nvds_tag_len_t * lengthPtr, uint8_t *buf)
+{
+    if (!sim_nvds_writable(tag) || !sim_nvds[tag].set)
+        return NVDS_TAG_NOT_DEFINED;
+
+    // Record header, then the DATA
+    sim_stats.nvds_gets++;
+    sim_stats.spi_rd_bytes += SIM_SPI_CMD_BYTES + SIM_NVDS_REC_HDR;
+
+    if (*lengthPtr < sim_nvds[tag].len)
+    {
+        *lengthPtr = 0;
+        return NVDS_LENGTH_OUT_OF_RANGE;
+    }
+
+    memcpy(buf, sim_nvds[tag].data, sim_nvds[tag].len);
+    *lengthPtr = sim_nvds[tag].len;
+    sim_stats.nvds_rd_bytes += sim_nvds[tag].len;
+    sim_stats.spi_rd_bytes += SIM_SPI_CMD_BYTES + sim_nvds[tag].len;
+
+    return NVDS_OK;
+}
+
+uint8_t nvds_put(uint8_t tag, nvds_tag_len_t length, uint8_t *buf)
+{
+    if (!sim_nvds_writable(tag))
+        return NVDS_FAIL;
+
+    sim_nvds[tag].set = true;
+    sim_nvds[tag].len = length;
+    memcpy(sim_nvds[tag].data, buf, length);
+    sim_stats.nvds_puts++;
+    sim_stats.nvds_wr_bytes += SIM_NVDS_REC_HDR + length;
+
+    return NVDS_OK;
+}
+
+uint8_t nvds_del(uint8_t tag)
+{
+    if (!sim_nvds_writable(tag))
+        return NVDS_FAIL;
+
+    // A deletion record, only if the TAG is defined
+    if (sim_nvds[tag].set)
+    {
+        sim_nvds[tag].set = false;
+        sim_stats.nvds_wr_bytes += SIM_NVDS_REC_HDR;
+    }
+
+    return NVDS_OK;
+}
+
+
+/*
+ * MODEL OF THE PROFILE TASKS AND OF THE APPLICATION
+ ****************************************************************************************
+ */
+
+/// UUID of an attribute of the model
+static void sim_uuid_make(struct sim_att_desc const *att, uint8_t *uuid)
+{
+    uint8_t i;
+
+    for (i = 0; i < att->uuid_len; i++)
+        uuid[i] = (i < 2) ? (uint8_t)(att->uuid >> (8 * i)) : (uint8_t)(0xA0 + i);
+}
+
+/// Initial value of an attribute of the model
+static void sim_value_make(uint16_t hdl, uint16_t length, uint8_t *value)
+{
+    uint16_t i;
+
+    for (i = 0; i < length; i++)
+        value[i] = (uint8_t)(hdl * 31 + i * 7);
+}
+
+/// app_db_init() of app.c, with app_db_init_func() of the keyboard
+static bool sim_app_db_init(void)
+{
+    if ((sim_app.boot == SIM_BOOT_IMAGE) && (sim_app.next_prf == 0))
+    {
+        // Complete database from the image, no service to add
+        if (app_db_image_restore())
+        {
+            sim_app.next_prf = SIM_PRF_NB;
+            sim_app.restored = true;
+            return true;
+        }
+
+        app_db_image_start();
+    }
+
+    if (sim_app.next_prf < SIM_PRF_NB)
+    {
+        void *req = ke_msg_alloc(SIM_CREATE_DB_REQ, sim_prfs[sim_app.next_prf].task, TASK_APP, 0);
+
+        ke_msg_send(req);
+        sim_stats.msgs++;
+        sim_app.next_prf++;
+
+        return false;
+    }
+
+    if (sim_app.boot == SIM_BOOT_IMAGE)
+    {
+        app_db_image_save();
+    }
+
+    return true;
+}
+
+/// Service creation by a profile task, then APP_MODULE_INIT_CMP_EVT
+static int sim_prf_create_db_req_handler(ke_msg_id_t const msgid, void const *param,
+                                         ke_task_id_t const dest_id, ke_task_id_t const src_id)
+{
+    struct sim_prf const *prf = sim_prfs;
+    uint8_t nb_att_uuid[3] = {0, 0, 0};
+    uint16_t total_size = 0, shdl = 0, hdl;
+    uint8_t uuid[ATT_UUID_128_LEN];
+    static uint8_t value[HOGPD_REPORT_MAP_MAX_LEN + APP_DB_IMAGE_SIZE];
+    uint8_t i;
+
+    while (prf->task != dest_id)
+        prf++;
+
+    for (i = 0; i < prf->nb_att; i++)
+    {
+        nb_att_uuid[(prf->atts[i].uuid_len == ATT_UUID_16_LEN) ? 0 :
+                    (prf->atts[i].uuid_len == ATT_UUID_32_LEN) ? 1 : 2]++;
+        total_size += prf->atts[i].max_length;
+    }
+    if (prf->task == TASK_HOGPD)
+        total_size += sim_report_map_extra;
+
+    if (attmdb_add_service(&shdl, prf->task, nb_att_uuid[0], nb_att_uuid[1], nb_att_uuid[2],
+                           total_size) == ATT_ERR_NO_ERROR)
+    {
+        for (i = 0; i < prf->nb_att; i++)
+        {
+            struct sim_att_desc att = prf->atts[i];
+
+            if ((prf->task == TASK_HOGPD) && (att.uuid == 0x2A4B))
+            {
+                att.max_length += sim_report_map_extra;
+                att.length += sim_report_map_extra;
+            }
+
+            sim_uuid_make(&att, uuid);
+            attmdb_add_attribute(shdl, att.max_length, att.uuid_len, uuid, att.perm, &hdl);
+
+            if (att.length != 0)
+            {
+                sim_value_make(hdl, att.length, value);
+                attmdb_att_set_value(hdl, att.length, value);
+            }
+        }
+
+        attmdb_svc_set_permission(shdl, PERM(SVC, ENABLE));
+    }
+
+    // Handles kept by the profile
+    for (i = 0; i < prf->env_size; i++)
+        ((uint8_t *) prf->env)[i] = (uint8_t)(shdl + i);
+    ke_state_set(prf->task, 1);
+
+    ke_msg_send(ke_msg_alloc(SIM_CREATE_DB_CFM, TASK_APP, dest_id, 0));
+    sim_stats.msgs++;
+
+    return (KE_MSG_CONSUMED);
+}
+
+/// app_module_init_cmp_evt_handler() of app_task.c
+static int sim_app_create_db_cfm_handler(ke_msg_id_t const msgid, void const *param,
+                                         ke_task_id_t const dest_id, ke_task_id_t const src_id)
+{
+    if (sim_app_db_init())
+    {
+        sim_app.done = true;
+    }
+
+    return (KE_MSG_CONSUMED);
+}
+
+/// Profile task handlers
+static const struct ke_msg_handler sim_prf_default_state[] =
+{
+    {SIM_CREATE_DB_REQ, (ke_msg_func_t) sim_prf_create_db_req_handler},
+};
+
+static const struct ke_state_handler sim_prf_default_handler = KE_STATE_HANDLER(sim_prf_default_state);
+
+static ke_state_t sim_diss_state[1];
+static ke_state_t sim_bass_state[1];
+static ke_state_t sim_hogpd_state[1];
+
+static const struct ke_task_desc sim_diss_desc = {NULL, &sim_prf_default_handler, sim_diss_state, 2, 1};
+static const struct ke_task_desc sim_bass_desc = {NULL, &sim_prf_default_handler, sim_bass_state, 2, 1};
+static const struct ke_task_desc sim_hogpd_desc = {NULL, &sim_prf_default_handler, sim_hogpd_state, 2, 1};
+
+/// Application handlers
+static const struct ke_msg_handler sim_app_default_state[] =
+{
+    {SIM_CREATE_DB_CFM, (ke_msg_func_t) sim_app_create_db_cfm_handler},
+};
+
+static const struct ke_state_handler sim_app_default_handler = KE_STATE_HANDLER(sim_app_default_state);
+
+static ke_state_t sim_app_state[1];
+
+static const struct ke_task_desc sim_app_desc = {NULL, &sim_app_default_handler, sim_app_state, 1, 1};
+
+
+/*
+ * LOCAL FUNCTION DEFINITIONS
+ ****************************************************************************************
+ */
+
+static uint64_t sim_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/// Run the kernel until no message is pending
+static void sim_schedule(void)
+{
+    while (!ke_sleep_check())
+    {
+        ke_event_schedule();
+    }
+}
+
+/// Add a service of n attributes with 16 bits UUIDs, as GAP and GATT do
+static void sim_svc_add(uint16_t task, uint8_t n)
+{
+    uint16_t shdl = 0, hdl;
+    uint8_t uuid[ATT_UUID_16_LEN] = {0x00, 0x28};
+    uint8_t i;
+
+    attmdb_add_service(&shdl, task, n, 0, 0, n * 2);
+    for (i = 0; i < n; i++)
+        attmdb_add_attribute(shdl, 2, ATT_UUID_16_LEN, uuid, PERM(RD, ENABLE), &hdl);
+}
+
+/// Reset, then run app_db_init() until the database is complete, returns the host time
+static uint64_t sim_boot(uint8_t boot)
+{
+    uint32_t i;
+    uint64_t t0;
+
+    sim_db_destroy();
+    memset(&sim_stats, 0, sizeof(sim_stats));
+    memset(&sim_app, 0, sizeof(sim_app));
+    sim_app.boot = boot;
+    for (i = 0; i < SIM_PRF_NB; i++)
+        memset(sim_prfs[i].env, 0, sim_prfs[i].env_size);
+
+    ke_init();
+    ke_task_create(TASK_APP, &sim_app_desc);
+    ke_task_create(TASK_DISS, &sim_diss_desc);
+    ke_task_create(TASK_BASS, &sim_bass_desc);
+    ke_task_create(TASK_HOGPD, &sim_hogpd_desc);
+
+    // GAP and GATT services, created by the stack before the application
+    sim_svc_add(TASK_GAPC, SIM_GAP_NB_ATT + sim_gap_extra);
+    sim_svc_add(TASK_GATTC, SIM_GATT_NB_ATT);
+    memset(&sim_stats, 0, sizeof(sim_stats));
+
+    t0 = sim_now_ns();
+
+    // First APP_MODULE_INIT_CMP_EVT
+    if (sim_app_db_init())
+    {
+        sim_app.done = true;
+    }
+    sim_schedule();
+
+    return sim_now_ns() - t0;
+}
+
+static void sim_put(struct sim_snapshot *s, void const *data, uint32_t len)
+{
+    if (s->len + len <= sizeof(s->data))
+        memcpy(&s->data[s->len], data, len);
+    s->len += len;
+}
+
+/// Services, attributes, environments and states of the profile tasks
+static void sim_snapshot_take(struct sim_snapshot *s)
+{
+    struct attm_svc_db *svc;
+    uint32_t i;
+
+    s->len = 0;
+
+    for (svc = attm_env.db; svc != NULL; svc = svc->next_db)
+    {
+        uint16_t hdl;
+
+        sim_put(s, &svc->start_hdl, sizeof(svc->start_hdl));
+        sim_put(s, &svc->last_hdl, sizeof(svc->last_hdl));
+        sim_put(s, &svc->task_id, sizeof(svc->task_id));
+        sim_put(s, &svc->perm, sizeof(svc->perm));
+        sim_put(s, &sim_svc[svc->start_hdl], sizeof(sim_svc[0]));
+
+        for (hdl = svc->start_hdl; hdl <= svc->last_hdl; hdl++)
+        {
+            struct attm_elmt *elmt = svc->att_elems[hdl - svc->start_hdl];
+
+            sim_put(s, &sim_uuid[hdl], sizeof(sim_uuid[0]));
+            sim_put(s, &elmt->uuid, sizeof(elmt->uuid));
+            sim_put(s, &elmt->perm, sizeof(elmt->perm));
+            sim_put(s, &elmt->max_length, sizeof(elmt->max_length));
+            sim_put(s, &elmt->length, sizeof(elmt->length));
+            sim_put(s, elmt->value, elmt->length);
+        }
+    }
+
+    for (i = 0; i < SIM_PRF_NB; i++)
+    {
+        ke_state_t state = ke_state_get(sim_prfs[i].task);
+
+        sim_put(s, &state, sizeof(state));
+        sim_put(s, sim_prfs[i].env, sim_prfs[i].env_size);
+    }
+}
+
+static void sim_print(const char *name, uint64_t host_ns)
+{
+    printf("%-18s %4u %6u %5u %6u %5u %6u %8.0f %8.0f\n", name, sim_stats.msgs, sim_stats.attm,
+           sim_stats.nvds_gets, sim_stats.nvds_rd_bytes, sim_stats.nvds_puts, sim_stats.nvds_wr_bytes,
+           (double) sim_stats.spi_rd_bytes * SIM_SPI_BYTE_NS / 1000, (double) host_ns / 1000);
+}
+
+/// Boot that must create the services (and save them), with the database of reference
+static int sim_check_created(const char *name, struct sim_snapshot const *ref)
+{
+    static struct sim_snapshot s;
+
+    sim_boot(SIM_BOOT_IMAGE);
+
+    if (!sim_app.done || sim_app.restored)
+    {
+        printf("  FAILED: %s, image used\n", name);
+        return 1;
+    }
+
+    sim_snapshot_take(&s);
+    if ((ref != NULL) && ((s.len != ref->len) || memcmp(s.data, ref->data, s.len)))
+    {
+        printf("  FAILED: %s, database created differs\n", name);
+        return 1;
+    }
+
+    return 0;
+}
+
+/// Boot that must restore the image, with the database of reference
+static int sim_check_restored(const char *name, struct sim_snapshot const *ref)
+{
+    static struct sim_snapshot s;
+
+    sim_boot(SIM_BOOT_IMAGE);
+
+    if (!sim_app.done || !sim_app.restored)
+    {
+        printf("  FAILED: %s, image not used\n", name);
+        return 1;
+    }
+
+    sim_snapshot_take(&s);
+    if ((s.len > sizeof(s.data)) || (s.len != ref->len) || memcmp(s.data, ref->data, s.len))
+    {
+        printf("  FAILED: %s, database restored differs\n", name);
+        return 1;
+    }
+
+    return 0;
+}
+
+/// Timed boots of one kind
+static uint64_t sim_timed(uint8_t boot, uint32_t repeat, bool clear)
+{
+    uint64_t total = 0;
+    uint32_t r;
+
+    for (r = 0; r < repeat; r++)
+    {
+        if (clear)
+            app_db_image_clear();
+        total += sim_boot(boot);
+    }
+
+    return total / repeat;
+}
+
+
+/*
+ * MAIN
+ ****************************************************************************************
+ */
+
+int main(int argc, char **argv)
+{
+    uint32_t repeat = (argc > 1) ? strtoul(argv[1], NULL, 0) : SIM_REPEAT;
+    static struct sim_snapshot ref;
+    uint64_t ns;
+    int err = 0;
+    uint8_t tag;
+
+    printf("db_image_sim: %u profiles, image of %d chunks of %d bytes, flash reads at 2MHz\n",
+           (uint32_t) SIM_PRF_NB, APP_DB_IMAGE_NB_CHUNK, APP_DB_IMAGE_CHUNK_SIZE);
+    printf("boot               msgs   attm  gets rd_bytes puts wr_bytes flash_us  host_us\n");
+
+    // Reference: firmware without the image
+    ns = sim_timed(SIM_BOOT_NO_IMAGE, repeat, false);
+    sim_print("without image", ns);
+    if (!sim_app.done)
+    {
+        printf("  FAILED: database not created\n");
+        return 1;
+    }
+    sim_snapshot_take(&ref);
+    if (ref.len > sizeof(ref.data))
+    {
+        printf("  FAILED: snapshot too big\n");
+        return 1;
+    }
+
+    // First boot, creation then save
+    ns = sim_timed(SIM_BOOT_IMAGE, repeat, true);
+    sim_print("first boot", ns);
+    if (sim_app.restored || !sim_nvds[NVDS_TAG_APP_DB_IMAGE_FIRST].set)
+    {
+        printf("  FAILED: image not saved\n");
+        err = 1;
+    }
+
+    // Then restore from the image
+    ns = sim_timed(SIM_BOOT_IMAGE, repeat, false);
+    sim_print("restore", ns);
+    err |= sim_check_restored("restore", &ref);
+
+    // Chunk corrupted: created, saved again, then restored
+    sim_nvds[NVDS_TAG_APP_DB_IMAGE_FIRST + 2].data[5] ^= 0x40;
+    err |= sim_check_created("corrupted chunk", &ref);
+    err |= sim_check_restored("after corruption", &ref);
+
+    // Chunk missing
+    sim_nvds[NVDS_TAG_APP_DB_IMAGE_FIRST + 1].set = false;
+    err |= sim_check_created("missing chunk", &ref);
+    err |= sim_check_restored("after missing chunk", &ref);
+
+    // Header of another version of the database content (version field, last of the header)
+    sim_nvds[NVDS_TAG_APP_DB_IMAGE_FIRST].data[sim_nvds[NVDS_TAG_APP_DB_IMAGE_FIRST].len - 2]++;
+    err |= sim_check_created("other version", &ref);
+    err |= sim_check_restored("after version", &ref);
+
+    // GAP and GATT end at another handle: created at other handles
+    sim_gap_extra = 1;
+    err |= sim_check_created("other first handle", NULL);
+    sim_gap_extra = 0;
+    err |= sim_check_created("first handle back", &ref);
+    err |= sim_check_restored("after first handle", &ref);
+
+    // Database too big (new firmware, the image is cleared): created at each boot, no
+    // chunk written
+    sim_report_map_extra = APP_DB_IMAGE_SIZE;
+    app_db_image_clear();
+    err |= sim_check_created("too big", NULL);
+    if (sim_stats.nvds_puts != 0)
+    {
+        printf("  FAILED: %u TAGs written for a database too big\n", sim_stats.nvds_puts);
+        err = 1;
+    }
+    err |= sim_check_created("too big again", NULL);
+    sim_report_map_extra = 0;
+
+    for (tag = NVDS_TAG_APP_DB_IMAGE_FIRST; tag <= NVDS_TAG_APP_DB_IMAGE_LAST; tag++)
+    {
+        if (!sim_nvds_writable(tag))
+        {
+            printf("  FAILED: TAG %02X not in NVDS_FLASH_TAGS\n", tag);
+            err = 1;
+        }
+    }
+
+    printf("%s\n", err ? "FAILED" : "database restored identical, invalid images refused");
+
+    sim_db_destroy();
+
+    return err;
+}
@@ -0,0 +1,25 @@
+/**
+ ****************************************************************************************
+ *
+ * @file da14580_config.h
+ *
+ * @brief Compile configuration file of the GTL transport benchmark (host build).
+ *
+ ****************************************************************************************
+ */
+
+#ifndef DA14580_CONFIG_H_
+#define DA14580_CONFIG_H_
+
+/////////////////////////////////////////////////////////////
+/*Host (off-target) build of the kernel*/
+#define CFG_KE_HOST
+/////////////////////////////////////////////////////////////
+
+/*Generic Transport Layer, no embedded controller*/
+#define CFG_GTL
+
+/*Maximum user connections*/
+#define BLE_CONNECTION_MAX_USER 1
+
+#endif // DA14580_CONFIG_H_
@@ -0,0 +1,801 @@
+/**
+ ****************************************************************************************
+ *
+ * @file gtl_bench.c
+ *
+ * @brief Benchmark of the GTL transport (custom_gtl_eif.c) over a pseudo-terminal.
+ *
+ * The UART of the transport is the master side of a pty, the external host reads and
+ * writes the slave side. The GTL task of the ROM is modelled: gtl_send_msg() sends a
+ * kernel message, and the messages sent to TASK_GTL while a transfer is ongoing wait
+ * in gtl_env.tx_queue. The UART interrupts are raised from the main loop, once the bytes
+ * of a transfer went through the pty.
+ *
+ * Sends bursts of kernel messages to the external host, which decodes the frames and
+ * checks the messages, then has the external host send messages to the application
+ * (half of them in batch frames with CFG_GTL_BATCH). Reports the messages per second
+ * measured through the pty, the latency of the messages (from ke_msg_send() to their
+ * decoding by the external host, from the write of their frame to the application
+ * handler), the number of UART transfers and of bytes per message, and the messages per
+ * second the bytes per message allow at BENCH_BAUD_RATE. Built once with and once
+ * without CFG_GTL_BATCH.
+ *
+ * Usage: gtl_bench [messages]
+ *
+ ****************************************************************************************
+ */
+
+/*
+ * INCLUDE FILES
+ ****************************************************************************************
+ */
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "rwip_config.h"
+#include "arch.h"
+#include "co_list.h"
+#include "ke.h"
+#include "ke_event.h"
+#include "ke_mem.h"
+#include "ke_msg.h"
+#include "ke_task.h"
+#include "rwip.h"
+#include "gtl.h"
+#include "gtl_env.h"
+#include "gtl_eif.h"
+#include "gtl_task.h"
+
+
+/*
+ * DEFINES
+ ****************************************************************************************
+ */
+
+/// Default number of messages per test
+#define BENCH_MESSAGES          (20000)
+
+/// Messages sent to the external host, and received from it
+#define BENCH_MSG_TX            (KE_FIRST_MSG(TASK_APP) + 0)
+#define BENCH_MSG_RX            (KE_FIRST_MSG(TASK_APP) + 1)
+
+/// Parameter length of a message, from 4 to 20 bytes (notifications, indications)
+#define BENCH_PARAM_LEN(seq)    (4 + ((seq) % 5) * 4)
+
+/// Size of the external host buffers
+#define BENCH_HOST_BUF_SIZE     (4096)
+
+/// Main loop iterations without progress before a test is declared stuck
+#define BENCH_STUCK             (1000000)
+
+/// UART baud rate used for the projected throughput
+#define BENCH_BAUD_RATE         (115200)
+
+
+/*
+ * LOCAL FUNCTION DECLARATIONS
+ ****************************************************************************************
+ */
+
+static int bench_gtl_handler(ke_msg_id_t const msgid, void const *param,
+                             ke_task_id_t const dest_id, ke_task_id_t const src_id);
+static int bench_app_handler(ke_msg_id_t const msgid, void const *param,
+                             ke_task_id_t const dest_id, ke_task_id_t const src_id);
+
+static void bench_uart_read(uint8_t *bufptr, uint32_t size, rwip_eif_callback callback);
+static void bench_uart_write(uint8_t *bufptr, uint32_t size, rwip_eif_callback callback);
+static void bench_uart_flow_on(void);
+static bool bench_uart_flow_off(void);
+
+/// RAM implementation of gtl_eif_init(), called by the ROM through the jump table
+void gtl_eif_init_func(void);
+
+
+/*
+ * GLOBAL VARIABLES
+ ****************************************************************************************
+ */
+
+/// ROM jump table, not used by the transport functions called here
+const uint32_t * const jump_table_base[88];
+
+/// Sleep prevention bits set by the transport
+static uint16_t bench_prevent_sleep;
+
+/// UART model
+static struct
+{
+    /// UART side of the pty
+    int fd;
+    /// Transfer being sent, bytes left and completion callback
+    uint8_t *tx_buf;
+    uint32_t tx_len;
+    rwip_eif_callback tx_cb;
+    /// Reception in progress, bytes left and completion callback
+    uint8_t *rx_buf;
+    uint32_t rx_len;
+    rwip_eif_callback rx_cb;
+    /// Statistics
+    uint32_t tx_transfers;
+    uint32_t tx_bytes;
+    uint32_t rx_transfers;
+} bench_uart;
+
+/// External interface of the transport
+static const struct rwip_eif_api bench_uart_api =
+{
+    bench_uart_read,
+    bench_uart_write,
+    bench_uart_flow_on,
+    bench_uart_flow_off,
+};
+
+/// External host, on the slave side of the pty
+static struct
+{
+    int fd;
+    /// Bytes received and not decoded yet
+    uint8_t buf[BENCH_HOST_BUF_SIZE];
+    uint32_t len;
+    /// Messages received (sequence number of the next one)
+    uint32_t msg_cnt;
+    /// Frames received
+    uint32_t frame_cnt;
+    /// Decoding errors
+    uint32_t err;
+} bench_host;
+
+/// Messages received by the application, errors
+static uint32_t bench_app_cnt;
+static uint32_t bench_app_err;
+
+/// Latency of the messages of a test, by sequence number
+static struct
+{
+    /// Time the message was queued (ke_msg_send() or write of its frame to the pty)
+    uint64_t *queued_ns;
+    /// Time from queued to received
+    uint64_t *latency_ns;
+    /// Messages of the test
+    uint32_t count;
+} bench_lat;
+
+/// Handlers of the modelled GTL task
+static const struct ke_msg_handler bench_gtl_default_handler[] =
+{
+    {KE_MSG_DEFAULT_HANDLER, (ke_msg_func_t) bench_gtl_handler},
+};
+
+static const struct ke_state_handler bench_gtl_default_state_handler = KE_STATE_HANDLER(bench_gtl_default_handler);
+
+static ke_state_t bench_gtl_state[GTL_IDX_MAX];
+
+static const struct ke_task_desc bench_gtl_task_desc =
+    {NULL, &bench_gtl_default_state_handler, bench_gtl_state, GTL_STATE_MAX, GTL_IDX_MAX};
+
+/// Handlers of the application task
+static const struct ke_msg_handler bench_app_default_handler[] =
+{
+    {KE_MSG_DEFAULT_HANDLER, (ke_msg_func_t) bench_app_handler},
+};
+
+static const struct ke_state_handler bench_app_default_state_handler = KE_STATE_HANDLER(bench_app_default_handler);
+
+static ke_state_t bench_app_state[1];
+
+static const struct ke_task_desc bench_app_task_desc =
+    {NULL, &bench_app_default_state_handler, bench_app_state, 0, 1};
+
+
+/*
+ * ROM MODEL
+ ****************************************************************************************
+ */
+
+void gtl_send_msg(struct ke_msg *msg)
+{
+    ke_state_set(TASK_GTL, GTL_TX_ONGOING);
+    gtl_env.p_msg_tx = msg;
+
+    gtl_eif_write(GTL_KE_MSG_TYPE, (uint8_t *) &msg->id, KE_MSG_HDR_LEN + msg->param_len);
+}
+
+/// GTL task: sends the message, or queues it while a transfer is ongoing
+static int bench_gtl_handler(ke_msg_id_t const msgid, void const *param,
+                             ke_task_id_t const dest_id, ke_task_id_t const src_id)
+{
+    struct ke_msg *msg = ke_param2msg(param);
+
+    if (ke_state_get(TASK_GTL) == GTL_TX_IDLE)
+    {
+        gtl_send_msg(msg);
+    }
+    else
+    {
+        co_list_push_back(&gtl_env.tx_queue, &msg->hdr);
+    }
+
+    return (KE_MSG_NO_FREE);
+}
+
+void rwip_prevent_sleep_set(uint16_t prv_slp_bit)
+{
+    bench_prevent_sleep |= prv_slp_bit;
+}
+
+void rwip_prevent_sleep_clear(uint16_t prv_slp_bit)
+{
+    bench_prevent_sleep &= ~prv_slp_bit;
+}
+
+bool rwip_sleep_enable(void)
+{
+    return false;
+}
+
+bool rwip_ext_wakeup_enable(void)
+{
+    return false;
+}
+
+
+/*
+ * UART MODEL
+ ****************************************************************************************
+ */
+
+static void bench_uart_read(uint8_t *bufptr, uint32_t size, rwip_eif_callback callback)
+{
+    bench_uart.rx_buf = bufptr;
+    bench_uart.rx_len = size;
+    bench_uart.rx_cb = callback;
+    bench_uart.rx_transfers++;
+}
+
+static void bench_uart_write(uint8_t *bufptr, uint32_t size, rwip_eif_callback callback)
+{
+    bench_uart.tx_buf = bufptr;
+    bench_uart.tx_len = size;
+    bench_uart.tx_cb = callback;
+    bench_uart.tx_transfers++;
+    bench_uart.tx_bytes += size;
+}
+
+static void bench_uart_flow_on(void)
+{
+}
+
+static bool bench_uart_flow_off(void)
+{
+    return true;
+}
+
+/**
+ ****************************************************************************************
+ * @brief UART interrupt: moves the bytes through the pty and calls the callback of a
+ * finished transfer.
+ *
+ * @return true if a byte was moved
+ ****************************************************************************************
+ */
+static bool bench_uart_isr(void)
+{
+    bool progress = false;
+    ssize_t n;
+
+    if (bench_uart.tx_cb != NULL)
+    {
+        n = write(bench_uart.fd, bench_uart.tx_buf, bench_uart.tx_len);
+        if (n > 0)
+        {
+            bench_uart.tx_buf += n;
+            bench_uart.tx_len -= n;
+            progress = true;
+        }
+        if (bench_uart.tx_len == 0)
+        {
+            rwip_eif_callback cb = bench_uart.tx_cb;
+
+            bench_uart.tx_cb = NULL;
+            cb(RWIP_EIF_STATUS_OK);
+        }
+    }
+
+    // The transport starts the next reception from the callback
+    while (bench_uart.rx_cb != NULL)
+    {
+        n = read(bench_uart.fd, bench_uart.rx_buf, bench_uart.rx_len);
+        if (n <= 0)
+        {
+            break;
+        }
+
+        bench_uart.rx_buf += n;
+        bench_uart.rx_len -= n;
+        progress = true;
+
+        if (bench_uart.rx_len == 0)
+        {
+            rwip_eif_callback cb = bench_uart.rx_cb;
+
+            bench_uart.rx_cb = NULL;
+            cb(RWIP_EIF_STATUS_OK);
+        }
+    }
+
+    return progress;
+}
+
+
+/*
+ * LATENCY
+ ****************************************************************************************
+ */
+
+static uint64_t bench_now_ns(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t) now.tv_sec * 1000000000u + now.tv_nsec;
+}
+
+static void bench_lat_queued(uint32_t seq, uint64_t now)
+{
+    if (seq < bench_lat.count)
+    {
+        bench_lat.queued_ns[seq] = now;
+    }
+}
+
+static void bench_lat_received(uint32_t seq)
+{
+    if (seq < bench_lat.count)
+    {
+        bench_lat.latency_ns[seq] = bench_now_ns() - bench_lat.queued_ns[seq];
+    }
+}
+
+static int bench_lat_cmp(void const *a, void const *b)
+{
+    uint64_t x = *(uint64_t const *) a;
+    uint64_t y = *(uint64_t const *) b;
+
+    return (x > y) - (x < y);
+}
+
+/// Print the average, 99th percentile and maximum latency of the messages of the test
+static void bench_lat_print(uint32_t count)
+{
+    uint64_t sum = 0;
+    uint32_t i;
+
+    qsort(bench_lat.latency_ns, count, sizeof(uint64_t), bench_lat_cmp);
+
+    for (i = 0; i < count; i++)
+    {
+        sum += bench_lat.latency_ns[i];
+    }
+
+    printf("latency %7.1f avg %7.1f p99 %8.1f max us",
+           (double) sum / count / 1000, (double) bench_lat.latency_ns[(count - 1) * 99 / 100] / 1000,
+           (double) bench_lat.latency_ns[count - 1] / 1000);
+}
+
+
+/*
+ * EXTERNAL HOST
+ ****************************************************************************************
+ */
+
+static uint16_t bench_read16(uint8_t const *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static void bench_write16(uint8_t *p, uint16_t v)
+{
+    p[0] = v & 0xFF;
+    p[1] = v >> 8;
+}
+
+/// Check a kernel message (header and parameters) sent by the transport
+static void bench_host_msg(uint8_t const *p)
+{
+    uint32_t seq = bench_host.msg_cnt++;
+    uint32_t val;
+
+    bench_lat_received(seq);
+
+    memcpy(&val, &p[KE_MSG_HDR_LEN], sizeof(val));
+
+    if ((bench_read16(&p[0]) != BENCH_MSG_TX) || (bench_read16(&p[4]) != TASK_APP)
+        || (bench_read16(&p[6]) != BENCH_PARAM_LEN(seq)) || (val != seq))
+    {
+        bench_host.err++;
+    }
+}
+
+/**
+ ****************************************************************************************
+ * @brief Read the bytes sent by the transport and decode the complete frames.
+ *
+ * @return true if a byte was read
+ ****************************************************************************************
+ */
+static bool bench_host_poll(void)
+{
+    uint8_t *p = bench_host.buf;
+    ssize_t n;
+
+    n = read(bench_host.fd, &bench_host.buf[bench_host.len], BENCH_HOST_BUF_SIZE - bench_host.len);
+    if (n <= 0)
+    {
+        return false;
+    }
+    bench_host.len += n;
+
+    while (bench_host.len > 0)
+    {
+        uint32_t need;
+
+        if (p[0] == GTL_KE_MSG_TYPE)
+        {
+            if (bench_host.len < 1 + KE_MSG_HDR_LEN)
+            {
+                break;
+            }
+            need = 1 + KE_MSG_HDR_LEN + bench_read16(&p[7]);
+            if (bench_host.len < need)
+            {
+                break;
+            }
+            bench_host_msg(&p[1]);
+        }
+        #if (GTL_BATCH)
+        else if (p[0] == GTL_BATCH_MSG_TYPE)
+        {
+            uint32_t off = GTL_BATCH_HDR_LEN;
+            int i;
+
+            if (bench_host.len < GTL_BATCH_HDR_LEN)
+            {
+                break;
+            }
+            need = GTL_BATCH_HDR_LEN + bench_read16(&p[2]);
+            if (bench_host.len < need)
+            {
+                break;
+            }
+            for (i = 0; (i < p[1]) && (off + KE_MSG_HDR_LEN <= need); i++)
+            {
+                bench_host_msg(&p[off]);
+                off += KE_MSG_HDR_LEN + bench_read16(&p[off + 6]);
+            }
+            if ((i != p[1]) || (off != need))
+            {
+                bench_host.err++;
+            }
+        }
+        #endif // GTL_BATCH
+        else
+        {
+            // Lost synchronization, nothing to resume from
+            bench_host.err++;
+            bench_host.len = 0;
+            break;
+        }
+
+        bench_host.frame_cnt++;
+        p += need;
+        bench_host.len -= need;
+    }
+
+    memmove(bench_host.buf, p, bench_host.len);
+
+    return true;
+}
+
+/// Build a kernel message for the application, returns its length
+static uint32_t bench_host_build(uint8_t *p, uint32_t seq)
+{
+    bench_write16(&p[0], BENCH_MSG_RX);
+    bench_write16(&p[2], TASK_APP);
+    bench_write16(&p[4], TASK_GTL);
+    bench_write16(&p[6], BENCH_PARAM_LEN(seq));
+    memset(&p[KE_MSG_HDR_LEN], 0, BENCH_PARAM_LEN(seq));
+    memcpy(&p[KE_MSG_HDR_LEN], &seq, sizeof(seq));
+
+    return KE_MSG_HDR_LEN + BENCH_PARAM_LEN(seq);
+}
+
+
+/*
+ * LOCAL FUNCTION DEFINITIONS
+ ****************************************************************************************
+ */
+
+static int bench_app_handler(ke_msg_id_t const msgid, void const *param,
+                             ke_task_id_t const dest_id, ke_task_id_t const src_id)
+{
+    struct ke_msg *msg = ke_param2msg(param);
+    uint32_t seq = bench_app_cnt++;
+
+    bench_lat_received(seq);
+
+    if ((msgid != BENCH_MSG_RX) || (src_id != TASK_GTL) || (msg->param_len != BENCH_PARAM_LEN(seq))
+        || memcmp(param, &seq, sizeof(seq)))
+    {
+        bench_app_err++;
+    }
+
+    return (KE_MSG_CONSUMED);
+}
+
+/**
+ ****************************************************************************************
+ * @brief Run the kernel, the UART and the external host until *count reaches target.
+ *
+ * @return 0 if the target was reached, 1 if the test is stuck
+ ****************************************************************************************
+ */
+static int bench_run_until(uint32_t const *count, uint32_t target)
+{
+    uint32_t idle = 0;
+
+    while (*count < target)
+    {
+        bool progress = false;
+
+        while (!ke_sleep_check())
+        {
+            ke_event_schedule();
+            progress = true;
+        }
+
+        progress |= bench_uart_isr();
+        progress |= bench_host_poll();
+
+        idle = progress ? 0 : (idle + 1);
+        if (idle > BENCH_STUCK)
+        {
+            printf("  FAILED: stuck at %u of %u messages\n", *count, target);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ ****************************************************************************************
+ * @brief Send messages to the external host in bursts.
+ *
+ * @param[in] burst     Number of messages sent before the kernel runs
+ * @param[in] count     Number of messages
+ *
+ * @return 0 if all messages were received in order and freed, 1 otherwise
+ ****************************************************************************************
+ */
+static int bench_tx(int burst, uint32_t count)
+{
+    uint64_t start, elapsed;
+    uint32_t transfers = bench_uart.tx_transfers;
+    uint32_t bytes = bench_uart.tx_bytes;
+    uint32_t sent = 0;
+    double bytes_per_msg;
+    int err = 0;
+    int i;
+
+    bench_host.len = 0;
+    bench_host.msg_cnt = 0;
+    bench_host.frame_cnt = 0;
+    bench_host.err = 0;
+
+    start = bench_now_ns();
+
+    while ((sent < count) && !err)
+    {
+        for (i = 0; (i < burst) && (sent < count); i++, sent++)
+        {
+            uint8_t *param = ke_msg_alloc(BENCH_MSG_TX, TASK_GTL, TASK_APP, BENCH_PARAM_LEN(sent));
+
+            memset(param, 0, BENCH_PARAM_LEN(sent));
+            memcpy(param, &sent, sizeof(sent));
+            bench_lat_queued(sent, bench_now_ns());
+            ke_msg_send(param);
+        }
+
+        err = bench_run_until(&bench_host.msg_cnt, sent);
+    }
+
+    elapsed = bench_now_ns() - start;
+
+    // Let the transport go back to idle
+    while (!ke_sleep_check())
+    {
+        ke_event_schedule();
+    }
+
+    transfers = bench_uart.tx_transfers - transfers;
+    bytes = bench_uart.tx_bytes - bytes;
+    bytes_per_msg = (double) bytes / count;
+
+    printf("tx, burst %-3d %8.0f msg/s, ", burst, count * 1e9 / elapsed);
+    bench_lat_print(count);
+    printf(", %5.2f msg/transfer, %5.2f bytes/msg, %6.0f msg/s at %d baud\n",
+           (double) count / transfers, bytes_per_msg, BENCH_BAUD_RATE / 10 / bytes_per_msg, BENCH_BAUD_RATE);
+
+    if (err || bench_host.err || (bench_host.msg_cnt != count) || (bench_host.len != 0)
+        || (ke_state_get(TASK_GTL) != GTL_TX_IDLE) || !co_list_is_empty(&gtl_env.tx_queue)
+        || !ke_mem_is_empty(KE_MEM_KE_MSG))
+    {
+        printf("  FAILED: %u of %u messages received, %u errors, heap %s\n", bench_host.msg_cnt,
+               count, bench_host.err, ke_mem_is_empty(KE_MEM_KE_MSG) ? "empty" : "not empty");
+        return 1;
+    }
+
+    return 0;
+}
+
+/**
+ ****************************************************************************************
+ * @brief Have the external host send messages to the application, alternately alone
+ * and in a batch frame of burst messages (alone only without GTL_BATCH).
+ *
+ * @return 0 if all messages were received in order and freed, 1 otherwise
+ ****************************************************************************************
+ */
+static int bench_rx(int burst, uint32_t count)
+{
+    uint8_t frame[BENCH_HOST_BUF_SIZE];
+    uint64_t start, elapsed, now;
+    uint32_t transfers = bench_uart.rx_transfers;
+    uint32_t bytes = 0;
+    uint32_t sent = 0;
+    bool batch = false;
+    int err = 0;
+
+    bench_app_cnt = 0;
+    bench_app_err = 0;
+
+    start = bench_now_ns();
+
+    while ((sent < count) && !err)
+    {
+        uint32_t first = sent;
+        uint32_t len;
+
+        #if (GTL_BATCH)
+        if (batch)
+        {
+            int i;
+
+            len = GTL_BATCH_HDR_LEN;
+            for (i = 0; (i < burst) && (sent < count); i++, sent++)
+            {
+                len += bench_host_build(&frame[len], sent);
+            }
+            frame[0] = GTL_BATCH_MSG_TYPE;
+            frame[1] = i;
+            bench_write16(&frame[2], len - GTL_BATCH_HDR_LEN);
+        }
+        else
+        #endif // GTL_BATCH
+        {
+            frame[0] = GTL_KE_MSG_TYPE;
+            len = 1 + bench_host_build(&frame[1], sent++);
+        }
+        batch = !batch;
+
+        for (now = bench_now_ns(); first < sent; first++)
+        {
+            bench_lat_queued(first, now);
+        }
+
+        if (write(bench_host.fd, frame, len) != (ssize_t) len)
+        {
+            printf("  FAILED: pty write\n");
+            return 1;
+        }
+        bytes += len;
+
+        err = bench_run_until(&bench_app_cnt, sent);
+    }
+
+    elapsed = bench_now_ns() - start;
+
+    printf("rx, burst %-3d %8.0f msg/s, ", GTL_BATCH ? burst : 1, count * 1e9 / elapsed);
+    bench_lat_print(count);
+    printf(", %5.2f reads/msg,    %5.2f bytes/msg\n",
+           (double)(bench_uart.rx_transfers - transfers) / count, (double) bytes / count);
+
+    if (err || bench_app_err || (bench_app_cnt != count) || !ke_mem_is_empty(KE_MEM_KE_MSG))
+    {
+        printf("  FAILED: %u of %u messages received, %u errors\n", bench_app_cnt, count, bench_app_err);
+        return 1;
+    }
+
+    return 0;
+}
+
+/// Open the pty, in raw mode and non-blocking on both sides
+static int bench_pty_open(void)
+{
+    struct termios tio;
+
+    bench_uart.fd = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if ((bench_uart.fd < 0) || grantpt(bench_uart.fd) || unlockpt(bench_uart.fd))
+    {
+        return -1;
+    }
+
+    bench_host.fd = open(ptsname(bench_uart.fd), O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if ((bench_host.fd < 0) || tcgetattr(bench_host.fd, &tio))
+    {
+        return -1;
+    }
+
+    cfmakeraw(&tio);
+
+    return tcsetattr(bench_host.fd, TCSANOW, &tio);
+}
+
+
+/*
+ * MAIN
+ ****************************************************************************************
+ */
+
+int main(int argc, char **argv)
+{
+    uint32_t count = (argc > 1) ? strtoul(argv[1], NULL, 0) : BENCH_MESSAGES;
+    int err = 0;
+
+    if (bench_pty_open())
+    {
+        perror("gtl_bench: pty");
+        return 1;
+    }
+
+    bench_lat.queued_ns = calloc(count, sizeof(uint64_t));
+    bench_lat.latency_ns = calloc(count, sizeof(uint64_t));
+    bench_lat.count = count;
+    if ((count == 0) || (bench_lat.queued_ns == NULL) || (bench_lat.latency_ns == NULL))
+    {
+        printf("gtl_bench: cannot run %u messages\n", count);
+        return 1;
+    }
+
+    ke_init();
+    ke_task_create(TASK_GTL, &bench_gtl_task_desc);
+    ke_task_create(TASK_APP, &bench_app_task_desc);
+    ke_state_set(TASK_GTL, GTL_TX_IDLE);
+
+    memset(&gtl_env, 0, sizeof(gtl_env));
+    gtl_env.ext_if = &bench_uart_api;
+    gtl_eif_init_func();
+
+    printf("gtl_bench: %u messages per test, %s\n", count,
+           GTL_BATCH ? "batch frames" : "single messages");
+
+    err |= bench_tx(1, count);
+    err |= bench_tx(4, count);
+    err |= bench_tx(16, count);
+    err |= bench_rx(8, count);
+
+    if (bench_prevent_sleep != 0)
+    {
+        printf("  FAILED: sleep prevented (0x%04X)\n", bench_prevent_sleep);
+        err = 1;
+    }
+
+    return err;
+}
@@ -0,0 +1,15 @@
+/**
+ ****************************************************************************************
+ *
+ * @file customer_prod.h
+ *
+ * @brief Empty replacement of the production test header included by custom_gtl_eif.c,
+ * which the transport does not use without the embedded controller (host build).
+ *
+ ****************************************************************************************
+ */
+
+#ifndef CUSTOMER_PROD_H_
+#define CUSTOMER_PROD_H_
+
+#endif // CUSTOMER_PROD_H_
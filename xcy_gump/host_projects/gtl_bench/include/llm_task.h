@@ -0,0 +1,15 @@
+/**
+ ****************************************************************************************
+ *
+ * @file llm_task.h
+ *
+ * @brief Empty replacement of the production test header included by custom_gtl_eif.c,
+ * which the transport does not use without the embedded controller (host build).
+ *
+ ****************************************************************************************
+ */
+
+#ifndef LLM_TASK_H_
+#define LLM_TASK_H_
+
+#endif // LLM_TASK_H_
@@ -0,0 +1,15 @@
+/**
+ ****************************************************************************************
+ *
+ * @file pll_vcocal_lut.h
+ *
+ * @brief Empty replacement of the production test header included by custom_gtl_eif.c,
+ * which the transport does not use without the embedded controller (host build).
+ *
+ ****************************************************************************************
+ */
+
+#ifndef PLL_VCOCAL_LUT_H_
+#define PLL_VCOCAL_LUT_H_
+
+#endif // PLL_VCOCAL_LUT_H_
@@ -0,0 +1,15 @@
+/**
+ ****************************************************************************************
+ *
+ * @file rf_580.h
+ *
+ * @brief Empty replacement of the production test header included by custom_gtl_eif.c,
+ * which the transport does not use without the embedded controller (host build).
+ *
+ ****************************************************************************************
+ */
+
+#ifndef RF_580_H_
+#define RF_580_H_
+
+#endif // RF_580_H_
@@ -0,0 +1,46 @@
+/**
+ ****************************************************************************************
+ *
+ * @file da14580_config.h
+ *
+ * @brief Compile configuration file of the keyboard scanning simulator (host build).
+ *
+ * Same profile set as the keyboard application, the scanning code is built unchanged.
+ *
+ ****************************************************************************************
+ */
+
+#ifndef DA14580_CONFIG_H_
+#define DA14580_CONFIG_H_
+
+/////////////////////////////////////////////////////////////
+/*Host (off-target) build of the kernel*/
+#define CFG_KE_HOST
+/////////////////////////////////////////////////////////////
+
+/*Peripheral role with the host and the controller*/
+#define CFG_BLE
+#define CFG_HOST
+#define CFG_EMB
+#define CFG_APP
+#define CFG_PERIPHERAL          1
+#define CFG_CON                 1
+#define CFG_ATTS
+#define CFG_BLECORE_11
+#define CFG_SLEEP
+
+/*Security*/
+#define CFG_SECURITY_ON         1
+#define CFG_APP_SEC
+
+/*Keyboard application with the HID profile*/
+#define CFG_APP_KEYBOARD
+#define CFG_PRF_HOGPD           1
+
+/*Maximum user connections*/
+#define BLE_CONNECTION_MAX_USER 1
+
+/*No breakpoints in the application code*/
+#define DEVELOPMENT__NO_OTP     0
+
+#endif // DA14580_CONFIG_H_
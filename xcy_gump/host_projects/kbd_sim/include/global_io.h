@@ -0,0 +1,42 @@
+/**
+ ****************************************************************************************
+ *
+ * @file global_io.h
+ *
+ * @brief Register access of the keyboard scanning simulator (host build).
+ *
+ * Includes the real global_io.h, then routes the 16-bit and 32-bit register accessors,
+ * and the bit field accessors built on them, to the models of kbd_sim.c: the GPIO ports
+ * on the key matrix and SysTick. The NVIC functions of the ARM core are modelled too.
+ *
+ ****************************************************************************************
+ */
+
+#ifndef KBD_SIM_GLOBAL_IO_H_
+#define KBD_SIM_GLOBAL_IO_H_
+
+#include_next "global_io.h"
+
+#undef SetWord16
+#undef GetWord16
+#undef SetWord32
+#undef GetWord32
+
+#define SetWord16(a,d)      sim_reg_write((a), (d))
+#define GetWord16(a)        ((uint16)sim_reg_read(a))
+#define SetWord32(a,d)      sim_reg_write((a), (d))
+#define GetWord32(a)        sim_reg_read(a)
+
+/// Write a register of the model
+void sim_reg_write(uint32 addr, uint32 data);
+
+/// Read a register of the model
+uint32 sim_reg_read(uint32 addr);
+
+/// NVIC of the model
+void NVIC_EnableIRQ(IRQn_Type irq);
+void NVIC_DisableIRQ(IRQn_Type irq);
+void NVIC_ClearPendingIRQ(IRQn_Type irq);
+void NVIC_SetPriority(IRQn_Type irq, uint32 priority);
+
+#endif // KBD_SIM_GLOBAL_IO_H_
@@ -0,0 +1,1673 @@
+/**
+ ****************************************************************************************
+ *
+ * @file kbd_sim.c
+ *
+ * @brief Keyboard scanning simulator on the host build.
+ *
+ * Runs the scanning code of the keyboard application (app_kbd.c) on a model of the key
+ * matrix. The rows and the columns are GPIOs: a pressed key connects its row to its
+ * column, and a column reads low when a path of pressed keys connects it to a row driven
+ * low, so the model shows the ghost keys of a real matrix. A key that changes bounces for
+ * a few scan cycles, its contact is random until it settles.
+ *
+ * Debounce replay: random key sequences are scanned by app_kbd.c and by a reference, the
+ * scan processing of the original code (one debouncing state machine per key in a table
+ * of 16 keys). The reference is fed with the rows read by app_kbd.c, and the reported
+ * status of the matrix, the debouncing status and the keycodes written to the buffer must
+ * be the same after every scan cycle. A sequence uses 4 keys, so that the keys being
+ * debounced, ghosts included, always fit in the table of the reference.
+ *
+ * Ghosting corpus: for every square of the matrix, 3 corners are pressed one after the
+ * other, in every order, and the 4th corner is the ghost. The third key must not be
+ * reported when the ghost is a valid key, and must be reported otherwise. Each pattern
+ * is played again with the first key released in the middle of the scan of the third
+ * one, so that the rows of the square disagree. The results must also match the
+ * reference, and all keys must be reported as released at the end.
+ *
+ * Key timeline: a script of key events is played in time on the scanning FSM of the
+ * application (app_kbd_scan_fsm.c), driven by the model of SysTick and of the wakeup
+ * interrupt, with the reports enabled. A bouncing contact toggles every 100us during its
+ * bounce time. The reports are sent at the connection events, as the sleep hooks of the
+ * application do, up to the number of Tx buffers per event. For each key event, the
+ * latency from the physical press (or release) to the HID report being queued, and to
+ * the notification of the last report queued with it, is printed. Then the number of
+ * notifications and the cost of the scan cycles: the rows read, the register accesses,
+ * the time from the first row to the processing of the results, and the host time of
+ * the scanning code (register model included). A cycle that reads all the rows is counted
+ * as a full scan.
+ *
+ * Timeline (one event per line, times in ms, # starts a comment):
+ *     <time> press <row> <col> [bounce]
+ *     <time> release <row> <col> [bounce]
+ *     <time> tap <row> <col> <hold> [bounce]       press, then release after hold
+ *
+ * Usage: kbd_sim [sequences] [seed] [timeline]
+ *
+ ****************************************************************************************
+ */
+
+/*
+ * INCLUDE FILES
+ ****************************************************************************************
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "rwip_config.h"
+#include "global_io.h"
+#include "ke_msg.h"
+#include "app.h"
+#include "app_task.h"
+#include "gpio.h"
+#include "wkupct_quadec.h"
+#include "periph_setup.h"
+#include "app_multi_bond.h"
+
+#include "app_kbd.h"
+#include "app_kbd_proj.h"
+#include "app_kbd_key_matrix.h"
+#include "app_kbd_fsm.h"
+#include "app_kbd_scan_fsm.h"
+#include "hogpd_task.h"
+
+// app_kbd_matrix.h defines the tables of the key matrix: the simulator has its own copy
+#define kbd_input_ports     sim_input_ports
+#define kbd_output_ports    sim_output_ports
+#define kbd_keymap          sim_keymap
+#include "app_kbd_matrix.h"
+#undef kbd_input_ports
+#undef kbd_output_ports
+#undef kbd_keymap
+
+
+/*
+ * DEFINES
+ ****************************************************************************************
+ */
+
+/// Default number of key sequences
+#define SIM_SEQUENCES           (500)
+
+/// Scan cycles of a sequence
+#define SIM_STEPS               (400)
+
+/// Keys used by a sequence
+#define SIM_KEYS                (4)
+
+/// A key changes once every SIM_CHANGE scan cycles on average
+#define SIM_CHANGE              (6)
+
+/// A key bounces for up to SIM_BOUNCE scan cycles after it changes
+#define SIM_BOUNCE              (6)
+
+/// Registers of the model, besides the peripheral ones
+#define SIM_REGS                (16)
+
+/// Peripheral registers of the model: 0x50000000 - 0x50003FFF
+#define SIM_PERIPH_BASE         (0x50000000)
+#define SIM_PERIPH_SIZE         (0x4000)
+
+/// Scan cycles between two key changes of a ghosting pattern
+#define SIM_PATTERN_STEP        (DEBOUNCE_COUNTER_PRESS + 2)
+
+/// Scan cycles allowed to return to idle at the end of a ghosting pattern
+#define SIM_PATTERN_END         (4 * DEBOUNCE_COUNTER_RELEASE)
+
+/// Mask of the columns
+#define SIM_COLUMNS             ((scan_t)((1 << KBD_NR_INPUTS) - 1))
+
+/// Contact toggle period of a bouncing key of a timeline, in us
+#define SIM_BOUNCE_PERIOD       (100)
+
+/// Events of a timeline
+#define SIM_EVENTS              (256)
+
+/// Time played after the last event of a timeline, in us
+#define SIM_TIMELINE_TAIL       ((DEBOUNCE_COUNTER_R_IN_MS + 2 * FULL_SCAN_IN_MS) * 1000)
+
+/// Connection interval, in us
+#define SIM_CONN_INTERVAL       (PREFERRED_CONN_INTERVAL_MIN * 1250)
+
+/// Notifications per connection event, one per Tx buffer
+#define SIM_CONN_NTF            (BLE_TX_BUFFER_DATA)
+
+/// SysTick registers
+#define SIM_SYSTICK_CTRL        (0xE000E010)
+#define SIM_SYSTICK_LOAD        (0xE000E014)
+#define SIM_SYSTICK_VAL         (0xE000E018)
+
+/// Size of the debouncing table of the reference
+#define REF_DEBOUNCE_SIZE       (16)
+
+
+/*
+ * STRUCTURES DEFINTIONS
+ ****************************************************************************************
+ */
+
+/// A key of the sequence
+struct sim_key
+{
+    /// Row
+    int row;
+    /// Column
+    int col;
+    /// Settled state
+    bool pressed;
+    /// Scan cycles until the contact settles
+    int bounce;
+};
+
+/// Register of the model
+struct sim_reg
+{
+    /// Address
+    uint32 addr;
+    /// Last value written
+    uint32 value;
+};
+
+/// A key event of the timeline
+struct sim_event
+{
+    /// Time, in us
+    uint32_t time;
+    /// Row
+    int row;
+    /// Column
+    int col;
+    /// Pressed or released
+    bool pressed;
+    /// Bounce time, in us
+    uint32_t bounce;
+    /// A report of the event has been queued
+    bool reported;
+    /// Number of the last report queued with the event
+    uint32_t report;
+    /// That report has been notified
+    bool notified;
+};
+
+/// Cost of the scan cycles
+struct sim_scan_stats
+{
+    /// Scan cycles
+    uint32_t cycles;
+    /// Rows read
+    uint32_t rows;
+    /// Register accesses
+    uint32_t accesses;
+    /// Time from the first row to the processing of the results, in us
+    uint32_t time;
+    /// Host time of the scanning code, in ns
+    uint64_t ns;
+};
+
+/// Latency of the reports
+struct sim_latency
+{
+    uint32_t cnt;
+    uint32_t min;
+    uint32_t max;
+    uint64_t sum;
+};
+
+/// Debouncing states of the reference
+enum ref_debounce_state
+{
+    REF_IDLE = 0,
+    REF_PRESS_DEBOUNCING,
+    REF_WAIT_RELEASE,
+    REF_RELEASE_DEBOUNCING,
+};
+
+/// Debouncing counter of a key of the reference
+struct ref_debounce_counter
+{
+    enum ref_debounce_state state;
+    uint8_t cnt;
+};
+
+
+/*
+ * GLOBAL VARIABLES
+ ****************************************************************************************
+ */
+
+/// Scanning status of app_kbd.c
+extern bool kbd_reports_en;
+extern uint16 kbd_keycode_buffer[KEYCODE_BUFFER_SIZE];
+extern uint8_t kbd_keycode_buffer_tail;
+extern uint16_t kbd_out_bitmasks[KBD_NR_OUTPUTS];
+extern scan_t kbd_scandata[KBD_NR_OUTPUTS];
+extern bool kbd_active_row[KBD_NR_OUTPUTS];
+extern scan_t kbd_new_scandata[KBD_NR_OUTPUTS];
+extern scan_t kbd_bounce_rows[KBD_NR_OUTPUTS];
+extern int kbd_fn_modifier;
+
+extern uint8_t kbd_keycode_buffer_head;
+extern uint8_t kbd_trm_cnt;
+
+/// Interrupt handlers of the Keyboard Controller and SysTick (app_kbd.c)
+void KEYBRD_Handler(void);
+void SysTick_Handler(void);
+
+/// Application environment (app.c)
+struct app_env_tag app_env;
+
+/// Registers written by the application
+static uint32 sim_periph[SIM_PERIPH_SIZE / 2];
+static struct sim_reg sim_regs[SIM_REGS];
+static int sim_reg_cnt;
+
+/// Register accesses of the application
+static uint32_t sim_reg_accesses;
+
+/// Time of the model, in us
+static uint32_t sim_now;
+
+/// SysTick is counting, and the time it reaches zero
+static bool sim_systick_on;
+static uint32_t sim_systick_end;
+
+/// Enabled interrupts
+static bool sim_irq_en[32];
+
+/// Wakeup timer callback
+static wakeup_handler_function_t sim_wkup_callback;
+
+/// Contacts of the keys, one word of columns per row ('1': closed)
+static scan_t sim_contact[KBD_NR_OUTPUTS];
+
+/// Last row driven low by the application
+static int sim_driven_row = -1;
+
+/// Rows read during the current scan cycle, and the scanword read
+static bool sim_row_read[KBD_NR_OUTPUTS];
+static scan_t sim_row_word[KBD_NR_OUTPUTS];
+
+/// Keys of the sequence
+static struct sim_key sim_keys[SIM_KEYS];
+
+/// Scanning is active, and the first scan cycle is pending
+static bool sim_scanning;
+static bool sim_first;
+
+/// Key released in the middle of the next scan cycle, when the row split_row is driven
+static struct sim_key *sim_split_key;
+static int sim_split_row;
+
+/// Statistics
+static uint32_t sim_cycles;
+static uint32_t sim_keycodes;
+static uint32_t sim_wakeups;
+static uint32_t sim_patterns;
+static uint32_t sim_ghosts_blocked;
+static uint32_t sim_ghosts_passed;
+
+/// Events of the timeline, in time order
+static struct sim_event sim_events[SIM_EVENTS];
+static int sim_event_cnt;
+
+/// Scan cycle in progress: started, time of its first row, cost so far
+static bool sim_cycle_on;
+static uint32_t sim_cycle_start;
+static uint32_t sim_cycle_accesses;
+static uint64_t sim_cycle_ns;
+
+/// Timeline statistics
+static struct sim_scan_stats sim_scan_full;
+static struct sim_scan_stats sim_scan_partial;
+static struct sim_latency sim_latency_press;
+static struct sim_latency sim_latency_release;
+static struct sim_latency sim_latency_ntf_press;
+static struct sim_latency sim_latency_ntf_release;
+
+/// Key reports notified and queued (merged ones excluded), the most pending at once
+static uint32_t sim_notifications;
+static uint32_t sim_reports;
+static uint32_t sim_reports_max;
+
+/// Reference: status of the matrix, as in app_kbd.c
+static scan_t ref_scandata[KBD_NR_OUTPUTS];
+static bool ref_active_row[KBD_NR_OUTPUTS];
+static scan_t ref_new_scandata[KBD_NR_OUTPUTS];
+static int ref_fn_modifier;
+
+/// Reference: one debouncing state machine per key, in a table
+static uint16_t ref_bounce_intersections[REF_DEBOUNCE_SIZE];
+static scan_t ref_bounce_rows[KBD_NR_OUTPUTS];
+static struct ref_debounce_counter ref_bounce_counters[REF_DEBOUNCE_SIZE];
+
+/// Reference: keycodes of the current scan cycle
+static uint16_t ref_keycodes[KEYCODE_BUFFER_SIZE];
+static int ref_keycode_cnt;
+
+
+/*
+ * MODEL OF THE HARDWARE
+ ****************************************************************************************
+ */
+
+/// Data register of a port
+static uint32 sim_port_data_reg(int port)
+{
+    return (port == 3) ? P3_DATA_REG : (P0_DATA_REG + port * 0x20);
+}
+
+/// Mode register of a GPIO (0xPB: port P, bit B), 0 if there is none
+static uint32 sim_mode_reg(int gpio)
+{
+    if ((gpio >> 4) > 3)
+        return 0;
+
+    return sim_port_data_reg(gpio >> 4) + 6 + 2 * (gpio & 0x0F);
+}
+
+static uint32 *sim_reg(uint32 addr)
+{
+    int i;
+
+    if ((addr - SIM_PERIPH_BASE) < SIM_PERIPH_SIZE)
+        return &sim_periph[(addr - SIM_PERIPH_BASE) / 2];
+
+    for (i = 0; i < sim_reg_cnt; i++)
+    {
+        if (sim_regs[i].addr == addr)
+            return &sim_regs[i].value;
+    }
+
+    if (sim_reg_cnt == SIM_REGS)
+    {
+        printf("kbd_sim: too many registers\n");
+        exit(1);
+    }
+
+    sim_regs[sim_reg_cnt].addr = addr;
+    sim_regs[sim_reg_cnt].value = 0;
+
+    return &sim_regs[sim_reg_cnt++].value;
+}
+
+/// The row is an output driven low
+static bool sim_row_is_low(int row)
+{
+    const uint32 reg = sim_mode_reg(sim_output_ports[row]);
+
+    return reg && (*sim_reg(reg) == 0x300);
+}
+
+/// Columns connected to a row driven low by a path of closed contacts
+static scan_t sim_low_columns(void)
+{
+    bool low[KBD_NR_OUTPUTS];
+    scan_t cols = 0;
+    bool changed;
+    int r;
+
+    for (r = 0; r < KBD_NR_OUTPUTS; r++)
+        low[r] = sim_row_is_low(r);
+
+    do
+    {
+        changed = false;
+
+        for (r = 0; r < KBD_NR_OUTPUTS; r++)
+        {
+            if (!low[r] && (sim_contact[r] & cols))
+                low[r] = true;
+
+            if (low[r] && (sim_contact[r] & ~cols))
+            {
+                cols |= sim_contact[r];
+                changed = true;
+            }
+        }
+    } while (changed);
+
+    return cols;
+}
+
+/// Read a data register: the inputs of the low columns read '0'
+static uint32 sim_port_read(int port)
+{
+    const scan_t low = sim_low_columns();
+    uint32 value = 0xFFFF;
+    int c;
+
+    for (c = 0; c < KBD_NR_INPUTS; c++)
+    {
+        if (((sim_input_ports[c] >> 4) == port) && (low & (1 << c)))
+            value &= ~(1 << (sim_input_ports[c] & 0x0F));
+    }
+
+    // the application reads the inputs of the last row it has driven low
+    if (sim_driven_row >= 0)
+    {
+        sim_row_read[sim_driven_row] = true;
+        sim_row_word[sim_driven_row] = SIM_COLUMNS & ~low;
+    }
+
+    return value;
+}
+
+void sim_reg_write(uint32 addr, uint32 data)
+{
+    int r;
+
+    sim_reg_accesses++;
+    *sim_reg(addr) = data;
+
+    // SysTick counts down from the reload value when it is enabled
+    if (addr == SIM_SYSTICK_CTRL)
+    {
+        sim_systick_on = (data & 1) && *sim_reg(SIM_SYSTICK_LOAD);
+        sim_systick_end = sim_now + *sim_reg(SIM_SYSTICK_LOAD);
+    }
+
+    if (data == 0x300)
+    {
+        for (r = 0; r < KBD_NR_OUTPUTS; r++)
+        {
+            if (addr == sim_mode_reg(sim_output_ports[r]))
+                sim_driven_row = r;
+        }
+    }
+}
+
+uint32 sim_reg_read(uint32 addr)
+{
+    int port;
+
+    sim_reg_accesses++;
+
+    if ((addr == SIM_SYSTICK_VAL) && sim_systick_on)
+        return sim_systick_end - sim_now;
+
+    for (port = 0; port < 4; port++)
+    {
+        if (addr == sim_port_data_reg(port))
+            return sim_port_read(port);
+    }
+
+    return *sim_reg(addr);
+}
+
+void NVIC_EnableIRQ(IRQn_Type irq)
+{
+    if (irq >= 0)
+        sim_irq_en[irq] = true;
+}
+
+void NVIC_DisableIRQ(IRQn_Type irq)
+{
+    if (irq >= 0)
+        sim_irq_en[irq] = false;
+}
+
+void NVIC_ClearPendingIRQ(IRQn_Type irq)
+{
+}
+
+void NVIC_SetPriority(IRQn_Type irq, uint32 priority)
+{
+}
+
+/// Raise the Keyboard Controller and the Wakeup Timer interrupts when an input is low
+static void sim_irq_check(void)
+{
+    if (!(sim_irq_en[KEYBRD_IRQn] || sim_irq_en[WKUP_QUADEC_IRQn]) || !sim_low_columns())
+        return;
+
+    if (sim_irq_en[KEYBRD_IRQn])
+        KEYBRD_Handler();
+
+    if (sim_irq_en[WKUP_QUADEC_IRQn] && sim_wkup_callback)
+    {
+        sim_wakeups++;
+        sim_wkup_callback();
+    }
+}
+
+/// Reload SysTick when it reaches zero, and raise its interrupt if enabled
+static void sim_systick_check(void)
+{
+    if (!sim_systick_on || (sim_now < sim_systick_end))
+        return;
+
+    sim_systick_end += *sim_reg(SIM_SYSTICK_LOAD);
+
+    if (*sim_reg(SIM_SYSTICK_CTRL) & 2)
+        SysTick_Handler();
+}
+
+/// Update the contacts from the keys, bouncing keys have random contacts
+static void sim_contacts_update(void)
+{
+    int i;
+
+    memset(sim_contact, 0, sizeof(sim_contact));
+
+    for (i = 0; i < SIM_KEYS; i++)
+    {
+        struct sim_key *key = &sim_keys[i];
+        bool closed = key->pressed;
+
+        if (key->bounce)
+        {
+            key->bounce--;
+            closed = rand() & 1;
+        }
+
+        if (closed)
+            sim_contact[key->row] |= (scan_t)1 << key->col;
+    }
+}
+
+
+/*
+ * STUBS OF THE APPLICATION
+ ****************************************************************************************
+ */
+
+void *ke_msg_alloc(ke_msg_id_t const id, ke_task_id_t const dest_id,
+                   ke_task_id_t const src_id, uint16_t const param_len)
+{
+    struct ke_msg *msg = calloc(1, sizeof(struct ke_msg) + param_len);
+
+    msg->id = id;
+    msg->dest_id = dest_id;
+    msg->src_id = src_id;
+    msg->param_len = param_len;
+
+    return ke_msg2param(msg);
+}
+
+void ke_msg_send(void const *param_ptr)
+{
+    const ke_msg_id_t id = ke_param2msg(param_ptr)->id;
+
+    if ((id == HOGPD_REPORT_UPD_REQ) || (id == HOGPD_BOOT_REPORT_UPD_REQ))
+        sim_notifications++;
+
+    free(ke_param2msg(param_ptr));
+}
+
+ke_state_t ke_state_get(ke_task_id_t const id)
+{
+    return APP_CONNECTED;
+}
+
+void app_state_update(enum main_fsm_events evt)
+{
+}
+
+void app_mitm_passcode_report(uint32_t code)
+{
+}
+
+void app_alt_pair_clear_all_bond_data(void)
+{
+}
+
+void reset_bonding_data(void)
+{
+}
+
+void wkupct_register_callback(wakeup_handler_function_t callback)
+{
+    sim_wkup_callback = callback;
+}
+
+void periph_init(void)
+{
+}
+
+void GPIO_ConfigurePin(GPIO_PORT port, GPIO_PIN pin, GPIO_PUPD mode, GPIO_FUNCTION function,
+                       const bool high)
+{
+}
+
+void GPIO_SetPinFunction(GPIO_PORT port, GPIO_PIN pin, GPIO_PUPD mode, GPIO_FUNCTION function)
+{
+}
+
+
+/*
+ * REFERENCE: SCAN PROCESSING OF THE ORIGINAL CODE
+ ****************************************************************************************
+ */
+
+static void ref_init(void)
+{
+    int i;
+
+    for (i = 0; i < KBD_NR_OUTPUTS; i++)
+    {
+        ref_scandata[i] = SIM_COLUMNS;
+        ref_new_scandata[i] = SIM_COLUMNS;
+        ref_active_row[i] = false;
+        ref_bounce_rows[i] = 0;
+    }
+
+    for (i = 0; i < REF_DEBOUNCE_SIZE; i++)
+    {
+        ref_bounce_intersections[i] = 0xFFFF;
+        ref_bounce_counters[i].state = REF_IDLE;
+        ref_bounce_counters[i].cnt = 0;
+    }
+
+    ref_fn_modifier = 0;
+}
+
+/// Debouncing of a key: 1 if the key is accepted and should be checked for ghosting
+static int ref_debounce_key(const uint16 output, const uint16 input, const int pressed)
+{
+    const uint16 my_intersection = (output << 8) | input;
+    const scan_t imask = 1 << input;
+    int i;
+
+    if (sim_keymap[0][output][input] == 0)
+        return 0;
+
+    for (i = 0; i < REF_DEBOUNCE_SIZE; ++i)
+        if (my_intersection == ref_bounce_intersections[i])
+            break;
+
+    if (i != REF_DEBOUNCE_SIZE)
+    {
+        struct ref_debounce_counter *deb = &ref_bounce_counters[i];
+
+        switch (deb->state)
+        {
+            case REF_PRESS_DEBOUNCING:
+                if (deb->cnt == 0)
+                {
+                    if (pressed)
+                        deb->state = REF_WAIT_RELEASE;
+                    else
+                    {
+                        deb->state = REF_IDLE;
+                        ref_bounce_intersections[i] = 0xFFFF;
+                        ref_bounce_rows[output] &= ~imask;
+                        return 0;
+                    }
+                }
+                else
+                {
+                    ref_new_scandata[output] |= imask;
+                    return 0;
+                }
+                break;
+            case REF_WAIT_RELEASE:
+                if (!pressed)
+                {
+                    deb->state = REF_RELEASE_DEBOUNCING;
+                    deb->cnt = DEBOUNCE_COUNTER_RELEASE;
+                    ref_new_scandata[output] &= ~imask;
+                    return 0;
+                }
+                else if (!(ref_scandata[output] & imask))
+                    return 0;
+                break;
+            case REF_RELEASE_DEBOUNCING:
+                if (deb->cnt == 0)
+                {
+                    if (pressed)
+                    {
+                        deb->state = REF_WAIT_RELEASE;
+                        return 0;
+                    }
+                    else
+                    {
+                        deb->state = REF_IDLE;
+                        ref_bounce_intersections[i] = 0xFFFF;
+                        ref_bounce_rows[output] &= ~imask;
+                        if (ref_scandata[output] & imask)
+                            return 0;
+                    }
+                }
+                else
+                {
+                    ref_new_scandata[output] &= ~imask;
+                    return 0;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+    else
+    {
+        for (i = 0; i < REF_DEBOUNCE_SIZE; ++i)
+            if (ref_bounce_intersections[i] == 0xFFFF)
+                break;
+
+        if (i == REF_DEBOUNCE_SIZE)
+        {
+            printf("kbd_sim: debouncing table of the reference full\n");
+            exit(1);
+        }
+
+        ref_bounce_intersections[i] = my_intersection;
+        ref_bounce_rows[output] |= imask;
+        ref_bounce_counters[i].cnt = DEBOUNCE_COUNTER_PRESS;
+        ref_bounce_counters[i].state = REF_PRESS_DEBOUNCING;
+        ref_new_scandata[output] |= imask;
+
+        return 0;
+    }
+
+    return 1;
+}
+
+/// The key is one corner of a square of valid keys (the 3 other corners exist)
+static int ref_square(int output, int input, int o, int i)
+{
+    return sim_keymap[0][output][i] && sim_keymap[0][o][input] && sim_keymap[0][o][i];
+}
+
+/// Deghosting of a key and keycode: 1 if the keycode is written
+static int ref_record_key(const uint16 output, const uint16 input, const int pressed)
+{
+    const scan_t imask = 1 << input;
+    uint16_t keycode;
+
+    if (pressed)
+    {
+        int i, o;
+        scan_t scandata;
+        scan_t mask = 1;
+
+        // a square of active keys in the newly scanned matrix
+        scandata = ref_new_scandata[output] & ~imask;
+        for (i = 0; i < KBD_NR_INPUTS; ++i, mask <<= 1)
+        {
+            if ((input == i) || (scandata & mask))
+                continue;
+
+            for (o = 0; o < KBD_NR_OUTPUTS; ++o)
+            {
+                const scan_t row = ~ref_new_scandata[o] & SIM_COLUMNS;
+
+                if ((output != o) && (row & (mask | imask)) && ref_square(output, input, o, i))
+                    return 0;
+            }
+        }
+
+        // an input "missed" in the row under examination
+        for (o = 0; o < KBD_NR_OUTPUTS; ++o)
+        {
+            if ((output == o) || (ref_new_scandata[o] & imask))
+                continue;
+
+            mask = 1;
+            for (i = 0; i < KBD_NR_INPUTS; ++i, mask <<= 1)
+            {
+                if (input == i)
+                    continue;
+
+                if ((!(ref_scandata[output] & mask) || !(ref_new_scandata[o] & mask))
+                    && ref_square(output, input, o, i))
+                    return 0;
+            }
+        }
+    }
+
+    if (HAS_EEPROM)
+    {
+        if ((sim_keymap[ref_fn_modifier][output][input] >> 8) == 0xF8)
+        {
+            uint8_t keychar = sim_keymap[ref_fn_modifier][output][input] & 0xFF;
+            ref_fn_modifier = (ref_fn_modifier & (~keychar)) | (pressed ? keychar : 0);
+        }
+
+        if (sim_keymap[ref_fn_modifier][output][input] == CLRP)
+            return 1;
+    }
+
+    keycode = sim_keymap[ref_fn_modifier][output][input] | (pressed ? 0 : 0x0100);
+    ref_keycodes[ref_keycode_cnt++] = keycode;
+
+    return 1;
+}
+
+/// Processing of the scan results, then update of the debouncing counters
+static void ref_process_scandata(void)
+{
+    scan_t new_scan_status[KBD_NR_OUTPUTS];
+    int i;
+
+    for (i = 0; i < KBD_NR_OUTPUTS; ++i)
+    {
+        scan_t xorword = (ref_scandata[i] ^ ref_new_scandata[i]) | ref_bounce_rows[i];
+
+        new_scan_status[i] = ref_new_scandata[i];
+        ref_active_row[i] = (xorword != 0);
+
+        while (xorword)
+        {
+            const int bit = 31 - __clz((uint32_t)xorword);
+            const scan_t mask = 1 << bit;
+
+            if (!ref_debounce_key(i, bit, !(new_scan_status[i] & mask)))
+                new_scan_status[i] = (new_scan_status[i] & ~mask) | (ref_scandata[i] & mask);
+            xorword &= ~mask;
+        }
+    }
+
+    for (i = 0; i < KBD_NR_OUTPUTS; ++i)
+    {
+        scan_t xorword = ref_scandata[i] ^ new_scan_status[i];
+
+        while (xorword)
+        {
+            const int bit = 31 - __clz((uint32_t)xorword);
+            const scan_t mask = 1 << bit;
+
+            if (!ref_record_key(i, bit, !(new_scan_status[i] & mask)))
+                new_scan_status[i] = (new_scan_status[i] & ~mask) | (ref_scandata[i] & mask);
+            xorword &= ~mask;
+        }
+    }
+
+    for (i = 0; i < KBD_NR_OUTPUTS; i++)
+        ref_scandata[i] = new_scan_status[i];
+
+    for (i = 0; i < REF_DEBOUNCE_SIZE; ++i)
+    {
+        if ((ref_bounce_intersections[i] != 0xFFFF) && ref_bounce_counters[i].cnt)
+            --ref_bounce_counters[i].cnt;
+    }
+}
+
+
+/*
+ * REPLAY
+ ****************************************************************************************
+ */
+
+/**
+ ****************************************************************************************
+ * @brief Scan all the rows with app_kbd.c, then process the rows it has read with the
+ * reference and compare the results.
+ *
+ * @return 0 if the results match, 1 otherwise
+ ****************************************************************************************
+ */
+static int sim_scan_cycle(void)
+{
+    const uint8_t tail = kbd_keycode_buffer_tail;
+    int row = 0;
+    int i;
+
+    memset(sim_row_read, 0, sizeof(sim_row_read));
+    sim_driven_row = -1;
+
+    while (!app_kbd_scan_matrix(&row))
+    {
+        if (sim_split_key && (row == sim_split_row + 1))
+        {
+            sim_split_key->pressed = false;
+            sim_split_key = NULL;
+            sim_contacts_update();
+        }
+    }
+
+    // the row of the split was not scanned: release the key after the scan cycle
+    if (sim_split_key)
+    {
+        sim_split_key->pressed = false;
+        sim_split_key = NULL;
+    }
+
+    sim_cycles++;
+
+    for (i = 0; i < KBD_NR_OUTPUTS; i++)
+    {
+        if (sim_row_read[i])
+            ref_new_scandata[i] = sim_row_word[i];
+    }
+
+    ref_keycode_cnt = 0;
+    ref_process_scandata();
+
+    for (i = 0; i < KBD_NR_OUTPUTS; i++)
+    {
+        if ((kbd_scandata[i] != ref_scandata[i]) || (kbd_new_scandata[i] != ref_new_scandata[i])
+            || (kbd_active_row[i] != ref_active_row[i]) || (kbd_bounce_rows[i] != ref_bounce_rows[i]))
+        {
+            printf("  row %d: status %05x (%05x), read %05x (%05x), active %d (%d), debouncing %05x (%05x)\n",
+                   i, kbd_scandata[i], ref_scandata[i], kbd_new_scandata[i], ref_new_scandata[i],
+                   kbd_active_row[i], ref_active_row[i], kbd_bounce_rows[i], ref_bounce_rows[i]);
+            return 1;
+        }
+    }
+
+    for (i = 0; i < ref_keycode_cnt; i++)
+    {
+        if ((((tail + i) % KEYCODE_BUFFER_SIZE) == kbd_keycode_buffer_tail)
+            || (kbd_keycode_buffer[(tail + i) % KEYCODE_BUFFER_SIZE] != ref_keycodes[i]))
+        {
+            printf("  keycode %d: %04x expected\n", i, ref_keycodes[i]);
+            return 1;
+        }
+    }
+
+    if ((((tail + i) % KEYCODE_BUFFER_SIZE) != kbd_keycode_buffer_tail) || (kbd_fn_modifier != ref_fn_modifier))
+    {
+        printf("  %d keycodes instead of %d, Fn %d (%d)\n",
+               (kbd_keycode_buffer_tail - tail + KEYCODE_BUFFER_SIZE) % KEYCODE_BUFFER_SIZE,
+               ref_keycode_cnt, kbd_fn_modifier, ref_fn_modifier);
+        return 1;
+    }
+
+    sim_keycodes += ref_keycode_cnt;
+
+    return 0;
+}
+
+/// Pick the keys of a sequence among the keys of the default keymap, all released
+static void sim_keys_init(void)
+{
+    int i;
+
+    for (i = 0; i < SIM_KEYS; i++)
+    {
+        struct sim_key *key = &sim_keys[i];
+
+        do
+        {
+            key->row = rand() % KBD_NR_OUTPUTS;
+            key->col = rand() % KBD_NR_INPUTS;
+        } while (!sim_keymap[0][key->row][key->col]);
+
+        key->pressed = false;
+        key->bounce = 0;
+    }
+}
+
+/// Start a sequence with the keys released and the scanning idle
+static void sim_start(void)
+{
+    memset(sim_contact, 0, sizeof(sim_contact));
+
+    app_keyboard_init();
+    app_kbd_enable_scanning();
+
+    sim_scanning = false;
+}
+
+/**
+ ****************************************************************************************
+ * @brief Run one scan period, with the steps of the scanning FSM: a key press wakes the
+ * scanning up, which runs until app_kbd_update_status() returns to idle.
+ *
+ * @return 0 if app_kbd.c and the reference agree, 1 otherwise
+ ****************************************************************************************
+ */
+static int sim_step(void)
+{
+    sim_contacts_update();
+    sim_irq_check();
+
+    if (!sim_scanning)
+    {
+        if (!wkup_hit)
+            return 0;
+
+        wkup_hit = false;
+        app_kbd_start_scanning();
+        ref_init();
+        sim_scanning = true;
+        sim_first = true;
+    }
+
+    if (!sim_first && !app_kbd_update_status())
+    {
+        sim_scanning = false;
+        sim_irq_check();
+        return 0;
+    }
+    sim_first = false;
+
+    if (sim_scan_cycle())
+        return 1;
+
+    sim_irq_check();
+
+    return 0;
+}
+
+/// Run steps scan periods, or until the scanning is idle if idle is set
+static int sim_run(int steps, bool idle)
+{
+    while (steps--)
+    {
+        if (sim_step())
+            return 1;
+
+        if (idle && !sim_scanning)
+            break;
+    }
+
+    return 0;
+}
+
+/// Replay a random key sequence
+static int sim_sequence(int seq)
+{
+    int step;
+
+    sim_keys_init();
+    sim_start();
+
+    for (step = 0; step < SIM_STEPS; step++)
+    {
+        if ((rand() % SIM_CHANGE) == 0)
+        {
+            struct sim_key *key = &sim_keys[rand() % SIM_KEYS];
+
+            key->pressed = !key->pressed;
+            key->bounce = rand() % (SIM_BOUNCE + 1);
+        }
+
+        if (sim_step())
+        {
+            printf("  FAILED: sequence %d, scan cycle %d\n", seq, step);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/// The key is reported as pressed
+static bool sim_reported(int row, int col)
+{
+    return !(kbd_scandata[row] & ((scan_t)1 << col));
+}
+
+/**
+ ****************************************************************************************
+ * @brief Play a ghosting pattern: 3 corners of a square are pressed one after the other
+ * and the 4th corner is the ghost. Corner n is (rows[n >> 1], cols[n & 1]).
+ *
+ * @param[in] rows      Rows of the square
+ * @param[in] cols      Columns of the square
+ * @param[in] ghost     Corner which is not pressed
+ * @param[in] third     Corner pressed last
+ * @param[in] split     Release the first key in the middle of the scan of the third one
+ *
+ * @return 0 if the keys are reported as expected, 1 otherwise
+ ****************************************************************************************
+ */
+static int sim_pattern(const int rows[2], const int cols[2], int ghost, int third, bool split)
+{
+    const int grow = rows[ghost >> 1];
+    const int gcol = cols[ghost & 1];
+    const bool valid_ghost = (sim_keymap[0][grow][gcol] != 0);
+    int k = 0;
+    int n;
+
+    memset(sim_keys, 0, sizeof(sim_keys));
+
+    for (n = 0; n < 4; n++)
+    {
+        if (n != ghost)
+        {
+            const int i = (n == third) ? 2 : k++;
+
+            sim_keys[i].row = rows[n >> 1];
+            sim_keys[i].col = cols[n & 1];
+        }
+    }
+
+    sim_start();
+
+    for (k = 0; k < 3; k++)
+    {
+        sim_keys[k].pressed = true;
+        if ((k == 2) && split)
+        {
+            sim_split_key = &sim_keys[0];
+            sim_split_row = (rows[0] > rows[1]) ? rows[0] : rows[1];
+        }
+
+        if (sim_run(SIM_PATTERN_STEP, false))
+            return 1;
+    }
+
+    if (!split)
+    {
+        if (!sim_reported(sim_keys[0].row, sim_keys[0].col) || !sim_reported(sim_keys[1].row, sim_keys[1].col)
+            || (sim_reported(sim_keys[2].row, sim_keys[2].col) == valid_ghost) || sim_reported(grow, gcol))
+        {
+            printf("  keys %d %d %d, ghost %d reported %d %d %d, ghost %d\n",
+                   sim_keymap[0][sim_keys[0].row][sim_keys[0].col] != 0,
+                   sim_keymap[0][sim_keys[1].row][sim_keys[1].col] != 0,
+                   sim_keymap[0][sim_keys[2].row][sim_keys[2].col] != 0, valid_ghost,
+                   sim_reported(sim_keys[0].row, sim_keys[0].col), sim_reported(sim_keys[1].row, sim_keys[1].col),
+                   sim_reported(sim_keys[2].row, sim_keys[2].col), sim_reported(grow, gcol));
+            return 1;
+        }
+
+        if (valid_ghost)
+            sim_ghosts_blocked++;
+        else
+            sim_ghosts_passed++;
+    }
+
+    for (k = 0; k < 3; k++)
+        sim_keys[k].pressed = false;
+
+    if (sim_run(SIM_PATTERN_END, true))
+        return 1;
+
+    for (n = 0; n < KBD_NR_OUTPUTS; n++)
+    {
+        if (kbd_scandata[n] != SIM_COLUMNS)
+        {
+            printf("  row %d: keys %05x still reported\n", n, ~kbd_scandata[n] & SIM_COLUMNS);
+            return 1;
+        }
+    }
+
+    if (sim_scanning)
+    {
+        printf("  scanning still active\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+/**
+ ****************************************************************************************
+ * @brief Play the ghosting patterns of all the squares of the matrix whose 3 pressed
+ * corners are valid keys.
+ *
+ * @return 0 if all the patterns pass, 1 otherwise
+ ****************************************************************************************
+ */
+static int sim_ghost_corpus(void)
+{
+    int rows[2], cols[2];
+    int ghost, third, split;
+
+    for (rows[0] = 0; rows[0] < KBD_NR_OUTPUTS; rows[0]++)
+    for (rows[1] = rows[0] + 1; rows[1] < KBD_NR_OUTPUTS; rows[1]++)
+    for (cols[0] = 0; cols[0] < KBD_NR_INPUTS; cols[0]++)
+    for (cols[1] = cols[0] + 1; cols[1] < KBD_NR_INPUTS; cols[1]++)
+    for (ghost = 0; ghost < 4; ghost++)
+    {
+        int n;
+
+        for (n = 0; n < 4; n++)
+        {
+            if ((n != ghost) && !sim_keymap[0][rows[n >> 1]][cols[n & 1]])
+                break;
+        }
+
+        if (n != 4)
+            continue;
+
+        for (third = 0; third < 4; third++)
+        for (split = 0; split < 2; split++)
+        {
+            if (third == ghost)
+                continue;
+
+            sim_patterns++;
+            if (sim_pattern(rows, cols, ghost, third, split))
+            {
+                printf("  FAILED: rows %d %d, columns %d %d, ghost %d, third %d%s\n", rows[0], rows[1],
+                       cols[0], cols[1], ghost, third, split ? ", split" : "");
+                return 1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+
+/*
+ * KEY TIMELINE
+ ****************************************************************************************
+ */
+
+static uint64_t sim_now_ns(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t) now.tv_sec * 1000000000u + now.tv_nsec;
+}
+
+/// Add an event to the timeline, in time order
+static int sim_timeline_add(double time, bool pressed, int row, int col, double bounce)
+{
+    struct sim_event *e;
+    int i;
+
+    if ((sim_event_cnt == SIM_EVENTS) || (time < 0) || (bounce < 0)
+        || (row < 0) || (row >= KBD_NR_OUTPUTS) || (col < 0) || (col >= KBD_NR_INPUTS))
+        return 1;
+
+    for (i = sim_event_cnt; (i > 0) && (sim_events[i - 1].time > (uint32_t)(time * 1000)); i--)
+        sim_events[i] = sim_events[i - 1];
+
+    e = &sim_events[i];
+    e->time = (uint32_t)(time * 1000);
+    e->row = row;
+    e->col = col;
+    e->pressed = pressed;
+    e->bounce = (uint32_t)(bounce * 1000);
+    e->reported = false;
+    sim_event_cnt++;
+
+    return 0;
+}
+
+/// Read a timeline
+static int sim_timeline_load(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    char line[128];
+    int n = 0;
+    int err = 0;
+
+    if (!f)
+    {
+        printf("kbd_sim: cannot open %s\n", path);
+        return 1;
+    }
+
+    while (!err && fgets(line, sizeof(line), f))
+    {
+        char *comment = strchr(line, '#');
+        char action[8];
+        double time, hold = 0, bounce = 0;
+        int row, col;
+        int fields;
+
+        n++;
+        if (comment)
+            *comment = '\0';
+
+        fields = sscanf(line, "%lf %7s %d %d %lf %lf", &time, action, &row, &col, &hold, &bounce);
+        if (fields <= 0)
+            continue;
+
+        if ((fields >= 5) && !strcmp(action, "tap"))
+            err = sim_timeline_add(time, true, row, col, bounce)
+                  || sim_timeline_add(time + hold, false, row, col, bounce);
+        else if ((fields >= 4) && (fields <= 5) && (!strcmp(action, "press") || !strcmp(action, "release")))
+            err = sim_timeline_add(time, !strcmp(action, "press"), row, col, hold);
+        else
+            err = 1;
+
+        if (err)
+            printf("kbd_sim: %s:%d: bad event: %s", path, n, line);
+    }
+
+    fclose(f);
+
+    return err;
+}
+
+/// Contacts of the keys at the current time: a bouncing contact toggles, starting with
+/// its new state
+static void sim_timeline_contacts(void)
+{
+    int i;
+
+    memset(sim_contact, 0, sizeof(sim_contact));
+
+    for (i = 0; (i < sim_event_cnt) && (sim_events[i].time <= sim_now); i++)
+    {
+        const struct sim_event *e = &sim_events[i];
+        const scan_t mask = (scan_t)1 << e->col;
+        bool closed = e->pressed;
+
+        if (sim_now < e->time + e->bounce)
+            closed ^= ((sim_now - e->time) / SIM_BOUNCE_PERIOD) & 1;
+
+        if (closed)
+            sim_contact[e->row] |= mask;
+        else
+            sim_contact[e->row] &= ~mask;
+    }
+}
+
+/// Next time at which a contact changes, SysTick reaches zero or a connection event occurs
+static uint32_t sim_timeline_next(void)
+{
+    uint32_t next = UINT32_MAX;
+    int i;
+
+    for (i = 0; i < sim_event_cnt; i++)
+    {
+        const struct sim_event *e = &sim_events[i];
+        uint32_t t;
+
+        if (e->time > sim_now)
+            t = e->time;
+        else if (sim_now < e->time + e->bounce)
+        {
+            t = e->time + ((sim_now - e->time) / SIM_BOUNCE_PERIOD + 1) * SIM_BOUNCE_PERIOD;
+            if (t > e->time + e->bounce)
+                t = e->time + e->bounce;
+        }
+        else
+            continue;
+
+        if (t < next)
+            next = t;
+    }
+
+    if (sim_systick_on && (sim_systick_end < next))
+        next = sim_systick_end;
+
+    if ((sim_now / SIM_CONN_INTERVAL + 1) * SIM_CONN_INTERVAL < next)
+        next = (sim_now / SIM_CONN_INTERVAL + 1) * SIM_CONN_INTERVAL;
+
+    return (next > sim_now) ? next : sim_now + 1;
+}
+
+static void sim_latency_add(struct sim_latency *lat, uint32_t latency)
+{
+    if (!lat->cnt || (latency < lat->min))
+        lat->min = latency;
+    if (latency > lat->max)
+        lat->max = latency;
+    lat->sum += latency;
+    lat->cnt++;
+}
+
+/// Match the keycodes turned into reports since head with the latest key event
+static void sim_timeline_reported(uint8_t head)
+{
+    // the keycodes are in the last report queued: reports are only added to the tail
+    sim_reports = sim_notifications + kbd_trm_cnt;
+    if (kbd_trm_cnt > sim_reports_max)
+        sim_reports_max = kbd_trm_cnt;
+
+    for (; head != kbd_keycode_buffer_head; head = (head + 1) % KEYCODE_BUFFER_SIZE)
+    {
+        const uint16 keycode = kbd_keycode_buffer[head];
+        const bool pressed = !(keycode & 0x0100);
+        struct sim_event *match = NULL;
+        int i;
+
+        for (i = 0; (i < sim_event_cnt) && (sim_events[i].time <= sim_now); i++)
+        {
+            struct sim_event *e = &sim_events[i];
+
+            if (!e->reported && (e->pressed == pressed)
+                && ((sim_keymap[0][e->row][e->col] | 0x0100) == (keycode | 0x0100)))
+                match = e;
+        }
+
+        if (!match)
+        {
+            printf("  %10.3f ms  keycode %04x, no physical event (ghost)\n", sim_now / 1000.0, keycode);
+            continue;
+        }
+
+        match->reported = true;
+        match->report = sim_reports;
+        sim_latency_add(pressed ? &sim_latency_press : &sim_latency_release, sim_now - match->time);
+
+        printf("  %10.3f ms  %s (%d,%d)  queued %10.3f ms  latency %7.3f ms\n", match->time / 1000.0,
+               pressed ? "press  " : "release", match->row, match->col, sim_now / 1000.0,
+               (sim_now - match->time) / 1000.0);
+    }
+}
+
+/// Run the scanning FSM once, and account for its cost in the current scan cycle
+static void sim_timeline_update(void)
+{
+    const enum key_scan_states state = current_scan_state;
+    const bool hit = systick_hit;
+    const uint8_t head = kbd_keycode_buffer_head;
+    const uint32_t accesses = sim_reg_accesses;
+    const uint64_t start = sim_now_ns();
+    int rows = 0;
+    int i;
+
+    fsm_scan_update();
+
+    sim_cycle_ns += sim_now_ns() - start;
+    sim_cycle_accesses += sim_reg_accesses - accesses;
+
+    for (i = 0; i < KBD_NR_OUTPUTS; i++)
+        rows += sim_row_read[i];
+
+    if (rows && !sim_cycle_on)
+    {
+        sim_cycle_on = true;
+        sim_cycle_start = sim_now;
+    }
+
+    // the results of a scan cycle are processed on the transition to KEY_STATUS_UPD,
+    // or when a single row is scanned by KEY_STATUS_UPD
+    if ((current_scan_state == KEY_STATUS_UPD) && ((state != KEY_STATUS_UPD) || hit))
+    {
+        struct sim_scan_stats *stats = (rows == KBD_NR_OUTPUTS) ? &sim_scan_full : &sim_scan_partial;
+
+        stats->cycles++;
+        stats->rows += rows;
+        stats->accesses += sim_cycle_accesses;
+        stats->time += sim_now - sim_cycle_start;
+        stats->ns += sim_cycle_ns;
+
+        sim_cycle_on = false;
+        sim_cycle_accesses = 0;
+        sim_cycle_ns = 0;
+        memset(sim_row_read, 0, sizeof(sim_row_read));
+        sim_driven_row = -1;
+    }
+
+    sim_timeline_reported(head);
+}
+
+/// Send the pending reports at a connection event, as app_asynch_trm() does
+static void sim_conn_event(void)
+{
+    const uint8_t head = kbd_keycode_buffer_head;
+    int ntf;
+    int i;
+
+    for (ntf = 0; (ntf < SIM_CONN_NTF) && kbd_trm_list; ntf++)
+    {
+        const bool overflow = (kbd_free_list == NULL);
+
+        app_kbd_send_key_report();
+        if (overflow)
+            app_kbd_prepare_keyreports();
+    }
+
+    sim_timeline_reported(head);
+
+    for (i = 0; i < sim_event_cnt; i++)
+    {
+        struct sim_event *e = &sim_events[i];
+
+        if (e->reported && !e->notified && (e->report <= sim_notifications))
+        {
+            e->notified = true;
+            sim_latency_add(e->pressed ? &sim_latency_ntf_press : &sim_latency_ntf_release,
+                            sim_now - e->time);
+        }
+    }
+}
+
+static void sim_latency_print(const char *name, const struct sim_latency *lat)
+{
+    if (lat->cnt)
+        printf("  %-8s %3u  min %7.3f  avg %7.3f  max %7.3f ms\n", name, lat->cnt, lat->min / 1000.0,
+               (double)lat->sum / lat->cnt / 1000.0, lat->max / 1000.0);
+    else
+        printf("  %-8s -\n", name);
+}
+
+static void sim_scan_print(const char *name, const struct sim_scan_stats *stats)
+{
+    if (stats->cycles)
+        printf("  %-8s per cycle: rows read %.1f, register accesses %.1f, scan time %.3f ms, host %.0f ns\n",
+               name, (double)stats->rows / stats->cycles, (double)stats->accesses / stats->cycles,
+               stats->time / 1000.0 / stats->cycles, (double)stats->ns / stats->cycles);
+}
+
+/**
+ ****************************************************************************************
+ * @brief Play a key timeline on the scanning FSM, with the time of SysTick.
+ *
+ * @return 0 if all the keys are reported as released and the scanning is idle at the
+ * end, 1 otherwise
+ ****************************************************************************************
+ */
+static int sim_timeline(void)
+{
+    uint32_t end = 0;
+    int i;
+
+    for (i = 0; i < sim_event_cnt; i++)
+    {
+        if (sim_events[i].time + sim_events[i].bounce > end)
+            end = sim_events[i].time + sim_events[i].bounce;
+    }
+    end += SIM_TIMELINE_TAIL;
+
+    sim_now = 0;
+    sim_cycle_on = false;
+    sim_cycle_accesses = 0;
+    sim_cycle_ns = 0;
+    memset(sim_contact, 0, sizeof(sim_contact));
+    memset(sim_row_read, 0, sizeof(sim_row_read));
+    sim_driven_row = -1;
+
+    app_keyboard_init();
+    app_kbd_start_reporting();
+    current_scan_state = KEY_SCAN_INACTIVE;
+    fsm_scan_update();
+
+    while (sim_now <= end)
+    {
+        sim_timeline_contacts();
+        sim_irq_check();
+        sim_systick_check();
+
+        if (wkup_hit || systick_hit)
+            sim_timeline_update();
+
+        // the inactive rows are driven low at the end of a scan cycle
+        sim_irq_check();
+        if (wkup_hit)
+            sim_timeline_update();
+
+        if ((sim_now % SIM_CONN_INTERVAL) == 0)
+            sim_conn_event();
+
+        sim_now = sim_timeline_next();
+    }
+
+    for (i = 0; i < sim_event_cnt; i++)
+    {
+        const struct sim_event *e = &sim_events[i];
+
+        if (!e->reported)
+            printf("  %10.3f ms  %s (%d,%d)  not reported\n", e->time / 1000.0,
+                   e->pressed ? "press  " : "release", e->row, e->col);
+    }
+
+    printf("  queued\n");
+    sim_latency_print("press", &sim_latency_press);
+    sim_latency_print("release", &sim_latency_release);
+    printf("  notified\n");
+    sim_latency_print("press", &sim_latency_ntf_press);
+    sim_latency_print("release", &sim_latency_ntf_release);
+    printf("  reports  %u notifications, up to %u pending, connection interval %.2f ms\n",
+           sim_notifications, sim_reports_max, SIM_CONN_INTERVAL / 1000.0);
+    printf("  scan     %u cycles (%u full, %u partial)\n", sim_scan_full.cycles + sim_scan_partial.cycles,
+           sim_scan_full.cycles, sim_scan_partial.cycles);
+    sim_scan_print("full", &sim_scan_full);
+    sim_scan_print("partial", &sim_scan_partial);
+
+    for (i = 0; i < KBD_NR_OUTPUTS; i++)
+    {
+        if (kbd_scandata[i] != SIM_COLUMNS)
+        {
+            printf("  row %d: keys %05x still reported\n", i, ~kbd_scandata[i] & SIM_COLUMNS);
+            return 1;
+        }
+    }
+
+    if (current_scan_state != KEY_SCAN_IDLE)
+    {
+        printf("  scanning still active\n");
+        return 1;
+    }
+
+    if (kbd_trm_list || (kbd_keycode_buffer_head != kbd_keycode_buffer_tail))
+    {
+        printf("  reports still pending\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+
+/*
+ * MAIN
+ ****************************************************************************************
+ */
+
+int main(int argc, char **argv)
+{
+    int sequences = (argc > 1) ? atoi(argv[1]) : SIM_SEQUENCES;
+    unsigned seed = (argc > 2) ? strtoul(argv[2], NULL, 0) : 1;
+    int err = 0;
+    int seq;
+
+    srand(seed);
+
+    printf("kbd_sim: %dx%d matrix, press/release debouncing %d/%d scan cycles\n",
+           KBD_NR_OUTPUTS, KBD_NR_INPUTS, DEBOUNCE_COUNTER_PRESS, DEBOUNCE_COUNTER_RELEASE);
+
+    for (seq = 0; (seq < sequences) && !err; seq++)
+        err = sim_sequence(seq);
+
+    printf("debounce replay: %d sequences, %u scan cycles, %u wakeups, %u keycodes, %s\n",
+           seq, sim_cycles, sim_wakeups, sim_keycodes, err ? "MISMATCH" : "same as the reference");
+
+    if (!err)
+    {
+        sim_cycles = 0;
+        err = sim_ghost_corpus();
+
+        printf("ghosting corpus: %u patterns, %u scan cycles, third key ignored %u times, reported %u times, %s\n",
+               sim_patterns, sim_cycles, sim_ghosts_blocked, sim_ghosts_passed, err ? "FAILED" : "passed");
+    }
+
+    if (!err && (argc > 3))
+    {
+        err = sim_timeline_load(argv[3]);
+
+        if (!err)
+        {
+            printf("key timeline %s: %d events\n", argv[3], sim_event_cnt);
+            err = sim_timeline();
+            printf("key timeline: %s\n", err ? "FAILED" : "passed");
+        }
+    }
+
+    return err;
+}
@@ -0,0 +1,22 @@
+/**
+ ****************************************************************************************
+ *
+ * @file da14580_config.h
+ *
+ * @brief Compile configuration file of the kernel benchmark (host build).
+ *
+ ****************************************************************************************
+ */
+
+#ifndef DA14580_CONFIG_H_
+#define DA14580_CONFIG_H_
+
+/////////////////////////////////////////////////////////////
+/*Host (off-target) build of the kernel*/
+#define CFG_KE_HOST
+/////////////////////////////////////////////////////////////
+
+/*Maximum user connections*/
+#define BLE_CONNECTION_MAX_USER 1
+
+#endif // DA14580_CONFIG_H_
@@ -0,0 +1,349 @@
+/**
+ ****************************************************************************************
+ *
+ * @file ke_bench.c
+ *
+ * @brief Benchmark of the kernel message path on the host build of the kernel.
+ *
+ * Measures the cost of a message going through alloc -> send -> dispatch -> free and
+ * the cost of the handler lookup done by the scheduler, with the message handled at
+ * the start, in the middle or at the end of a handler table sized like the ones of
+ * the profile tasks, or only by the default handler. With CFG_KE_HANDLER_INDEX the task
+ * is registered like TASK_APP on target, with a one-entry default handler dispatching
+ * through the sorted index, and the lookup alone is timed for both searches.
+ *
+ * Usage: ke_bench [iterations]
+ *
+ ****************************************************************************************
+ */
+
+/*
+ * INCLUDE FILES
+ ****************************************************************************************
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "rwip_config.h"
+#include "arch.h"
+#include "ke.h"
+#include "ke_event.h"
+#include "ke_mem.h"
+#include "ke_msg.h"
+#include "ke_task.h"
+#include "ke_handler_index.h"
+
+
+/*
+ * DEFINES
+ ****************************************************************************************
+ */
+
+/// Default number of messages per test
+#define BENCH_ITERATIONS        (1000000)
+
+/// Number of handlers of the state table (the HOGPD and GAPM tables have 20 to 40)
+#define BENCH_TABLE_SIZE        (32)
+
+/// Number of messages queued before the scheduler runs, for the burst test
+#define BENCH_BURST             (8)
+
+/// Size of the message parameters
+#define BENCH_PARAM_SIZE        (20)
+
+/// Number of parameter sizes of the mixed size test
+#define BENCH_SIZE_CNT          (6)
+
+/// Messages of the state table, then messages only known by the default handler
+#define BENCH_MSG(i)            (KE_FIRST_MSG(TASK_APP) + (i))
+#define BENCH_MSG_DEFAULT(i)    (KE_FIRST_MSG(TASK_APP) + BENCH_TABLE_SIZE + (i))
+
+
+/*
+ * LOCAL FUNCTION DECLARATIONS
+ ****************************************************************************************
+ */
+
+static int bench_msg_handler(ke_msg_id_t const msgid, void const *param,
+                             ke_task_id_t const dest_id, ke_task_id_t const src_id);
+
+
+/*
+ * GLOBAL VARIABLES
+ ****************************************************************************************
+ */
+
+/// Number of messages received by the handlers
+static uint32_t bench_rx_cnt;
+
+/// Parameter sizes of the mixed size test: GAP/GATT indications, notification data,
+/// ATT database entries and long writes
+static const uint16_t bench_param_size[BENCH_SIZE_CNT] = {4, 12, 20, 44, 100, 200};
+
+/// Handler table of the only task state, filled at start-up
+static struct ke_msg_handler bench_handler[BENCH_TABLE_SIZE];
+
+/// Task state
+static ke_state_t bench_state[1];
+
+#if !(KE_HANDLER_INDEX)
+/// Specifies the message handlers of the task states
+static const struct ke_state_handler bench_state_handler[1] =
+{
+    {bench_handler, BENCH_TABLE_SIZE},
+};
+
+/// Default handler table
+static const struct ke_msg_handler bench_default_handler[] =
+{
+    {KE_MSG_DEFAULT_HANDLER, (ke_msg_func_t) bench_msg_handler},
+};
+
+/// Specifies the message handlers that are common to all states
+static const struct ke_state_handler bench_default_state_handler = KE_STATE_HANDLER(bench_default_handler);
+
+/// Task descriptor
+static const struct ke_task_desc bench_task_desc =
+    {bench_state_handler, &bench_default_state_handler, bench_state, 1, 1};
+#else
+/// State and default handlers in one table, as app_default_state
+static struct ke_msg_handler bench_indexed_table[BENCH_TABLE_SIZE + 1];
+
+/// Handler table searched through the index
+static const struct ke_state_handler bench_indexed_table_handler = {bench_indexed_table, BENCH_TABLE_SIZE + 1};
+
+/// Sorted positions of bench_indexed_table
+static uint8_t bench_order[BENCH_TABLE_SIZE + 1];
+
+/// Index of bench_indexed_table
+static struct ke_handler_index bench_index;
+
+static int bench_indexed_msg_handler(ke_msg_id_t const msgid, void const *param,
+                                     ke_task_id_t const dest_id, ke_task_id_t const src_id)
+{
+    return ke_handler_index_dispatch(&bench_index, msgid, param, dest_id, src_id);
+}
+
+/// Default handler registered to the scheduler
+static const struct ke_msg_handler bench_indexed_handler[] =
+{
+    {KE_MSG_DEFAULT_HANDLER, (ke_msg_func_t) bench_indexed_msg_handler},
+};
+
+/// Specifies the message handlers that are common to all states
+static const struct ke_state_handler bench_indexed_state_handler = KE_STATE_HANDLER(bench_indexed_handler);
+
+/// Task descriptor
+static const struct ke_task_desc bench_task_desc =
+    {NULL, &bench_indexed_state_handler, bench_state, 1, 1};
+#endif //KE_HANDLER_INDEX
+
+
+/*
+ * LOCAL FUNCTION DEFINITIONS
+ ****************************************************************************************
+ */
+
+static int bench_msg_handler(ke_msg_id_t const msgid, void const *param,
+                             ke_task_id_t const dest_id, ke_task_id_t const src_id)
+{
+    bench_rx_cnt++;
+
+    return (KE_MSG_CONSUMED);
+}
+
+static uint64_t bench_now_ns(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t) now.tv_sec * 1000000000u + now.tv_nsec;
+}
+
+/**
+ ****************************************************************************************
+ * @brief Send messages to the task and let the scheduler dispatch them.
+ *
+ * @param[in] name      Test name
+ * @param[in] ids       Message identifiers, sent in turn
+ * @param[in] id_cnt    Number of identifiers
+ * @param[in] burst     Number of messages sent before the scheduler runs
+ * @param[in] sizes     Parameter sizes, used in turn
+ * @param[in] size_cnt  Number of parameter sizes
+ * @param[in] count     Number of messages
+ *
+ * @return 0 if all messages were received and freed, 1 otherwise
+ ****************************************************************************************
+ */
+static int bench_run(char const *name, ke_msg_id_t const *ids, int id_cnt, int burst,
+                     uint16_t const *sizes, int size_cnt, uint32_t count)
+{
+    uint64_t start;
+    uint32_t sent = 0;
+    int i;
+
+    bench_rx_cnt = 0;
+    start = bench_now_ns();
+
+    while (sent < count)
+    {
+        for (i = 0; (i < burst) && (sent < count); i++, sent++)
+        {
+            uint8_t *param = ke_msg_alloc(ids[sent % id_cnt], TASK_APP, TASK_APP,
+                                          sizes[sent % size_cnt]);
+
+            param[0] = (uint8_t) sent;
+            ke_msg_send(param);
+        }
+
+        while (!ke_sleep_check())
+        {
+            ke_event_schedule();
+        }
+    }
+
+    printf("%-40s %8.1f ns/msg\n", name, (double)(bench_now_ns() - start) / count);
+
+    if ((bench_rx_cnt != count) || !ke_mem_is_empty(KE_MEM_KE_MSG))
+    {
+        printf("  FAILED: %u of %u messages received, heap %s\n", bench_rx_cnt, count,
+               ke_mem_is_empty(KE_MEM_KE_MSG) ? "empty" : "not empty");
+        return 1;
+    }
+
+    return 0;
+}
+
+#if (KE_HANDLER_INDEX)
+/// Same search as the scheduler
+static ke_msg_func_t bench_linear_search(ke_msg_id_t const msg_id, struct ke_state_handler const *state_handler)
+{
+    for (int i = (state_handler->msg_cnt-1); 0 <= i; i--)
+    {
+        if ((state_handler->msg_table[i].id == msg_id)
+                || (state_handler->msg_table[i].id == KE_MSG_DEFAULT_HANDLER))
+        {
+            return state_handler->msg_table[i].func;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ ****************************************************************************************
+ * @brief Time the handler lookup alone, linear search vs. index, and check that both
+ * searches give the same handler.
+ *
+ * @param[in] name      Test name
+ * @param[in] ids       Message identifiers, searched in turn
+ * @param[in] id_cnt    Number of identifiers
+ * @param[in] count     Number of searches
+ *
+ * @return 0 if the searches agree, 1 otherwise
+ ****************************************************************************************
+ */
+static int bench_lookup(char const *name, ke_msg_id_t const *ids, int id_cnt, uint32_t count)
+{
+    // Volatile sink, so that the searches are not optimized out
+    ke_msg_func_t volatile func;
+    uint64_t start, linear_ns;
+    uint32_t i;
+
+    for (i = 0; i < id_cnt; i++)
+    {
+        if (bench_linear_search(ids[i], &bench_indexed_table_handler)
+                != ke_handler_index_search(&bench_index, ids[i]))
+        {
+            printf("  FAILED: index and linear search differ for message 0x%04x\n", ids[i]);
+            return 1;
+        }
+    }
+
+    start = bench_now_ns();
+    for (i = 0; i < count; i++)
+    {
+        func = bench_linear_search(ids[i % id_cnt], &bench_indexed_table_handler);
+    }
+    linear_ns = bench_now_ns() - start;
+
+    start = bench_now_ns();
+    for (i = 0; i < count; i++)
+    {
+        func = ke_handler_index_search(&bench_index, ids[i % id_cnt]);
+    }
+
+    printf("%-40s %8.1f ns linear, %5.1f ns indexed\n", name, (double) linear_ns / count,
+           (double)(bench_now_ns() - start) / count);
+    (void) func;
+
+    return 0;
+}
+#endif //KE_HANDLER_INDEX
+
+
+/*
+ * MAIN
+ ****************************************************************************************
+ */
+
+int main(int argc, char **argv)
+{
+    uint32_t count = (argc > 1) ? strtoul(argv[1], NULL, 0) : BENCH_ITERATIONS;
+    ke_msg_id_t ids[BENCH_TABLE_SIZE];
+    uint16_t size = BENCH_PARAM_SIZE;
+    ke_msg_id_t id;
+    int err = 0;
+    int i;
+
+    for (i = 0; i < BENCH_TABLE_SIZE; i++)
+    {
+        bench_handler[i].id = BENCH_MSG(i);
+        bench_handler[i].func = (ke_msg_func_t) bench_msg_handler;
+        ids[i] = BENCH_MSG(i);
+    }
+
+    #if (KE_HANDLER_INDEX)
+    bench_indexed_table[0].id = KE_MSG_DEFAULT_HANDLER;
+    bench_indexed_table[0].func = (ke_msg_func_t) bench_msg_handler;
+    for (i = 0; i < BENCH_TABLE_SIZE; i++)
+    {
+        bench_indexed_table[i + 1] = bench_handler[i];
+    }
+    ke_handler_index_init(&bench_index, &bench_indexed_table_handler, bench_order);
+    #endif //KE_HANDLER_INDEX
+
+    ke_init();
+    ke_task_create(TASK_APP, &bench_task_desc);
+
+    printf("ke_bench: %u messages per test, %d handlers, handler cache %d entries%s\n",
+           count, BENCH_TABLE_SIZE, KE_HANDLER_CACHE_SIZE,
+           KE_HANDLER_INDEX ? ", indexed handler table" : "");
+
+    // The scheduler parses the tables from the end
+    id = BENCH_MSG(BENCH_TABLE_SIZE - 1);
+    err |= bench_run("alloc/send/dispatch/free, best", &id, 1, 1, &size, 1, count);
+    id = BENCH_MSG(BENCH_TABLE_SIZE / 2);
+    err |= bench_run("alloc/send/dispatch/free, middle", &id, 1, 1, &size, 1, count);
+    id = BENCH_MSG(0);
+    err |= bench_run("alloc/send/dispatch/free, worst", &id, 1, 1, &size, 1, count);
+    id = BENCH_MSG_DEFAULT(0);
+    err |= bench_run("alloc/send/dispatch/free, default", &id, 1, 1, &size, 1, count);
+    err |= bench_run("handler lookup, all messages", ids, BENCH_TABLE_SIZE, 1, &size, 1, count);
+    err |= bench_run("handler lookup, all messages, burst", ids, BENCH_TABLE_SIZE, BENCH_BURST,
+                     &size, 1, count);
+    err |= bench_run("mixed sizes, burst", ids, BENCH_TABLE_SIZE, BENCH_BURST,
+                     bench_param_size, BENCH_SIZE_CNT, count);
+
+    #if (KE_HANDLER_INDEX)
+    id = BENCH_MSG(0);
+    err |= bench_lookup("lookup only, worst", &id, 1, count);
+    id = BENCH_MSG_DEFAULT(0);
+    err |= bench_lookup("lookup only, default", &id, 1, count);
+    err |= bench_lookup("lookup only, all messages", ids, BENCH_TABLE_SIZE, count);
+    #endif //KE_HANDLER_INDEX
+
+    return err;
+}
@@ -0,0 +1,511 @@
+/**
+ ****************************************************************************************
+ *
+ * @file nvds_sim.c
+ *
+ * @brief Power failure simulator of the read-write NVDS on the host build.
+ *
+ * Runs nvds_flash.c on a model of the NOR flash (programming only clears bits, an erase
+ * sets a sector to 0xFF) and replays a sequence of nvds_put() and nvds_del() which
+ * compacts the log several times. The sequence is then replayed with a power failure
+ * after the N-th programmed byte or erase, for every N: the log is mounted again, every
+ * TAG must hold its value before the interrupted operation or the value written by it,
+ * and the log must accept new values. Finally checks that a locked TAG survives the
+ * compactions.
+ *
+ * With CFG_SPI_FLASH_ASYNC, the stale sectors are erased by a model of the asynchronous
+ * driver which only runs the erase from the main loop, or when it is flushed.
+ *
+ * Usage: nvds_sim [stride]
+ *
+ ****************************************************************************************
+ */
+
+/*
+ * INCLUDE FILES
+ ****************************************************************************************
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rwip_config.h"
+#include "arch.h"
+#include "nvds.h"
+#include "spi_flash.h"
+#include "spi_flash_async.h"
+
+
+/*
+ * DEFINES
+ ****************************************************************************************
+ */
+
+/// Default distance between two power failures, in flash operations
+#define SIM_STRIDE              (1)
+
+/// Number of operations of the sequence
+#define SIM_OPS                 (400)
+
+/// Maximum length of a value
+#define SIM_LEN_MAX             (64)
+
+/// Size of the flash model
+#define SIM_FLASH_SIZE          (NVDS_FLASH_BASE + NVDS_FLASH_SECTORS * NVDS_FLASH_SECTOR_SIZE)
+
+
+/*
+ * STRUCTURES DEFINTIONS
+ ****************************************************************************************
+ */
+
+/// Expected value of a TAG
+struct sim_value
+{
+    /// Written or deleted at least once
+    bool written;
+    /// Last operation is a deletion
+    bool deleted;
+    /// Length of the value
+    uint8_t len;
+    /// Value
+    uint8_t data[SIM_LEN_MAX];
+};
+
+
+/*
+ * GLOBAL VARIABLES
+ ****************************************************************************************
+ */
+
+/// TAGs that can be written
+static const uint8_t sim_tags[] = {NVDS_FLASH_TAGS};
+
+/// Number of TAGs that can be written
+#define SIM_TAG_NB              (sizeof(sim_tags))
+
+/// Flash model
+static uint8_t sim_flash[SIM_FLASH_SIZE];
+
+/// Flash operations (programmed bytes and erases) since the start of the run
+static uint32_t sim_ops;
+
+/// Flash operation cut by the power failure, 0 if none
+static uint32_t sim_cut;
+
+/// Power failed: the flash does not change anymore
+static bool sim_off;
+
+/// Number of sector headers committed since the start of the run
+static uint32_t sim_commits;
+
+/// State of the pseudo random sequence
+static uint32_t sim_seed;
+
+/// Expected values
+static struct sim_value sim_model[SIM_TAG_NB];
+
+#if (SPI_FLASH_ASYNC)
+/// Asynchronous erase accepted by the driver model and not run yet
+static spi_flash_async_cb_t sim_erase_cb;
+static uint32_t sim_erase_addr;
+
+/// Number of asynchronous erases run by spi_flash_async_flush()
+static uint32_t sim_flushes;
+#endif // SPI_FLASH_ASYNC
+
+
+/*
+ * FLASH MODEL
+ ****************************************************************************************
+ */
+
+/// Count a flash operation, false if it is cut by the power failure
+static bool sim_consume(void)
+{
+    sim_ops++;
+
+    if ((sim_cut != 0) && (sim_ops >= sim_cut))
+        sim_off = true;
+
+    return !sim_off;
+}
+
+static void sim_check_range(uint32_t address, uint32_t size)
+{
+    if ((address < NVDS_FLASH_BASE) || (address + size > SIM_FLASH_SIZE))
+    {
+        printf("  FAILED: access out of the NVDS area, 0x%05X, %u bytes\n", address, size);
+        exit(1);
+    }
+}
+
+static void sim_erase(uint32_t address)
+{
+    sim_check_range(address, NVDS_FLASH_SECTOR_SIZE);
+
+    if (sim_off)
+        return;
+
+    // an erase cut by the power failure leaves the sector partly erased
+    if (!sim_consume())
+        memset(&sim_flash[address], 0xFF, NVDS_FLASH_SECTOR_SIZE / 2);
+    else
+        memset(&sim_flash[address], 0xFF, NVDS_FLASH_SECTOR_SIZE);
+}
+
+int8_t spi_flash_wait_till_ready(void)
+{
+    return ERR_OK;
+}
+
+uint32_t spi_flash_read_data(uint8_t *rd_data_ptr, uint32_t address, uint32_t size)
+{
+    sim_check_range(address, size);
+    memcpy(rd_data_ptr, &sim_flash[address], size);
+
+    return size;
+}
+
+int32_t spi_flash_write_data(uint8_t *wr_data_ptr, uint32_t address, uint32_t size)
+{
+    uint32_t i;
+
+    sim_check_range(address, size);
+
+    if (((address - NVDS_FLASH_BASE) % NVDS_FLASH_SECTOR_SIZE == 0) && (size == 4))
+        sim_commits++;
+
+    for (i = 0; (i < size) && !sim_off; i++)
+    {
+        if (sim_consume())
+            sim_flash[address + i] &= wr_data_ptr[i];
+    }
+
+    return size;
+}
+
+int8_t spi_flash_block_erase_start(uint32_t address, SPI_erase_module_t spiEraseModule)
+{
+    sim_erase(address);
+
+    return ERR_OK;
+}
+
+#if (SPI_FLASH_ASYNC)
+bool spi_flash_async_busy(void)
+{
+    return (sim_erase_cb != NULL);
+}
+
+int8_t spi_flash_async_block_erase(uint32_t address, SPI_erase_module_t spiEraseModule, spi_flash_async_cb_t cb)
+{
+    if (sim_erase_cb != NULL)
+        return ERR_BUSY;
+
+    sim_erase_cb = cb;
+    sim_erase_addr = address;
+
+    return ERR_OK;
+}
+
+/// Run the pending asynchronous erase, as the driver task does from the main loop
+static void sim_async_run(void)
+{
+    spi_flash_async_cb_t cb = sim_erase_cb;
+
+    if (cb == NULL)
+        return;
+
+    sim_erase_cb = NULL;
+    sim_erase(sim_erase_addr);
+    cb(ERR_OK);
+}
+
+int8_t spi_flash_async_flush(void)
+{
+    if (sim_erase_cb != NULL)
+        sim_flushes++;
+
+    sim_async_run();
+
+    return ERR_OK;
+}
+#endif // SPI_FLASH_ASYNC
+
+/// The NVDS storage area is empty
+uint8_t nvds_get_ptr(uint8_t tag, nvds_tag_len_t * lengthPtr, uint8_t const **data)
+{
+    return NVDS_TAG_NOT_DEFINED;
+}
+
+
+/*
+ * LOCAL FUNCTION DEFINITIONS
+ ****************************************************************************************
+ */
+
+static uint32_t sim_rand(void)
+{
+    sim_seed = sim_seed * 1103515245 + 12345;
+
+    return (sim_seed >> 16) & 0x7FFF;
+}
+
+/// Check the value of a TAG, false if it does not match
+static bool sim_match(uint8_t idx, struct sim_value const *value)
+{
+    uint8_t buf[SIM_LEN_MAX];
+    nvds_tag_len_t len = sizeof(buf);
+    uint8_t status = nvds_flash_get(sim_tags[idx], &len, buf);
+
+    if (!value->written)
+        return (status == NVDS_TAG_NOT_DEFINED);
+
+    if (value->deleted)
+        return (status == NVDS_FAIL);
+
+    return ((status == NVDS_OK) && (len == value->len) && (memcmp(buf, value->data, len) == 0));
+}
+
+/// Power back on: mount the log again, the RAM of the NVDS and of the driver is lost
+static bool sim_power_on(void)
+{
+    sim_cut = 0;
+    sim_off = false;
+#if (SPI_FLASH_ASYNC)
+    sim_erase_cb = NULL;
+#endif
+
+    return (nvds_flash_init() == NVDS_OK);
+}
+
+/**
+ ****************************************************************************************
+ * @brief Check the log after a power failure: values of the TAGs, then a new value
+ * written to each TAG.
+ *
+ * @param[in] idx   TAG of the interrupted operation
+ * @param[in] next  Value written by the interrupted operation
+ *
+ * @return 0 if the log is consistent, 1 otherwise
+ ****************************************************************************************
+ */
+static int sim_check(uint8_t idx, struct sim_value const *next)
+{
+    struct sim_value value;
+    uint8_t i;
+
+    if (!sim_power_on())
+    {
+        printf("  FAILED: cut at %u, mount failed\n", sim_cut);
+        return 1;
+    }
+
+    for (i = 0; i < SIM_TAG_NB; i++)
+    {
+        if (!sim_match(i, &sim_model[i]) && ((i != idx) || !sim_match(i, next)))
+        {
+            printf("  FAILED: TAG 0x%02X, wrong value after the power failure\n", sim_tags[i]);
+            return 1;
+        }
+    }
+
+    for (i = 0; i < SIM_TAG_NB; i++)
+    {
+        memset(&value, 0, sizeof(value));
+        value.written = true;
+        value.len = 1 + i;
+        memset(value.data, i, value.len);
+
+        if ((nvds_put(sim_tags[i], value.len, value.data) != NVDS_OK) || !sim_match(i, &value))
+        {
+            printf("  FAILED: TAG 0x%02X, cannot be written after the power failure\n", sim_tags[i]);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ ****************************************************************************************
+ * @brief Replay the sequence on an erased flash.
+ *
+ * @param[in] cut  Flash operation cut by a power failure, 0 for none
+ *
+ * @return 0 if the log is consistent, 1 otherwise
+ ****************************************************************************************
+ */
+static int sim_run(uint32_t cut)
+{
+    struct sim_value next;
+    uint8_t status;
+    uint8_t idx;
+    uint32_t op;
+    uint8_t i;
+
+    memset(sim_flash, 0xFF, sizeof(sim_flash));
+    memset(sim_model, 0, sizeof(sim_model));
+    sim_ops = 0;
+    sim_cut = cut;
+    sim_off = false;
+    sim_commits = 0;
+    sim_seed = 1;
+#if (SPI_FLASH_ASYNC)
+    sim_erase_cb = NULL;
+#endif
+
+    status = nvds_flash_init();
+    if (sim_off)
+        return sim_check(0, &sim_model[0]);
+
+    if (status != NVDS_OK)
+    {
+        printf("  FAILED: mount of the erased flash\n");
+        return 1;
+    }
+
+    for (op = 0; op < SIM_OPS; op++)
+    {
+        idx = sim_rand() % SIM_TAG_NB;
+        memset(&next, 0, sizeof(next));
+        next.written = true;
+
+        if ((sim_rand() % 8) == 0)
+        {
+            next.deleted = true;
+            status = nvds_del(sim_tags[idx]);
+        }
+        else
+        {
+            next.len = 1 + sim_rand() % SIM_LEN_MAX;
+            for (i = 0; i < next.len; i++)
+                next.data[i] = sim_rand();
+
+            status = nvds_put(sim_tags[idx], next.len, next.data);
+        }
+
+        if (sim_off)
+            return sim_check(idx, &next);
+
+        if ((status != NVDS_OK) || !sim_match(idx, &next))
+        {
+            printf("  FAILED: operation %u on TAG 0x%02X, status %d\n", op, sim_tags[idx], status);
+            return 1;
+        }
+
+        sim_model[idx] = next;
+
+        #if (SPI_FLASH_ASYNC)
+        // the main loop does not always run between two writes
+        if ((sim_rand() % 4) == 0)
+            sim_async_run();
+        #endif // SPI_FLASH_ASYNC
+    }
+
+    // nothing lost while the sectors are compacted and erased
+    for (i = 0; i < SIM_TAG_NB; i++)
+    {
+        if (!sim_match(i, &sim_model[i]))
+        {
+            printf("  FAILED: TAG 0x%02X, wrong value at the end of the sequence\n", sim_tags[i]);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/// A locked TAG keeps its value through the compactions and a power cycle
+static int sim_lock(void)
+{
+    uint8_t locked[SIM_LEN_MAX];
+    uint8_t data[SIM_LEN_MAX];
+    struct sim_value value;
+    uint32_t commits = sim_commits;
+    uint32_t i;
+
+    memset(locked, 0xA5, sizeof(locked));
+    memset(data, 0x5A, sizeof(data));
+
+    if ((nvds_put(sim_tags[0], sizeof(locked), locked) != NVDS_OK) || (nvds_lock(sim_tags[0]) != NVDS_OK))
+    {
+        printf("  FAILED: lock\n");
+        return 1;
+    }
+
+    for (i = 0; (sim_commits - commits) < 2 * NVDS_FLASH_SECTORS; i++)
+    {
+        if ((nvds_put(sim_tags[1 + i % (SIM_TAG_NB - 1)], sizeof(data), data) != NVDS_OK)
+            || (nvds_put(sim_tags[0], sizeof(data), data) != NVDS_PARAM_LOCKED))
+        {
+            printf("  FAILED: write %u while a TAG is locked\n", i);
+            return 1;
+        }
+        #if (SPI_FLASH_ASYNC)
+        sim_async_run();
+        #endif // SPI_FLASH_ASYNC
+    }
+
+    memset(&value, 0, sizeof(value));
+    value.written = true;
+    value.len = sizeof(locked);
+    memcpy(value.data, locked, sizeof(locked));
+
+    if (!sim_power_on() || !sim_match(0, &value) || (nvds_del(sim_tags[0]) != NVDS_PARAM_LOCKED))
+    {
+        printf("  FAILED: locked TAG lost\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+
+/*
+ * MAIN
+ ****************************************************************************************
+ */
+
+int main(int argc, char **argv)
+{
+    uint32_t stride = (argc > 1) ? strtoul(argv[1], NULL, 0) : SIM_STRIDE;
+    uint32_t total, commits, cut;
+    uint32_t runs = 0, failed = 0;
+    int err;
+
+    if (stride == 0)
+        stride = 1;
+
+    err = sim_run(0);
+    total = sim_ops;
+    commits = sim_commits;
+
+    printf("nvds_sim: %d sectors, %s erase, %u TAGs, %d operations, %u flash operations, %u compactions\n",
+           NVDS_FLASH_SECTORS, SPI_FLASH_ASYNC ? "asynchronous" : "synchronous", (unsigned)SIM_TAG_NB,
+           SIM_OPS, total, commits - 1);
+
+    for (cut = 1; cut <= total; cut += stride, runs++)
+    {
+        if (sim_run(cut))
+        {
+            printf("  power failure at flash operation %u\n", cut);
+            failed++;
+        }
+    }
+
+    printf("%u power failures, %u failed\n", runs, failed);
+
+    err |= (failed != 0);
+
+    sim_run(0);
+    err |= sim_lock();
+
+    #if (SPI_FLASH_ASYNC)
+    printf("%u compactions, over all the runs, waited for an erase started in the background\n", sim_flushes);
+    err |= (sim_flushes == 0);
+    #endif // SPI_FLASH_ASYNC
+
+    return err;
+}
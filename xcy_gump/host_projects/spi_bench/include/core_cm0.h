@@ -0,0 +1,10 @@
+/**
+ ****************************************************************************************
+ *
+ * @file core_cm0.h
+ *
+ * @brief Empty replacement of the CMSIS core header for the SPI benchmark (host build):
+ * the SPI driver does not use the NVIC, and the ARM header redefines __INLINE.
+ *
+ ****************************************************************************************
+ */
@@ -0,0 +1,31 @@
+/**
+ ****************************************************************************************
+ *
+ * @file global_io.h
+ *
+ * @brief Register access of the SPI benchmark (host build).
+ *
+ * Includes the real global_io.h, then routes the 16-bit register accessors, and the
+ * bit field accessors built on them, to the SPI controller model of spi_bench.c.
+ *
+ ****************************************************************************************
+ */
+
+#ifndef SPI_BENCH_GLOBAL_IO_H_
+#define SPI_BENCH_GLOBAL_IO_H_
+
+#include_next "global_io.h"
+
+#undef SetWord16
+#undef GetWord16
+
+#define SetWord16(a,d)      bench_reg_write((a), (d))
+#define GetWord16(a)        bench_reg_read(a)
+
+/// Write a 16-bit register of the model
+void bench_reg_write(uint32 addr, uint16 data);
+
+/// Read a 16-bit register of the model
+uint16 bench_reg_read(uint32 addr);
+
+#endif // SPI_BENCH_GLOBAL_IO_H_
@@ -0,0 +1,428 @@
+/**
+ ****************************************************************************************
+ *
+ * @file spi_bench.c
+ *
+ * @brief Cycle benchmark of the SPI flash data transfers on the host build.
+ *
+ * Runs the real spi.c and spi_flash.c against a model of the SPI controller and of a
+ * serial flash, and compares spi_flash_read_data()/spi_flash_page_program(), which use
+ * the block transfers, with the former byte per spi_access() loops.
+ *
+ * Cycle model, at the 16MHz system clock:
+ * - every SPI register access costs BENCH_REG_CYCLES (Cortex-M0 LDRH/STRH to the APB),
+ * - a transfer starts when SPI_RX_TX_REG0 is written and sets SPI_INT_BIT after
+ *   (word bits) x (SPI_CLK divider) cycles, so SPI_INT_BIT polling costs what it costs
+ *   on the chip.
+ * The instructions between the register accesses (loop, byte packing) are not counted:
+ * the figures are a lower bound, dominated by the bus time at the SPOTAR clock.
+ *
+ * Usage: spi_bench
+ *
+ ****************************************************************************************
+ */
+
+/*
+ * INCLUDE FILES
+ ****************************************************************************************
+ */
+#include "global_io.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "spi.h"
+#include "spi_flash.h"
+
+
+/*
+ * DEFINES
+ ****************************************************************************************
+ */
+
+/// Cycles of one access to a SPI register
+#define BENCH_REG_CYCLES        (2)
+
+/// Size of the flash model (SPOTAR image bank)
+#define BENCH_FLASH_SIZE        (0x20000)
+
+/// Page size of the flash model
+#define BENCH_PAGE_SIZE         (256)
+
+/// Status register reads during which the flash stays busy after a page program
+#define BENCH_PROGRAM_BUSY      (3)
+
+/// Flash chip select pad
+#define BENCH_CS_PORT           (GPIO_PORT_0)
+#define BENCH_CS_PIN            (GPIO_PIN_3)
+
+
+/*
+ * GLOBAL VARIABLES
+ ****************************************************************************************
+ */
+
+/// SPI controller model
+static struct
+{
+    /// SPI_CTRL_REG, SPI_INT_BIT excluded
+    uint16_t ctrl;
+    /// Data written in SPI_RX_TX_REG0/1
+    uint16_t tx[2];
+    /// Data received by the last transfer
+    uint16_t rx[2];
+    /// Cycle at which the current transfer ends
+    uint64_t end;
+    /// Transfer pending (SPI_INT_BIT not cleared)
+    bool pending;
+} bench_spi;
+
+/// Serial flash model
+static struct
+{
+    /// Memory array
+    uint8_t mem[BENCH_FLASH_SIZE];
+    /// Chip selected
+    bool selected;
+    /// Bytes exchanged since the chip was selected
+    uint32_t count;
+    /// Command of the current transaction
+    uint8_t cmd;
+    /// Address of the current transaction
+    uint32_t addr;
+    /// Write enable latch
+    bool wel;
+    /// Remaining busy status reads
+    int busy;
+} bench_flash;
+
+/// Cycle counter and register access counter
+static uint64_t bench_cycles;
+static uint32_t bench_reg_nb;
+
+
+/*
+ * REGISTER MODEL
+ ****************************************************************************************
+ */
+
+/// Exchange one byte with the flash, most significant byte first on the bus
+static uint8_t bench_flash_xfer(uint8_t out)
+{
+    uint8_t in = 0xFF;
+    uint32_t n = bench_flash.count++;
+
+    if (!bench_flash.selected)
+        return in;
+
+    if (n == 0)
+    {
+        bench_flash.cmd = out;
+        bench_flash.addr = 0;
+        if (out == WRITE_ENABLE)
+            bench_flash.wel = true;
+        return in;
+    }
+
+    switch (bench_flash.cmd)
+    {
+        case READ_STATUS_REG:
+            in = (bench_flash.busy ? STATUS_BUSY : 0) | (bench_flash.wel ? STATUS_WEL : 0);
+            if (bench_flash.busy)
+                bench_flash.busy--;
+            break;
+
+        case READ_DATA:
+        case PAGE_PROGRAM:
+            if (n < 4)
+            {
+                bench_flash.addr = (bench_flash.addr << 8) | out;
+            }
+            else if (bench_flash.cmd == READ_DATA)
+            {
+                in = bench_flash.mem[bench_flash.addr++ % BENCH_FLASH_SIZE];
+            }
+            else if (bench_flash.wel)
+            {
+                // The address wraps in the page, programming only clears bits
+                uint32_t addr = (bench_flash.addr & ~(BENCH_PAGE_SIZE - 1))
+                              | ((bench_flash.addr + n - 4) & (BENCH_PAGE_SIZE - 1));
+
+                bench_flash.mem[addr % BENCH_FLASH_SIZE] &= out;
+            }
+            break;
+
+        default:
+            break;
+    }
+
+    return in;
+}
+
+static void bench_flash_select(bool selected)
+{
+    if (bench_flash.selected && !selected && (bench_flash.cmd == PAGE_PROGRAM) && (bench_flash.count > 4))
+    {
+        bench_flash.wel = false;
+        bench_flash.busy = BENCH_PROGRAM_BUSY;
+    }
+
+    bench_flash.selected = selected;
+    bench_flash.count = 0;
+}
+
+/// Start a transfer of the current word size
+static void bench_spi_start(void)
+{
+    static const uint8_t divider[4] = {8, 4, 2, 14};
+    int bytes = 1 << ((bench_spi.ctrl & SPI_WORD) >> 7);    // 8, 16 or 32 bits
+    uint32_t out = ((uint32_t)bench_spi.tx[1] << 16) | bench_spi.tx[0];
+    uint32_t in = 0;
+    int i;
+
+    if (bytes > 4)
+    {
+        printf("  FAILED: 9-bit mode not modelled\n");
+        exit(1);
+    }
+
+    for (i = bytes - 1; i >= 0; i--)
+    {
+        in = (in << 8) | bench_flash_xfer((uint8_t)(out >> (8 * i)));
+    }
+
+    bench_spi.rx[0] = (uint16_t)in;
+    bench_spi.rx[1] = (uint16_t)(in >> 16);
+    bench_spi.end = bench_cycles + 8 * bytes * divider[(bench_spi.ctrl & SPI_CLK) >> 3];
+    bench_spi.pending = true;
+}
+
+void bench_reg_write(uint32 addr, uint16 data)
+{
+    bench_cycles += BENCH_REG_CYCLES;
+    bench_reg_nb++;
+
+    switch (addr)
+    {
+        case SPI_CTRL_REG:
+            bench_spi.ctrl = data & ~SPI_INT_BIT;
+            break;
+
+        case SPI_RX_TX_REG0:
+            bench_spi.tx[0] = data;
+            bench_spi_start();
+            break;
+
+        case SPI_RX_TX_REG1:
+            bench_spi.tx[1] = data;
+            break;
+
+        case SPI_CLEAR_INT_REG:
+            bench_spi.pending = false;
+            break;
+
+        default:
+            break;
+    }
+}
+
+uint16 bench_reg_read(uint32 addr)
+{
+    bench_cycles += BENCH_REG_CYCLES;
+    bench_reg_nb++;
+
+    switch (addr)
+    {
+        case SPI_CTRL_REG:
+            return bench_spi.ctrl
+                 | ((bench_spi.pending && (bench_cycles >= bench_spi.end)) ? SPI_INT_BIT : 0);
+
+        case SPI_RX_TX_REG0:
+            return bench_spi.rx[0];
+
+        case SPI_RX_TX_REG1:
+            return bench_spi.rx[1];
+
+        default:
+            return 0;
+    }
+}
+
+// The chip select is the only GPIO used by the SPI driver
+
+void GPIO_SetActive(GPIO_PORT port, GPIO_PIN pin)
+{
+    if ((port == BENCH_CS_PORT) && (pin == BENCH_CS_PIN))
+        bench_flash_select(false);
+}
+
+void GPIO_SetInactive(GPIO_PORT port, GPIO_PIN pin)
+{
+    if ((port == BENCH_CS_PORT) && (pin == BENCH_CS_PIN))
+        bench_flash_select(true);
+}
+
+
+/*
+ * FORMER DATA PATHS
+ ****************************************************************************************
+ */
+
+/// spi_flash_read_data() before the block transfers: one spi_access() per byte
+static uint32_t bench_legacy_read(uint8_t *rd_data_ptr, uint32_t address, uint32_t size)
+{
+    uint32_t i;
+
+    if (spi_flash_wait_till_ready() != ERR_OK)
+        return 0;
+
+    spi_set_bitmode(SPI_MODE_32BIT);
+    spi_cs_low();
+    spi_access((READ_DATA << 24) | address);
+
+    spi_set_bitmode(SPI_MODE_8BIT);
+    for (i = 0; i < size; i++)
+    {
+        *rd_data_ptr++ = (uint8_t)spi_access(0x0000);
+    }
+
+    spi_cs_high();
+
+    return size;
+}
+
+/// spi_flash_page_program() before the block transfers: one spi_access() per byte
+static int32_t bench_legacy_program(uint8_t *wr_data_ptr, uint32_t address, uint16_t size)
+{
+    if ((spi_flash_wait_till_ready() != ERR_OK) || (spi_flash_set_write_enable() != ERR_OK))
+        return ERR_TIMEOUT;
+
+    spi_set_bitmode(SPI_MODE_32BIT);
+    spi_cs_low();
+    spi_access((PAGE_PROGRAM << 24) | address);
+
+    spi_set_bitmode(SPI_MODE_8BIT);
+    while (size > 0)
+    {
+        spi_access(*wr_data_ptr++);
+        size--;
+    }
+
+    spi_cs_high();
+
+    return spi_flash_wait_till_ready();
+}
+
+
+/*
+ * BENCHMARK
+ ****************************************************************************************
+ */
+
+static uint64_t bench_start_cycles;
+static uint32_t bench_start_reg_nb;
+
+static void bench_start(void)
+{
+    bench_start_cycles = bench_cycles;
+    bench_start_reg_nb = bench_reg_nb;
+}
+
+static uint64_t bench_print(char const *name, uint32_t size)
+{
+    uint64_t cycles = bench_cycles - bench_start_cycles;
+
+    printf("%-32s %8llu cycles %7.1f cycles/B %5u reg accesses\n", name,
+           (unsigned long long)cycles, (double)cycles / size, bench_reg_nb - bench_start_reg_nb);
+
+    return cycles;
+}
+
+/**
+ ****************************************************************************************
+ * @brief Program a page and read it back with both paths, at the given SPI clock.
+ *
+ * @return 0 if the data read back is the data programmed, 1 otherwise
+ ****************************************************************************************
+ */
+static int bench_run(char const *clock, SPI_XTAL_Freq_t freq, uint32_t size)
+{
+    SPI_Pad_t cs = {BENCH_CS_PORT, BENCH_CS_PIN};
+    uint8_t pattern[BENCH_PAGE_SIZE];
+    uint8_t data[BENCH_PAGE_SIZE];
+    uint64_t legacy, block;
+    uint32_t addr = 0x1000;
+    uint32_t i;
+    int err = 0;
+
+    printf("-- %s, %u bytes\n", clock, size);
+
+    spi_init(&cs, SPI_MODE_8BIT, SPI_ROLE_MASTER, SPI_CLK_IDLE_POL_LOW, SPI_PHA_MODE_0,
+             SPI_MINT_DISABLE, freq);
+
+    for (i = 0; i < size; i++)
+    {
+        pattern[i] = (uint8_t)(i * 7 + size);
+    }
+
+    memset(bench_flash.mem, 0xFF, sizeof(bench_flash.mem));
+    bench_start();
+    bench_legacy_program(pattern, addr, size);
+    legacy = bench_print("page program, byte loop", size);
+    err |= (memcmp(&bench_flash.mem[addr], pattern, size) != 0);
+
+    memset(bench_flash.mem, 0xFF, sizeof(bench_flash.mem));
+    bench_start();
+    spi_flash_page_program(pattern, addr, size);
+    block = bench_print("page program, block", size);
+    err |= (memcmp(&bench_flash.mem[addr], pattern, size) != 0);
+    printf("  %.1f%% fewer cycles\n", 100.0 * (legacy - block) / legacy);
+
+    memset(data, 0, sizeof(data));
+    bench_start();
+    bench_legacy_read(data, addr, size);
+    legacy = bench_print("read, byte loop", size);
+    err |= (memcmp(data, pattern, size) != 0);
+
+    memset(data, 0, sizeof(data));
+    bench_start();
+    spi_flash_read_data(data, addr, size);
+    block = bench_print("read, block", size);
+    err |= (memcmp(data, pattern, size) != 0);
+    printf("  %.1f%% fewer cycles\n", 100.0 * (legacy - block) / legacy);
+
+    if ((GetBits16(SPI_CTRL_REG, SPI_WORD) != SPI_MODE_8BIT) || bench_flash.selected)
+    {
+        printf("  FAILED: SPI not left in 8-bit mode or flash still selected\n");
+        err = 1;
+    }
+    else if (err)
+    {
+        printf("  FAILED: data read back differs\n");
+    }
+
+    return err;
+}
+
+
+/*
+ * MAIN
+ ****************************************************************************************
+ */
+
+int main(int argc, char **argv)
+{
+    int err = 0;
+
+    spi_flash_init(BENCH_FLASH_SIZE, BENCH_PAGE_SIZE);
+
+    printf("spi_bench: %d cycles per SPI register access, 16MHz system clock\n", BENCH_REG_CYCLES);
+
+    // SPOTAR clock, then the fastest one; 255 bytes exercises the 8-bit tail
+    err |= bench_run("SPI_XTAL_DIV_8 (2MHz)", SPI_XTAL_DIV_8, BENCH_PAGE_SIZE);
+    err |= bench_run("SPI_XTAL_DIV_2 (8MHz)", SPI_XTAL_DIV_2, BENCH_PAGE_SIZE);
+    err |= bench_run("SPI_XTAL_DIV_2 (8MHz)", SPI_XTAL_DIV_2, BENCH_PAGE_SIZE - 1);
+
+    return err;
+}
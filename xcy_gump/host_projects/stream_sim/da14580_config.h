@@ -0,0 +1,41 @@
+/**
+ ****************************************************************************************
+ *
+ * @file da14580_config.h
+ *
+ * @brief Compile configuration file of the streaming simulator (host build).
+ *
+ ****************************************************************************************
+ */
+
+#ifndef DA14580_CONFIG_H_
+#define DA14580_CONFIG_H_
+
+/////////////////////////////////////////////////////////////
+/*Host (off-target) build of the kernel*/
+#define CFG_KE_HOST
+/////////////////////////////////////////////////////////////
+
+/*Peripheral role with the host and the controller*/
+#define CFG_BLE
+#define CFG_HOST
+#define CFG_EMB
+#define CFG_APP
+#define CFG_PERIPHERAL          1
+#define CFG_CON                 1
+#define CFG_ATTS
+#define CFG_BLECORE_11
+
+/*Security, needed by the GAP definitions*/
+#define CFG_SECURITY_ON         1
+
+/*StreamData Device profile*/
+#define CFG_PRF_STREAMDATAD
+
+/*Maximum user connections*/
+#define BLE_CONNECTION_MAX_USER 1
+
+/*No breakpoints in the application code*/
+#define DEVELOPMENT__NO_OTP     0
+
+#endif // DA14580_CONFIG_H_
@@ -0,0 +1,653 @@
+/**
+ ****************************************************************************************
+ *
+ * @file stream_sim.c
+ *
+ * @brief Simulation of the streamdata TX buffer refill on a model of the link layer.
+ *
+ * The StreamData Device task (streamdatad.c, streamdatad_task.c) runs unchanged on the
+ * host build of the kernel. L2CC and the link layer are modelled: every
+ * L2CC_PDU_SEND_REQ takes one of the TX buffers (l2cm_get_nb_buffer_available()), and
+ * each connection event transmits the buffered packets back to back until the buffers
+ * are empty or the event reaches the next anchor. The L2CC_DATA_SEND_RSP of the packets
+ * transmitted reach the host after the event, as the TX confirmations of the controller
+ * are processed at the end of the event.
+ *
+ * The application side is played in three ways:
+ * - rsp:      one packet on STREAMDATAD_START_IND, then one per L2CC_DATA_SEND_RSP, as
+ *             stream_more_data_handler() did before the end of event refill,
+ * - evt_end:  app_stream_evt_end() at the end of every BLE event, which produces until
+ *             streamdatad has no credit left,
+ * - ring:     a producer posting STREAMDATAD_SEND_DATA_PACKETS_REQ at every BLE event,
+ *             drained from the producer ring by streamdatad_evt_end().
+ *
+ * For several connection intervals, reports the payload throughput on air, the packets
+ * per connection event and the part of the event time during which the TX buffers were
+ * empty. Every packet is checked on air, in order, and the credits, the ring and the
+ * kernel heap must be back to their initial state once the stream is stopped.
+ *
+ * Usage: stream_sim [duration_ms [tx_buffers]]
+ *
+ ****************************************************************************************
+ */
+
+/*
+ * INCLUDE FILES
+ ****************************************************************************************
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rwip_config.h"
+#include "arch.h"
+#include "co_utils.h"
+#include "ke.h"
+#include "ke_event.h"
+#include "ke_mem.h"
+#include "ke_msg.h"
+#include "ke_task.h"
+#include "ke_timer.h"
+#include "attm_db.h"
+#include "attm_util.h"
+#include "atts_util.h"
+#include "gapc.h"
+#include "gattc_task.h"
+#include "l2cm.h"
+#include "l2cc_task.h"
+#include "streamdatad.h"
+#include "streamdatad_task.h"
+
+
+/*
+ * DEFINES
+ ****************************************************************************************
+ */
+
+/// Default simulated duration of each run (ms)
+#define SIM_DURATION_MS         (10000)
+
+/// Default number of TX buffers (the value used by the former streamdatad code)
+#define SIM_TX_BUF              (5)
+
+/// Maximum number of TX buffers
+#define SIM_TX_BUF_MAX          (16)
+
+/// Air time of a notification with its empty acknowledgement (us): 20 bytes of value in
+/// a 27 bytes LL payload (296us), IFS, empty PDU (80us), IFS, at 1Mbps
+#define SIM_PKT_US              (296 + 150 + 80 + 150)
+
+/// Packets posted by the producer at every BLE event in the ring mode
+#define SIM_RING_BURST          (4)
+
+/// Number of simulated attribute handles
+#define SIM_ATT_NB              (64)
+
+/// Size of a payload in 16-bit words
+#define SIM_PKT_WORDS           (STREAMDATAD_PACKET_SIZE / 2)
+
+/// Application modes
+enum sim_mode
+{
+    /// One packet per L2CC_DATA_SEND_RSP
+    SIM_MODE_RSP,
+    /// Refill at the end of every BLE event
+    SIM_MODE_EVT_END,
+    /// Producer ring fed with STREAMDATAD_SEND_DATA_PACKETS_REQ
+    SIM_MODE_RING,
+    SIM_MODE_MAX
+};
+
+
+/*
+ * LOCAL FUNCTION DECLARATIONS
+ ****************************************************************************************
+ */
+
+static int sim_app_start_ind_handler(ke_msg_id_t const msgid, void const *param,
+                                     ke_task_id_t const dest_id, ke_task_id_t const src_id);
+static int sim_app_data_send_rsp_handler(ke_msg_id_t const msgid, void const *param,
+                                         ke_task_id_t const dest_id, ke_task_id_t const src_id);
+static int sim_app_ignore_handler(ke_msg_id_t const msgid, void const *param,
+                                  ke_task_id_t const dest_id, ke_task_id_t const src_id);
+static int sim_l2cc_pdu_send_req_handler(ke_msg_id_t const msgid,
+                                         struct l2cc_pdu_send_req const *param,
+                                         ke_task_id_t const dest_id, ke_task_id_t const src_id);
+
+
+/*
+ * GLOBAL VARIABLES
+ ****************************************************************************************
+ */
+
+/// L2CAP manager environment, read by l2cm_get_nb_buffer_available()
+struct l2cm_env_tag l2cm_env;
+
+/// Mode names
+static char const * const sim_mode_name[SIM_MODE_MAX] = {"rsp", "evt_end", "ring"};
+
+/// Connection intervals of the runs (1.25ms units)
+static const uint16_t sim_intervals[] = {6, 9, 24, 40};
+
+/// Attribute values, only the 16-bit configuration values are used
+static uint16_t sim_att_val[SIM_ATT_NB];
+
+/// Application state
+static struct
+{
+    /// Mode of the run
+    enum sim_mode mode;
+    /// Stream started
+    bool started;
+    /// Sequence number of the next packet produced
+    uint16_t seq;
+} sim_app;
+
+/// Link layer state
+static struct
+{
+    /// TX buffers, in transmission order
+    struct l2cc_pdu_send_req *buf[SIM_TX_BUF_MAX];
+    /// Number of TX buffers
+    uint8_t buf_nb;
+    /// Index of the oldest buffered packet
+    uint8_t buf_first;
+    /// Number of buffered packets
+    uint8_t buf_cnt;
+    /// Sequence number expected in the next packet on air
+    uint16_t seq;
+    /// Packets missing on air
+    uint32_t gap;
+    /// Packets transmitted
+    uint32_t tx_nb;
+    /// Connection events, and events that transmitted at least one packet
+    uint32_t evt_nb;
+    uint32_t evt_tx_nb;
+    /// Fewest and most packets transmitted by an event after the start of the stream
+    uint32_t evt_pkt_min;
+    uint32_t evt_pkt_max;
+    /// Event time during which the TX buffers were empty (us)
+    uint64_t idle_us;
+    /// Event time available (us)
+    uint64_t evt_us;
+    /// Errors found
+    int err;
+} sim_ll;
+
+/// Application handlers
+static const struct ke_msg_handler sim_app_default_state[] =
+{
+    {STREAMDATAD_CREATE_DB_CFM, (ke_msg_func_t) sim_app_ignore_handler},
+    {STREAMDATAD_START_IND,     (ke_msg_func_t) sim_app_start_ind_handler},
+    {STREAMDATAD_STOP_IND,      (ke_msg_func_t) sim_app_ignore_handler},
+    {L2CC_DATA_SEND_RSP,        (ke_msg_func_t) sim_app_data_send_rsp_handler},
+};
+
+/// Application default handler
+static const struct ke_state_handler sim_app_default_handler = KE_STATE_HANDLER(sim_app_default_state);
+
+/// Application task state
+static ke_state_t sim_app_state[1];
+
+/// Application task descriptor
+static const struct ke_task_desc sim_app_desc = {NULL, &sim_app_default_handler, sim_app_state, 1, 1};
+
+/// L2CC handlers
+static const struct ke_msg_handler sim_l2cc_default_state[] =
+{
+    {L2CC_PDU_SEND_REQ, (ke_msg_func_t) sim_l2cc_pdu_send_req_handler},
+};
+
+/// L2CC default handler
+static const struct ke_state_handler sim_l2cc_default_handler = KE_STATE_HANDLER(sim_l2cc_default_state);
+
+/// L2CC task state
+static ke_state_t sim_l2cc_state[1];
+
+/// L2CC task descriptor
+static const struct ke_task_desc sim_l2cc_desc = {NULL, &sim_l2cc_default_handler, sim_l2cc_state, 1, 1};
+
+
+/*
+ * STUBS OF THE ATTRIBUTE DATABASE AND OF GAP
+ ****************************************************************************************
+ */
+
+uint8_t attm_svc_create_db(uint16_t *shdl, uint8_t *cfg_flag, uint8_t max_nb_att,
+                           uint8_t *att_tbl, ke_task_id_t const dest_id,
+                           const struct attm_desc *att_db)
+{
+    if (*shdl == 0)
+    {
+        *shdl = 1;
+    }
+
+    return (ATT_ERR_NO_ERROR);
+}
+
+uint8_t attmdb_svc_set_permission(uint16_t handle, uint8_t perm)
+{
+    return (ATT_ERR_NO_ERROR);
+}
+
+uint8_t attmdb_att_set_value(uint16_t handle, att_size_t length, uint8_t* value)
+{
+    if ((handle < SIM_ATT_NB) && (length == sizeof(uint16_t)))
+    {
+        sim_att_val[handle] = co_read16p(value);
+    }
+
+    return (ATT_ERR_NO_ERROR);
+}
+
+uint8_t attmdb_att_update_value(uint16_t handle, att_size_t length, att_size_t offset,
+                                uint8_t* value)
+{
+    return attmdb_att_set_value(handle, length, value);
+}
+
+uint8_t attmdb_att_get_value(uint16_t handle, att_size_t* length, uint8_t** value)
+{
+    *length = sizeof(uint16_t);
+    *value = (uint8_t *) &sim_att_val[handle % SIM_ATT_NB];
+
+    return (ATT_ERR_NO_ERROR);
+}
+
+void atts_write_rsp_send(uint8_t conidx, uint16_t atthdl, uint8_t status)
+{
+}
+
+uint8_t gapc_get_conidx(uint16_t conhdl)
+{
+    return 0;
+}
+
+
+/*
+ * LOCAL FUNCTION DEFINITIONS
+ ****************************************************************************************
+ */
+
+/// Run the kernel until no message is pending
+static void sim_schedule(void)
+{
+    while (!ke_sleep_check())
+    {
+        ke_event_schedule();
+    }
+}
+
+/// Write the payload of packet seq
+static void sim_payload_fill(uint8_t *data, uint16_t seq)
+{
+    memset(data, (uint8_t) seq, STREAMDATAD_PACKET_SIZE);
+    co_write16p(data, seq);
+}
+
+/// Produce one packet straight into its PDU, as stream_queue_more_data()
+static bool sim_app_produce(void)
+{
+    struct l2cc_pdu_send_req *pkt;
+
+    if (streamdatad_credits_get() == 0)
+        return false;
+
+    pkt = streamdatad_packet_alloc();
+    if (pkt == NULL)
+        return false;
+
+    sim_payload_fill(STREAMDATAD_PACKET_DATA(pkt), sim_app.seq++);
+    streamdatad_packet_send(pkt);
+
+    return true;
+}
+
+/// Post a burst of packets to the producer ring
+static void sim_app_post_burst(void)
+{
+    struct streamdatad_send_data_packets_req *req = KE_MSG_ALLOC(STREAMDATAD_SEND_DATA_PACKETS_REQ,
+                                                                 TASK_STREAMDATAD, TASK_APP,
+                                                                 streamdatad_send_data_packets_req);
+    uint8_t data[STREAMDATAD_PACKET_SIZE];
+
+    req->nr_packets = SIM_RING_BURST;
+    for (int i = 0; i < SIM_RING_BURST; i++)
+    {
+        sim_payload_fill(data, sim_app.seq++);
+        memcpy(&req->packets[i][0], data, STREAMDATAD_PACKET_SIZE);
+    }
+
+    ke_msg_send(req);
+}
+
+static int sim_app_start_ind_handler(ke_msg_id_t const msgid, void const *param,
+                                     ke_task_id_t const dest_id, ke_task_id_t const src_id)
+{
+    sim_app.started = true;
+
+    if (sim_app.mode == SIM_MODE_RSP)
+    {
+        sim_app_produce();
+    }
+
+    return (KE_MSG_CONSUMED);
+}
+
+static int sim_app_data_send_rsp_handler(ke_msg_id_t const msgid, void const *param,
+                                         ke_task_id_t const dest_id, ke_task_id_t const src_id)
+{
+    if (sim_app.started && (sim_app.mode == SIM_MODE_RSP))
+    {
+        sim_app_produce();
+    }
+
+    return (KE_MSG_CONSUMED);
+}
+
+static int sim_app_ignore_handler(ke_msg_id_t const msgid, void const *param,
+                                  ke_task_id_t const dest_id, ke_task_id_t const src_id)
+{
+    return (KE_MSG_CONSUMED);
+}
+
+static int sim_l2cc_pdu_send_req_handler(ke_msg_id_t const msgid,
+                                         struct l2cc_pdu_send_req const *param,
+                                         ke_task_id_t const dest_id, ke_task_id_t const src_id)
+{
+    uint16_t handle = param->pdu.data.hdl_val_ntf.handle;
+
+    if ((param->pdu.chan_id != L2C_CID_ATTRIBUTE) || (param->pdu.data.code != L2C_CODE_ATT_HDL_VAL_NTF)
+            || (param->pdu.data.hdl_val_ntf.value_len != STREAMDATAD_PACKET_SIZE)
+            || (handle < STREAMDATAD_DIR_VAL_HANDLE(0))
+            || (handle > STREAMDATAD_DIR_VAL_HANDLE(STREAMDATAD_MAX - 1))
+            || (((handle - STREAMDATAD_DIR_VAL_HANDLE(0)) % 4) != 0))
+    {
+        printf("  FAILED: malformed notification PDU, handle %d\n", handle);
+        sim_ll.err = 1;
+        return (KE_MSG_CONSUMED);
+    }
+
+    // One credit per TX buffer: a PDU without a free buffer is a credit leak
+    if (sim_ll.buf_cnt >= sim_ll.buf_nb)
+    {
+        printf("  FAILED: PDU sent without a free TX buffer\n");
+        sim_ll.err = 1;
+        return (KE_MSG_CONSUMED);
+    }
+
+    sim_ll.buf[(sim_ll.buf_first + sim_ll.buf_cnt) % sim_ll.buf_nb] = (struct l2cc_pdu_send_req *) param;
+    sim_ll.buf_cnt++;
+
+    // Kept until transmitted
+    return (KE_MSG_NO_FREE);
+}
+
+/**
+ ****************************************************************************************
+ * @brief Run a connection event: transmit the buffered packets back to back, then
+ * confirm them to the host.
+ *
+ * @param[in] evt_max_us  Time available until the next anchor.
+ * @param[in] counted     The event is counted in the packets per event statistics.
+ ****************************************************************************************
+ */
+static void sim_conn_event(uint32_t evt_max_us, bool counted)
+{
+    uint32_t used_us = 0;
+    uint32_t pkt_nb = 0;
+
+    while ((sim_ll.buf_cnt != 0) && ((used_us + SIM_PKT_US) <= evt_max_us))
+    {
+        struct l2cc_pdu_send_req *pkt = sim_ll.buf[sim_ll.buf_first];
+        uint8_t const *data = STREAMDATAD_PACKET_DATA(pkt);
+        uint8_t expected[STREAMDATAD_PACKET_SIZE];
+        uint16_t seq = co_read16p(data);
+
+        // Packets dropped by the producer ring leave a gap, never a reordering
+        sim_payload_fill(expected, seq);
+        if ((memcmp(data, expected, STREAMDATAD_PACKET_SIZE) != 0)
+                || ((uint16_t)(seq - sim_ll.seq) >= 0x8000))
+        {
+            printf("  FAILED: packet %d expected on air, got %d\n", sim_ll.seq, seq);
+            sim_ll.err = 1;
+        }
+        sim_ll.gap += (uint16_t)(seq - sim_ll.seq);
+        sim_ll.seq = seq + 1;
+
+        KE_MSG_FREE(pkt);
+        sim_ll.buf_first = (sim_ll.buf_first + 1) % sim_ll.buf_nb;
+        sim_ll.buf_cnt--;
+        used_us += SIM_PKT_US;
+        pkt_nb++;
+    }
+
+    sim_ll.evt_nb++;
+    sim_ll.tx_nb += pkt_nb;
+    if (pkt_nb != 0)
+    {
+        sim_ll.evt_tx_nb++;
+    }
+
+    if (counted)
+    {
+        sim_ll.evt_us += evt_max_us;
+        if (sim_ll.buf_cnt == 0)
+        {
+            // The buffers ran dry before the end of the event
+            sim_ll.idle_us += evt_max_us - used_us;
+        }
+        if (pkt_nb < sim_ll.evt_pkt_min)
+            sim_ll.evt_pkt_min = pkt_nb;
+        if (pkt_nb > sim_ll.evt_pkt_max)
+            sim_ll.evt_pkt_max = pkt_nb;
+    }
+
+    // The TX confirmations reach L2CC after the event
+    while (pkt_nb--)
+    {
+        struct l2cc_data_send_rsp *rsp = KE_MSG_ALLOC(L2CC_DATA_SEND_RSP, TASK_STREAMDATAD,
+                                                      TASK_L2CC, l2cc_data_send_rsp);
+
+        rsp->status = CO_ERROR_NO_ERROR;
+        ke_msg_send(rsp);
+    }
+}
+
+/// Write the stream enable value, as the peer does
+static void sim_stream_enable(uint16_t enable)
+{
+    struct gattc_write_cmd_ind *ind = KE_MSG_ALLOC_DYN(GATTC_WRITE_CMD_IND, TASK_STREAMDATAD,
+                                                       TASK_GATTC, gattc_write_cmd_ind,
+                                                       sizeof(uint16_t));
+
+    ind->handle = STREAMDATAD_HANDLE(STREAMDATAD_IDX_ENABLE_VAL);
+    ind->length = sizeof(uint16_t);
+    ind->offset = 0;
+    ind->response = true;
+    ind->last = true;
+    co_write16p(&ind->value[0], enable);
+    ke_msg_send(ind);
+
+    sim_schedule();
+}
+
+/**
+ ****************************************************************************************
+ * @brief Stream for a given time at a given connection interval.
+ *
+ * @param[in] mode        Application mode.
+ * @param[in] interval    Connection interval (1.25ms units).
+ * @param[in] duration_ms Simulated duration.
+ * @param[in] buf_nb      Number of TX buffers.
+ *
+ * @return 0 if all checks passed, 1 otherwise
+ ****************************************************************************************
+ */
+static int sim_run(enum sim_mode mode, uint16_t interval, uint32_t duration_ms, uint8_t buf_nb)
+{
+    uint32_t interval_us = interval * 1250;
+    uint32_t evt_max_us = interval_us - 150;
+    uint32_t evt_cap = evt_max_us / SIM_PKT_US;
+    uint32_t evt_full = (buf_nb < evt_cap) ? buf_nb : evt_cap;
+    uint64_t now_us = 0;
+    uint32_t host_rate;
+    int err = 0;
+
+    memset(&sim_app, 0, sizeof(sim_app));
+    memset(&sim_ll, 0, sizeof(sim_ll));
+    memset(sim_att_val, 0, sizeof(sim_att_val));
+    sim_app.mode = mode;
+    sim_ll.buf_nb = buf_nb;
+    sim_ll.evt_pkt_min = UINT32_MAX;
+    l2cm_env.buf_mon.nb_buffer_avail = buf_nb;
+
+    ke_init();
+    ke_time_sim_set(0);
+    ke_task_create(TASK_APP, &sim_app_desc);
+    ke_task_create(TASK_L2CC, &sim_l2cc_desc);
+    streamdatad_init();
+
+    // Database, connection, then the peer enables the stream
+    {
+        struct streamdatad_create_db_req *req = KE_MSG_ALLOC(STREAMDATAD_CREATE_DB_REQ, TASK_STREAMDATAD,
+                                                             TASK_APP, streamdatad_create_db_req);
+        req->start_hdl = 0;
+        ke_msg_send(req);
+        sim_schedule();
+    }
+    {
+        struct streamdatad_enable_req *req = KE_MSG_ALLOC(STREAMDATAD_ENABLE_REQ, TASK_STREAMDATAD,
+                                                          TASK_APP, streamdatad_enable_req);
+        req->appid = TASK_APP;
+        req->conhdl = 0;
+        ke_msg_send(req);
+        sim_schedule();
+    }
+    sim_stream_enable(1);
+
+    if (!sim_app.started)
+    {
+        printf("  FAILED: stream not started\n");
+        return 1;
+    }
+
+    while (now_us < (uint64_t) duration_ms * 1000)
+    {
+        now_us += interval_us;
+        ke_time_sim_set((uint32_t)(now_us / 10000));
+
+        // The first event only sees what was produced at the start of the stream
+        sim_conn_event(evt_max_us, sim_ll.evt_nb != 0);
+        sim_schedule();
+
+        // End of the BLE event, main loop
+        if (mode == SIM_MODE_RING)
+        {
+            sim_app_post_burst();
+            sim_schedule();
+            streamdatad_evt_end();
+        }
+        else if (mode == SIM_MODE_EVT_END)
+        {
+            // app_stream_evt_end()
+            streamdatad_evt_end();
+            while (sim_app_produce())
+                ;
+        }
+        sim_schedule();
+    }
+
+    host_rate = streamdatad_throughput_get();
+
+    printf("%-8s %6.2f ms %8.0f B/s (host %5u) %5.2f pkt/evt (%u..%u of %u) %5.1f%% idle %7u stalled %u dropped\n",
+           sim_mode_name[mode], interval * 1.25,
+           (double) sim_ll.tx_nb * STREAMDATAD_PACKET_SIZE * 1000000 / now_us, host_rate,
+           (double) sim_ll.tx_nb / sim_ll.evt_nb, sim_ll.evt_pkt_min, sim_ll.evt_pkt_max, evt_full,
+           (sim_ll.evt_us != 0) ? (100.0 * sim_ll.idle_us / sim_ll.evt_us) : 0.0,
+           streamdatad_env.stats.stalled, streamdatad_env.stats.dropped);
+
+    // The end of event refill must fill every connection event
+    if ((mode != SIM_MODE_RSP) && (sim_ll.evt_pkt_min < ((mode == SIM_MODE_RING) && (SIM_RING_BURST < evt_full)
+                                                          ? SIM_RING_BURST : evt_full)))
+    {
+        printf("  FAILED: connection event not filled\n");
+        err = 1;
+    }
+
+    if ((mode == SIM_MODE_RING) && (streamdatad_env.stats.dropped != 0) && (SIM_RING_BURST <= evt_full))
+    {
+        printf("  FAILED: packets dropped while the link keeps up\n");
+        err = 1;
+    }
+
+    // Stop, then let the link layer send what it holds
+    sim_stream_enable(0);
+    while (sim_ll.buf_cnt != 0)
+    {
+        sim_conn_event(evt_max_us, false);
+        sim_schedule();
+    }
+
+    // Only the packets dropped by the producer ring may be missing
+    if (sim_ll.gap > streamdatad_env.stats.dropped)
+    {
+        printf("  FAILED: %u packets missing on air, %u dropped\n", sim_ll.gap,
+               streamdatad_env.stats.dropped);
+        err = 1;
+    }
+
+    if (streamdatad_env.stats.sent != sim_ll.tx_nb)
+    {
+        printf("  FAILED: %u notifications handed over to L2CC, %u on air\n",
+               streamdatad_env.stats.sent, sim_ll.tx_nb);
+        err = 1;
+    }
+
+    if ((streamdatad_env.credits != buf_nb) || (streamdatad_env.ring_head != streamdatad_env.ring_tail))
+    {
+        printf("  FAILED: %d credits of %d, ring %s\n", streamdatad_env.credits, buf_nb,
+               (streamdatad_env.ring_head != streamdatad_env.ring_tail) ? "not empty" : "empty");
+        err = 1;
+    }
+
+    if (!ke_mem_is_empty(KE_MEM_KE_MSG))
+    {
+        printf("  FAILED: kernel heap not empty\n");
+        err = 1;
+    }
+
+    return err | sim_ll.err;
+}
+
+
+/*
+ * MAIN
+ ****************************************************************************************
+ */
+
+int main(int argc, char **argv)
+{
+    uint32_t duration_ms = (argc > 1) ? strtoul(argv[1], NULL, 0) : SIM_DURATION_MS;
+    uint32_t buf_nb = (argc > 2) ? strtoul(argv[2], NULL, 0) : SIM_TX_BUF;
+    int err = 0;
+
+    if ((buf_nb == 0) || (buf_nb > SIM_TX_BUF_MAX))
+    {
+        printf("stream_sim: 1 to %d TX buffers\n", SIM_TX_BUF_MAX);
+        return 1;
+    }
+
+    printf("stream_sim: %u ms per run, %u TX buffers, %d us per packet on air\n",
+           duration_ms, buf_nb, SIM_PKT_US);
+
+    for (int mode = 0; mode < SIM_MODE_MAX; mode++)
+    {
+        for (int i = 0; i < (int)(sizeof(sim_intervals) / sizeof(sim_intervals[0])); i++)
+        {
+            err |= sim_run((enum sim_mode) mode, sim_intervals[i], duration_ms, buf_nb);
+        }
+    }
+
+    return err;
+}
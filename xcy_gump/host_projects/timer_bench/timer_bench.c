@@ -0,0 +1,369 @@
+/**
+ ****************************************************************************************
+ *
+ * @file timer_bench.c
+ *
+ * @brief Benchmark of the kernel timers on the host build of the kernel.
+ *
+ * Models 8 links with 4 timers each plus the application timers: the supervision timer
+ * of each link is re-armed at every connection event and never expires, the other ones
+ * are periodic. Measures the cost of ke_timer_set(), ke_timer_clear(), ke_timer_active()
+ * and of the expiration, then runs the model on a simulated time and checks the number
+ * of expirations. Built once with the sorted timer queue and once with the timer wheel
+ * (CFG_KE_TIMER_WHEEL).
+ *
+ * Usage: timer_bench [iterations]
+ *
+ ****************************************************************************************
+ */
+
+/*
+ * INCLUDE FILES
+ ****************************************************************************************
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "rwip_config.h"
+#include "arch.h"
+#include "ke.h"
+#include "ke_event.h"
+#include "ke_mem.h"
+#include "ke_msg.h"
+#include "ke_task.h"
+#include "ke_timer.h"
+
+
+/*
+ * DEFINES
+ ****************************************************************************************
+ */
+
+/// Default number of operations per test
+#define BENCH_ITERATIONS        (1000000)
+
+/// Number of links
+#define BENCH_LINK_NB           (8)
+
+/// Connection interval, in kernel time units (10ms)
+#define BENCH_CONN_INTERVAL     (3)
+
+/// Duration of the simulated run, in kernel time units (10ms)
+#define BENCH_RUN_TIME          (100000)
+
+/// Timers of each link, then application timers (instance 0 only)
+enum bench_timer
+{
+    /// Supervision timeout, re-armed at every connection event
+    BENCH_TIMER_SUPERVISION = KE_FIRST_MSG(TASK_APP),
+    /// Profile procedure timer
+    BENCH_TIMER_PRF,
+    /// Encryption/pairing timer
+    BENCH_TIMER_ENC,
+    /// Battery level polling
+    BENCH_TIMER_BATT,
+
+    /// Keyboard scanning
+    BENCH_TIMER_SCAN,
+    /// Advertising timeout
+    BENCH_TIMER_ADV,
+
+    BENCH_TIMER_MAX,
+};
+
+/// Number of timers of each link
+#define BENCH_LINK_TIMER_NB     (BENCH_TIMER_SCAN - BENCH_TIMER_SUPERVISION)
+
+/// Number of timers
+#define BENCH_TIMER_NB          (BENCH_LINK_NB * BENCH_LINK_TIMER_NB + BENCH_TIMER_MAX - BENCH_TIMER_SCAN)
+
+/// Index of a timer in the tables
+#define BENCH_TIMER_IDX(id)     ((id) - BENCH_TIMER_SUPERVISION)
+
+
+/*
+ * LOCAL FUNCTION DECLARATIONS
+ ****************************************************************************************
+ */
+
+static int bench_timer_handler(ke_msg_id_t const msgid, void const *param,
+                               ke_task_id_t const dest_id, ke_task_id_t const src_id);
+
+
+/*
+ * GLOBAL VARIABLES
+ ****************************************************************************************
+ */
+
+/// Period of each timer (0 for the supervision timer, which is never expected to expire)
+static const uint16_t bench_period[BENCH_TIMER_MAX - BENCH_TIMER_SUPERVISION] =
+{
+    [BENCH_TIMER_IDX(BENCH_TIMER_SUPERVISION)]  = 0,
+    [BENCH_TIMER_IDX(BENCH_TIMER_PRF)]          = 100,
+    [BENCH_TIMER_IDX(BENCH_TIMER_ENC)]          = 3000,
+    [BENCH_TIMER_IDX(BENCH_TIMER_BATT)]         = 6000,
+    [BENCH_TIMER_IDX(BENCH_TIMER_SCAN)]         = 2,
+    [BENCH_TIMER_IDX(BENCH_TIMER_ADV)]          = 1000,
+};
+
+/// Supervision timeout
+#define BENCH_SUPERVISION_TO    (500)
+
+/// Number of expirations per timer and link
+static uint32_t bench_expired[BENCH_TIMER_MAX - BENCH_TIMER_SUPERVISION][BENCH_LINK_NB];
+
+/// Re-arm the periodic timers when they expire
+static bool bench_periodic;
+
+/// Message handlers
+static const struct ke_msg_handler bench_default_handler[] =
+{
+    {KE_MSG_DEFAULT_HANDLER, (ke_msg_func_t) bench_timer_handler},
+};
+
+/// Specifies the message handlers that are common to all states
+static const struct ke_state_handler bench_default_state_handler = KE_STATE_HANDLER(bench_default_handler);
+
+/// Task states, one instance per link
+static ke_state_t bench_state[BENCH_LINK_NB];
+
+/// Task descriptor
+static const struct ke_task_desc bench_task_desc =
+    {NULL, &bench_default_state_handler, bench_state, 0, BENCH_LINK_NB};
+
+/// Timer identifiers and tasks, in creation order
+static struct
+{
+    ke_msg_id_t id;
+    ke_task_id_t task;
+} bench_timer[BENCH_TIMER_NB];
+
+
+/*
+ * LOCAL FUNCTION DEFINITIONS
+ ****************************************************************************************
+ */
+
+static int bench_timer_handler(ke_msg_id_t const msgid, void const *param,
+                               ke_task_id_t const dest_id, ke_task_id_t const src_id)
+{
+    uint16_t period = bench_period[BENCH_TIMER_IDX(msgid)];
+
+    bench_expired[BENCH_TIMER_IDX(msgid)][KE_IDX_GET(dest_id)]++;
+
+    if (bench_periodic && (period != 0))
+    {
+        ke_timer_set(msgid, dest_id, period);
+    }
+
+    return (KE_MSG_CONSUMED);
+}
+
+static uint64_t bench_now_ns(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t) now.tv_sec * 1000000000u + now.tv_nsec;
+}
+
+/// Run the kernel until no event is pending
+static void bench_schedule(void)
+{
+    ke_timer_hw_poll();
+
+    while (!ke_sleep_check())
+    {
+        ke_event_schedule();
+    }
+}
+
+/// Program all the timers with their period (the supervision timeout for supervision)
+static void bench_timer_arm_all(void)
+{
+    int i;
+
+    for (i = 0; i < BENCH_TIMER_NB; i++)
+    {
+        uint16_t period = bench_period[BENCH_TIMER_IDX(bench_timer[i].id)];
+
+        ke_timer_set(bench_timer[i].id, bench_timer[i].task, (period != 0) ? period : BENCH_SUPERVISION_TO);
+    }
+}
+
+static void bench_print(char const *name, uint64_t start, uint32_t count, char const *unit)
+{
+    printf("%-40s %8.1f ns/%s\n", name, (double)(bench_now_ns() - start) / count, unit);
+}
+
+/**
+ ****************************************************************************************
+ * @brief Run the model for BENCH_RUN_TIME time units and check the expirations.
+ *
+ * @return 0 if every timer expired the expected number of times, 1 otherwise
+ ****************************************************************************************
+ */
+static int bench_model_run(uint32_t *time)
+{
+    uint64_t start;
+    uint32_t t;
+    uint32_t expired = 0;
+    int err = 0;
+    int idx, link;
+
+    memset(bench_expired, 0, sizeof(bench_expired));
+    bench_periodic = true;
+    bench_timer_arm_all();
+
+    start = bench_now_ns();
+
+    for (t = 1; t <= BENCH_RUN_TIME; t++)
+    {
+        ke_time_sim_set(++(*time));
+
+        // Connection events of the links, spread over the connection interval
+        for (link = 0; link < BENCH_LINK_NB; link++)
+        {
+            if ((t % BENCH_CONN_INTERVAL) == (link % BENCH_CONN_INTERVAL))
+            {
+                ke_timer_set(BENCH_TIMER_SUPERVISION, KE_BUILD_ID(TASK_APP, link), BENCH_SUPERVISION_TO);
+            }
+        }
+
+        bench_schedule();
+    }
+
+    for (idx = 0; idx < BENCH_TIMER_IDX(BENCH_TIMER_MAX); idx++)
+    {
+        for (link = 0; link < ((idx < BENCH_LINK_TIMER_NB) ? BENCH_LINK_NB : 1); link++)
+        {
+            uint32_t expected = bench_period[idx] ? (BENCH_RUN_TIME / bench_period[idx]) : 0;
+
+            expired += bench_expired[idx][link];
+            if (bench_expired[idx][link] != expected)
+            {
+                printf("  FAILED: timer %d of link %d expired %u times instead of %u\n",
+                       idx, link, bench_expired[idx][link], expected);
+                err = 1;
+            }
+        }
+    }
+
+    bench_print("model run, 8 links", start, BENCH_RUN_TIME, "10ms");
+    printf("  %u expirations, %u supervision re-arms\n", expired,
+           BENCH_RUN_TIME * BENCH_LINK_NB / BENCH_CONN_INTERVAL);
+
+    bench_periodic = false;
+    for (idx = 0; idx < BENCH_TIMER_NB; idx++)
+    {
+        ke_timer_clear(bench_timer[idx].id, bench_timer[idx].task);
+    }
+
+    return err;
+}
+
+
+/*
+ * MAIN
+ ****************************************************************************************
+ */
+
+int main(int argc, char **argv)
+{
+    uint32_t count = (argc > 1) ? strtoul(argv[1], NULL, 0) : BENCH_ITERATIONS;
+    uint32_t time = 0;
+    uint32_t expired;
+    uint64_t start;
+    uint32_t i;
+    int nb = 0;
+    int err = 0;
+    int link, idx;
+
+    for (link = 0; link < BENCH_LINK_NB; link++)
+    {
+        for (idx = 0; idx < BENCH_LINK_TIMER_NB; idx++, nb++)
+        {
+            bench_timer[nb].id = BENCH_TIMER_SUPERVISION + idx;
+            bench_timer[nb].task = KE_BUILD_ID(TASK_APP, link);
+        }
+    }
+    for (idx = BENCH_TIMER_SCAN; idx < BENCH_TIMER_MAX; idx++, nb++)
+    {
+        bench_timer[nb].id = idx;
+        bench_timer[nb].task = TASK_APP;
+    }
+
+    ke_time_sim_set(time);
+    ke_init();
+    ke_task_create(TASK_APP, &bench_task_desc);
+
+    printf("timer_bench: %s, %d timers, %u operations per test\n",
+           KE_TIMER_WHEEL ? "timer wheel" : "sorted timer queue", BENCH_TIMER_NB, count);
+
+    // Re-arm a programmed timer, all the other ones programmed
+    bench_timer_arm_all();
+    start = bench_now_ns();
+    for (i = 0; i < count; i++)
+    {
+        int n = i % BENCH_TIMER_NB;
+        ke_timer_set(bench_timer[n].id, bench_timer[n].task, 1 + (i * 7) % 3000);
+    }
+    bench_print("set, re-arm", start, count, "op");
+
+    start = bench_now_ns();
+    for (i = 0; i < count; i++)
+    {
+        int n = i % BENCH_TIMER_NB;
+        ke_timer_clear(bench_timer[n].id, bench_timer[n].task);
+        ke_timer_set(bench_timer[n].id, bench_timer[n].task, 1 + (i * 7) % 3000);
+    }
+    bench_print("clear + set", start, count, "op");
+
+    start = bench_now_ns();
+    for (i = 0; i < count; i++)
+    {
+        int n = (i * 13) % BENCH_TIMER_NB;
+        err |= !ke_timer_active(bench_timer[n].id, bench_timer[n].task);
+    }
+    bench_print("active", start, count, "op");
+
+    // Expiration: all the timers expire at the same time and are dispatched
+    start = bench_now_ns();
+    memset(bench_expired, 0, sizeof(bench_expired));
+    for (i = 0; i < count; i += BENCH_TIMER_NB)
+    {
+        for (idx = 0; idx < BENCH_TIMER_NB; idx++)
+        {
+            ke_timer_set(bench_timer[idx].id, bench_timer[idx].task, 1);
+        }
+        ke_time_sim_set(++time);
+        bench_schedule();
+    }
+    for (expired = 0, idx = 0; idx < BENCH_TIMER_IDX(BENCH_TIMER_MAX); idx++)
+    {
+        for (link = 0; link < BENCH_LINK_NB; link++)
+        {
+            expired += bench_expired[idx][link];
+        }
+    }
+    bench_print("set + expire + dispatch", start, expired, "timer");
+
+    if (err || (expired != ((count + BENCH_TIMER_NB - 1) / BENCH_TIMER_NB) * BENCH_TIMER_NB))
+    {
+        printf("  FAILED: %u timers expired\n", expired);
+        err = 1;
+    }
+
+    err |= bench_model_run(&time);
+
+    if (!ke_mem_is_empty(KE_MEM_KE_MSG))
+    {
+        printf("  FAILED: timers or messages not freed\n");
+        err = 1;
+    }
+
+    return err;
+}
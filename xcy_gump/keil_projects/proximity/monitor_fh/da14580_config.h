@@ -45,6 +45,9 @@
 /* BLE Security  */
 #define CFG_APP_SEC
 
+/* Binary search of the application handler table */
+#define CFG_KE_HANDLER_INDEX
+
 /* Coarse calibration */
 #define CFG_LUT_PATCH
 
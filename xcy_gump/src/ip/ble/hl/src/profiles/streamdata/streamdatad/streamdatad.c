@@ -38,6 +38,10 @@
 #include "attm_cfg.h"
 #include "prf_utils.h"
 #include "l2cm.h"
+#include "l2cc_task.h"
+#include "ll.h"
+#include "ke_timer.h"
+#include "reg_blecore.h"
 
 #include "streamdatad.h"
 #include "streamdatad_task.h"
@@ -77,8 +81,14 @@ void streamdatad_streamonoff(void)
 	// Indicate to the application the state of the profile
 	int on = ((len == 2) && (streamdatad_en && (*streamdatad_en))) ? 1 : 0;
 	
+	// Start and stop with an empty ring
+	streamdatad_ring_reset();
+
 	if (on)
 	{
+		// Measure from the start of the stream
+		streamdatad_stats_reset();
+
 		// Allocate the start indication message
 		struct streamdatad_start_ind *ind = KE_MSG_ALLOC(STREAMDATAD_START_IND,
 												   streamdatad_env.appid, TASK_STREAMDATAD,
@@ -103,69 +113,266 @@ void streamdatad_streamonoff(void)
 	int lastattr = enable_val?((STREAMDATAD_MAX>MAX_TRANSMIT_BUFFER_PACKETS)?MAX_TRANSMIT_BUFFER_PACKETS:STREAMDATAD_MAX):STREAMDATAD_MAX;
 	
 	attmdb_att_set_value(STREAMDATAD_IDX_ENABLE_EN, sizeof(uint16_t),(uint8_t*) &(enable_val));
+	streamdatad_env.ntf_en_mask = 0;
 	for (int i = 0; i < lastattr; i++)
 	{
 		attmdb_att_set_value(STREAMDATAD_DIR_EN_HANDLE(i), sizeof(uint16_t),(uint8_t*) &(enable_val));
 		streamdatad_env.nr_enabled_attributes++;
+		if (enable_val) streamdatad_env.ntf_en_mask |= (1 << i);
 	}
 	if (!enable_val) streamdatad_env.nr_enabled_attributes = 0;
 }
 
-int streamdatad_send_data_packet(uint8_t *data)
+/**
+ ****************************************************************************************
+ * @brief Get the next data characteristic enabled by the peer, in turn.
+ *
+ * @return Index of the characteristic, STREAMDATAD_MAX if none is enabled.
+ ****************************************************************************************
+ */
+static uint16_t streamdatad_next_dir(void)
 {
-    uint16_t* packet_buffer_enabled;
-	int retval = 0;
-    uint16_t len = 0;
-	packet_buffer_enabled = NULL;
-	attmdb_att_get_value(STREAMDATAD_DIR_EN_HANDLE(streamdatad_env.next_attribute_idx), &(len), (uint8_t**)&(packet_buffer_enabled));
-
-	if ((packet_buffer_enabled && (*packet_buffer_enabled)))
-	{        
-        // Update the value in the attribute database
-        attmdb_att_set_value(STREAMDATAD_DIR_VAL_HANDLE(streamdatad_env.next_attribute_idx), sizeof(uint8_t) * STREAMDATAD_PACKET_SIZE, data);
-
-        // Send notification
-        prf_server_send_event((prf_env_struct *)&(streamdatad_env.con_info), false, STREAMDATAD_DIR_VAL_HANDLE(streamdatad_env.next_attribute_idx));
-        
-		retval = 1;
-	}
+    // Cycle on the data characteristics, skipping the ones not enabled by the peer
+    for (int li = 0; li < STREAMDATAD_MAX; li++)
+    {
+        uint16_t idx = streamdatad_env.next_attribute_idx;
 
-	streamdatad_env.next_attribute_idx++; if (streamdatad_env.next_attribute_idx >= STREAMDATAD_MAX) streamdatad_env.next_attribute_idx = 0;
-	return retval;
+        streamdatad_env.next_attribute_idx++; if (streamdatad_env.next_attribute_idx >= STREAMDATAD_MAX) streamdatad_env.next_attribute_idx = 0;
+
+        if (streamdatad_env.ntf_en_mask & (1 << idx))
+            return idx;
+    }
+
+    return STREAMDATAD_MAX;
 }
 
-int streamdatad_send_overflow_packets(void)
+/**
+ ****************************************************************************************
+ * @brief Allocate a notification PDU. The handle is written when the PDU is sent.
+ *
+ * @return The PDU, its payload is accessed with STREAMDATAD_PACKET_DATA().
+ ****************************************************************************************
+ */
+static struct l2cc_pdu_send_req *streamdatad_pdu_alloc(void)
 {
-	int nr_buffers_available;
-	uint16_t next_packet = 0;
-	
-	if (streamdatad_env.nr_overflow_packets <= 0) return 0;
-	
-	nr_buffers_available = 6 - 1; //l2cm_get_nb_buffer_available();  by ED TBC;
-	
-    for (int li = 0; (li < STREAMDATAD_MAX) && (streamdatad_env.nr_overflow_packets > 0) && (nr_buffers_available > 0); li++)
-	{
-		if (streamdatad_send_data_packet((uint8_t*) &(streamdatad_env.overflow_packets[next_packet][0])))
-		{
-			next_packet++; streamdatad_env.nr_overflow_packets--;
-			nr_buffers_available--;
-		}
-		// else notification at this index was not enabled;
+    struct l2cc_pdu_send_req *pkt = KE_MSG_ALLOC(L2CC_PDU_SEND_REQ,
+                                                 KE_BUILD_ID(TASK_L2CC, streamdatad_env.con_info.conidx),
+                                                 TASK_STREAMDATAD, l2cc_pdu_send_req);
+
+    // Set attribute channel ID
+    pkt->pdu.chan_id   = L2C_CID_ATTRIBUTE;
+    // Set packet opcode.
+    pkt->pdu.data.code = L2C_CODE_ATT_HDL_VAL_NTF;
+    pkt->pdu.data.hdl_val_ntf.value_len = STREAMDATAD_PACKET_SIZE;
+
+    return pkt;
+}
+
+/**
+ ****************************************************************************************
+ * @brief Take a credit for a packet ready to be sent.
+ *
+ * @return true if a credit was taken, false if no credit is left (counted as stalled) or
+ * no data characteristic has notifications enabled.
+ ****************************************************************************************
+ */
+static bool streamdatad_credit_take(void)
+{
+    // Nothing can be sent, this is not a stall
+    if (streamdatad_env.ntf_en_mask == 0)
+        return false;
+
+    if (streamdatad_env.credits == 0)
+    {
+        // Data is waiting for a TX buffer
+        streamdatad_env.stats.stalled++;
+        return false;
     }
-	
-	if (streamdatad_env.nr_overflow_packets > 0)
-	{
-		// ERROR double overflow. See similar code below 'ERROR overflow'.
-		// May never happen, but can't guarantee.
-		
-		// We'll copy the data for later transmission
-		for (int i = 0; i < streamdatad_env.nr_overflow_packets; ++i)
-		{
-			memcpy(&(streamdatad_env.overflow_packets[i][0]), &(streamdatad_env.overflow_packets[next_packet][0]), STREAMDATAD_PACKET_SIZE);
-			next_packet++;
-		}
-	}
-	return nr_buffers_available;
+
+    streamdatad_env.credits--;
+
+    return true;
+}
+
+struct l2cc_pdu_send_req *streamdatad_packet_alloc(void)
+{
+    struct l2cc_pdu_send_req *pkt;
+
+    if (!streamdatad_credit_take())
+        return NULL;
+
+    pkt = streamdatad_pdu_alloc();
+    pkt->pdu.data.hdl_val_ntf.handle = STREAMDATAD_DIR_VAL_HANDLE(streamdatad_next_dir());
+
+    return pkt;
+}
+
+void streamdatad_packet_send(struct l2cc_pdu_send_req *pkt)
+{
+    // L2CC answers with L2CC_DATA_SEND_RSP, which returns the credit
+    ke_msg_send(pkt);
+
+    streamdatad_env.stats.sent++;
+}
+
+uint16_t streamdatad_credits_get(void)
+{
+    return (streamdatad_env.ntf_en_mask != 0) ? streamdatad_env.credits : 0;
+}
+
+uint8_t *streamdatad_ring_slot_get(void)
+{
+    uint8_t head = streamdatad_env.ring_head;
+    struct l2cc_pdu_send_req **slot = &streamdatad_env.ring[head & (STREAMDATAD_RING_SIZE - 1)];
+
+    if ((uint8_t)(head - streamdatad_env.ring_tail) >= STREAMDATAD_RING_SIZE)
+    {
+        streamdatad_env.stats.dropped++;
+        return NULL;
+    }
+
+    // A slot got but not committed keeps its PDU
+    if (*slot == NULL)
+    {
+        *slot = streamdatad_pdu_alloc();
+    }
+
+    return STREAMDATAD_PACKET_DATA(*slot);
+}
+
+void streamdatad_ring_commit(void)
+{
+    // Publish the PDU of the slot, it is sent as is when a credit is available
+    streamdatad_env.ring_head++;
+    streamdatad_env.stats.queued++;
+}
+
+bool streamdatad_ring_put(uint8_t const *data)
+{
+    uint8_t *slot = streamdatad_ring_slot_get();
+
+    if (slot == NULL)
+        return false;
+
+    memcpy(slot, data, STREAMDATAD_PACKET_SIZE);
+    streamdatad_ring_commit();
+
+    return true;
+}
+
+void streamdatad_ring_drain(void)
+{
+    while (streamdatad_env.ring_tail != streamdatad_env.ring_head)
+    {
+        struct l2cc_pdu_send_req **slot = &streamdatad_env.ring[streamdatad_env.ring_tail & (STREAMDATAD_RING_SIZE - 1)];
+        struct l2cc_pdu_send_req *pkt = *slot;
+
+        if (!streamdatad_credit_take())
+        {
+            // Out of credits (counted as stalled) or nothing enabled: L2CC_DATA_SEND_RSP
+            // or the end of the next BLE event resumes
+            break;
+        }
+
+        // The PDU of the slot is handed over to L2CC, no copy
+        pkt->pdu.data.hdl_val_ntf.handle = STREAMDATAD_DIR_VAL_HANDLE(streamdatad_next_dir());
+        *slot = NULL;
+
+        // Release the slot to the producer
+        streamdatad_env.ring_tail++;
+
+        streamdatad_packet_send(pkt);
+    }
+}
+
+void streamdatad_ring_poll(void)
+{
+    // Without credit the drain would only count a stall, L2CC_DATA_SEND_RSP resumes
+    if ((streamdatad_env.credits != 0) && (streamdatad_env.ring_tail != streamdatad_env.ring_head))
+    {
+        streamdatad_ring_drain();
+    }
+}
+
+void streamdatad_ring_reset(void)
+{
+    // Free the queued PDUs, and the one of a slot got but not committed
+    for (int i = 0; i < STREAMDATAD_RING_SIZE; i++)
+    {
+        if (streamdatad_env.ring[i] != NULL)
+        {
+            KE_MSG_FREE(streamdatad_env.ring[i]);
+            streamdatad_env.ring[i] = NULL;
+        }
+    }
+
+    // The credits are not reloaded: the PDUs already handed over to L2CC return theirs
+    streamdatad_env.ring_tail = streamdatad_env.ring_head;
+}
+
+/// Accumulate the time elapsed since the previous call. ke_time() wraps at
+/// BLE_GROSSTARGET_MASK (about 11 minutes), this is called at every BLE event.
+static void streamdatad_stats_time_update(void)
+{
+    uint32_t now = ke_time();
+
+    streamdatad_env.stats.elapsed += (now - streamdatad_env.stats.time_prev) & BLE_GROSSTARGET_MASK;
+    streamdatad_env.stats.time_prev = now;
+}
+
+void streamdatad_evt_end(void)
+{
+    uint32_t pkt_nb;
+
+    if (!streamdatad_env.stream_enabled)
+        return;
+
+    // Notifications handed over to L2CC since the previous BLE event
+    pkt_nb = streamdatad_env.stats.sent - streamdatad_env.stats.evt_sent_prev;
+    streamdatad_env.stats.evt_sent_prev = streamdatad_env.stats.sent;
+
+    streamdatad_env.stats.evt_nb++;
+    if (pkt_nb == 0)
+        streamdatad_env.stats.evt_idle_nb++;
+    else if (pkt_nb > streamdatad_env.stats.evt_pkt_max)
+        streamdatad_env.stats.evt_pkt_max = pkt_nb;
+
+    streamdatad_stats_time_update();
+
+    // Refill the TX buffers released during the event
+    streamdatad_ring_drain();
+}
+
+void streamdatad_stats_reset(void)
+{
+    memset(&streamdatad_env.stats, 0, sizeof(streamdatad_env.stats));
+    streamdatad_env.stats.time_prev = ke_time();
+}
+
+uint32_t streamdatad_throughput_get(void)
+{
+    streamdatad_stats_time_update();
+
+    if (streamdatad_env.stats.elapsed == 0)
+        return 0;
+
+    return (uint32_t)(((uint64_t)streamdatad_env.stats.sent * STREAMDATAD_PACKET_SIZE * 100)
+                      / streamdatad_env.stats.elapsed);
+}
+
+int streamdatad_send_data_packet(uint8_t *data)
+{
+    struct l2cc_pdu_send_req *pkt = streamdatad_packet_alloc();
+
+    if (pkt == NULL)
+        return 0;
+
+    // Single copy, straight into the PDU
+    memcpy(STREAMDATAD_PACKET_DATA(pkt), data, STREAMDATAD_PACKET_SIZE);
+
+    streamdatad_packet_send(pkt);
+
+    return 1;
 }
 
 #endif /* BLE_STREAMDATA_DEVICE */
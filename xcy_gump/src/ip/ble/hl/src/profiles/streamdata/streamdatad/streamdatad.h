@@ -54,8 +54,6 @@
 #define STREAMDATAD_PACKET_SIZE (20)
 #define MAX_TRANSMIT_BUFFER_PACKETS (10)
 
-extern uint8_t nb_buf_av;
-
 // Proprietary UUIDs
 enum
 {
@@ -96,6 +94,14 @@ enum
 #define STREAMDATAD_DIR_VAL_HANDLE(dir) \
     STREAMDATAD_HANDLE(STREAMDATAD_IDX_STREAMDATAD_D0_VAL + 4 * ((dir)))
 
+/// Get data characteristic index from its client configuration attribute index
+#define STREAMDATAD_EN_IDX_TO_DIR(idx) \
+    (((idx) - STREAMDATAD_IDX_STREAMDATAD_D0_EN) / 4)
+
+/// Payload of a packet allocated by streamdatad_packet_alloc(), STREAMDATAD_PACKET_SIZE bytes
+#define STREAMDATAD_PACKET_DATA(pkt) \
+    (&((pkt)->pdu.data.hdl_val_ntf.value[0]))
+
 
 enum
 {
@@ -112,11 +118,43 @@ enum
     STREAMDATAD_MAX
 };
 
+/// Depth of the producer ring in packets (power of 2, at most 128). The queued packets
+/// are held in allocated notification PDUs
+#ifndef STREAMDATAD_RING_SIZE
+#define STREAMDATAD_RING_SIZE   (16)
+#endif
+
 /*
  * TYPE DEFINITIONS
  ****************************************************************************************
  */
 
+/// Stream counters. The notifications are counted when handed over to L2CC, not when
+/// the link layer transmits them: up to the number of TX buffers can still be in flight.
+struct streamdatad_stats
+{
+    /// Packets written in the producer ring
+    uint32_t queued;
+    /// Notifications handed over to L2CC
+    uint32_t sent;
+    /// Packets lost because the producer ring was full
+    uint32_t dropped;
+    /// Times a packet was ready while no credit was left
+    uint32_t stalled;
+    /// BLE events ended while streaming
+    uint32_t evt_nb;
+    /// BLE events ended while streaming in which no notification was handed over
+    uint32_t evt_idle_nb;
+    /// Highest number of notifications handed over between two BLE events
+    uint16_t evt_pkt_max;
+    /// Value of sent at the end of the previous BLE event
+    uint32_t evt_sent_prev;
+    /// Time elapsed since the stream was started (10ms unit)
+    uint32_t elapsed;
+    /// ke_time() when elapsed was last updated (10ms unit)
+    uint32_t time_prev;
+};
+
 #if 0
 /// StreamData Device environment structure definition
 struct streamdatad_env_tag
@@ -149,12 +187,29 @@ struct streamdatad_env_tag
 	uint16_t nr_enabled_attributes;
 	uint16_t next_attribute_idx;
 	uint16_t stream_enabled;
-	
-	uint16_t nr_overflow_packets;
-	uint16_t overflow_packets[STREAMDATAD_MAX][STREAMDATAD_PACKET_SIZE/2];
+	/// Data characteristics with notifications enabled (bit per characteristic)
+	uint16_t ntf_en_mask;
+
+	/// Notifications that can still be handed over to L2CC: loaded with the number of TX
+	/// buffers when the profile is enabled, taken by every PDU and returned by its
+	/// L2CC_DATA_SEND_RSP
+	uint16_t credits;
+	/// Stream counters
+	struct streamdatad_stats stats;
+
+	/// Producer ring write index, only modified by the producer
+	uint8_t ring_head;
+	/// Producer ring read index, only modified by the consumer
+	uint8_t ring_tail;
+	/// Producer ring: notification PDUs written by the producer, sent as they are when
+	/// a credit is available (NULL for the free slots)
+	struct l2cc_pdu_send_req *ring[STREAMDATAD_RING_SIZE];
 };
 #endif
 
+// forward declarations
+struct l2cc_pdu_send_req;
+
     /// Connection Info
 struct stream_con_info_tag{
     struct prf_con_info con_info;
@@ -239,9 +294,133 @@ extern struct streamdatad_env_tag streamdatad_env;
  */
 void streamdatad_init(void);
 void streamdatad_streamonoff(void);
-int streamdatad_send_overflow_packets(void);
 int streamdatad_send_data_packet(uint8_t *data);
 
+/**
+ ****************************************************************************************
+ * @brief Get the next free slot of the producer ring.
+ *
+ * The slot is the payload of a notification PDU allocated for it, that L2CC receives as
+ * is: the data written by the producer is not copied again. Kernel context only (the
+ * kernel handlers and the main loop), as the PDU is allocated from the kernel heap. The
+ * slot is queued by streamdatad_ring_commit().
+ *
+ * @return Slot of STREAMDATAD_PACKET_SIZE bytes, NULL if the ring is full (the packet is
+ * counted as dropped).
+ ****************************************************************************************
+ */
+uint8_t *streamdatad_ring_slot_get(void);
+
+/**
+ ****************************************************************************************
+ * @brief Queue the slot returned by streamdatad_ring_slot_get().
+ *
+ * It only publishes the slot. The ring is drained by streamdatad_ring_poll() from the
+ * main loop, at the end of every BLE event and when L2CC returns a credit.
+ ****************************************************************************************
+ */
+void streamdatad_ring_commit(void);
+
+/**
+ ****************************************************************************************
+ * @brief Copy a packet in the PDU of the next slot of the producer ring.
+ *
+ * @param[in] data Packet of STREAMDATAD_PACKET_SIZE bytes.
+ *
+ * @return true if queued, false if the ring is full (the packet is counted as dropped).
+ ****************************************************************************************
+ */
+bool streamdatad_ring_put(uint8_t const *data);
+
+/**
+ ****************************************************************************************
+ * @brief Send the PDUs of the producer ring while credits are available.
+ * Consumer side of the ring, kernel context only.
+ ****************************************************************************************
+ */
+void streamdatad_ring_drain(void);
+
+/**
+ ****************************************************************************************
+ * @brief Drain the producer ring if packets are queued and credits are available.
+ * To be called from the main loop (app_asynch_proc()), for the packets committed outside
+ * of the kernel handlers.
+ ****************************************************************************************
+ */
+void streamdatad_ring_poll(void);
+
+/**
+ ****************************************************************************************
+ * @brief Discard the content of the producer ring and free its PDUs. Kernel context only.
+ * The credits are left untouched: the PDUs in flight return theirs.
+ ****************************************************************************************
+ */
+void streamdatad_ring_reset(void);
+
+/**
+ ****************************************************************************************
+ * @brief Update the per event counters and drain the producer ring. To be called at the
+ * end of every BLE event (KE_EVENT_BLE_EVT_END), so that the TX buffers are refilled
+ * before the next connection event.
+ ****************************************************************************************
+ */
+void streamdatad_evt_end(void);
+
+/**
+ ****************************************************************************************
+ * @brief Clear the stream counters and restart the throughput measurement.
+ ****************************************************************************************
+ */
+void streamdatad_stats_reset(void);
+
+/**
+ ****************************************************************************************
+ * @brief Notification payload throughput since the stream was started.
+ *
+ * The payload is counted when handed over to L2CC, so this is the rate at which the
+ * host fills the TX buffers, not the rate acknowledged by the peer.
+ *
+ * @return Bytes per second, 0 if less than 10ms have elapsed.
+ ****************************************************************************************
+ */
+uint32_t streamdatad_throughput_get(void);
+
+/**
+ ****************************************************************************************
+ * @brief Allocate the notification of the next data characteristic enabled by the peer.
+ *
+ * The returned L2CC PDU is ready to be sent, only its payload, accessed with
+ * STREAMDATAD_PACKET_DATA(), has to be written by the producer. The attribute database
+ * is not updated, the data goes from the producer to L2CC without any intermediate copy.
+ *
+ * A credit is taken for each packet, it is returned when L2CC reports that the PDU has
+ * been sent. Producers check streamdatad_credits_get() first: a call without credit
+ * is counted as a stall.
+ *
+ * @return The packet, NULL if no data characteristic has notifications enabled or no
+ * credit is left.
+ ****************************************************************************************
+ */
+struct l2cc_pdu_send_req *streamdatad_packet_alloc(void);
+
+/**
+ ****************************************************************************************
+ * @brief Number of packets that can be handed over to L2CC now.
+ *
+ * @return The credits left, 0 if no data characteristic has notifications enabled.
+ ****************************************************************************************
+ */
+uint16_t streamdatad_credits_get(void);
+
+/**
+ ****************************************************************************************
+ * @brief Hand a packet allocated by streamdatad_packet_alloc() over to L2CC.
+ *
+ * @param[in] pkt Packet with its payload written.
+ ****************************************************************************************
+ */
+void streamdatad_packet_send(struct l2cc_pdu_send_req *pkt);
+
 
 #endif /* BLE_STREAMDATA_DEVICE */
 
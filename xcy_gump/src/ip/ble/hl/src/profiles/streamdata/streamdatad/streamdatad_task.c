@@ -51,6 +51,10 @@
 #include "atts_util.h"
 #include "attm_cfg.h"
 #include "prf_utils.h"
+#include "co_utils.h"
+#include "l2cm.h"
+#include "l2cc_task.h"
+#include "ll.h"
 
 #include "streamdatad_task.h"
 #include "streamdatad.h"
@@ -236,10 +240,12 @@ static int streamdatad_enable_req_handler(ke_msg_id_t const msgid,
 	streamdatad_env.next_attribute_idx = 0;
 	streamdatad_env.nr_enabled_attributes = 0;
 	streamdatad_env.stream_enabled = 0;
+	streamdatad_env.ntf_en_mask = 0;
+
+    // Empty ring. New connection, no PDU in flight: all the TX buffers are available
+    streamdatad_ring_reset();
+    streamdatad_env.credits = l2cm_get_nb_buffer_available();
 
-    // get tx buffers available 
-    nb_buf_av = l2cm_get_nb_buffer_available() - 6;
-    
     attmdb_att_set_value(STREAMDATAD_HANDLE(STREAMDATAD_IDX_ENABLE_VAL), sizeof(uint16_t), (uint8_t*) &(disable_val));
 
     attmdb_att_set_value(STREAMDATAD_HANDLE(STREAMDATAD_IDX_STREAMDATAD_D0_EN), sizeof(uint16_t),(uint8_t*) &(disable_val));
@@ -284,7 +290,8 @@ static int streamdatad_disable_req_handler(ke_msg_id_t const msgid,
 /**
  ****************************************************************************************
  * @brief Handles reception of the @ref STREAMDATAD_SEND_DATA_PACKETS_REQ message.
- * The handler sends up to l2cm_get_nb_buffer_available() packets of data from param.
+ * The handler copies the packets of data from param in the notification PDUs of the
+ * producer ring and sends as many as the available credits allow.
  * @param[in] msgid Id of the message received (probably unused).
  * @param[in] param Pointer to the parameters of the message.
  * @param[in] dest_id ID of the receiving task instance (probably unused).
@@ -298,70 +305,17 @@ int streamdatad_send_data_packets_req_handler(ke_msg_id_t const msgid,
                                    ke_task_id_t const dest_id,
                                    ke_task_id_t const src_id)
 {
-	uint16_t next_packet;
-	uint16_t nr_packets;
-	uint16_t nr_buffers_available;
-    uint16_t* packet_buffer_enabled;
-    uint16_t len = 0;
-
 	if (!streamdatad_env.stream_enabled) return KE_MSG_CONSUMED; 
 
-	next_packet = 0;
-	nr_packets = param->nr_packets;
-
-#if 0	
-	if (streamdatad_env.nr_overflow_packets > 0)
-		nr_buffers_available = streamdatad_send_overflow_packets(); // send overflow packets first.
-	else
-		nr_buffers_available = l2cm_get_nb_buffer_available() - 6;  //by ED TBC
-#endif
-    
-    nb_buf_av = l2cm_get_nb_buffer_available();
-    
-    for (int li = 0; (li < STREAMDATAD_MAX) && (nr_packets > 0) && (nb_buf_av > 0); li++)
-	{		
-        packet_buffer_enabled = NULL;
-        attmdb_att_get_value(STREAMDATAD_DIR_EN_HANDLE(streamdatad_env.next_attribute_idx), &(len), (uint8_t**)&(packet_buffer_enabled));
-        
-        if ((packet_buffer_enabled && (*packet_buffer_enabled)))
-        {        
-            // Update the value in the attribute database
-            attmdb_att_set_value(STREAMDATAD_DIR_VAL_HANDLE(streamdatad_env.next_attribute_idx), sizeof(uint8_t) * STREAMDATAD_PACKET_SIZE, (uint8_t*) &(param->packets[next_packet][0]));
-
-            // Send notification
-            prf_server_send_event((prf_env_struct *)&(streamdatad_env.con_info), false, STREAMDATAD_DIR_VAL_HANDLE(streamdatad_env.next_attribute_idx));
-        }
-        else
-        {
-            len = 2;
-        }
-        
-        //set_pxact_gpio();
-        next_packet++; nr_packets--;
-        nb_buf_av--;
-        
-        streamdatad_env.next_attribute_idx++; 
-        if (streamdatad_env.next_attribute_idx >= STREAMDATAD_MAX) {
-            
-            streamdatad_env.next_attribute_idx = 0;
-            break; // the for loop
-        }
-        
-		// else notification at this index was not enabled;
+    // Every packet that does not fit in the ring is counted as dropped
+    for (int i = 0; i < param->nr_packets; i++)
+    {
+        streamdatad_ring_put((uint8_t const *) &param->packets[i][0]);
     }
-    //set_pxact_gpio();
-#if 0	
-	while (nr_packets-- > 0)
-	{
-		// ERROR overflow
-		// This can happen if there are SEND_DATA_REQ packets in-flight when a LLC_NB_PKT_CMP_EVT comes in, or
-		// this can also happen there are fewer notification-enabled attributes than there are transmit buffers.
-		
-		// We'll copy the data for later transmission
-		memcpy(&(streamdatad_env.overflow_packets[streamdatad_env.nr_overflow_packets][0]), &(param->packets[next_packet][0]), STREAMDATAD_PACKET_SIZE);
-		if (streamdatad_env.nr_overflow_packets < STREAMDATAD_MAX) ++streamdatad_env.nr_overflow_packets;
-	}
-#endif
+
+    // Send now rather than waiting for the main loop
+    streamdatad_ring_drain();
+
     return (KE_MSG_CONSUMED);
 }
 
@@ -400,26 +354,50 @@ static int gattc_write_cmd_ind_handler(ke_msg_id_t const msgid,
         case STREAMDATAD_IDX_STREAMDATAD_D5_EN:
         case STREAMDATAD_IDX_STREAMDATAD_D6_EN:
         case STREAMDATAD_IDX_STREAMDATAD_D7_EN:
+        case STREAMDATAD_IDX_STREAMDATAD_D8_EN:
+        case STREAMDATAD_IDX_STREAMDATAD_D9_EN:
+        {
+            uint16_t dir = STREAMDATAD_EN_IDX_TO_DIR(STREAMDATAD_IDX(param->handle));
+
+            // Keep track of the enabled notifications, the send path does not read the database
+            if (co_read16p(&param->value[0]))
+                streamdatad_env.ntf_en_mask |= (1 << dir);
+            else
+                streamdatad_env.ntf_en_mask &= ~(1 << dir);
+
 			atts_write_rsp_send(streamdatad_env.conhdl, param->handle, PRF_ERR_OK);
-            break;
+        } break;
     }
 
     return (KE_MSG_CONSUMED);
 }
 
-uint8_t nb_buf_av;
-static int gattc_cmp_evt_handler(ke_msg_id_t const msgid,  struct gattc_cmp_evt const *param,
-                                 ke_task_id_t const dest_id, ke_task_id_t const src_id)
+/**
+ ****************************************************************************************
+ * @brief Handles reception of the @ref L2CC_DATA_SEND_RSP message.
+ * A notification PDU has been handed over to the controller: its credit is returned and
+ * the producer ring is drained. The response is then forwarded to the application.
+ * @param[in] msgid Id of the message received (probably unused).
+ * @param[in] param Pointer to the parameters of the message.
+ * @param[in] dest_id ID of the receiving task instance (probably unused).
+ * @param[in] src_id ID of the sending task instance.
+ * @return If the message was consumed or not.
+ ****************************************************************************************
+ */
+static int l2cc_data_send_rsp_handler(ke_msg_id_t const msgid,
+                                      struct l2cc_data_send_rsp const *param,
+                                      ke_task_id_t const dest_id,
+                                      ke_task_id_t const src_id)
 {
+    streamdatad_env.credits++;
 
-    if(param->req_type == GATTC_NOTIFY)
-    {
-        nb_buf_av++;
-        //set_pxact_gpio();
-    }
-    return (KE_MSG_CONSUMED);
-}
+    streamdatad_ring_drain();
+
+    // The application produces its next packet on this response
+    ke_msg_forward(param, streamdatad_env.appid, src_id);
 
+    return (KE_MSG_NO_FREE);
+}
 
 /*
  * TASK DESCRIPTOR DEFINITIONS
@@ -444,7 +422,6 @@ const struct ke_msg_handler streamdatad_active[] =
     {STREAMDATAD_DISABLE_REQ, (ke_msg_func_t)streamdatad_disable_req_handler},
     {STREAMDATAD_SEND_DATA_PACKETS_REQ, (ke_msg_func_t)streamdatad_send_data_packets_req_handler},
     {GATTC_WRITE_CMD_IND, (ke_msg_func_t)gattc_write_cmd_ind_handler},
-//    {GATTC_CMP_EVT,       (ke_msg_func_t)gattc_cmp_evt_handler},
 }; 
 
 /// Specifies the message handler structure for every input state
@@ -459,8 +436,14 @@ const struct ke_state_handler streamdatad_state_handler[STREAMDATAD_STATE_MAX] =
 
 };
 
+/// Default State handlers definition
+const struct ke_msg_handler streamdatad_default_state[] =
+{
+    {L2CC_DATA_SEND_RSP,         (ke_msg_func_t)l2cc_data_send_rsp_handler},
+};
+
 /// Specifies the message handlers that are common to all states.
-const struct ke_state_handler streamdatad_default_handler = KE_STATE_HANDLER_NONE;
+const struct ke_state_handler streamdatad_default_handler = KE_STATE_HANDLER(streamdatad_default_state);
 
 /// Defines the placeholder for the states of all the task instances.
 ke_state_t streamdatad_state[STREAMDATAD_IDX_MAX]; // __attribute__((section("retention_mem_area0"),zero_init)); //@RETENTION MEMORY
@@ -163,6 +163,12 @@ enum APP_MSG
     APP_WAKEUP_MSG,
 #endif
 
+#if (KE_MEM_STATS)
+    /// Heap statistics request, can be sent over GTL
+    APP_MEM_STATS_REQ,
+    /// Heap statistics response
+    APP_MEM_STATS_RSP,
+#endif //KE_MEM_STATS
 };
 
 /*
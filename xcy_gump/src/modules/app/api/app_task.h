@@ -39,6 +39,8 @@
 
 #include "ke_task.h"        // Kernel Task
 #include "ke_msg.h"         // Kernel Message
+#include "ke_mem_stats.h"   // Kernel Memory Statistics
+#include "ke_handler_index.h" // Kernel Handler Table Index
 #include "gapm_task.h"        // 
 #include "gapc_task.h"        //
 #include "app_api.h"
@@ -102,6 +104,22 @@ struct app_pairing_cmp_evt
     uint8_t status;
 };
 
+#if (KE_MEM_STATS)
+/// Parameters of the @ref APP_MEM_STATS_REQ message
+struct app_mem_stats_req
+{
+    /// Reset the peak usage and failure counters once read
+    uint8_t reset;
+};
+
+/// Parameters of the @ref APP_MEM_STATS_RSP message
+struct app_mem_stats_rsp
+{
+    /// Statistics of each heap (env, db, msg, non-ret)
+    struct ke_mem_heap_stats heap[KE_MEM_BLOCK_MAX];
+};
+#endif //KE_MEM_STATS
+
 
 /*
  * GLOBAL VARIABLE DECLARATIONS
@@ -110,6 +128,12 @@ struct app_pairing_cmp_evt
 
 extern const struct ke_state_handler app_default_handler;
 
+#if (KE_HANDLER_INDEX)
+/// Default handler registered to the scheduler: dispatches through the index of
+/// app_default_handler
+extern const struct ke_state_handler app_indexed_handler;
+#endif //KE_HANDLER_INDEX
+
 extern ke_state_t app_state[APP_IDX_MAX];
 
 
@@ -182,6 +206,28 @@ int app_module_init_cmp_evt_handler(ke_msg_id_t const msgid,
                                            ke_task_id_t const dest_id,
                                            ke_task_id_t const src_id);
 
+#if (KE_MEM_STATS)
+/**
+ ****************************************************************************************
+ * @brief Handles reception of the APP_MEM_STATS_REQ message. Replies with the heap
+ * statistics to the requester.
+ ****************************************************************************************
+ */
+int app_mem_stats_req_handler(ke_msg_id_t const msgid,
+                                     struct app_mem_stats_req const *param,
+                                     ke_task_id_t const dest_id,
+                                     ke_task_id_t const src_id);
+#endif //KE_MEM_STATS
+
+#if (KE_HANDLER_INDEX)
+/**
+ ****************************************************************************************
+ * @brief Build the index of the application handler table, before TASK_APP is created.
+ ****************************************************************************************
+ */
+void app_handler_index_init(void);
+#endif //KE_HANDLER_INDEX
+
 
 /// @} APPTASK
 
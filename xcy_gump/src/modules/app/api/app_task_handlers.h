@@ -54,6 +54,9 @@ EXTERN const struct ke_msg_handler app_default_state[] =
     {GAPC_CONNECTION_REQ_IND,               (ke_msg_func_t)gapc_connection_req_ind_handler},
     {GAPC_DISCONNECT_IND,                   (ke_msg_func_t)gapc_disconnect_ind_handler},
     {APP_MODULE_INIT_CMP_EVT,               (ke_msg_func_t)app_module_init_cmp_evt_handler},
+#if (KE_MEM_STATS)
+    {APP_MEM_STATS_REQ,                     (ke_msg_func_t)app_mem_stats_req_handler},
+#endif //KE_MEM_STATS
 
 #if (BLE_APP_SEC)
     {GAPC_BOND_REQ_IND,                     (ke_msg_func_t)gapc_bond_req_ind_handler},
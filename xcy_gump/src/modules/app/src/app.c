@@ -41,6 +41,23 @@
 #include "nvds.h"                    // NVDS Definitions
 #endif //(NVDS_SUPPORT)
 
+#if (SPI_FLASH_ASYNC)
+#include "spi_flash_async.h"         // Asynchronous SPI Flash Definitions
+#endif //(SPI_FLASH_ASYNC)
+
+#if (I2C_EEPROM_ASYNC)
+#include "i2c_eeprom_async.h"        // Interrupt driven I2C EEPROM Definitions
+#endif //(I2C_EEPROM_ASYNC)
+
+#if (BLE_APP_DB_IMAGE)
+#include "app_db_image.h"            // Attribute database image
+#endif //(BLE_APP_DB_IMAGE)
+
+#if (BLE_APP_DB_TIMING)
+#include "lld_evt.h"                 // BLE time
+#include "app_console.h"             // Console output
+#endif //(BLE_APP_DB_TIMING)
+
 /*
  * ENUMERATIONS
  ****************************************************************************************
@@ -60,9 +77,19 @@ struct app_env_tag app_env __attribute__((section("retention_mem_area0"),zero_in
  ****************************************************************************************
  */
 
+#if (BLE_APP_DB_TIMING)
+/// BLE time when app_init() runs (625us slots)
+static uint32_t app_db_timing_start;
+#endif //(BLE_APP_DB_TIMING)
+
 /// Application Task Descriptor
+#if (KE_HANDLER_INDEX)
+static const struct ke_task_desc TASK_DESC_APP = {NULL, &app_indexed_handler,
+                                                  app_state, APP_STATE_MAX, APP_IDX_MAX};
+#else
 static const struct ke_task_desc TASK_DESC_APP = {NULL, &app_default_handler,
                                                   app_state, APP_STATE_MAX, APP_IDX_MAX};
+#endif //KE_HANDLER_INDEX
 
 /*
  * FUNCTION DEFINITIONS
@@ -83,9 +110,22 @@ void app_init(void)
     uint8_t length = NVDS_LEN_SECURITY_ENABLE;
     #endif // NVDS_SUPPORT
 
+    #if (BLE_APP_DB_TIMING)
+    app_db_timing_start = lld_evt_time_get();
+    #endif // (BLE_APP_DB_TIMING)
+
     // Reset the environment
     memset(&app_env, 0, sizeof(app_env));
 
+    #if (NVDS_SUPPORT) && (NVDS_READ_WRITE == 1)
+    // Mount the NVDS log before the first nvds_get(), its TAGs take precedence. The SPI
+    // flash has been set up by periph_init()
+    if (nvds_flash_init() != NVDS_OK)
+    {
+        ASSERT_WARNING(0);
+    }
+    #endif // NVDS_SUPPORT && NVDS_READ_WRITE
+
     // Initialize next_prf_init value for first service to add in the database
     app_env.next_prf_init = APP_PRF_LIST_START + 1;
 
@@ -100,17 +140,50 @@ void app_init(void)
 
 	app_init_func();    
 		
+    #if (KE_HANDLER_INDEX)
+    // Sort the handler table before the first message reaches the task
+    app_handler_index_init();
+    #endif //KE_HANDLER_INDEX
+
     // Create APP task
     ke_task_create(TASK_APP, &TASK_DESC_APP);
 
     // Initialize Task state
     ke_state_set(TASK_APP, APP_DISABLED);
 
+    #if (SPI_FLASH_ASYNC)
+    // Create the asynchronous SPI Flash task
+    spi_flash_async_init();
+    #endif // (SPI_FLASH_ASYNC)
+
+    #if (I2C_EEPROM_ASYNC)
+    // Create the I2C EEPROM task
+    i2c_eeprom_async_init();
+    #endif // (I2C_EEPROM_ASYNC)
+
     #if (BLE_APP_SEC)
     app_sec_init();
     #endif // (BLE_APP_SEC)
 }
 
+#if (BLE_APP_DB_TIMING)
+/**
+ ****************************************************************************************
+ * @brief Print the time from app_init() to the end of the database creation, when
+ * app_db_init_complete_func() starts the advertising.
+ *
+ * @return void
+ ****************************************************************************************
+ */
+
+static void app_db_timing_print(const char *how)
+{
+    uint32_t slots = (lld_evt_time_get() - app_db_timing_start) & BLE_BASETIMECNT_MASK;
+
+    arch_printf("app_db_init: database %s in %d us\r\n", how, slots * 625);
+}
+#endif // (BLE_APP_DB_TIMING)
+
 /**
  ****************************************************************************************
  * @brief Profiles's Database initialization sequence.
@@ -125,7 +198,35 @@ bool app_db_init(void)
     // Indicate if more services need to be added in the database
     bool end_db_create = false;
     
+    #if (BLE_APP_DB_IMAGE)
+    if (app_env.next_prf_init == APP_PRF_LIST_START + 1)
+    {
+        // Complete database from the image, no service to add
+        if (app_db_image_restore())
+        {
+            app_env.next_prf_init = APP_PRF_LIST_STOP;
+            #if (BLE_APP_DB_TIMING)
+            app_db_timing_print("restored");
+            #endif // (BLE_APP_DB_TIMING)
+            return true;
+        }
+
+        app_db_image_start();
+    }
+    #endif // (BLE_APP_DB_IMAGE)
+    
     end_db_create = app_db_init_func();
+    
+    if (end_db_create)
+    {
+        #if (BLE_APP_DB_IMAGE)
+        app_db_image_save();
+        #endif // (BLE_APP_DB_IMAGE)
+
+        #if (BLE_APP_DB_TIMING)
+        app_db_timing_print("created");
+        #endif // (BLE_APP_DB_TIMING)
+    }
         
     return end_db_create;
 }
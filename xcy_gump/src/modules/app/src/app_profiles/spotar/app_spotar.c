@@ -40,6 +40,8 @@
 #include "gpio.h"
 #include "spi.h"
 #include "spi_flash.h"
+#include "spi_flash_async.h"
+#include "i2c_eeprom_async.h"
 #include "arch_sleep.h"
 #include "periph_setup.h"
 
@@ -60,6 +62,36 @@ __align(4) uint8_t spota_all_pd[SPOTA_OVERALL_PD_SIZE] __attribute__((section("s
 
 void app_spotar_spi_config(spi_gpio_config_t *spi_conf);
 void app_spotar_i2c_config(i2c_gpio_config_t *i2c_conf);
+
+#if (SPI_FLASH_ASYNC) || (I2C_EEPROM_ASYNC)
+/**
+ ****************************************************************************************
+ * @brief End of the SPI Flash or I2C EEPROM patch write started by app_spotar_pd_hdlr().
+ *
+ * @param[in]   status  Number of bytes written or error code
+ *
+ * @return      void
+ ****************************************************************************************
+ */
+static void app_spotar_mem_write_cmp(int32_t status)
+{
+    uint32_t mem_info;
+
+    mem_info = get_patching_spota_length( ((spota_state.mem_dev << 24) | spota_state.mem_base_add), spota_state.gpio_map);
+    spotar_send_mem_info_update_req(mem_info);
+
+    if( status == spota_state.spota_pd_idx )
+    {
+        app_spotar_stop();
+        app_spotar_reset();
+        spotar_send_status_update_req((uint8_t) SPOTAR_CMP_OK);
+    }
+    else
+    {
+        spotar_send_status_update_req((uint8_t) SPOTAR_EXT_MEM_ERR);
+    }
+}
+#endif // SPI_FLASH_ASYNC || I2C_EEPROM_ASYNC
  
  /**
  ****************************************************************************************
@@ -234,6 +266,10 @@ void app_spotar_stop(void)
 {
 
     if( spota_state.mem_dev == SPOTAR_MEM_I2C_EEPROM ){
+#if (I2C_EEPROM_ASYNC)
+        // released by the driver once its queue is empty
+        if (!i2c_eeprom_async_busy())
+#endif
         i2c_eeprom_release();
     }
     
@@ -377,6 +413,15 @@ void app_spotar_pd_hdlr(void)
                 break;
             }
             app_spotar_i2c_config(&i2c_conf);
+#if (I2C_EEPROM_ASYNC)
+            // BLE keeps running while the patch is programmed, the status is sent on completion
+            i2c_eeprom_async_config(i2c_conf.slave_addr, I2C_SPEED_MODE, I2C_ADDRESS_MODE, I2C_2BYTES_ADDR);
+            if (i2c_eeprom_async_write(spota_new_pd, (spota_state.mem_base_add + overall_len_in_bytes),
+                                       spota_state.spota_pd_idx, app_spotar_mem_write_cmp) == I2C_EEPROM_ASYNC_OK)
+                return;
+            status = SPOTAR_EXT_MEM_ERR;
+            break;
+#endif // I2C_EEPROM_ASYNC
             i2c_eeprom_init(i2c_conf.slave_addr, I2C_SPEED_MODE, I2C_ADDRESS_MODE, I2C_2BYTES_ADDR);            
             ret = i2c_eeprom_write_data (spota_new_pd, (spota_state.mem_base_add + overall_len_in_bytes), spota_state.spota_pd_idx);
             if( ret !=  spota_state.spota_pd_idx){
@@ -398,6 +443,14 @@ void app_spotar_pd_hdlr(void)
             app_spotar_spi_config(&spi_conf);             
             spi_init(&spi_conf.cs, SPI_MODE_16BIT, SPI_ROLE_MASTER, SPI_CLK_IDLE_POL_LOW,	SPI_PHA_MODE_0, SPI_MINT_DISABLE, SPI_XTAL_DIV_8);
             spi_flash_init(SPI_FLASH_SIZE, SPI_FLASH_PAGE_SIZE );                                
+#if (SPI_FLASH_ASYNC)
+            // BLE keeps running while the patch is programmed, the status is sent on completion
+            if (spi_flash_async_write(spota_new_pd, (spota_state.mem_base_add + overall_len_in_bytes),
+                                      spota_state.spota_pd_idx, app_spotar_mem_write_cmp) == ERR_OK)
+                return;
+            status = SPOTAR_EXT_MEM_ERR;
+            break;
+#endif // SPI_FLASH_ASYNC
             ret = spi_flash_write_data (spota_new_pd, (spota_state.mem_base_add + overall_len_in_bytes), spota_state.spota_pd_idx);
             if( ret !=  spota_state.spota_pd_idx){
                 status = SPOTAR_EXT_MEM_ERR;
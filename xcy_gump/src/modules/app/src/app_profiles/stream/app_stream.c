@@ -96,6 +96,9 @@ void stream_start_button_init(void)
 
 void app_stream_idle_handler(void)
 {
+   // Send the packets waiting in the streamdatad ring for a credit
+   streamdatad_ring_poll();
+
    if (1 == app_stream_streamon)
 	{
         if (ke_state_get(TASK_APP) != APP_CONNECTED){ 
@@ -229,15 +232,16 @@ void stream_stop(void)
 
 uint8 num_of_pckets = 0;
 
-void stream_queue_more_data(uint16_t nr_packets)
+bool stream_queue_more_data(uint16_t nr_packets)
 {
-    uint8 dst[STREAMDATAD_PACKET_SIZE];
+    struct l2cc_pdu_send_req *pkt;
+    uint8_t *dst;
     
-    if( num_of_pckets == STREAMDATAD_MAX || (l2cm_get_nb_buffer_available() == 0 ))
+    if( num_of_pckets == STREAMDATAD_MAX )
     {
         //set_pxact_gpio();
         num_of_pckets = 0;
-        return;
+        return false;
     }
     
       //if( num_of_pckets == 0)
@@ -250,25 +254,41 @@ void stream_queue_more_data(uint16_t nr_packets)
         app_stream_stop_when_the_buffer_is_empty = 0;
     }
         
-    memset(dst, num_of_pckets, STREAMDATAD_PACKET_SIZE);
-    dst[0] = (num_of_pckets >> 8);
+    // Stop on the credits: producing without one would be counted as a stall
+    if (streamdatad_credits_get() == 0)
+    {
+        num_of_pckets = 0;
+        return false;
+    }
+
+    // Get the next notification PDU and produce the data directly in it
+    pkt = streamdatad_packet_alloc();
+    if (pkt == NULL)
     {
-        struct l2cc_pdu_send_req *pkt = KE_MSG_ALLOC(L2CC_PDU_SEND_REQ,
-                                                     KE_BUILD_ID(TASK_L2CC, app_env.conidx), TASK_APP,
-                                                     l2cc_pdu_send_req);
-
-        // Set attribute channel ID
-        pkt->pdu.chan_id   = L2C_CID_ATTRIBUTE;
-        // Set packet opcode.
-        pkt->pdu.data.code = L2C_CODE_ATT_HDL_VAL_NTF;
-        pkt->pdu.data.hdl_val_ntf.handle    = STREAMDATAD_DIR_VAL_HANDLE(num_of_pckets);
-        pkt->pdu.data.hdl_val_ntf.value_len = STREAMDATAD_PACKET_SIZE;
-        /* copy the content to value */
-        memcpy(&(pkt->pdu.data.hdl_val_ntf.value[0]), dst, pkt->pdu.data.hdl_val_ntf.value_len);
-        num_of_pckets++;
-        ke_msg_send(pkt);
+        num_of_pckets = 0;
+        return false;
     }
 
+    dst = STREAMDATAD_PACKET_DATA(pkt);
+    memset(dst, num_of_pckets, STREAMDATAD_PACKET_SIZE);
+    dst[0] = (num_of_pckets >> 8);
+    num_of_pckets++;
+
+    streamdatad_packet_send(pkt);
+
+    return true;
+}
+
+void app_stream_evt_end(void)
+{
+    if (!started)
+        return;
+
+    streamdatad_evt_end();
+
+    // Produce until streamdatad runs out of credits
+    while (stream_queue_more_data(0))
+        ;
 }
 
 #endif // (BLE_APP_PRESENT)
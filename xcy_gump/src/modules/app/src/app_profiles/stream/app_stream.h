@@ -37,6 +37,7 @@
 #if (BLE_STREAMDATA_DEVICE)
 
 #include <stdint.h>          // standard integer definition
+#include <stdbool.h>         // standard boolean definition
 #include <co_bt.h>
 
 
@@ -48,6 +49,8 @@
  
 extern uint8_t audio_adv_count;
 extern uint16_t audio_adv_interval;
+/// Set while the peer has the stream started (app_stream_task.c)
+extern int started;
 
 /*
  * FUNCTION DECLARATIONS
@@ -76,7 +79,16 @@ void stream_start(void);
 void app_stream_idle_handler(void);
 void app_stream_button_released(void);
 void stream_start_button_init(void);
-void stream_queue_more_data(uint16_t nr_packets);
+bool stream_queue_more_data(uint16_t nr_packets);
+
+/**
+ ****************************************************************************************
+ * @brief Keep the TX buffers full while streaming. Called at the end of every BLE event,
+ * it fills all the buffers released during the event so that the next connection event
+ * can carry as many packets as the controller allows.
+ ****************************************************************************************
+ */
+void app_stream_evt_end(void);
 void app_stream_enable(void);
 /**
  ****************************************************************************************
@@ -152,13 +152,12 @@ int stream_start_ind_handler(ke_msg_id_t const msgid,
 
 void request_more_data_if_possible( void )
 {
-	if (0 == started) { streamdatad_env.nr_overflow_packets = 0; return; }
+	if (0 == started) return;
 	const int nb_buffer_available = l2cm_get_nb_buffer_available();  //by ED TBC
 	
 	switch (streamdatad_env.stream_enabled)
 	{
 		default: 
-			streamdatad_env.nr_overflow_packets = 0;
 			break;
 		case 1:
             stream_queue_more_data(nb_buffer_available);           
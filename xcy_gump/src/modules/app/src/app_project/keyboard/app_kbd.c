@@ -82,18 +82,25 @@ uint32_t passcode   __RETAINED;                                     // used to s
 uint16 kbd_keycode_buffer[KEYCODE_BUFFER_SIZE] __RETAINED;          // Buffer to hold the scan results for the key presses / releases
 uint8_t kbd_keycode_buffer_head __RETAINED;                         // Read pointer for accessing the data of the keycode buffer
 uint8_t kbd_keycode_buffer_tail __RETAINED;                         // Write pointer for writing data to the keycode buffer
-uint8_t kbd_key_report[MAX_REPORTS][8] __RETAINED;                  // Key Report buffers
-uint8_t normal_key_report_st[8] __RETAINED;                         // Holds the contents of the last Key Report for normal keys sent to the Host
+uint8_t kbd_keycode_scan[KEYCODE_BUFFER_SIZE] __RETAINED;           // Scan cycle tag of each keycode of the keycode buffer
+uint8_t kbd_scan_tag __RETAINED;                                    // Tag of the scan cycle being processed (advanced after each one that logs key events)
+uint8_t kbd_report_scan __RETAINED;                                 // Scan cycle tag of the keycode being turned into Key Reports
+uint8_t kbd_key_report[MAX_REPORTS][KEY_REPORT_LEN] __RETAINED;     // Key Report buffers
+uint8_t normal_key_report_st[KEY_REPORT_LEN] __RETAINED;            // Holds the contents of the last Key Report for normal keys sent to the Host
 uint8_t extended_key_report_st[3] __RETAINED;                       // Holds the contents of the last Key Report for special functions sent to the Host
-kbd_rep_info report_list[MAX_REPORTS] __RETAINED;                   // The list of the reports instances (free or used)
-kbd_rep_info *kbd_trm_list __RETAINED;                              // Linked list of the pending Key Reports
-kbd_rep_info *kbd_free_list __RETAINED;                             // Linked list of the free Key Reports
+kbd_rep_info report_list[MAX_REPORTS] __RETAINED;                   // The ring of the reports instances (free or used)
+uint8_t kbd_trm_head __RETAINED;                                    // Index of the oldest pending Key Report in report_list[]
+uint8_t kbd_trm_cnt __RETAINED;                                     // Number of pending Key Reports
+kbd_rep_info *kbd_trm_list __RETAINED;                              // Oldest pending Key Report (NULL if none)
+kbd_rep_info *kbd_free_list __RETAINED;                             // Next free Key Report (NULL if all are pending)
+kbd_rep_info *kbd_last_key_rep __RETAINED;                          // Last pending Key Report for normal keys (NULL if none)
 //bool normal_key_report_ack_pending __RETAINED;                      // Keeps track of the acknowledgement of the last Key Report for normal keys sent to the Host
 //bool extended_key_report_ack_pending __RETAINED;                    // Keeps track of the acknowledgement of the last Key Report for special functions sent to the Host
     
 int kbd_output_mode_regs[KBD_NR_OUTPUTS] __RETAINED;                // MODE_REGs for the output GPIOs
 int kbd_output_reset_data_regs[KBD_NR_OUTPUTS] __RETAINED;          // RESET_DATA_REGs for the output GPIOs
 uint16_t kbd_out_bitmasks[KBD_NR_OUTPUTS] __RETAINED;               // mask to validate output GPIOs
+scan_t kbd_keymap_rows[KBD_NR_OUTPUTS] __RETAINED;                  // mask of the keys of each row that exist in the default keymap
 int kbd_input_mode_regs[KBD_NR_INPUTS] __RETAINED;                  // MODE_REGs for the input GPIOs
 
 
@@ -122,9 +129,10 @@ bool full_scan;                                                     // when true
 bool next_is_full_scan;                                             // Got an interrupt (key press) during partial scanning
 
 uint8_t kbd_bounce_active;                                          // flag indicating we are still in debouncing mode
-uint16_t kbd_bounce_intersections[DEBOUNCE_BUFFER_SIZE];            // holds output - input pair (key) for which debouncing is on
 scan_t kbd_bounce_rows[KBD_NR_OUTPUTS];                             // holds the key mask ('1' is active) for each row that is being debounced
-struct debounce_counter_t kbd_bounce_counters[DEBOUNCE_BUFFER_SIZE];// counter for each intersection (key)
+scan_t kbd_bounce_release[KBD_NR_OUTPUTS];                          // '1': key in WAIT_RELEASE or RELEASE_DEBOUNCING, '0': key in PRESS_DEBOUNCING
+scan_t kbd_bounce_counting[KBD_NR_OUTPUTS];                         // '1': key in RELEASE_DEBOUNCING (with kbd_bounce_release)
+scan_t kbd_bounce_counters[KBD_NR_OUTPUTS][DEBOUNCE_COUNTER_BITS];  // vertical debouncing counters, bit n of the counter of each key of a row
 uint8_t kbd_global_deb_cnt;                                         // counts down for press debouncing time when after a scan no new key has been detected
 struct roll_over_tag roll_over_info;                                // holds all the keys being pressed during a RollOver (Phantom state) state
 
@@ -138,6 +146,8 @@ __forceinline static bool kbd_buffer_has_data(void);
 static void kbd_enable_kbd_irq(void);
 static void app_kbd_enable_wakeup_irq(void);
 static inline void kbd_process_scandata(void);
+static inline scan_t debounce_counters_zero(const scan_t *cnt);
+static inline void debounce_counters_dec(scan_t *cnt, scan_t mask);
 static int prepare_kbd_keyreport(void);
 
 
@@ -158,78 +168,77 @@ static inline uint8 hut_to_ascii(const uint8 hut)
 
 
 /*
- * (Report) List management functions
+ * (Report) Queue management functions
  ****************************************************************************************
  */
 
+// The pending reports are kept in order in report_list[], used as a ring. kbd_trm_list 
+// and kbd_free_list are updated with it so that the sleep hooks can check them directly.
+static void kbd_update_lists(void)
+{
+    kbd_trm_list = (kbd_trm_cnt > 0) ? &report_list[kbd_trm_head] : NULL;
+    kbd_free_list = (kbd_trm_cnt < MAX_REPORTS) ? &report_list[(kbd_trm_head + kbd_trm_cnt) % MAX_REPORTS] : NULL;
+}
+
 static void kbd_init_lists(void)
 {
 	int i;
 	kbd_rep_info *node;
 	
-	kbd_trm_list = NULL;
-	
 	for (i = 0; i < MAX_REPORTS; i++) 
     {
 		node = &report_list[i];
 		node->pBuf = kbd_key_report[i];
 		node->type = FREE;
 		node->modifier_report = false; // normal keys
-		node->pNext = kbd_free_list;
-		kbd_free_list = node;
 	}
+    
+    kbd_trm_head = 0;
+    kbd_trm_cnt = 0;
+    kbd_last_key_rep = NULL;
+    kbd_update_lists();
 }
 
-// pull one from the beginning
-static kbd_rep_info *kbd_pull_from_list(kbd_rep_info **list)
+// take the next free one and add it at the end
+static kbd_rep_info *kbd_add_to_queue(void)
 {
-	kbd_rep_info *node;
+	kbd_rep_info *node = kbd_free_list;
 	
-	if (!(*list))
+	if (!node)
 		return NULL;
 	
-	node = *list;
-	*list = node->pNext;
-	node->pNext = NULL;
+	kbd_trm_cnt++;
+	kbd_update_lists();
 	
 	return node;
 }
 	
-// push one at the end
-static int kbd_push_to_list(kbd_rep_info **list, kbd_rep_info *node)
+// pull one from the beginning (valid until the next kbd_add_to_queue())
+static kbd_rep_info *kbd_pull_from_queue(void)
 {
-	kbd_rep_info *p;
+	kbd_rep_info *node = kbd_trm_list;
 	
 	if (!node)
-		return 0;
+		return NULL;
 	
-	if (!(*list))
-		*list = node;
-	else 
-    {
-		for (p = *list; p->pNext != NULL; p = p->pNext);
-		
-		p->pNext = node;
-		node->pNext = NULL;
-	}
+	if (node == kbd_last_key_rep)
+		kbd_last_key_rep = NULL;
+	
+	kbd_trm_head = (kbd_trm_head + 1) % MAX_REPORTS;
+	kbd_trm_cnt--;
+	kbd_update_lists();
 	
-	return 1;
+	return node;
 }
 
-#if 0
-// finds the last instance of a specific type
-static kbd_rep_info *kbd_search_in_list(kbd_rep_info *list, enum KEY_BUFF_TYPE type)
+// the last one added (NULL if none)
+__forceinline static kbd_rep_info *kbd_queue_tail(void)
 {
-	kbd_rep_info *node;
-	kbd_rep_info *last_found = NULL;
-	
-	for (node = list; node != NULL; node = node->pNext)
-		if (node->type == type)
-			last_found = node;
+	if (!kbd_trm_cnt)
+		return NULL;
 	
-	return last_found;
+	return &report_list[(kbd_trm_head + kbd_trm_cnt - 1) % MAX_REPORTS];
 }
-#endif	
 
 
 
@@ -378,6 +387,19 @@ static void kbd_init_retained_scan_vars(void)
 
         kbd_input_mode_regs[i] = (int)&(data_reg[3 + databit]);
 	}
+    
+    // to check whether a key is valid or not we always check the default keymap (#0).
+    // the assumption is that a key will definitely appear in the default  
+    // keymap and may appear in secondary keymaps as well.
+    for (i = 0; i < KBD_NR_OUTPUTS; ++i)
+    {
+        int j;
+        
+        kbd_keymap_rows[i] = 0;
+        for (j = 0; j < KBD_NR_INPUTS; ++j)
+            if (kbd_keymap[0][i][j] != 0)
+                kbd_keymap_rows[i] |= (scan_t)1 << j;
+    }
 }
 
 /*
@@ -398,12 +420,6 @@ static void kbd_init_scan_vars(void)
 
 	kbd_fn_modifier = 0;
     
-	for (i = 0; i < DEBOUNCE_BUFFER_SIZE ; ++i)
-	{
-		kbd_bounce_intersections[i] = 0xFFFF;
-		kbd_bounce_counters[i].cnt = 0;
-        kbd_bounce_counters[i].state = IDLE;
-	}
     kbd_global_deb_cnt = 0;
 	kbd_bounce_active = 0;
 	
@@ -418,6 +434,9 @@ static void kbd_init_scan_vars(void)
 		kbd_scandata[i] = val;
         kbd_active_row[i] = false;
         kbd_bounce_rows[i] = 0;
+        kbd_bounce_release[i] = 0;
+        kbd_bounce_counting[i] = 0;
+        memset(kbd_bounce_counters[i], 0, sizeof(kbd_bounce_counters[i]));
     }
     
     for (i = 0; i < 16; i++)
@@ -438,7 +457,7 @@ static void kbd_init_keyreport(void)
 	int i;
 	
 	for (i = 0; i < MAX_REPORTS; i++)
-		memset(kbd_key_report[i], 0, 8);
+		memset(kbd_key_report[i], 0, KEY_REPORT_LEN);
         
 	kbd_init_lists();
     
@@ -568,21 +587,26 @@ bool app_kbd_scan_matrix(int *row)
     if (i == KBD_NR_OUTPUTS) 
     {
         // a. process scan results
+        const uint8_t tail = kbd_keycode_buffer_tail;
+        
         kbd_process_scandata();
+        
+        // the next key events get a new tag. Only the scan cycles that log key events advance
+        // it, so the tags still waiting in the keycode buffer (or in the last pending report)
+        // span less than KEYCODE_BUFFER_SIZE values and are never reused while in use.
+        if (kbd_keycode_buffer_tail != tail)
+            kbd_scan_tag++;
 
         // b. Update debouncing counters
         kbd_bounce_active = 0;
-        for (int i = 0; i < DEBOUNCE_BUFFER_SIZE ; ++i) 
+        for (int i = 0; i < KBD_NR_OUTPUTS; ++i) 
         {
-            if (0xFFFF != kbd_bounce_intersections[i]) 
+            if (kbd_bounce_rows[i]) 
             {
                 kbd_bounce_active = 1;
                 
-                if (kbd_bounce_counters[i].cnt) 
-                {
-//                    dbg_printf(DBG_SCAN_LVL, "bounce i:%d cnt:%d\r\n", i, cnt);
-                    --kbd_bounce_counters[i].cnt;
-                }
+                // decrement the counters that are not zero
+                debounce_counters_dec(kbd_bounce_counters[i], kbd_bounce_rows[i] & ~debounce_counters_zero(kbd_bounce_counters[i]));
             }
         }
         
@@ -685,153 +709,118 @@ bool app_kbd_scan_matrix(int *row)
 }
 
 /*
- * Description  : Do debouncing for a key (called even when the key is considered
- *              : as pressed after press debouncing has finished).
+ * Description  : Vertical counters: bit n of the counters of all the keys of a row is
+ *              : held in cnt[n], so that the counters of a row are updated at once.
  *
- * Returns      : 0, key is ignored
- *              : 1, key is accepted and should be checked for ghosting
+ * Returns      : the mask of the keys whose counter is zero
  *
  */
-   
-static inline int debounce_key(const uint16 output, const uint16 input, const int pressed)
+static inline scan_t debounce_counters_zero(const scan_t *cnt)
 {
-    const uint16 my_intersection = (output << 8) | input;
-    const scan_t imask = 1 << input;
-    int i;
+    scan_t nz = 0;
+    int n;
     
-    // to check whether a key is valid or not we always check the default keymap (#0).
-    // the assumption is that a key will definitely appear in the default  
-    // keymap and may appear in secondary keymaps as well.
-    // if this is not sufficient for a specific application then additional 
-    // logic needs to be implemented.
-    if (kbd_keymap[0][output][input] == 0)
-        return 0;                       // this key does not exist in the default 
-                                        // keymap => it's a ghost!
+    for (n = 0; n < DEBOUNCE_COUNTER_BITS; ++n)
+        nz |= cnt[n];
+    
+    return ~nz;
+}
 
+/*
+ * Description  : Loads value in the counters of the keys of mask.
+ *
+ * Returns      : void
+ *
+ */
+static inline void debounce_counters_load(scan_t *cnt, const scan_t mask, const int value)
+{
+    int n;
+    
+    for (n = 0; n < DEBOUNCE_COUNTER_BITS; ++n)
+        cnt[n] = (value & (1 << n)) ? (cnt[n] | mask) : (cnt[n] & ~mask);
+}
 
-    // *** DEBOUNCE ***
+/*
+ * Description  : Decrements the counters of the keys of mask (they must not be zero).
+ *
+ * Returns      : void
+ *
+ */
+static inline void debounce_counters_dec(scan_t *cnt, scan_t mask)
+{
+    int n;
     
-    // check if there's an entry for this intersection in the array. an entry is
-    // reserved when a key is pressed. if an entry is reserved, 
-    // then the entry remains reserved until the key is released!
-    for (i = 0; i < DEBOUNCE_BUFFER_SIZE ; ++i)
-        if (my_intersection == kbd_bounce_intersections[i])
-            break;
-           
-    // the debouncing counter is 2-field structure. the field is the state. 
-    // the second field is the debouncing counter that counts down when doing
-    // press and release debouncing
-    if (i != DEBOUNCE_BUFFER_SIZE)          // entry found!
-    {
-        struct debounce_counter_t *deb = &kbd_bounce_counters[i];
-        
-        switch(deb->state)
-        {
-            case IDLE:
-#if DEVELOPMENT__NO_OTP
-                __asm("BKPT #0\n");         // cannot be in here!
-#endif
-                break;
-            case PRESS_DEBOUNCING:
-                if (deb->cnt == 0)          // debouncing done! check key status...
-                {
-                    if (pressed)            // go to WAIT_RELEASE and continue with deghosting
-                        deb->state = WAIT_RELEASE;
-                    else 
-                    {
-                        deb->state = IDLE;  // key is ignored since after debouncing is inactive
-                        kbd_bounce_intersections[i] = 0xFFFF;
-                        kbd_bounce_rows[output] &= ~imask;
-                        return 0;
-                    }
-                } 
-                else 
-                {
-                    kbd_new_scandata[output] |= imask;  // this bit is still toggling! reset it to the previous stable state so that
-                                            // it doesn't affect deghosting of other valid keys below
-                                            
-                    return 0;               // still debouncing...
-                }
-                break;
-            case WAIT_RELEASE:
-                if (!pressed) 
-                {
-                    deb->state = RELEASE_DEBOUNCING;
-                    deb->cnt = DEBOUNCE_COUNTER_RELEASE;
-                    kbd_new_scandata[output] &= ~imask;  // this bit is still toggling! reset it to the previous stable state so that
-                                            // is doesn't affect deghosting of other valid keys below
-                                            
-                    return 0;               // do debouncing...
-                } 
-                else 
-                {                           // check if this key press has been reported (could be a ghost key)
-                    if ( !(kbd_scandata[output] & imask) )
-                        return 0;           // skip key press as it has already been reported!
-                    // else, do deghosting so as to report the key press if need be
-                }
-                break;
-            case RELEASE_DEBOUNCING:
-                if (deb->cnt == 0)          // debouncing done! check key status...
-                {
-                    if (pressed)            // still pressed? fake release! return to WAIT_RELEASE
-                    {
-                        deb->state = WAIT_RELEASE;
-                        return 0;
-                    } 
-                    else 
-                    {
-                        deb->state = IDLE;  // return to IDLE and continue to register the key release in the buffer if need be
-                        kbd_bounce_intersections[i] = 0xFFFF;
-                        kbd_bounce_rows[output] &= ~imask;
-                        if (kbd_scandata[output] & imask)   // check if the key press had been reported
-                            return 0;       // it hadn't so skip the release report!
-                    }
-                } 
-                else 
-                {
-                    kbd_new_scandata[output] &= ~imask;  // this bit is still toggling! reset it to the previous stable state so that
-                                            // is doesn't affect deghosting of other valid keys below
-                                            
-                    return 0;               // still debouncing...
-                }
-                break;
-            default:
-                break;
-        }
-    }
-    else                                    // find an empty place
+    // subtract 1: each bit toggles until the first bit that was '1' (the borrow stops there)
+    for (n = 0; (n < DEBOUNCE_COUNTER_BITS) && mask; ++n)
     {
-#if DEVELOPMENT__NO_OTP
-        if (!pressed)
-            __asm("BKPT #0\n");             // if it's a release then there should be a valid entry for this key in the array!
-#endif
-
-        for (i = 0; i < DEBOUNCE_BUFFER_SIZE ; ++i)
-            if (kbd_bounce_intersections[i] == 0xFFFF) 
-            {
-#if DEVELOPMENT__NO_OTP
-                if (kbd_bounce_counters[i].state != IDLE)
-                    __asm("BKPT #0\n");     // this should not happen!
-#endif
-                break;
-            }
-
-        if (i == DEBOUNCE_BUFFER_SIZE)      // no space available!
-            return 0;
-
-        kbd_bounce_intersections[i] = my_intersection;
-        kbd_bounce_rows[output] |= imask;
-        kbd_bounce_counters[i].cnt = DEBOUNCE_COUNTER_PRESS;
-        kbd_bounce_counters[i].state = PRESS_DEBOUNCING;
-        kbd_new_scandata[output] |= imask;  // this bit is still toggling! reset it to the previous stable state so that
-                                            // is doesn't affect deghosting of other valid keys below
+        const scan_t bit = cnt[n];
         
-        return 0;                           // debouncing is started! the key will be put into the key buffer when it's finished!
+        cnt[n] = bit ^ mask;
+        mask &= ~bit;
     }
+}
 
-
-    // No bounce, continue to check for ghosting
-    return 1;
+/*
+ * Description  : Do debouncing for all the keys of a row that changed or are being
+ *              : debounced (the keys are still processed when they are considered
+ *              : as pressed after press debouncing has finished).
+ *              : Each key follows IDLE -> PRESS_DEBOUNCING -> WAIT_RELEASE -> 
+ *              : RELEASE_DEBOUNCING -> IDLE:
+ *              :   kbd_bounce_rows     '0'  '1'  '1'  '1'
+ *              :   kbd_bounce_release  '0'  '0'  '1'  '1'
+ *              :   kbd_bounce_counting '0'  '0'  '0'  '1'
+ *              : The bits of kbd_new_scandata[output] that are still toggling are
+ *              : reset to the previous stable state so that they don't affect
+ *              : deghosting of other valid keys.
+ *
+ * Returns      : the mask of the keys that are accepted and should be checked for ghosting,
+ *              : the other keys keep the status of kbd_scandata[output]
+ *
+ */
+static inline scan_t debounce_row(const uint16 output, const scan_t keys)
+{
+    const scan_t pressed = ~kbd_new_scandata[output];
+    const scan_t zero = debounce_counters_zero(kbd_bounce_counters[output]);
+    const scan_t busy = kbd_bounce_rows[output];
+    const scan_t release = kbd_bounce_release[output];
+    const scan_t counting = kbd_bounce_counting[output];
+    scan_t *cnt = kbd_bounce_counters[output];
+    scan_t start, press_deb, wait_release, release_deb;
+    scan_t done_press, done_release, to_wait, to_release_deb;
+    scan_t accepted;
+    
+    // a key that does not exist in the default keymap is a ghost!
+    const scan_t k = keys & kbd_keymap_rows[output];
+    
+    start = k & ~busy;                                  // IDLE: debouncing is started
+    press_deb = k & busy & ~release;
+    wait_release = k & busy & release & ~counting;
+    release_deb = k & busy & release & counting;
+    
+    // PRESS_DEBOUNCING done: go to WAIT_RELEASE if the key is still pressed, else the
+    // key is ignored and returns to IDLE
+    done_press = press_deb & zero;
+    // WAIT_RELEASE and release: start release debouncing
+    to_release_deb = wait_release & ~pressed;
+    // RELEASE_DEBOUNCING done: still pressed? fake release! return to WAIT_RELEASE
+    done_release = release_deb & zero;
+    to_wait = (done_press & pressed) | (done_release & pressed);
+    
+    // accepted: press debounced, key still pressed (the press is reported once) and release debounced
+    accepted = (done_press & pressed) | (wait_release & pressed) | (done_release & ~pressed);
+    
+    // still toggling: keep the previous stable state
+    kbd_new_scandata[output] |= start | (press_deb & ~zero);
+    kbd_new_scandata[output] &= ~(to_release_deb | (release_deb & ~zero));
+    
+    // update the states and the counters
+    kbd_bounce_rows[output] = (busy | start) & ~((done_press | done_release) & ~pressed);
+    kbd_bounce_release[output] = (release | to_wait) & ~(start | (done_release & ~pressed));
+    kbd_bounce_counting[output] = (counting | to_release_deb) & ~(start | done_release);
+    debounce_counters_load(cnt, start, DEBOUNCE_COUNTER_PRESS);
+    debounce_counters_load(cnt, to_release_deb, DEBOUNCE_COUNTER_RELEASE);
+    
+    return accepted;
 }
 
 /*
@@ -887,88 +876,47 @@ static inline int record_key(const uint16 output, const uint16 input, const int
         // this situation). Else, it should be reported normally.
         //
 
-        int i, o;
-        scan_t scandata;
-        scan_t mask = 1;
-
-        // also, skip this key if:
-        // a. a "square of active keys" in formed in the newly scanned matrix that 
-        //    includes this key
-        // b. the corresponding "square" in the last reported status contains only 1 
-        //    active key. this means that there's another new key in the row we're 
-        //    examining that creates this "ghost" status (implicit 'B' and 'C' cases)
-        scandata = kbd_new_scandata[output] & ~imask;
-        if (scandata != imask)              // other columns are being driven in the row under examination
-        {
-            for (i = 0; i < KBD_NR_INPUTS; ++i, mask <<= 1)
-            {
-                if (input == i)
-                    continue;               // skip this column (it's the input under investigation)
-
-                if ( !(scandata & mask) )   // column (input) found
-                {
-                    // check if any other newly scanned row reports a key pressed in any of the two columns { input - i }
-                    // if so, then a "square" is formed. 
-                    for (o = 0; o < KBD_NR_OUTPUTS; ++o)
-                    {
-                        if (output == o)
-                            continue;       // skip this row (it's the output under investigation)
-
-                        scan_t combined_mask = (mask | imask);
-                        scan_t new_scandata = ((~kbd_new_scandata[o]) & ((1 << KBD_NR_INPUTS) - 1));
-                        if ( (new_scandata & combined_mask) != 0) { // if any is used => "square" of { (output, input) - (o, i) }
-                            // the other "corner" is not detected because the scanning of the rows 
-                            // is done in series (one after the other). thus, one row may be scanned 
-                            // just before the key is released and the other just after. they are 
-                            // scanned during the same scan cycle but the first row does not
-                            // indicate the current status of the matrix but the previous one!
-                            int cnt = 0;
-                            
-                            if (kbd_keymap[0][output][i]) cnt++;
-                            if (kbd_keymap[0][o][input]) cnt++;
-                            if (kbd_keymap[0][o][i]) cnt++;
-                            
-                            if (cnt == 3)
-                                return 0;
-                        }
-                    }
-                }
-            }
-        }
+        const scan_t all = (1 << KBD_NR_INPUTS) - 1;
+        // other columns with a key pressed in the row under examination, in the newly
+        // scanned matrix and in the last reported status
+        const scan_t new_cols = ~kbd_new_scandata[output] & all & ~imask;
+        const scan_t old_cols = ~kbd_scandata[output] & all & ~imask;
+        int o;
 
-        // scan all rows once more just in case an input is "missed" in the row under examination
+        // a "square" is formed with any other row o and column i for which the 3 other
+        // corners are valid keys. the rows are compared as whole words, one per row.
         for (o = 0; o < KBD_NR_OUTPUTS; ++o)
         {
-            if (output == o)
-                continue;                   // skip this row (it's the row under investigation)
-
-            scandata = kbd_new_scandata[o];
-            if ( !(scandata & imask) )      // this row has the same column (input) driven 
-            {
-                // check if any other column has a key pressed in any of the two rows { output - o } (or both)
-                // if this is the case then a "square" is formed.
-                mask = 1;
-                for (i = 0; i < KBD_NR_INPUTS; ++i, mask <<= 1)
-                {
-                    if (input == i)
-                        continue;           // skip this column (it's the input under investigation)
-
-                    scan_t d1 = kbd_scandata[output] & mask;
-                    scan_t d2 = scandata & mask;
+            scan_t row, corners;
+            
+            // skip this row (it's the row under investigation) and the rows that have
+            // no key in the column under investigation (no corner there)
+            if ( (output == o) || !(kbd_keymap_rows[o] & imask) )
+                continue;
 
-                    if ( !d1 || !d2 )       // at least one row uses an extra column. a "square" is formed
-                    {
-                        int cnt = 0;
-                        
-                        if (kbd_keymap[0][output][i]) cnt++;
-                        if (kbd_keymap[0][o][input]) cnt++;
-                        if (kbd_keymap[0][o][i]) cnt++;
-                        
-                        if (cnt == 3)
-                            return 0;
-                    }
-                }
-            }
+            // keys pressed in the newly scanned row o
+            row = ~kbd_new_scandata[o] & all;
+            
+            // columns i where both (output, i) and (o, i) are valid keys
+            corners = kbd_keymap_rows[output] & kbd_keymap_rows[o];
+
+            // skip this key if:
+            // a. a "square of active keys" in formed in the newly scanned matrix that 
+            //    includes this key: (output, i) is pressed and row o reports a key pressed
+            //    in any of the two columns { input - i }
+            //    the other "corner" is not detected because the scanning of the rows 
+            //    is done in series (one after the other). thus, one row may be scanned 
+            //    just before the key is released and the other just after. they are 
+            //    scanned during the same scan cycle but the first row does not
+            //    indicate the current status of the matrix but the previous one!
+            if (new_cols & corners & ((row & imask) ? all : row))
+                return 0;
+
+            // b. row o has the same column (input) driven and any other column has a key 
+            //    pressed in any of the two rows { output - o } (or both). this covers an
+            //    input "missed" in the row under examination (implicit 'B' and 'C' cases)
+            if ( (row & imask) && ((old_cols | row) & ~imask & corners) )
+                return 0;
         }
     }
 
@@ -1005,6 +953,7 @@ static inline int record_key(const uint16 output, const uint16 input, const int
     if (next_tail != kbd_keycode_buffer_head)
     {
         kbd_keycode_buffer[kbd_keycode_buffer_tail] = kbd_keymap[kbd_fn_modifier][output][input] | (pressed ? 0 : (0x0100));
+        kbd_keycode_scan[kbd_keycode_buffer_tail] = kbd_scan_tag;
         kbd_keycode_buffer_tail = next_tail;
         if (HAS_EEPROM)
         {
@@ -1039,37 +988,19 @@ static inline void kbd_process_scandata(void)
             
             new_scan_status[i] = kbd_new_scandata[i];
             
-            // look into kbd_bounce_intersections[] for any keys that are being debounced 
+            // look into kbd_bounce_rows[] for any keys that are being debounced 
             // that might not be reported in the xorword
             xorword |= kbd_bounce_rows[i];
             
             if (xorword) // if any key state changed
             {
-                scan_t bit;
-                scan_t mask;
-                int press;
+                scan_t ignored;
                 
                 kbd_active_row[i] = true;
                 
-                do
-                {
-                    leading_zeros = __clz((uint32_t)xorword);
-                    if (leading_zeros == 32)
-                        break;
-                    else {
-                        bit = 31 - leading_zeros;
-                        mask = 1 << bit;
-                    }
-                        
-                    press = !(new_scan_status[i] & mask);
-                    if (!debounce_key(i, bit, press))
-                    {
-                        // This key is ignored, copy the bit from kbd_scandata[i] to newscanword => always keep last key status!
-                        new_scan_status[i] = (new_scan_status[i] & (~mask)) | (kbd_scandata[i] & mask);
-                    }
-                    xorword &= ~mask;
-                    
-                } while (xorword);
+                // The ignored keys keep the bit from kbd_scandata[i] => always keep last key status!
+                ignored = xorword & ~debounce_row(i, xorword);
+                new_scan_status[i] = (new_scan_status[i] & ~ignored) | (kbd_scandata[i] & ignored);
             }
             else
                 kbd_active_row[i] = false;
@@ -1289,13 +1220,9 @@ void app_kbd_flush_reports(void)
 {
     kbd_rep_info *pReportInfo;
     
-    // Get the last pending normal key report, if any
-    while (kbd_trm_list)
-    {
-        pReportInfo = kbd_pull_from_list(&kbd_trm_list);
+    // Free all pending key reports, if any
+    while ((pReportInfo = kbd_pull_from_queue()) != NULL)
         pReportInfo->type = FREE;
-        kbd_push_to_list(&kbd_free_list, pReportInfo);
-    }
 }
 
 
@@ -1325,53 +1252,68 @@ __forceinline static int keycode_buffer_written_sz(void)
  */
 static kbd_rep_info* add_report(enum KEY_BUFF_TYPE type)
 {
-    kbd_rep_info *pReportInfo, *_pReportInfo, *pTmpRep;
+    kbd_rep_info *pReportInfo;
     
     // Get the last pending normal key report, if any
-    if (!kbd_trm_list)
-        _pReportInfo = NULL;
-    else 
-    {
-        pTmpRep = NULL;
-
-        _pReportInfo = kbd_trm_list;
-        do 
-        {
-            if (_pReportInfo->char_id == 0) 
-                pTmpRep = _pReportInfo;
-            _pReportInfo = _pReportInfo->pNext;
-        } while (_pReportInfo != NULL);
-
-        _pReportInfo = pTmpRep;
-    }
+    kbd_rep_info *_pReportInfo = kbd_last_key_rep;
 
     // add one <type> report
-    pReportInfo = kbd_pull_from_list(&kbd_free_list);
+    pReportInfo = kbd_add_to_queue();
     ASSERT_(pReportInfo);
     pReportInfo->type = type;
     pReportInfo->modifier_report = false;
     pReportInfo->char_id = 0;
-    pReportInfo->len = 8;
+    pReportInfo->len = KEY_REPORT_LEN;
 
     if (!_pReportInfo)   // first entry - copy last one sent
     {
         if (normal_key_report_st[0] != 0xFF) 
         {
-            memcpy(pReportInfo->pBuf, normal_key_report_st, 8);
+            memcpy(pReportInfo->pBuf, normal_key_report_st, KEY_REPORT_LEN);
         } 
         else 
         {
-            memset(pReportInfo->pBuf, 0, 8); // should not happen
+            memset(pReportInfo->pBuf, 0, KEY_REPORT_LEN); // should not happen
         }
     } 
     else /*if (_pReportInfo)*/ // last report pending 
-        memcpy(pReportInfo->pBuf, _pReportInfo->pBuf, 8);
+        memcpy(pReportInfo->pBuf, _pReportInfo->pBuf, KEY_REPORT_LEN);
 
-    kbd_push_to_list(&kbd_trm_list, pReportInfo);
+    pReportInfo->scan = kbd_report_scan;
+    kbd_last_key_rep = pReportInfo;
 
     return pReportInfo;
 }
 
+/*
+ * Description  : Coalescing of the key reports. A key press or release is merged in the 
+ *              : last report of the trm list, instead of adding a new one, when:
+ *              : 1. it is a key report (not a modifier or an extended one) of the same type
+ *              :    and nothing else has been queued after it, and
+ *              : 2. its key changes come from the same scan cycle (their order is unknown
+ *              :    anyway) or both are releases (the order of the releases does not matter
+ *              :    to the host). The keycodes are tagged with their scan cycle, so this
+ *              :    holds when the keycode buffer is drained later (free list depletion).
+ *              : A press that follows a press of a previous scan cycle is still sent in its
+ *              : own report so that the host sees the presses in order.
+ *
+ * Returns      : a pointer to the report to update
+ *
+ */
+static kbd_rep_info* get_key_report(enum KEY_BUFF_TYPE type)
+{
+    kbd_rep_info *p = kbd_queue_tail();
+    
+    if ( p && (p == kbd_last_key_rep) && (p->type == type) && !p->modifier_report 
+         && ((p->scan == kbd_report_scan) || (type == RELEASE)) )
+    {
+        p->scan = kbd_report_scan;
+        return p;
+    }
+    
+    return add_report(type);
+}
+
 static void sort_report_data(uint8_t *buf, int len)
 {
     // bring all used entries at the beginning of the report
@@ -1406,7 +1348,7 @@ static void sort_report_data(uint8_t *buf, int len)
 __forceinline static int modify_kbd_keyreport(const char keymode, const char keychar, uint8_t pressed)
 {
     int i;
-    kbd_rep_info *pReportInfo, *_pReportInfo, *pTmpRep;
+    kbd_rep_info *pReportInfo;
 
     // 1. The Key Report is filled from pos 2 to pos 7. It monitors the state of up to 6 keys. If more are pressed then
     //    RollOver functionality (Phantom state) should be applied.
@@ -1425,6 +1367,28 @@ __forceinline static int modify_kbd_keyreport(const char keymode, const char key
     {
         case 0x00: // normal key
         {
+            if (HAS_NKRO)
+            {
+                // N-Key Roll-Over: each key has its own bit in the report, there is no 
+                // Phantom state and no sorting.
+                const uint8_t usage = keychar;
+                const uint8_t bit = 1 << (usage & 0x07);
+                uint8_t *pByte;
+                
+                if (usage > NKRO_USAGE_MAX)
+                    break;  // not in the bitmap
+                
+                pReportInfo = get_key_report(pressed ? PRESS : RELEASE);
+                pByte = &pReportInfo->pBuf[2 + (usage >> 3)];
+                
+                if (pressed)
+                    *pByte |= bit;
+                else
+                    *pByte &= ~bit;
+                
+                break;
+            }
+            
             if (pressed) 
             {
                 // check if in Phantom state (Roll-Over)
@@ -1435,8 +1399,8 @@ __forceinline static int modify_kbd_keyreport(const char keymode, const char key
                     return 0;
                 }
                 
-                // add one press report
-                pReportInfo = add_report(PRESS);
+                // add one press report (or use the pending one)
+                pReportInfo = get_key_report(PRESS);
 
                 for (i = 2; i < 8; i++)
                     if (!pReportInfo->pBuf[i])
@@ -1490,8 +1454,8 @@ __forceinline static int modify_kbd_keyreport(const char keymode, const char key
                     return 1;
                 }
                 
-                // add one RELEASE report
-                pReportInfo = add_report(RELEASE);
+                // add one RELEASE report (or use the pending one)
+                pReportInfo = get_key_report(RELEASE);
 
                 for (i = 2; i < 8; i++) 
                     if (pReportInfo->pBuf[i] == keychar) 
@@ -1518,31 +1482,15 @@ __forceinline static int modify_kbd_keyreport(const char keymode, const char key
             uint8_t *pLastKeyStatus = NULL;
 
             // get last report to find the modifiers' status
-            if (!kbd_trm_list) 
+            if (kbd_last_key_rep) 
+                pLastKeyStatus = kbd_last_key_rep->pBuf;
+            else if (!kbd_trm_list) 
             {
                 if (normal_key_report_st[0] != 0xFF)
                     pLastKeyStatus = normal_key_report_st;
                 else
                     /*pLastKeyStatus = NULL*/;
             } 
-            else 
-            {
-                pTmpRep = NULL;
-
-                _pReportInfo = kbd_trm_list;
-                do 
-                {
-                    if (_pReportInfo->char_id == 0) 
-                        pTmpRep = _pReportInfo;
-                        
-                    _pReportInfo = _pReportInfo->pNext;
-                } while (_pReportInfo != NULL);
-
-                if (pTmpRep)
-                    pLastKeyStatus = pTmpRep->pBuf;
-                else
-                    /*pLastKeyStatus = NULL*/;
-            } 
             
             if (pLastKeyStatus)
                 modifier = pLastKeyStatus[0];
@@ -1554,7 +1502,7 @@ __forceinline static int modify_kbd_keyreport(const char keymode, const char key
             if (new_modifier != modifier)   // normally this will always be true
             {
                 // add "modifier" report in the trm list.
-                pReportInfo = kbd_pull_from_list(&kbd_free_list);
+                pReportInfo = kbd_add_to_queue();
                 ASSERT_(pReportInfo);
 
                 if (pressed) 
@@ -1564,15 +1512,15 @@ __forceinline static int modify_kbd_keyreport(const char keymode, const char key
                     
                 pReportInfo->modifier_report = true;
                 pReportInfo->char_id = 0;
-                pReportInfo->len = 8;
+                pReportInfo->len = KEY_REPORT_LEN;
 
                 // copy last key status
                 if (pLastKeyStatus)
-                    memcpy(pReportInfo->pBuf, pLastKeyStatus, 8);
+                    memcpy(pReportInfo->pBuf, pLastKeyStatus, KEY_REPORT_LEN);
                 else
-                    memset(pReportInfo->pBuf, 0, 8);
+                    memset(pReportInfo->pBuf, 0, KEY_REPORT_LEN);
 
-                kbd_push_to_list(&kbd_trm_list, pReportInfo);
+                kbd_last_key_rep = pReportInfo;
 
                 pReportInfo->pBuf[0] = new_modifier;
             }
@@ -1647,7 +1595,7 @@ static int kbd_process_keycode(uint16 keycode)
                 
                 // add a "full release" report in the trm list.
                 pReportInfo = add_report(RELEASE);
-                memset(pReportInfo->pBuf, 0, 8); 
+                memset(pReportInfo->pBuf, 0, KEY_REPORT_LEN); 
                 
                 kbd_fn_modifier = (kbd_fn_modifier & (~keychar)) | (pressed ? keychar : 0);
                 break;
@@ -1700,7 +1648,7 @@ static int kbd_process_keycode(uint16 keycode)
                 else   // Normal case
                 {
                     // Add an extended key report for each press / release
-                    pReportInfo = kbd_pull_from_list(&kbd_free_list);
+                    pReportInfo = kbd_add_to_queue();
                     ASSERT_(pReportInfo);
 
                     pReportInfo->type = EXTENDED;
@@ -1714,7 +1662,6 @@ static int kbd_process_keycode(uint16 keycode)
                         extended_key_report_st[byte] &= ~mask;
                     
                     memcpy(pReportInfo->pBuf, extended_key_report_st, 3); 
-                    kbd_push_to_list(&kbd_trm_list, pReportInfo);
                 }
                 break;
             }
@@ -1748,6 +1695,7 @@ static int prepare_kbd_keyreport(void)
     
     do 
     {
+        kbd_report_scan = kbd_keycode_scan[kbd_keycode_buffer_head];
         kbd_process_keycode(kbd_keycode_buffer[kbd_keycode_buffer_head]);
         kbd_keycode_buffer_head = (kbd_keycode_buffer_head + 1) % KEYCODE_BUFFER_SIZE;
     } 
@@ -1779,30 +1727,32 @@ __forceinline static int send_kbd_keyreport(void)
         }
         else
         {
-            req = KE_MSG_ALLOC_DYN(HOGPD_REPORT_UPD_REQ, TASK_HOGPD, TASK_APP, hogpd_report_info, 8);
+            req = KE_MSG_ALLOC_DYN(HOGPD_REPORT_UPD_REQ, TASK_HOGPD, TASK_APP, hogpd_report_info, KEY_REPORT_LEN);
         }
         
         if (!req)
             break;
 
-        p = kbd_pull_from_list(&kbd_trm_list);
+        p = kbd_pull_from_queue();
         
         // Fill in the parameter structure
         req->conhdl = app_env.conhdl;
         req->hids_nb = 0;
         req->report_nb = p->char_id;
         req->report_length = p->len;
-        memcpy(req->report, p->pBuf, 8);
+        memcpy(req->report, p->pBuf, KEY_REPORT_LEN);
 
-        dbg_printf(DBG_SCAN_LVL, "Sending HOGPD_REPORT_UPD_REQ %02x:[%02x:%02x:%02x:%02x:%02x:%02x]\r\n", 
-                    (int)p->pBuf[0], (int)p->pBuf[2], (int)p->pBuf[3], (int)p->pBuf[4], (int)p->pBuf[5], (int)p->pBuf[6], (int)p->pBuf[7]);
+        dbg_puts(DBG_SCAN_LVL, "Sending HOGPD_REPORT_UPD_REQ [");
+        for (int i = 0; i < KEY_REPORT_LEN; i++)
+            dbg_printf(DBG_SCAN_LVL, (i == 0) ? "%02x" : ":%02x", (int)p->pBuf[i]);
+        dbg_puts(DBG_SCAN_LVL, "]\r\n");
                     
         ke_msg_send(req);
 
         switch (p->char_id) 
         {
         case 0:
-            memcpy(normal_key_report_st, p->pBuf, 8);
+            memcpy(normal_key_report_st, p->pBuf, KEY_REPORT_LEN);
 //            normal_key_report_ack_pending = true;
             break;
         case 2:
@@ -1814,7 +1764,6 @@ __forceinline static int send_kbd_keyreport(void)
         }
         
         p->type = FREE;
-        kbd_push_to_list(&kbd_free_list, p);
         
         ret = 1;
     } while (0);
@@ -2307,7 +2256,7 @@ void app_kbd_stop_reporting(void)
     passcode = 0;
     kbd_reports_en = false;
     
-    memset(normal_key_report_st, 0, 8);
+    memset(normal_key_report_st, 0, KEY_REPORT_LEN);
     memset(extended_key_report_st, 0, 3);
 }
 
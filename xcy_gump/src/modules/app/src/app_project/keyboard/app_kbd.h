@@ -77,6 +77,16 @@
 #define HAS_HOGPD_BOOT_PROTO                    0
 #endif
 
+#ifdef NKRO_ON
+#define HAS_NKRO                                1
+#else
+#define HAS_NKRO                                0
+#endif
+
+#if (HAS_NKRO) && (HAS_HOGPD_BOOT_PROTO)
+#error "N-Key Roll-Over is not supported in BOOT MODE!"
+#endif
+
 #ifdef BATT_EXTERNAL_REPORT_ON
 #define HAS_BATT_EXTERNAL_REPORT                1
 #else
@@ -167,19 +177,17 @@
 
 #define KEYCODE_BUFFER_SIZE (64)	// if set to more than 255, change the type of the rd & wr pointers from 8- to 16-bit
 
-#define DEBOUNCE_BUFFER_SIZE (16)
-
-enum DEBOUNCE_STATE {
-    IDLE = 0,
-    PRESS_DEBOUNCING,
-    WAIT_RELEASE,
-    RELEASE_DEBOUNCING,
-};
+// The debouncing counters of the keys of a row are updated at once: bit n of each counter
+// is held in the same scan_t word. The counters go up to (1 << DEBOUNCE_COUNTER_BITS) - 1,
+// which must be enough for DEBOUNCE_COUNTER_PRESS and DEBOUNCE_COUNTER_RELEASE.
+#define DEBOUNCE_COUNTER_BITS (5)
 
-struct debounce_counter_t {
-    enum DEBOUNCE_STATE state;
-    uint8_t cnt;
-};
+// Same check with integer math, as the preprocessor has no floats: the operands of the
+// counters are integers, so their '+ 0.999' has no effect.
+#if ( (1 + (DEBOUNCE_COUNTER_P_IN_MS - FULL_SCAN_IN_MS) / PARTIAL_SCAN_IN_MS) >= (1 << DEBOUNCE_COUNTER_BITS) ) \
+    || ( (DEBOUNCE_COUNTER_R_IN_MS / PARTIAL_SCAN_IN_MS) >= (1 << DEBOUNCE_COUNTER_BITS) )
+#error "DEBOUNCE_COUNTER_BITS is too small for the debouncing counters!"
+#endif
 
 
 
@@ -190,6 +198,16 @@ struct debounce_counter_t {
 
 #define MAX_REPORTS 5 
 
+// (NKRO) The keys with usage 0x00 - NKRO_USAGE_MAX are reported in a bitmap, after the
+// modifiers and the reserved byte. Multiple of 8 minus 1, so that the bitmap has no padding.
+#define NKRO_USAGE_MAX      (0x87)
+
+#if (HAS_NKRO)
+#define KEY_REPORT_LEN      (2 + (NKRO_USAGE_MAX + 1) / 8)
+#else
+#define KEY_REPORT_LEN      (8)
+#endif
+
 enum KEY_BUFF_TYPE {
 	FREE,
 	PRESS,
@@ -202,8 +220,8 @@ typedef struct __kbd_rep_info {
 	bool modifier_report;
     uint8_t char_id;
     uint8_t len;
+    uint8_t scan;                   // scan cycle tag of the key changes of a key report
 	uint8_t *pBuf;
-	struct __kbd_rep_info *pNext;
 } kbd_rep_info;
 
 
@@ -43,6 +43,13 @@
 //#define HOGPD_BOOT_PROTO_ON
 
 
+/****************************************************************************************
+ * Use N-Key Roll-Over: the Key Report holds a bitmap of the keys instead of an         *
+ * array of 6 keys (not compatible with BOOT MODE)                                      *
+ ****************************************************************************************/
+//#define NKRO_ON
+
+
 /****************************************************************************************
  * Include BATT in HID                                                                  *
  ****************************************************************************************/
@@ -189,8 +189,8 @@
 #endif // EEPROM_ON
 
 #if (HAS_MULTI_BOND)
- #if ( !(HAS_EEPROM) )
-  #error "Multiple bonding support requires EEPROM!"
+ #if ( !(HAS_EEPROM) && !defined(CFG_BOND_STORAGE_FLASH) )
+  #error "Multiple bonding support requires EEPROM or CFG_BOND_STORAGE_FLASH!"
  #endif
 #endif // (HAS_MULTI_BOND)
 
@@ -290,8 +290,8 @@
 #endif // EEPROM_ON
 
 #if (HAS_MULTI_BOND)
- #if ( !(HAS_EEPROM) )
-  #error "Multiple bonding support requires EEPROM!"
+ #if ( !(HAS_EEPROM) && !defined(CFG_BOND_STORAGE_FLASH) )
+  #error "Multiple bonding support requires EEPROM or CFG_BOND_STORAGE_FLASH!"
  #endif
 #endif // (HAS_MULTI_BOND)
 
@@ -450,8 +450,8 @@
 #endif // EEPROM_ON
 
 #if (HAS_MULTI_BOND)
- #if ( !(HAS_EEPROM) )
-  #error "Multiple bonding support requires EEPROM!"
+ #if ( !(HAS_EEPROM) && !defined(CFG_BOND_STORAGE_FLASH) )
+  #error "Multiple bonding support requires EEPROM or CFG_BOND_STORAGE_FLASH!"
  #endif
 #endif // (HAS_MULTI_BOND)
 
@@ -543,8 +543,8 @@
 #endif // EEPROM_ON
 
 #if (HAS_MULTI_BOND)
- #if ( !(HAS_EEPROM) )
-  #error "Multiple bonding support requires EEPROM!"
+ #if ( !(HAS_EEPROM) && !defined(CFG_BOND_STORAGE_FLASH) )
+  #error "Multiple bonding support requires EEPROM or CFG_BOND_STORAGE_FLASH!"
  #endif
 #endif // (HAS_MULTI_BOND)
 
@@ -633,8 +633,8 @@
 #endif // EEPROM_ON
 
 #if (HAS_MULTI_BOND)
- #if ( !(HAS_EEPROM) )
-  #error "Multiple bonding support requires EEPROM!"
+ #if ( !(HAS_EEPROM) && !defined(CFG_BOND_STORAGE_FLASH) )
+  #error "Multiple bonding support requires EEPROM or CFG_BOND_STORAGE_FLASH!"
  #endif
 #endif // (HAS_MULTI_BOND)
 
@@ -737,8 +737,8 @@
 
 
 #if (HAS_MULTI_BOND)
- #if ( !(HAS_EEPROM) )
-  #error "Multiple bonding support requires EEPROM!"
+ #if ( !(HAS_EEPROM) && !defined(CFG_BOND_STORAGE_FLASH) )
+  #error "Multiple bonding support requires EEPROM or CFG_BOND_STORAGE_FLASH!"
  #endif
 #endif // (HAS_MULTI_BOND)
 
@@ -91,6 +91,16 @@ int keyboard_create_db_cfm_handler(ke_msg_id_t const msgid,
 		0x95, 0x01,         //  Report Count (1)
 		0x75, 0x03,         //  Report Size (3)
 		0x91, 0x01,         //  Output: (Constant); LED report padding
+#if (HAS_NKRO)
+		0x95, NKRO_USAGE_MAX + 1, //  Report Count (136)
+		0x75, 0x01,         //  Report Size (1)
+		0x15, 0x00,         //  Log Minimum (0)
+		0x25, 0x01,         //  Log Maximum (1)
+		0x05, 0x07,         //  Usage Page (Key Codes)
+		0x19, 0x00,         //  Usage Minimum (0)
+		0x29, NKRO_USAGE_MAX, //  Usage Maximum (135)
+		0x81, 0x02,         //  Input: (Data, Variable, Absolute) ; Key bitmap (17 bytes)
+#else
 		0x95, 0x06,         //  Report Count (6)
 		0x75, 0x08,         //  Report Size (8)
 		0x15, 0x00,         //  Log Minimum (0)
@@ -99,6 +109,7 @@ int keyboard_create_db_cfm_handler(ke_msg_id_t const msgid,
 		0x19, 0x00,         //  Usage Minimum (0)
 		0x29, 0x65,         //  Usage Maximum (101)
 		0x81, 0x00,         //  Input: (Data, Array) ; Key arrays (6 bytes)
+#endif
 		0xC0,               // End Collection
         0x05, 0x0C,         // Usage Page (Consumer Devices)
         0x09, 0x01,         // Usage (Consumer Control)
@@ -24,6 +24,10 @@
 #include "gpio.h"
 #include "uart.h"
 
+#if defined(CFG_NVDS_READ_WRITE)
+#include "spi_flash.h"
+#endif
+
 #include "app_kbd.h"
 #include "app_kbd_key_matrix.h"
 #include "app_kbd_scan_fsm.h"
@@ -163,6 +167,17 @@ void periph_init(void)
 	//Init pads
 	set_pad_functions();
 
+#if defined(CFG_NVDS_READ_WRITE)
+    // SPI flash of the NVDS log, the SPI registers are lost when the peripherals are powered down
+    {
+        SPI_Pad_t cs_pad = {SPI_FLASH_CS_PORT, SPI_FLASH_CS_PIN};
+
+        spi_init(&cs_pad, SPI_MODE_8BIT, SPI_ROLE_MASTER, SPI_CLK_IDLE_POL_LOW, SPI_PHA_MODE_0,
+                 SPI_MINT_DISABLE, SPI_XTAL_DIV_8);
+        spi_flash_init(SPI_FLASH_SIZE, SPI_FLASH_PAGE_SIZE);
+    }
+#endif
+
 #ifndef FPGA_USED
 	SetBits16(CLK_PER_REG, WAKEUPCT_ENABLE, 1); // enable clock of Wakeup Controller
     if (current_scan_state == KEY_SCAN_IDLE)
@@ -62,14 +62,18 @@
 #endif // HAS_EEPROM
 
 
-#if BLE_SPOTA_RECEIVER
+#if BLE_SPOTA_RECEIVER || defined(CFG_NVDS_READ_WRITE)
 /****************************************************************************************/ 
 /* SPI FLASH configuration                                                             */
 /****************************************************************************************/
 #define SPI_FLASH_SIZE      0x20000
 #define SPI_FLASH_PAGE_SIZE 0x100
 
-#endif // BLE_SPOTA_RECEIVER
+// Chip select of the flash holding the NVDS log (CFG_NVDS_READ_WRITE), see set_pad_functions()
+#define SPI_FLASH_CS_PORT   GPIO_PORT_1
+#define SPI_FLASH_CS_PIN    GPIO_PIN_0
+
+#endif // BLE_SPOTA_RECEIVER || CFG_NVDS_READ_WRITE
 
 /****************************************************************************************/ 
 /* Wkupct configuration                                                                 */
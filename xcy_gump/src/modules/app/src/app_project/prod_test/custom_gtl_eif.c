@@ -26,6 +26,7 @@
 #include "rwip_config.h"      // SW configuration
 
 #if (GTL_ITF)
+#include <string.h>
 #include "co_bt.h"            // BT standard definitions
 #include "co_endian.h"
 #include "co_utils.h"
@@ -87,6 +88,23 @@ extern uint16_t last_temp_count; /// temperature counter
 /// Transport layer synchronization pattern
 static const uint8_t gtl_sync_pattern[GTL_SYNC_PATTERN_SIZE] = "RW!";
 
+#if (GTL_BATCH)
+/// Batched kernel messages
+struct gtl_eif_batch_tag
+{
+    /// Batch frame being sent
+    uint8_t buf[GTL_BATCH_BUF_SIZE];
+    /// A message of a received batch is being received
+    bool rx_active;
+    /// Messages of the received batch not started yet
+    uint8_t rx_count;
+    /// Bytes of the received batch not started yet
+    uint16_t rx_len;
+};
+
+static struct gtl_eif_batch_tag gtl_eif_batch;
+#endif // GTL_BATCH
+
 
 /*
  * LOCAL FUNCTION DECLARATIONS
@@ -112,6 +130,12 @@ static void gtl_eif_rx_done(uint8_t status);
 */
 static void gtl_eif_read_start(void)
 {
+    #if (GTL_BATCH)
+    // A new packet ends the batch being received
+    gtl_eif_batch.rx_active = false;
+    gtl_eif_batch.rx_count = 0;
+    #endif // GTL_BATCH
+
     //Initialize external interface in reception mode state
     gtl_env.rx_state = GTL_STATE_RX_START;
 
@@ -165,6 +189,30 @@ static void gtl_eif_read_payl(uint16_t len, uint8_t* p_buf)
 }
 
 
+/**
+******************************************************************************************
+* @brief Local function : starts the reception of the next message of the batch being
+* received, or of a new packet.
+******************************************************************************************
+*/
+static void gtl_eif_read_next(void)
+{
+    #if (GTL_BATCH)
+    if (gtl_eif_batch.rx_count != 0)
+    {
+        gtl_eif_batch.rx_count--;
+        gtl_eif_batch.rx_active = true;
+
+        // The messages of a batch are kernel messages, without type byte
+        gtl_env.curr_msg_type = GTL_KE_MSG_TYPE;
+        gtl_eif_read_hdr(KE_MSG_HDR_LEN);
+        return;
+    }
+    #endif // GTL_BATCH
+
+    gtl_eif_read_start();
+}
+
 /**
 ******************************************************************************************
 * @brief Local function : places GTL EIF in RX_START_OUT_OF_SYNC state.
@@ -271,6 +319,83 @@ static void gtl_eif_tx_done(uint8_t status)
     #endif // DEEP_SLEEP
 }
 
+#if (GTL_BATCH)
+/**
+ ****************************************************************************************
+ * @brief Check if a message of the GTL TX queue is sent as a kernel message, and can be
+ * batched. gtl_send_msg() formats the messages of the controller tasks as HCI events.
+ *****************************************************************************************
+ */
+static bool gtl_eif_batch_msg(struct ke_msg const *msg)
+{
+    #if BLE_EMB_PRESENT
+    uint8_t src_type = KE_TYPE_GET(msg->src_id);
+
+    if ((src_type == TASK_LLM) || (src_type == TASK_LLC) || (src_type == TASK_LLD) || (src_type == TASK_DBG))
+    {
+        return false;
+    }
+    #endif //BLE_EMB_PRESENT
+
+    return true;
+}
+
+/**
+ ****************************************************************************************
+ * @brief Pack the kernel messages waiting in the GTL TX queue in a batch frame and send
+ * it. The messages are freed once copied, gtl_env.p_msg_tx is cleared. Called when the
+ * UART is free.
+ *
+ * @return false if the first message cannot be batched, nothing is sent
+ *****************************************************************************************
+ */
+static bool gtl_eif_batch_send(void)
+{
+    uint8_t *frame = gtl_eif_batch.buf;
+    uint16_t len = GTL_BATCH_HDR_LEN;
+    uint8_t count = 0;
+    struct ke_msg *msg;
+
+    while ((count < 0xFF) && ((msg = (struct ke_msg *) co_list_pick(&gtl_env.tx_queue)) != NULL))
+    {
+        uint16_t msg_len = KE_MSG_HDR_LEN + msg->param_len;
+
+        if ((len + msg_len > GTL_BATCH_BUF_SIZE) || !gtl_eif_batch_msg(msg))
+        {
+            break;
+        }
+
+        // The kernel message header (id, dest_id, src_id, param_len) precedes the parameters
+        co_list_pop_front(&gtl_env.tx_queue);
+        memcpy(&frame[len], &msg->id, msg_len);
+        ke_msg_free(msg);
+
+        len += msg_len;
+        count++;
+    }
+
+    if (count == 0)
+    {
+        return false;
+    }
+
+    frame[0] = GTL_BATCH_MSG_TYPE;
+    frame[1] = count;
+    co_write16p(&frame[2], co_htobs(len - GTL_BATCH_HDR_LEN));
+
+    // No message to free when the frame is sent
+    gtl_env.p_msg_tx = NULL;
+
+    #if (DEEP_SLEEP)
+    rwip_prevent_sleep_set(RW_GTL_TX_ONGOING);
+    #endif // DEEP_SLEEP
+
+    gtl_env.ext_if->write(frame, len, &gtl_eif_tx_done);
+
+    return true;
+}
+#endif // GTL_BATCH
+
 /**
  ****************************************************************************************
  * @brief Function called at each RX interrupt.
@@ -369,6 +494,15 @@ static void gtl_eif_rx_done(uint8_t status)
                 break;
                 #endif // BLE_APP_NEB
 
+                #if (GTL_BATCH)
+                case GTL_BATCH_MSG_TYPE:
+                {
+                    // Start batch header reception
+                    gtl_eif_read_hdr(GTL_BATCH_HDR_LEN - HCI_TRANSPORT_HDR_LEN);
+                }
+                break;
+                #endif // GTL_BATCH
+
                 default:
                 {
                     // Incorrect packet indicator -> enter in out of sync
@@ -430,6 +564,19 @@ static void gtl_eif_rx_done(uint8_t status)
                 {
                     struct gtl_kemsghdr * p_msg_hdr = (struct gtl_kemsghdr *) (&gtl_env.curr_hdr_buff[0]);
 
+                    #if (GTL_BATCH)
+                    if (gtl_eif_batch.rx_active)
+                    {
+                        // The message must fit in what is left of the batch
+                        if (KE_MSG_HDR_LEN + p_msg_hdr->param_len > gtl_eif_batch.rx_len)
+                        {
+                            gtl_eif_out_of_sync(0);
+                            break;
+                        }
+                        gtl_eif_batch.rx_len -= KE_MSG_HDR_LEN + p_msg_hdr->param_len;
+                    }
+                    #endif // GTL_BATCH
+
                     // Allocate the kernel message
                     gtl_env.p_msg_rx = ke_param2msg(ke_msg_alloc(p_msg_hdr->id,
                             p_msg_hdr->dest_id,
@@ -442,8 +589,8 @@ static void gtl_eif_rx_done(uint8_t status)
                         // Send message directly
                         ke_msg_send(ke_msg2param(gtl_env.p_msg_rx));
 
-                        // Restart a new packet reception
-                        gtl_eif_read_start();
+                        // Next message of the batch or new packet reception
+                        gtl_eif_read_next();
                     }
                     else
                     {
@@ -476,6 +623,18 @@ static void gtl_eif_rx_done(uint8_t status)
                 break;
                 #endif // BLE_APP_NEB
 
+                #if (GTL_BATCH)
+                case GTL_BATCH_MSG_TYPE:
+                {
+                    gtl_eif_batch.rx_count = gtl_env.curr_hdr_buff[0];
+                    gtl_eif_batch.rx_len = co_btohs(co_read16p(&gtl_env.curr_hdr_buff[1]));
+
+                    // First message of the batch (or new packet for an empty batch)
+                    gtl_eif_read_next();
+                }
+                break;
+                #endif // GTL_BATCH
+
                 default:
                 {
                     ASSERT_ERR(0);
@@ -534,8 +693,8 @@ static void gtl_eif_rx_done(uint8_t status)
                     // Send the kernel message
                     ke_msg_send(ke_msg2param(gtl_env.p_msg_rx));
 
-                    // Restart a new packet reception
-                    gtl_eif_read_start();
+                    // Next message of the batch or new packet reception
+                    gtl_eif_read_next();
                 }
                 break;
 
@@ -583,13 +742,25 @@ static void gtl_eif_tx_done_evt_handler(void)
     // Clear the event
     ke_event_clear(KE_EVENT_GTL_TX_DONE);
 
-
     // Free the kernel message space
+    #if (GTL_BATCH)
+    // (none after a batch frame)
+    if (gtl_env.p_msg_tx != NULL)
+    #endif // GTL_BATCH
     ke_msg_free(gtl_env.p_msg_tx);
 
     // check if there is something in TX queue
     if(! co_list_is_empty(&gtl_env.tx_queue))
     {
+        #if (GTL_BATCH)
+        // The ROM GTL task queues the messages while the UART is busy: when several are
+        // waiting, they are sent in a single frame
+        if ((gtl_env.tx_queue.first->next != NULL) && gtl_eif_batch_send())
+        {
+            return;
+        }
+        #endif // GTL_BATCH
+
         //extract the ke_msg pointer from the param passed and push it in GTL queue
         struct ke_msg *msg = (struct ke_msg *) co_list_pop_front(&gtl_env.tx_queue);
 
@@ -636,6 +807,10 @@ void gtl_eif_init_func(void)
     // Register GTL TX DONE kernel event
     ke_event_callback_set(KE_EVENT_GTL_TX_DONE, &gtl_eif_tx_done_evt_handler);
 
+    #if (GTL_BATCH)
+    memset(&gtl_eif_batch, 0, sizeof(gtl_eif_batch));
+    #endif // GTL_BATCH
+
     // Enable external interface
     gtl_env.ext_if->flow_on();
 
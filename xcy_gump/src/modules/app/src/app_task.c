@@ -327,6 +327,38 @@ int app_module_init_cmp_evt_handler(ke_msg_id_t const msgid,
     return (KE_MSG_CONSUMED);
 }
 
+#if (KE_MEM_STATS)
+int app_mem_stats_req_handler(ke_msg_id_t const msgid,
+                                     struct app_mem_stats_req const *param,
+                                     ke_task_id_t const dest_id,
+                                     ke_task_id_t const src_id)
+{
+    struct app_mem_stats_rsp *rsp;
+    uint8_t type;
+
+    // Inspect the heaps before the response is allocated, it is not part of the usage
+    // being reported, and bypass the accounting of KE_MSG_ALLOC() for the same reason
+    ke_mem_stats_update();
+
+    rsp = (struct app_mem_stats_rsp *) ke_msg_alloc(APP_MEM_STATS_RSP, src_id, TASK_APP,
+                                                   sizeof(struct app_mem_stats_rsp));
+
+    for (type = 0; type < KE_MEM_BLOCK_MAX; type++)
+    {
+        ke_mem_stats_get(type, &rsp->heap[type]);
+    }
+
+    if (param->reset)
+    {
+        ke_mem_stats_reset();
+    }
+
+    ke_msg_send(rsp);
+
+    return (KE_MSG_CONSUMED);
+}
+#endif //KE_MEM_STATS
+
 /*
  * GLOBAL VARIABLES DEFINITION
  ****************************************************************************************
@@ -337,6 +369,48 @@ int app_module_init_cmp_evt_handler(ke_msg_id_t const msgid,
 
 const struct ke_state_handler app_default_handler = KE_STATE_HANDLER(app_default_state);
 
+#if (KE_HANDLER_INDEX)
+/// Positions of the app_default_state entries sorted by message id
+static uint8_t app_default_order[sizeof(app_default_state) / sizeof(struct ke_msg_handler)];
+
+/// Index of app_default_state
+static struct ke_handler_index app_default_index;
+
+/**
+ ****************************************************************************************
+ * @brief Forwards all the messages of TASK_APP to their handler in app_default_state,
+ * found by binary search.
+ *
+ * @param[in] msgid     Id of the message received.
+ * @param[in] param     Pointer to the parameters of the message.
+ * @param[in] dest_id   ID of the receiving task instance (TASK_APP).
+ * @param[in] src_id    ID of the sending task instance.
+ *
+ * @return If the message was consumed or not.
+ ****************************************************************************************
+ */
+static int app_indexed_msg_handler(ke_msg_id_t const msgid,
+                                   void const *param,
+                                   ke_task_id_t const dest_id,
+                                   ke_task_id_t const src_id)
+{
+    return ke_handler_index_dispatch(&app_default_index, msgid, param, dest_id, src_id);
+}
+
+/* Matched at once by the scheduler of the ROM, which parses the tables linearly. */
+static const struct ke_msg_handler app_indexed_state[] =
+{
+    {KE_MSG_DEFAULT_HANDLER, (ke_msg_func_t)app_indexed_msg_handler},
+};
+
+const struct ke_state_handler app_indexed_handler = KE_STATE_HANDLER(app_indexed_state);
+
+void app_handler_index_init(void)
+{
+    ke_handler_index_init(&app_default_index, &app_default_handler, app_default_order);
+}
+#endif //KE_HANDLER_INDEX
+
 /* Defines the place holder for the states of all the task instances. */
 ke_state_t app_state[APP_IDX_MAX] __attribute__((section("retention_mem_area0"), zero_init)); //RETENTION MEMORY 
 
@@ -16,100 +16,161 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
  
 #include "app.h"
 #include "app_console.h"
 #include "arch_sleep.h"
 
-#include "ke_mem.h"
+#include "ke_mem_stats.h"
 
 #include "uart.h"
 
 #if defined (CFG_PRINTF)
 
-printf_msg *printf_msg_list __attribute__((section("retention_mem_area0"), zero_init));
-bool defer_sending __attribute__((section("retention_mem_area0"), zero_init));
-
-extern uint8_t func_check_mem_flag;
+// The console state is not retained: what is still in the ring when the system goes to
+// deep sleep is lost, the retention RAM is kept for the BLE and application state.
+
+/// Console ring (producers: arch_printf() from any context, consumer: UART TX interrupt).
+/// The indexes are updated with the interrupts disabled, the data is copied with them
+/// enabled: a producer reserves its bytes, copies them, then commits them.
+static uint8_t printf_ring[PRINTF_RING_SIZE];
+/// End of the data published to the consumer
+static volatile uint16_t printf_ring_head;
+/// End of the space reserved by the producers, the bytes from head are being copied
+static volatile uint16_t printf_ring_resv;
+/// Producers that reserved space and did not commit yet (nested by the interrupts)
+static volatile uint8_t printf_ring_writers;
+/// Next byte to send, moved by the consumer and by the producers when they drop the oldest bytes
+static volatile uint16_t printf_ring_rd;
+/// End of the free space, behind rd while the consumer copies a chunk
+static volatile uint16_t printf_ring_tail;
+/// The consumer copies the bytes from tail to rd
+static volatile bool printf_ring_reading;
+/// Number of messages dropped or truncated because the ring was full
+static uint32_t printf_ring_overflow;
+/// A UART transfer is ongoing
+static volatile bool printf_tx_active;
+/// Chunk handed over to the UART driver
+static uint8_t printf_tx_chunk[PRINTF_TX_CHUNK_SIZE];
 
 #define PRINT_SZ 256
 
+#define PRINTF_RING_MASK        (PRINTF_RING_SIZE - 1)
+// free running indexes, bytes waiting to be sent
+#define PRINTF_RING_USED()      ((uint16_t)(printf_ring_head - printf_ring_rd))
+// bytes not free: waiting, being copied by the producers or by the consumer
+#define PRINTF_RING_BUSY()      ((uint16_t)(printf_ring_resv - printf_ring_tail))
+
 
 /*
- * List management functions
+ * Ring management functions
  */
 
-// pull one from the beginning
-static printf_msg *remove_from_list(printf_msg **list)
-{
-	printf_msg *node = NULL;
-	
-	if (*list)
-    {	
-        node = *list;
-        *list = node->pNext;
-        node->pNext = NULL;
-    }
-	
-	return node;
-}
-	
-// push one at the end
-static int put_to_list(printf_msg **list, printf_msg *node)
+// copy at most max bytes of the oldest data to the TX chunk, called by the consumer
+static uint32_t ring_get_chunk(uint32_t max)
 {
-	printf_msg *p;
-	
-	if (!node)
-		return 0;
-	
-	if (!(*list))
-		*list = node;
-	else {
-		for (p = *list; p->pNext != NULL; p = p->pNext);
-		
-		p->pNext = node;
-		node->pNext = NULL;
-	}
-    
-	return 1;
-}
+    uint32_t len;
+    uint16_t rd;
+    uint32_t i;
 
+    // Take the bytes, they stay allocated until copied
+    GLOBAL_INT_DISABLE();
 
-/*
- * Message functions
- */
-static printf_msg* create_msg(uint32_t sz)
-{
-    printf_msg *node = (printf_msg *)ke_malloc(sizeof(printf_msg), KE_MEM_NON_RETENTION);
-    
-    if (!node)
-        return NULL;
-    
-    node->pBuf = (char *)ke_malloc(sz, KE_MEM_NON_RETENTION);
-    if (!node->pBuf) {
-        ke_free(node);
-        return NULL;
-    }
-    node->pNext = NULL;
-    
-    return node;
+    rd = printf_ring_rd;
+    len = PRINTF_RING_USED();
+    if (len > max)
+        len = max;
+
+    printf_ring_rd = rd + len;
+    printf_ring_reading = true;
+
+    GLOBAL_INT_RESTORE();
+
+    for (i = 0; i < len; i++)
+        printf_tx_chunk[i] = printf_ring[(rd + i) & PRINTF_RING_MASK];
+
+    // Release the bytes to the producers
+    GLOBAL_INT_DISABLE();
+
+    printf_ring_reading = false;
+    printf_ring_tail = printf_ring_rd;
+
+    GLOBAL_INT_RESTORE();
+
+    return len;
 }
 
-int delete_msg(printf_msg *node)
+// append len bytes, called by the producers
+static void ring_put(const char *data, uint32_t len)
 {
-    if (!node)
-        return 0;
+    uint16_t pos;
+    uint32_t room, first;
+
+    // arch_printf() may be called from the main loop and from interrupts: only the
+    // reservation is done with the interrupts disabled
+    GLOBAL_INT_DISABLE();
+
+    room = PRINTF_RING_SIZE - PRINTF_RING_BUSY();
+    if (len > room)
+    {
+        printf_ring_overflow++;
+
+#if (PRINTF_DROP_OLDEST)
+        // drop the oldest bytes waiting, not the ones of a chunk being copied
+        if (!printf_ring_reading)
+        {
+            uint32_t drop = PRINTF_RING_USED();
+
+            if (drop > len - room)
+                drop = len - room;
+
+            printf_ring_rd += drop;
+            printf_ring_tail = printf_ring_rd;
+            room += drop;
+        }
 
-    if (!node->pBuf)
-        __asm("BKPT #0\n");
-    
-    ke_free(node->pBuf);
-    ke_free(node);
-    
-    return 1;
+        if (len > room)
+        {
+            // keep the end of the message
+            data += len - room;
+            len = room;
+        }
+#elif (PRINTF_BINARY)
+        // drop the newest frame, a partial one would desynchronize the decoder
+        len = 0;
+#else
+        // drop the newest data
+        len = room;
+#endif
+    }
+
+    pos = printf_ring_resv;
+    printf_ring_resv = pos + len;
+    printf_ring_writers++;
+
+    GLOBAL_INT_RESTORE();
+
+    // at most two copies: up to the end of the ring, then from its start
+    first = PRINTF_RING_SIZE - (pos & PRINTF_RING_MASK);
+    if (first > len)
+        first = len;
+
+    memcpy(&printf_ring[pos & PRINTF_RING_MASK], data, first);
+    memcpy(&printf_ring[0], data + first, len - first);
+
+    GLOBAL_INT_DISABLE();
+
+    // Publish the data to the consumer when the outermost producer commits: the ones that
+    // interrupted it reserved after it and have committed already
+    if (--printf_ring_writers == 0)
+        printf_ring_head = printf_ring_resv;
+
+    GLOBAL_INT_RESTORE();
 }
 
 
+#if !(PRINTF_BINARY)
 /*
  * String manipulation functions
  */
@@ -311,62 +372,96 @@ static int32_t arch_snprintf(char* buffer, uint32_t buffer_len, const char *fmt,
     return ret;
 }
 
+#endif // !PRINTF_BINARY
+
+#if (PRINTF_BINARY)
+
+// nothing is formatted on target, only the raw arguments are sent
+
+void arch_trace_emit(const char *fmt, uint32_t nargs, ...)
+{
+    va_list args;
+    uint8_t frame[2 + 4 + 4 * PRINTF_TRACE_ARGS_MAX];
+    uint8_t *p = frame;
+    uint32_t val = (uint32_t)fmt;
+    uint32_t i;
+
+    *p++ = PRINTF_TRACE_SYNC;
+
+    if (nargs > PRINTF_TRACE_ARGS_MAX) {
+        // the decoder shows that the message is incomplete
+        nargs = PRINTF_TRACE_ARGS_MAX;
+        *p++ = (uint8_t)(nargs | PRINTF_TRACE_TRUNCATED);
+    } else {
+        *p++ = (uint8_t)nargs;
+    }
+
+    va_start(args, nargs);
+    for (i = 0; i <= nargs; i++) {
+        // the format address first, then the arguments (int, long and pointers are 32-bit)
+        if (i > 0)
+            val = va_arg(args, uint32_t);
+        *p++ = (uint8_t)val;
+        *p++ = (uint8_t)(val >> 8);
+        *p++ = (uint8_t)(val >> 16);
+        *p++ = (uint8_t)(val >> 24);
+    }
+    va_end(args);
+
+    ring_put((const char *)frame, p - frame);
+}
+
+void arch_puts(const char *s)
+{
+    uint8_t frame[2 + 255 + 1];
+    uint32_t len = 0;
+
+    // strings from RAM cannot be decoded later, they are sent as they are
+    while ((s[len] != '\0') && (len < 255)) {
+        frame[2 + len] = s[len];
+        len++;
+    }
+
+    frame[0] = PRINTF_TEXT_SYNC;
+    frame[1] = (uint8_t)len;
+    // lets the decoder tell a frame from a sync byte inside another frame
+    frame[2 + len] = '\0';
+
+    ring_put((const char *)frame, 2 + len + 1);
+}
+
+#endif // PRINTF_BINARY
+
 /* Note: App should not modify the sleep mode until all messages have been printed out */
 static void uart_callback(uint8_t res)
 {
-    printf_msg* msg = remove_from_list(&printf_msg_list);
-    delete_msg(msg);
-    
-    uart_finish_transfers();
-    
-    if (printf_msg_list) {
-        char *p = printf_msg_list->pBuf;
-        uart_write((uint8_t *)p, arch_strlen(p), uart_callback);
-    } else
+    uint32_t len;
+
+    // Chain the next chunk from the TX interrupt, the FIFO keeps the line busy
+    len = ring_get_chunk(PRINTF_TX_CHUNK_SIZE);
+    if (len) {
+        uart_write(printf_tx_chunk, len, uart_callback);
+    } else {
+        // Only the last chunk waits for the FIFO to empty, before the system may sleep
+        uart_finish_transfers();
+        printf_tx_active = false;
         app_restore_sleep_mode();
+    }
 }
 
+#if !(PRINTF_BINARY)
 int arch_printf(const char *fmt, ...)
 {
     va_list args;
     char my_buf[PRINT_SZ];
-    printf_msg* msg;
     uint32_t len;
     
-    // Check if heap is ready
-    if (func_check_mem_flag) {
-        // Heap is not ready => there's no memory to store the msg
-        // The msg is discarded!
-        return 0;
-    }
-
     va_start(args, fmt);
-    arch_snprintf(my_buf, sizeof(my_buf), fmt, args);
+    len = arch_snprintf(my_buf, sizeof(my_buf), fmt, args);
     va_end(args);
 
-    len = arch_strlen(my_buf);
-    msg = create_msg(len + 1);
-    if (msg) {
-        strcpy(msg->pBuf, my_buf);
-        
-        // Critical section
-        GLOBAL_INT_DISABLE();
-        
-        // if printf_msg_list is NULL we can send the msg immediately (in the synchrouns part of the loop), else 
-        // the callback function will handle it
-        if (printf_msg_list == NULL)
-            defer_sending = true;
-        
-        if (!put_to_list(&printf_msg_list, msg)) {
-            delete_msg(msg);
-            if (printf_msg_list == NULL)
-                defer_sending = false;
-        } else {
-            //send to UART only if XTAL16 is used else it crashes: defer_sending will trigger the procedure!
-        }
-        // End of critical section
-        GLOBAL_INT_RESTORE();
-    }
+    // Bounded copy, the transfer is started by arch_printf_process() (XTAL16 must be used)
+    ring_put(my_buf, len);
 
     return 1;
 }
@@ -376,13 +471,44 @@ void arch_puts(const char *s)
 {
     arch_printf("%s", s);
 }
+#endif // !PRINTF_BINARY
 
-void arch_printf_process(void)
+#if (KE_MEM_STATS)
+void arch_printf_mem_stats(void)
 {
-    if (defer_sending) {
-        app_force_active_mode();
-        uart_write((uint8_t *)printf_msg_list->pBuf, arch_strlen(printf_msg_list->pBuf), uart_callback);
-        defer_sending = false;
+    struct ke_mem_heap_stats stats;
+    uint8_t type;
+
+    ke_mem_stats_update();
+
+    arch_puts("heap  size  used  peak  maxfree  nfree  fail  msg  top\r\n");
+    for (type = 0; type < KE_MEM_BLOCK_MAX; type++)
+    {
+        ke_mem_stats_get(type, &stats);
+        arch_printf("%4d %5d %5d %5d %8d %6d %5d %4d  %d/%d\r\n", type, stats.heap_size,
+                    stats.used, stats.max_used, stats.max_free_blk, stats.free_blk_nb,
+                    stats.alloc_fail, stats.msg_bytes, stats.top_task, stats.top_task_bytes);
     }
 }
+#endif // KE_MEM_STATS
+
+uint32_t arch_printf_overflow_get(void)
+{
+    return printf_ring_overflow;
+}
+
+void arch_printf_process(void)
+{
+    uint32_t len;
+
+    if (printf_tx_active || (PRINTF_RING_USED() == 0))
+        return;
+
+    // Kept awake until the ring is empty, see uart_callback()
+    printf_tx_active = true;
+    app_force_active_mode();
+
+    len = ring_get_chunk(PRINTF_TX_CHUNK_SIZE);
+    uart_write(printf_tx_chunk, len, uart_callback);
+}
 #endif // CFG_PRINTF
@@ -23,11 +23,42 @@
 #if defined (CFG_PRINTF)
 
 #include <stdarg.h>
+#include <stdint.h>
 
-typedef struct __print_msg {
-	char *pBuf;
-	struct __print_msg *pNext;
-} printf_msg;
+/// Size of the console ring in bytes (power of 2)
+#ifdef CFG_PRINTF_RING_SIZE
+#define PRINTF_RING_SIZE            CFG_PRINTF_RING_SIZE
+#else
+#define PRINTF_RING_SIZE            (512)
+#endif
+
+/// Bytes copied from the ring for each UART transfer
+#define PRINTF_TX_CHUNK_SIZE        (32)
+
+/// Ring overflow policy: drop the oldest bytes (CFG_PRINTF_DROP_OLDEST) or the newest ones
+#ifdef CFG_PRINTF_DROP_OLDEST
+#define PRINTF_DROP_OLDEST          1
+#else
+#define PRINTF_DROP_OLDEST          0
+#endif
+
+/// Binary trace mode (CFG_PRINTF_BINARY): arch_printf() emits the address of its format
+/// string and its raw arguments, utilities/trace_decoder formats them on the host
+#ifdef CFG_PRINTF_BINARY
+#define PRINTF_BINARY               1
+#else
+#define PRINTF_BINARY               0
+#endif
+
+/// Binary trace frames: sync byte, then
+///  - TRACE: argument count (0..PRINTF_TRACE_ARGS_MAX, PRINTF_TRACE_TRUNCATED set if arguments
+///    were dropped), format address (4 bytes), arguments (4 bytes each)
+///  - TEXT: length (1 byte), characters, NUL terminator
+/// All the fields are little endian.
+#define PRINTF_TRACE_SYNC           (0xA5)
+#define PRINTF_TEXT_SYNC            (0xA6)
+#define PRINTF_TRACE_ARGS_MAX       (12)
+#define PRINTF_TRACE_TRUNCATED      (0x80)
 
 typedef enum {
    ST_INIT,
@@ -48,6 +79,33 @@ int arch_vprintf(const char *fmt, va_list args);
 
 int arch_printf(const char *fmt, ...);
 
+#if (PRINTF_BINARY)
+// Emit a TRACE frame, use arch_printf() rather than calling it directly
+void arch_trace_emit(const char *fmt, uint32_t nargs, ...);
+
+// Counts up to 16 arguments, the ones above PRINTF_TRACE_ARGS_MAX are dropped and flagged
+#define ARCH_TRACE_NARGS(args...)   ARCH_TRACE_NARGS_(0, ##args, 16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+#define ARCH_TRACE_NARGS_(_0, _1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, _13, _14, _15, _16, n, ...)   n
+
+// The format must be a string literal, it is only stored in the trace_fmt section of the
+// image. %s arguments are decoded only if they point to the image.
+#undef arch_printf
+#define arch_printf(fmt, args...)                                                           \
+    do {                                                                                    \
+        static const char trace_fmt[] __attribute__((section("trace_fmt"))) = fmt;          \
+        arch_trace_emit(trace_fmt, ARCH_TRACE_NARGS(args), ##args);                         \
+    } while (0)
+#endif // PRINTF_BINARY
+
+// Dump the heap statistics (CFG_KE_MEM_STATS)
+void arch_printf_mem_stats(void);
+
+// Start sending the console ring over the UART if idle, called from the main loop
+void arch_printf_process(void);
+
+// Number of messages dropped or truncated because the console ring was full
+uint32_t arch_printf_overflow_get(void);
+
 #ifndef putchar
 #define putchar(c)                              __putchar(c)
 #endif
@@ -57,6 +115,9 @@ int arch_printf(const char *fmt, ...);
 #define arch_puts(s) {}
 #define arch_vprintf(fmt, args) {}
 #define arch_printf(fmt, args...) {}
+#define arch_printf_mem_stats() {}
+#define arch_printf_process() {}
+#define arch_printf_overflow_get() (0)
     
 #endif // CFG_PRINTF
 
@@ -0,0 +1,587 @@
+/**
+****************************************************************************************
+*
+* @file app_db_image.c
+*
+* @brief Attribute database image.
+*
+* Copyright (C) 2013. Dialog Semiconductor Ltd, unpublished work. This computer
+* program includes Confidential, Proprietary Information and is a Trade Secret of
+* Dialog Semiconductor Ltd.  All use, disclosure, and/or reproduction is prohibited
+* unless authorized in writing. All Rights Reserved.
+*
+* <bluetooth.support@diasemi.com> and contributors.
+*
+****************************************************************************************
+*/
+
+/**
+ ****************************************************************************************
+ * @addtogroup APP
+ * @{
+ ****************************************************************************************
+ */
+
+
+/*
+ * INCLUDE FILES
+ ****************************************************************************************
+ */
+
+#include <stddef.h>                     // standard definitions
+#include <string.h>                     // string manipulation and functions
+
+#include "rwip_config.h"
+
+#if (BLE_APP_DB_IMAGE)
+
+#include "arch.h"                       // platform definitions
+#include "co_math.h"                    // co_min
+#include "ke_task.h"                    // kernel task
+#include "attm.h"                       // attribute manager
+#include "attm_db.h"                    // attribute database
+#include "nvds.h"                       // NVDS log
+#include "app_db_image.h"
+
+#if (BLE_DIS_SERVER)
+#include "diss.h"
+#endif
+
+#if (BLE_BATT_SERVER)
+#include "bass.h"
+#endif
+
+#if (BLE_HID_DEVICE)
+#include "hogpd.h"
+#endif
+
+#if (BLE_SPOTA_RECEIVER)
+#include "spotar.h"
+#endif
+
+#if (NVDS_READ_WRITE == 0)
+#error "CFG_APP_DB_IMAGE needs CFG_NVDS_READ_WRITE"
+#endif
+
+
+/*
+ * DEFINES
+ ****************************************************************************************
+ */
+
+/// Image signature ("ADBI")
+#define APP_DB_IMAGE_MAGIC          (0x41444249)
+
+/*
+ * TYPE DEFINITIONS
+ ****************************************************************************************
+ */
+
+/// Header of the image (TAG NVDS_TAG_APP_DB_IMAGE_FIRST), the service records and the
+/// profile task records follow in the chunks
+struct app_db_image_hdr
+{
+    /// APP_DB_IMAGE_MAGIC when the image is valid
+    uint32_t magic;
+    /// Number of bytes in the chunks
+    uint16_t len;
+    /// Checksum of the bytes in the chunks
+    uint16_t checksum;
+    /// First handle of the application services
+    uint16_t first_hdl;
+    /// Number of services
+    uint8_t nb_svc;
+    /// Number of profile tasks
+    uint8_t nb_env;
+    /// Size of the profile task records
+    uint16_t env_size;
+    /// APP_DB_IMAGE_VERSION of the firmware that saved the image
+    uint16_t version;
+};
+
+/// Service record, followed by nb_att attribute records
+struct app_db_image_svc
+{
+    /// Start handle
+    uint16_t start_hdl;
+    /// Task that manages the service
+    uint16_t task_id;
+    /// Total payload size (sum of the maximum lengths)
+    uint16_t total_size;
+    /// Number of attributes using 16, 32 and 128 bits UUIDs
+    uint8_t nb_att_uuid[3];
+    /// Service permission
+    uint8_t perm;
+};
+
+/// Attribute record, followed by the UUID and the value
+struct app_db_image_att
+{
+    /// Attribute permission
+    uint16_t perm;
+    /// Maximum length of the value
+    uint16_t max_length;
+    /// Current length of the value
+    uint16_t length;
+    /// UUID length
+    uint8_t uuid_len;
+};
+
+/// Profile task kept with the services it created
+struct app_db_image_env
+{
+    /// Profile task
+    ke_task_id_t task;
+    /// Environment of the task
+    void *env;
+    /// Size of the environment
+    uint16_t size;
+};
+
+/// Chunk of the image being written or read, the records may span two chunks
+struct app_db_image_io
+{
+    /// Chunk content
+    uint8_t buf[APP_DB_IMAGE_CHUNK_SIZE];
+    /// Position in buf
+    uint8_t pos;
+    /// Bytes in buf (read)
+    uint8_t len;
+    /// Index of the next chunk
+    uint8_t chunk;
+    /// Size pass: the chunks are not written
+    bool dry;
+    /// Image too big, truncated or flash error
+    bool error;
+    /// Bytes written or read
+    uint16_t total;
+    /// Fletcher-16 sums of these bytes
+    uint16_t sum1, sum2;
+};
+
+/*
+ * LOCAL VARIABLES
+ ****************************************************************************************
+ */
+
+/// Profile tasks, the records follow the services in this order (task state, environment)
+static const struct app_db_image_env app_db_image_envs[] =
+{
+#if (BLE_DIS_SERVER)
+    {TASK_DISS,     &diss_env,      sizeof(diss_env)},
+#endif
+#if (BLE_BATT_SERVER)
+    {TASK_BASS,     &bass_env,      sizeof(bass_env)},
+#endif
+#if (BLE_HID_DEVICE)
+    {TASK_HOGPD,    &hogpd_env,     sizeof(hogpd_env)},
+#endif
+#if (BLE_SPOTA_RECEIVER)
+    {TASK_SPOTAR,   &spotar_env,    sizeof(spotar_env)},
+#endif
+    {TASK_NONE,     NULL,           0},
+};
+
+/// First free handle before the application services are added
+static uint16_t app_db_image_first_hdl;
+
+/*
+ * LOCAL FUNCTION DEFINITIONS
+ ****************************************************************************************
+ */
+
+static void app_db_image_io_init(struct app_db_image_io *io, bool dry)
+{
+    io->pos = 0;
+    io->len = 0;
+    io->chunk = 0;
+    io->dry = dry;
+    io->error = false;
+    io->total = 0;
+    io->sum1 = 0;
+    io->sum2 = 0;
+}
+
+/// Fletcher-16 checksum of the bytes written or read
+static uint16_t app_db_image_checksum(struct app_db_image_io const *io)
+{
+    return (io->sum2 << 8) | io->sum1;
+}
+
+static void app_db_image_sum(struct app_db_image_io *io, uint8_t const *data, uint16_t len)
+{
+    uint16_t i;
+
+    for (i = 0; i < len; i++)
+    {
+        io->sum1 = (io->sum1 + data[i]) % 255;
+        io->sum2 = (io->sum2 + io->sum1) % 255;
+    }
+
+    io->total += len;
+}
+
+/// Write the chunk filled so far
+static void app_db_image_flush(struct app_db_image_io *io)
+{
+    if (io->error || (io->pos == 0))
+        return;
+
+    if (io->chunk >= APP_DB_IMAGE_NB_CHUNK)
+    {
+        io->error = true;
+        return;
+    }
+
+    if (!io->dry
+        && (nvds_put(NVDS_TAG_APP_DB_IMAGE_FIRST + 1 + io->chunk, io->pos, io->buf) != NVDS_OK))
+    {
+        io->error = true;
+        return;
+    }
+
+    io->chunk++;
+    io->pos = 0;
+}
+
+/// Append bytes to the image, false if they do not fit or cannot be written
+static bool app_db_image_put(struct app_db_image_io *io, void const *data, uint16_t len)
+{
+    uint8_t const *src = data;
+
+    while ((len != 0) && !io->error)
+    {
+        uint16_t n = co_min(len, APP_DB_IMAGE_CHUNK_SIZE - io->pos);
+
+        memcpy(&io->buf[io->pos], src, n);
+        app_db_image_sum(io, src, n);
+        io->pos += n;
+        src += n;
+        len -= n;
+
+        if (io->pos == APP_DB_IMAGE_CHUNK_SIZE)
+        {
+            app_db_image_flush(io);
+        }
+    }
+
+    return !io->error;
+}
+
+/// Read the next chunk once the current one is consumed, false if there is none
+static bool app_db_image_fill(struct app_db_image_io *io)
+{
+    nvds_tag_len_t len = APP_DB_IMAGE_CHUNK_SIZE;
+
+    if (io->error || (io->pos < io->len))
+        return !io->error;
+
+    if ((io->chunk >= APP_DB_IMAGE_NB_CHUNK)
+        || (nvds_flash_get(NVDS_TAG_APP_DB_IMAGE_FIRST + 1 + io->chunk, &len, io->buf) != NVDS_OK)
+        || (len == 0))
+    {
+        io->error = true;
+        return false;
+    }
+
+    io->chunk++;
+    io->pos = 0;
+    io->len = len;
+
+    return true;
+}
+
+/// Read bytes from the image (the records are not aligned), data NULL skips them
+static bool app_db_image_get(struct app_db_image_io *io, void *data, uint16_t len)
+{
+    uint8_t *dst = data;
+
+    while ((len != 0) && app_db_image_fill(io))
+    {
+        uint16_t n = co_min(len, io->len - io->pos);
+
+        if (dst != NULL)
+        {
+            memcpy(dst, &io->buf[io->pos], n);
+            dst += n;
+        }
+        app_db_image_sum(io, &io->buf[io->pos], n);
+        io->pos += n;
+        len -= n;
+    }
+
+    return !io->error;
+}
+
+/// Read the value of an attribute from the image into the database
+static uint8_t app_db_image_get_value(struct app_db_image_io *io, uint16_t hdl, uint16_t len)
+{
+    uint16_t offset = 0;
+    uint8_t status = ATT_ERR_NO_ERROR;
+
+    while ((offset < len) && (status == ATT_ERR_NO_ERROR))
+    {
+        uint16_t n;
+
+        if (!app_db_image_fill(io))
+            return ATT_ERR_INVALID_ATTRIBUTE_VAL_LEN;
+
+        n = co_min(len - offset, io->len - io->pos);
+
+        status = attmdb_att_update_value(hdl, n, offset, &io->buf[io->pos]);
+        app_db_image_sum(io, &io->buf[io->pos], n);
+        io->pos += n;
+        offset += n;
+    }
+
+    return status;
+}
+
+/// Save one service and its attributes
+static bool app_db_image_save_svc(struct app_db_image_io *io, struct attm_svc_db const *svc)
+{
+    struct app_db_image_svc rec;
+    struct app_db_image_att att;
+    uint8_t uuid[ATT_UUID_128_LEN];
+    uint8_t *value;
+    uint16_t hdl;
+
+    memset(&rec, 0, sizeof(rec));
+    rec.start_hdl = svc->start_hdl;
+    rec.task_id = svc->task_id;
+    rec.perm = svc->perm;
+
+    // The record precedes the attributes in the chunks, count them first
+    for (hdl = svc->start_hdl; hdl <= svc->last_hdl; hdl++)
+    {
+        struct attm_elmt *elmt = attmdb_get_attribute(hdl);
+
+        if ((elmt == NULL)
+            || (attmdb_att_get_uuid(hdl, &att.uuid_len, uuid) != ATT_ERR_NO_ERROR))
+            return false;
+
+        switch (att.uuid_len)
+        {
+            case ATT_UUID_16_LEN:  rec.nb_att_uuid[0]++; break;
+            case ATT_UUID_32_LEN:  rec.nb_att_uuid[1]++; break;
+            case ATT_UUID_128_LEN: rec.nb_att_uuid[2]++; break;
+            default: return false;
+        }
+        rec.total_size += ATTM_GET_MAX_LENGTH(elmt);
+    }
+
+    if (!app_db_image_put(io, &rec, sizeof(rec)))
+        return false;
+
+    for (hdl = svc->start_hdl; hdl <= svc->last_hdl; hdl++)
+    {
+        struct attm_elmt *elmt = attmdb_get_attribute(hdl);
+
+        if ((attmdb_att_get_uuid(hdl, &att.uuid_len, uuid) != ATT_ERR_NO_ERROR)
+            || (attmdb_att_get_value(hdl, &att.length, &value) != ATT_ERR_NO_ERROR))
+            return false;
+
+        att.perm = elmt->perm;
+        att.max_length = ATTM_GET_MAX_LENGTH(elmt);
+
+        if (!app_db_image_put(io, &att, sizeof(att))
+            || !app_db_image_put(io, uuid, att.uuid_len)
+            || !app_db_image_put(io, value, att.length))
+            return false;
+    }
+
+    return true;
+}
+
+/// Rebuild one service and its attributes
+static uint8_t app_db_image_restore_svc(struct app_db_image_io *io)
+{
+    struct app_db_image_svc rec;
+    struct app_db_image_att att;
+    uint8_t uuid[ATT_UUID_128_LEN];
+    uint16_t start_hdl, hdl;
+    uint8_t i, nb_att;
+    uint8_t status;
+
+    if (!app_db_image_get(io, &rec, sizeof(rec)))
+        return ATT_ERR_INVALID_HANDLE;
+
+    // Same handles as when the services were created, the peers may have cached them
+    start_hdl = rec.start_hdl;
+    status = attmdb_add_service(&start_hdl, rec.task_id, rec.nb_att_uuid[0], rec.nb_att_uuid[1],
+                                rec.nb_att_uuid[2], rec.total_size);
+
+    nb_att = rec.nb_att_uuid[0] + rec.nb_att_uuid[1] + rec.nb_att_uuid[2];
+
+    for (i = 0; (i < nb_att) && (status == ATT_ERR_NO_ERROR); i++)
+    {
+        if (!app_db_image_get(io, &att, sizeof(att))
+            || (att.uuid_len > sizeof(uuid))
+            || !app_db_image_get(io, uuid, att.uuid_len))
+            return ATT_ERR_INVALID_HANDLE;
+
+        status = attmdb_add_attribute(start_hdl, att.max_length, att.uuid_len, uuid, att.perm, &hdl);
+
+        if (status == ATT_ERR_NO_ERROR)
+        {
+            status = app_db_image_get_value(io, hdl, att.length);
+        }
+    }
+
+    if (status == ATT_ERR_NO_ERROR)
+    {
+        status = attmdb_svc_set_permission(start_hdl, rec.perm);
+    }
+
+    return status;
+}
+
+/// Serialise the application services and the profile tasks
+static bool app_db_image_write(struct app_db_image_io *io, struct app_db_image_hdr *hdr)
+{
+    struct attm_svc_db *svc;
+    const struct app_db_image_env *p;
+
+    memset(hdr, 0, sizeof(*hdr));
+
+    for (svc = attm_env.db; svc != NULL; svc = svc->next_db)
+    {
+        if (svc->start_hdl < app_db_image_first_hdl)
+            continue;
+
+        if (!app_db_image_save_svc(io, svc))
+            return false;
+
+        hdr->nb_svc++;
+    }
+
+    for (p = app_db_image_envs; p->env != NULL; p++)
+    {
+        ke_state_t state = ke_state_get(p->task);
+
+        if (!app_db_image_put(io, &state, sizeof(state))
+            || !app_db_image_put(io, p->env, p->size))
+            return false;
+
+        hdr->nb_env++;
+        hdr->env_size += sizeof(state) + p->size;
+    }
+
+    app_db_image_flush(io);
+
+    hdr->len = io->total;
+    hdr->checksum = app_db_image_checksum(io);
+    hdr->first_hdl = app_db_image_first_hdl;
+    hdr->version = APP_DB_IMAGE_VERSION;
+
+    return !io->error;
+}
+
+/*
+ * EXPORTED FUNCTION DEFINITIONS
+ ****************************************************************************************
+ */
+
+void app_db_image_start(void)
+{
+    struct attm_svc_db *svc;
+
+    app_db_image_first_hdl = 1;
+
+    for (svc = attm_env.db; svc != NULL; svc = svc->next_db)
+    {
+        if (svc->last_hdl >= app_db_image_first_hdl)
+            app_db_image_first_hdl = svc->last_hdl + 1;
+    }
+}
+
+bool app_db_image_restore(void)
+{
+    struct app_db_image_hdr hdr;
+    struct app_db_image_io io;
+    nvds_tag_len_t len = sizeof(hdr);
+    uint8_t i;
+    uint16_t env_size = 0;
+    const struct app_db_image_env *p;
+
+    if ((nvds_flash_get(NVDS_TAG_APP_DB_IMAGE_FIRST, &len, (uint8_t *)&hdr) != NVDS_OK)
+        || (len != sizeof(hdr))
+        || (hdr.magic != APP_DB_IMAGE_MAGIC)
+        || (hdr.version != APP_DB_IMAGE_VERSION)
+        || (hdr.len > APP_DB_IMAGE_SIZE))
+        return false;
+
+    // Same profile tasks
+    for (i = 0, p = app_db_image_envs; p->env != NULL; p++)
+    {
+        i++;
+        env_size += sizeof(ke_state_t) + p->size;
+    }
+    if ((i != hdr.nb_env) || (env_size != hdr.env_size))
+        return false;
+
+    // The services created before (GAP, GATT) must end where the image starts
+    app_db_image_start();
+    if (app_db_image_first_hdl != hdr.first_hdl)
+        return false;
+
+    // Check all the chunks before the database is touched
+    app_db_image_io_init(&io, false);
+    if (!app_db_image_get(&io, NULL, hdr.len) || (app_db_image_checksum(&io) != hdr.checksum))
+        return false;
+
+    app_db_image_io_init(&io, false);
+
+    for (i = 0; i < hdr.nb_svc; i++)
+    {
+        if (app_db_image_restore_svc(&io) != ATT_ERR_NO_ERROR)
+        {
+            // The database is incomplete, the image does not match this firmware
+            app_db_image_clear();
+            ASSERT_ERR(0);
+            return false;
+        }
+    }
+
+    for (p = app_db_image_envs; p->env != NULL; p++)
+    {
+        ke_state_t state;
+
+        app_db_image_get(&io, &state, sizeof(state));
+        app_db_image_get(&io, p->env, p->size);
+        ke_state_set(p->task, state);
+    }
+
+    return true;
+}
+
+void app_db_image_save(void)
+{
+    struct app_db_image_hdr hdr;
+    struct app_db_image_io io;
+
+    // The chunks of the previous image are overwritten, invalidate it first
+    app_db_image_clear();
+
+    // Too big for the image: nothing is written, the services are created at each boot
+    app_db_image_io_init(&io, true);
+    if (!app_db_image_write(&io, &hdr))
+        return;
+
+    app_db_image_io_init(&io, false);
+    if (!app_db_image_write(&io, &hdr))
+        return;
+
+    // The header is written last, a power failure before leaves no valid image
+    hdr.magic = APP_DB_IMAGE_MAGIC;
+    nvds_put(NVDS_TAG_APP_DB_IMAGE_FIRST, sizeof(hdr), (uint8_t *)&hdr);
+}
+
+void app_db_image_clear(void)
+{
+    nvds_del(NVDS_TAG_APP_DB_IMAGE_FIRST);
+}
+
+#endif // BLE_APP_DB_IMAGE
+
+/// @} APP
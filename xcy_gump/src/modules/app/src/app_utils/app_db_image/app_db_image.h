@@ -0,0 +1,121 @@
+/**
+****************************************************************************************
+*
+* @file app_db_image.h
+*
+* @brief Attribute database image header file.
+*
+* Copyright (C) 2013. Dialog Semiconductor Ltd, unpublished work. This computer
+* program includes Confidential, Proprietary Information and is a Trade Secret of
+* Dialog Semiconductor Ltd.  All use, disclosure, and/or reproduction is prohibited
+* unless authorized in writing. All Rights Reserved.
+*
+* <bluetooth.support@diasemi.com> and contributors.
+*
+****************************************************************************************
+*/
+
+#ifndef APP_DB_IMAGE_H_
+#define APP_DB_IMAGE_H_
+
+/*
+ * USAGE
+ *
+ * With CFG_APP_DB_IMAGE, the services added by app_db_init_func() are created one by one
+ * (one *_CREATE_DB_REQ / APP_MODULE_INIT_CMP_EVT exchange per profile) only once. The
+ * complete result is then saved in the NVDS log in SPI flash: for each service its
+ * handles, task and permission, for each attribute its UUID, permission, maximum length
+ * and value, and the environment and state of the profile tasks. The next time
+ * app_db_init() runs (reset or power-up, SystemInit() clears the retention RAM) the
+ * database is rebuilt from the image with direct calls to ATTM DB and the application
+ * starts at once, at the same handles.
+ *
+ * Needs CFG_NVDS_READ_WRITE. The image is split in chunks of APP_DB_IMAGE_CHUNK_SIZE
+ * bytes, one per NVDS TAG (the length of a TAG is 8 bits), the TAG
+ * NVDS_TAG_APP_DB_IMAGE_FIRST holds the header and is written last. If the database
+ * does not fit in APP_DB_IMAGE_SIZE bytes, no image is kept and the services are created
+ * at each boot.
+ *
+ * Optional:
+ *     CFG_APP_DB_IMAGE_VERSION : version of the database content (0 by default), saved
+ *         in the image. The image survives a firmware update: the firmware that changes
+ *         the content of the database (attribute values, new characteristics) must
+ *         change it, an image of another version is not used.
+ *
+ * The image holds the values of the attributes at the end of the database creation,
+ * the values written later are not saved. app_db_image_clear() forces a new creation.
+ ****************************************************************************************
+ */
+
+
+/*
+ * INCLUDE FILES
+ ****************************************************************************************
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include "rwip_config.h"
+
+#if (BLE_APP_DB_IMAGE)
+
+#include "nvds.h"
+
+/*
+ * DEFINES
+ ****************************************************************************************
+ */
+
+/// Bytes of the image in each NVDS TAG
+#define APP_DB_IMAGE_CHUNK_SIZE     (128)
+
+/// Number of chunks (the first TAG holds the header)
+#define APP_DB_IMAGE_NB_CHUNK       (NVDS_TAG_APP_DB_IMAGE_LAST - NVDS_TAG_APP_DB_IMAGE_FIRST)
+
+/// Maximum size of the image
+#define APP_DB_IMAGE_SIZE           (APP_DB_IMAGE_NB_CHUNK * APP_DB_IMAGE_CHUNK_SIZE)
+
+#ifdef CFG_APP_DB_IMAGE_VERSION
+#define APP_DB_IMAGE_VERSION        (CFG_APP_DB_IMAGE_VERSION)
+#else
+#define APP_DB_IMAGE_VERSION        (0)
+#endif
+
+/*
+ * FUNCTION DECLARATIONS
+ ****************************************************************************************
+ */
+
+/**
+ ****************************************************************************************
+ * @brief Mark the beginning of the application services: the services already in the
+ * database (GAP, GATT) are not part of the image.
+ ****************************************************************************************
+ */
+void app_db_image_start(void);
+
+/**
+ ****************************************************************************************
+ * @brief Rebuild the application services and the profile tasks from the image.
+ *
+ * @return true if the database is complete, false if there is no valid image
+ ****************************************************************************************
+ */
+bool app_db_image_restore(void);
+
+/**
+ ****************************************************************************************
+ * @brief Save the application services and the profile tasks in the image.
+ ****************************************************************************************
+ */
+void app_db_image_save(void);
+
+/**
+ ****************************************************************************************
+ * @brief Invalidate the image, the services are created again at the next boot.
+ ****************************************************************************************
+ */
+void app_db_image_clear(void);
+
+#endif // BLE_APP_DB_IMAGE
+
+#endif // APP_DB_IMAGE_H_
@@ -28,6 +28,7 @@
  ****************************************************************************************
  */
 
+#include <stddef.h>                     // standard definitions
 #include <string.h>                     // string manipulation and functions
 
 #include "app.h"                        // application definitions
@@ -44,6 +45,15 @@
 #include "app_multi_bond.h"
 #include "i2c_eeprom.h"
 #include "periph_setup.h"
+#include "i2c_eeprom_async.h"
+
+#if (BOND_STORAGE_FLASH)
+#include "nvds.h"
+
+#if !(NVDS_READ_WRITE)
+ #error "CFG_BOND_STORAGE_FLASH requires CFG_NVDS_READ_WRITE!"
+#endif
+#endif
 
 #if (BLE_APP_KEYBOARD)
 #include "app_kbd.h"
@@ -53,7 +63,7 @@
 
 #if (BLE_APP_PRESENT)
 
-uint8_t multi_bond_status                   __attribute__((section("retention_mem_area0"), zero_init));
+uint32_t multi_bond_status                  __attribute__((section("retention_mem_area0"), zero_init));
 uint8_t multi_bond_enabled                  __attribute__((section("retention_mem_area0"), zero_init)); 
 static uint8_t multi_bond_active_peer_pos   __attribute__((section("retention_mem_area0"), zero_init)); 
 static uint8_t multi_bond_next_peer_pos     __attribute__((section("retention_mem_area0"), zero_init)); 
@@ -115,90 +125,603 @@ bool app_alt_pair_check_peer(struct bd_addr *peer_addr, uint8_t peer_addr_type)
 }
 
 
+/*
+ * Bond storage
+ *
+ * I2C EEPROM (default):
+ *     EEPROM_BONDING_STATUS_ADDR   multi_bond_status
+ *     EEPROM_BOND_DATA_ADDR        MAX_BOND_PEER x struct app_sec_env_tag
+ *     BOND_INDEX_ADDR              bond index block, if the EEPROM is large enough for it
+ *
+ * SPI flash (CFG_BOND_STORAGE_FLASH), in the NVDS log (nvds_put()), BLE link key TAGs:
+ *     BOND_TAG_INDEX               bond index block
+ *     BOND_TAG_SLOT + slot         struct app_sec_env_tag
+ * multi_bond_status is not stored, it is rebuilt from the bond index. The NVDS log must
+ * have been mounted with nvds_flash_init().
+ */
+
+#define HAS_BOND_STORAGE            (HAS_EEPROM || BOND_STORAGE_FLASH)
+
+/// End of the bonds in the EEPROM
+#define BOND_DATA_END               (EEPROM_BOND_DATA_ADDR + MAX_BOND_PEER * sizeof(struct app_sec_env_tag))
+
+/// Bond index block in the EEPROM
+#define BOND_INDEX_ADDR             (BOND_DATA_END)
+#define BOND_INDEX_STORED           (BOND_INDEX_ADDR + sizeof(struct bond_index_block) <= I2C_EEPROM_SIZE)
+
+#if (HAS_EEPROM) && !(BOND_STORAGE_FLASH)
+// MAX_BOND_PEER bonds must fit in the EEPROM (BOND_DATA_END uses sizeof, out of reach of #if)
+typedef char bond_data_fits_in_eeprom[(BOND_DATA_END <= I2C_EEPROM_SIZE) ? 1 : -1];
+#endif
+
+/// Bits of multi_bond_status that can be set
+#define BOND_STATUS_MASK            (0xFFFFFFFFUL >> (32 - MAX_BOND_PEER))
+
+/// NVDS TAGs of the bond index block and of the bonds
+#define BOND_TAG_INDEX              (NVDS_TAG_BLE_LINK_KEY_FIRST)
+#define BOND_TAG_SLOT               (NVDS_TAG_BLE_LINK_KEY_FIRST + 1)
+
+
+/*
+ * Bond index
+ *
+ * One entry per slot, read with a single access from the bond index block (or built with
+ * a pass over the bonds if there's none) and kept up to date by the writes. The lookups
+ * only read the record of the candidate slot, to check the fields that are hashed in the
+ * index. The entries are written after the record, an interrupted write leaves a stale
+ * entry that no lookup can match (the peer pairs again).
+ *
+ * seq orders the slots by last use, the least recently used bond is evicted when all the
+ * slots are taken.
+ */
+
+/// The slot holds a bond
+#define BOND_INDEX_BONDED           (0x01)
+/// The peer of the slot uses a public address
+#define BOND_INDEX_PUBLIC           (0x02)
+
+/// Bond index block header
+#define BOND_INDEX_MAGIC            (0xB14D)
+
+/// bond_index_store(): all the entries
+#define BOND_INDEX_ALL              (MAX_BOND_PEER)
+
+/// Bond index entry
+struct bond_index_entry
+{
+    /// EDIV
+    uint16_t ediv;
+    /// Last use (bond_seq), 0 if never used since the index was built
+    uint16_t seq;
+    /// Hash of the random number
+    uint8_t rand_hash;
+    /// Hash of the peer address and address type
+    uint8_t addr_hash;
+    /// BOND_INDEX_BONDED, BOND_INDEX_PUBLIC
+    uint8_t flags;
+    /// Reserved
+    uint8_t reserved;
+};
+
+/// Bond index block, as stored
+struct bond_index_block
+{
+    /// BOND_INDEX_MAGIC
+    uint16_t magic;
+    /// MAX_BOND_PEER of the firmware that wrote it
+    uint8_t peers;
+    /// Reserved
+    uint8_t reserved;
+    /// Entries
+    struct bond_index_entry entry[MAX_BOND_PEER];
+};
+
+static struct bond_index_block bond_index                   __attribute__((section("retention_mem_area0"), zero_init));
+static bool bond_index_valid                                __attribute__((section("retention_mem_area0"), zero_init));
+/// Highest seq in use
+static uint16_t bond_seq                                    __attribute__((section("retention_mem_area0"), zero_init));
+
+
+#if !(BOND_STORAGE_FLASH)
+#if (I2C_EEPROM_ASYNC)
+/// Copy of the data of a queued write: a record, an index entry or the status
+union bond_stage
+{
+    struct app_sec_env_tag sec_env;
+    struct bond_index_entry entry;
+    uint32_t status;
+};
+
+/// One copy per write in flight, the sources (app_sec_env, bond_index, multi_bond_status)
+/// may change before the writes are done. Released in order by the completion callbacks.
+static union bond_stage bond_stage[I2C_EEPROM_ASYNC_QUEUE_SIZE];
+/// Oldest copy in flight
+static uint8_t bond_stage_first;
+/// Copies in flight
+static uint8_t bond_stage_count;
+
+
+static void bond_stage_release(int32_t status)
+{
+    bond_stage_first = (bond_stage_first + 1) % I2C_EEPROM_ASYNC_QUEUE_SIZE;
+    bond_stage_count--;
+
+    // the EEPROM no longer matches the bond index, read it again at the next use
+    if (status < 0)
+        bond_index_valid = false;
+}
+
+
+// Run the queued operations, a write that failed invalidates the bond index
+static void bond_eeprom_flush(void)
+{
+    if (i2c_eeprom_async_flush() != I2C_EEPROM_ASYNC_OK)
+        bond_index_valid = false;
+}
+#endif
+
+
+static int bond_slot_addr(uint32_t slot)
+{
+    return EEPROM_BOND_DATA_ADDR + slot * sizeof(struct app_sec_env_tag);
+}
+
+
+// False if the EEPROM did not respond, the data is then all-zero (a slot never written)
+static bool bond_eeprom_read(void *data, uint32_t address, uint32_t size)
+{
+    bool ok;
+    
+#if (I2C_EEPROM_ASYNC)
+    // Queued after the pending writes and received by the interrupt, the interrupts stay
+    // enabled. The bond API is synchronous (the keys are returned to the LTK request
+    // handler), the caller still waits for the data
+    while (i2c_eeprom_async_read( (uint8_t *) data, address, size, NULL) != I2C_EEPROM_ASYNC_OK)
+        bond_eeprom_flush();
+    ok = (i2c_eeprom_async_flush() == I2C_EEPROM_ASYNC_OK);
+#else
+    ok = (i2c_eeprom_read_data( (uint8_t *) data, address, size) == size);
+#endif
+    
+    // a buffer the read did not fill must not be taken for keys
+    if (!ok)
+        memset(data, 0, size);
+    
+    return ok;
+}
+
+
+// The data can be changed on return
+static void bond_eeprom_write(const void *data, uint32_t address, uint32_t size)
+{
+#if (I2C_EEPROM_ASYNC)
+    union bond_stage *stage;
+
+    if (size > sizeof(union bond_stage))
+    {
+        // the whole bond index block (rare): written from the caller's data, done on return
+        while (i2c_eeprom_async_write( (uint8_t const *) data, address, size, NULL) != I2C_EEPROM_ASYNC_OK)
+            bond_eeprom_flush();
+        bond_eeprom_flush();
+        return;
+    }
+
+    // the write cycles are waited for by the interrupt driven driver, not here
+    while (bond_stage_count == I2C_EEPROM_ASYNC_QUEUE_SIZE)
+        bond_eeprom_flush();
+
+    stage = &bond_stage[(bond_stage_first + bond_stage_count) % I2C_EEPROM_ASYNC_QUEUE_SIZE];
+    memcpy(stage, data, size);
+
+    while (i2c_eeprom_async_write( (uint8_t const *) stage, address, size, bond_stage_release) != I2C_EEPROM_ASYNC_OK)
+        bond_eeprom_flush();
+    bond_stage_count++;
+#else
+    // as a queued write that failed (bond_stage_release())
+    if (i2c_eeprom_write_data( (uint8_t *) data, address, size) != size)
+        bond_index_valid = false;
+#endif
+}
+#endif
+
+
+static void bond_storage_open(void)
+{
+#if !(BOND_STORAGE_FLASH)
+#if (I2C_EEPROM_ASYNC)
+    // the driver sets the controller up for each operation, the previous writes may still run
+    i2c_eeprom_async_config(I2C_SLAVE_ADDRESS, I2C_SPEED_MODE, I2C_ADDRESS_MODE, I2C_ADRESS_BYTES_CNT);
+#else
+    i2c_eeprom_init(I2C_SLAVE_ADDRESS, I2C_SPEED_MODE, I2C_ADDRESS_MODE, I2C_ADRESS_BYTES_CNT);
+#endif
+#endif
+}
+
+
+static void bond_storage_close(void)
+{
+// with I2C_EEPROM_ASYNC, released by the driver once the queued writes are done
+#if !(BOND_STORAGE_FLASH) && !(I2C_EEPROM_ASYNC)
+    i2c_eeprom_release();
+#endif
+}
+
+
+// False if the storage did not respond, sec_env is then an all-zero record
+static bool bond_storage_read(uint32_t slot, struct app_sec_env_tag *sec_env)
+{
+#if (BOND_STORAGE_FLASH)
+    nvds_tag_len_t len = sizeof(struct app_sec_env_tag);
+    
+    // a slot never written reads as an all-zero record
+    if ((nvds_flash_get(BOND_TAG_SLOT + slot, &len, (uint8_t *) sec_env) != NVDS_OK) || (len != sizeof(struct app_sec_env_tag)))
+        memset(sec_env, 0, sizeof(struct app_sec_env_tag));
+    
+    return true;
+#else
+    return bond_eeprom_read(sec_env, bond_slot_addr(slot), sizeof(struct app_sec_env_tag));
+#endif
+}
+
+
+static void bond_storage_write(uint32_t slot, struct app_sec_env_tag *sec_env)
+{
+#if (BOND_STORAGE_FLASH)
+    nvds_put(BOND_TAG_SLOT + slot, sizeof(struct app_sec_env_tag), (uint8_t *) sec_env);
+#else
+    bond_eeprom_write(sec_env, bond_slot_addr(slot), sizeof(struct app_sec_env_tag));
+#endif
+}
+
+
+// The bond index must have been checked
+static void bond_storage_read_status(void)
+{
+#if (BOND_STORAGE_FLASH)
+    uint32_t i;
+    
+    multi_bond_status = 0;
+    for (i = 0; i < MAX_BOND_PEER; i++)
+    {
+        if (bond_index.entry[i].flags & BOND_INDEX_BONDED)
+            multi_bond_status |= (1UL << i);
+    }
+#else
+    // a single byte up to 8 bonds, the next ones are 0
+    bond_eeprom_read(&multi_bond_status, EEPROM_BONDING_STATUS_ADDR, sizeof(multi_bond_status));
+    
+    // an erased (0xFF) or foreign EEPROM must not bring bonds of slots that do not exist
+    multi_bond_status &= BOND_STATUS_MASK;
+#endif
+}
+
+
+static void bond_storage_write_status(void)
+{
+#if !(BOND_STORAGE_FLASH)
+    bond_eeprom_write(&multi_bond_status, EEPROM_BONDING_STATUS_ADDR, sizeof(multi_bond_status));
+#endif
+}
+
+
+// Erase the status and the bonds
+static void bond_storage_erase(void)
+{
+    uint32_t i;
+
+#if (BOND_STORAGE_FLASH)
+    for (i = 0; i < MAX_BOND_PEER; i++)
+        nvds_del(BOND_TAG_SLOT + i);
+#else
+    static const uint8_t zero_data[32] = {0};
+    uint32_t size;
+    
+    for (i = 0; i < BOND_DATA_END; i += size)
+    {
+        size = BOND_DATA_END - i;
+        if (size > sizeof(zero_data))
+            size = sizeof(zero_data);
+        
+        bond_eeprom_write(zero_data, i, size);
+    }
+#endif
+}
+
+
+static uint8_t bond_index_hash(uint8_t hash, const uint8_t *data, uint8_t len)
+{
+    while (len--)
+        hash = (uint8_t)((hash << 1) | (hash >> 7)) ^ *data++;
+    
+    return hash;
+}
+
+
+static uint8_t bond_index_addr_hash(const struct bd_addr *peer_addr, uint8_t peer_addr_type)
+{
+    return bond_index_hash(peer_addr_type, peer_addr->addr, BD_ADDR_LEN);
+}
+
+
+static void bond_index_set(uint32_t slot, const struct app_sec_env_tag *sec_env)
+{
+    bond_index.entry[slot].ediv = sec_env->ediv;
+    bond_index.entry[slot].rand_hash = bond_index_hash(0, sec_env->rand_nb.nb, RAND_NB_LEN);
+    bond_index.entry[slot].addr_hash = bond_index_addr_hash(&sec_env->peer_addr, sec_env->peer_addr_type);
+    bond_index.entry[slot].flags = ((sec_env->auth & GAP_AUTH_BOND) ? BOND_INDEX_BONDED : 0)
+                                 | ((sec_env->peer_addr_type == 0) ? BOND_INDEX_PUBLIC : 0);
+}
+
+
+// Write one entry (or BOND_INDEX_ALL) of the bond index block
+static void bond_index_store(uint32_t slot)
+{
+#if (BOND_STORAGE_FLASH)
+    // the TAG is rewritten as a whole
+    nvds_put(BOND_TAG_INDEX, sizeof(struct bond_index_block), (uint8_t *) &bond_index);
+#else
+    if (!BOND_INDEX_STORED)
+        return;
+    
+    if (slot == BOND_INDEX_ALL)
+        bond_eeprom_write(&bond_index, BOND_INDEX_ADDR, sizeof(struct bond_index_block));
+    else
+        bond_eeprom_write(&bond_index.entry[slot],
+                          BOND_INDEX_ADDR + offsetof(struct bond_index_block, entry) + slot * sizeof(struct bond_index_entry),
+                          sizeof(struct bond_index_entry));
+#endif
+}
+
+
+// Read the bond index block, false if there's none or it was written for another MAX_BOND_PEER
+static bool bond_index_load(void)
+{
+#if (BOND_STORAGE_FLASH)
+    nvds_tag_len_t len = sizeof(struct bond_index_block);
+    
+    if ((nvds_flash_get(BOND_TAG_INDEX, &len, (uint8_t *) &bond_index) != NVDS_OK) || (len != sizeof(struct bond_index_block)))
+        return false;
+#else
+    if (!BOND_INDEX_STORED)
+        return false;
+    
+    bond_eeprom_read(&bond_index, BOND_INDEX_ADDR, sizeof(struct bond_index_block));
+#endif
+    
+    return (bond_index.magic == BOND_INDEX_MAGIC) && (bond_index.peers == MAX_BOND_PEER);
+}
+
+
+// False if a record could not be read, nothing is stored then
+static bool bond_index_build(void)
+{
+    struct app_sec_env_tag tmp_sec_env;
+    uint32_t i;
+    
+    memset(&bond_index, 0, sizeof(struct bond_index_block));
+    bond_index.magic = BOND_INDEX_MAGIC;
+    bond_index.peers = MAX_BOND_PEER;
+    
+    for (i = 0; i < MAX_BOND_PEER; i++)
+    {
+        if (!bond_storage_read(i, &tmp_sec_env))
+            return false;
+        
+        bond_index_set(i, &tmp_sec_env);
+    }
+    
+    bond_index_store(BOND_INDEX_ALL);
+    
+    return true;
+}
+
+
+// The storage must have been opened. False if the bond index could not be read nor built
+static bool bond_index_check(void)
+{
+    uint32_t i;
+    
+    if (bond_index_valid)
+        return true;
+    
+    if (!bond_index_load() && !bond_index_build())
+        return false;
+    
+    bond_seq = 0;
+    for (i = 0; i < MAX_BOND_PEER; i++)
+    {
+        if (bond_index.entry[i].seq > bond_seq)
+            bond_seq = bond_index.entry[i].seq;
+    }
+    
+    bond_index_valid = true;
+    
+    return true;
+}
+
+
+// Make the slot the most recently used one and store its entry
+static void bond_index_update(uint32_t slot)
+{
+    uint16_t rank[MAX_BOND_PEER];
+    uint32_t i, j;
+    
+    if (bond_seq == 0xFFFF)
+    {
+        // renumber from 1, in the same order
+        for (i = 0; i < MAX_BOND_PEER; i++)
+        {
+            rank[i] = 1;
+            for (j = 0; j < MAX_BOND_PEER; j++)
+            {
+                if (bond_index.entry[j].seq < bond_index.entry[i].seq)
+                    rank[i]++;
+            }
+        }
+        
+        bond_seq = 0;
+        for (i = 0; i < MAX_BOND_PEER; i++)
+        {
+            bond_index.entry[i].seq = rank[i];
+            if (rank[i] > bond_seq)
+                bond_seq = rank[i];
+        }
+        
+        bond_index.entry[slot].seq = ++bond_seq;
+        bond_index_store(BOND_INDEX_ALL);
+    }
+    else
+    {
+        bond_index.entry[slot].seq = ++bond_seq;
+        bond_index_store(slot);
+    }
+}
+
+
+// Same as bond_index_update(), without a write if the slot is already the most recently used one
+static void bond_index_touch(uint32_t slot)
+{
+    if ((bond_seq == 0) || (bond_index.entry[slot].seq != bond_seq))
+        bond_index_update(slot);
+}
+
+
+// Least recently used slot
+static uint32_t bond_index_lru(void)
+{
+    uint32_t i, lru = 0;
+    
+    for (i = 1; i < MAX_BOND_PEER; i++)
+    {
+        if (bond_index.entry[i].seq < bond_index.entry[lru].seq)
+            lru = i;
+    }
+    
+    return lru;
+}
+
+
+/*
+ * Find the slot of the bond with these keys. tmp_sec_env receives the record.
+ * Returns MAX_BOND_PEER if there's none.
+ */
+static uint32_t bond_index_find_keys(const struct rand_nb *rand_nb, uint16_t ediv, struct app_sec_env_tag *tmp_sec_env)
+{
+    uint8_t rand_hash = bond_index_hash(0, rand_nb->nb, RAND_NB_LEN);
+    uint32_t i;
+    
+    for (i = 0; i < MAX_BOND_PEER; i++)
+    {
+        if ((bond_index.entry[i].ediv != ediv) || (bond_index.entry[i].rand_hash != rand_hash))
+            continue;
+        
+        if (!bond_storage_read(i, tmp_sec_env))
+            continue;
+        
+        if ((tmp_sec_env->ediv == ediv) && (!memcmp(rand_nb, &tmp_sec_env->rand_nb, RAND_NB_LEN)))
+            break;
+    }
+    
+    return i;
+}
+
+
 //TODO: Maybe this is used to store the position of the last connected bonded host. This way, after a reset,
 // we would try to connect to it first. (VK)/
 void app_alt_pair_read_status(void)
 {
-    if (HAS_EEPROM)
+    if (HAS_BOND_STORAGE)
     {
-        i2c_eeprom_init(I2C_SLAVE_ADDRESS, I2C_SPEED_MODE, I2C_ADDRESS_MODE, I2C_ADRESS_BYTES_CNT);
+        bond_storage_open();
         
-        i2c_eeprom_read_data(&multi_bond_status, EEPROM_BONDING_STATUS_ADDR, sizeof(uint8_t));
+        // read the bond index once, the lookups only read the matching bond
+        bond_index_check();
         
-        i2c_eeprom_release();
+        bond_storage_read_status();
+
+        bond_storage_close();
     }
 }
 
 
 void app_alt_pair_store_status(void)
 {
-    if (HAS_EEPROM)
+    if (HAS_BOND_STORAGE)
     {
-        i2c_eeprom_init(I2C_SLAVE_ADDRESS, I2C_SPEED_MODE, I2C_ADDRESS_MODE, I2C_ADRESS_BYTES_CNT);
+        bond_storage_open();
         
-        i2c_eeprom_write_byte(EEPROM_BONDING_STATUS_ADDR, multi_bond_status);
+        bond_storage_write_status();
         
-        i2c_eeprom_release();
+        bond_storage_close();
     }
 }
 
 
 void app_alt_pair_store_bond_data(void)
 {
-    if (HAS_EEPROM)
+    if (HAS_BOND_STORAGE)
     {
         struct app_sec_env_tag tmp_sec_env;
-        int addr = EEPROM_BOND_DATA_ADDR;
-        int empty_pos_addr = 0; // address 0 is RESERVED!
+        uint8_t addr_hash = bond_index_addr_hash(&app_env.peer_addr, app_env.peer_addr_type);
+        uint32_t empty_pos = MAX_BOND_PEER;
+        uint32_t found_pos;
         uint32_t i;
-        bool found = false;
         
-        i2c_eeprom_init(I2C_SLAVE_ADDRESS, I2C_SPEED_MODE, I2C_ADDRESS_MODE, I2C_ADRESS_BYTES_CNT);
+        bond_storage_open();
+        
+        // the EEPROM does not respond, the bond cannot be stored
+        if (!bond_index_check())
+        {
+            bond_storage_close();
+            return;
+        }
         
         //find entry 
-        for (i = 0; i < MAX_BOND_PEER; i++)
+        found_pos = bond_index_find_keys(&app_sec_env.rand_nb, app_sec_env.ediv, &tmp_sec_env);
+        
+        if (found_pos == MAX_BOND_PEER)
         {
-            i2c_eeprom_read_data( (uint8_t *) &tmp_sec_env, addr, sizeof(struct app_sec_env_tag));
-            
-            if (!(tmp_sec_env.auth & GAP_AUTH_BOND) && (empty_pos_addr == 0))
+            for (i = 0; i < MAX_BOND_PEER; i++)
             {
-                empty_pos_addr = addr;   
+                if (!(bond_index.entry[i].flags & BOND_INDEX_BONDED) && (empty_pos == MAX_BOND_PEER))
+                {
+                    empty_pos = i;
+                }
+                
+                if ((bond_index.entry[i].addr_hash == addr_hash) && bond_storage_read(i, &tmp_sec_env))
+                {
+                    if ((tmp_sec_env.peer_addr_type == app_env.peer_addr_type) && (!memcmp(&app_env.peer_addr, &tmp_sec_env.peer_addr, BD_ADDR_LEN)))
+                    {
+                        empty_pos = i;  // overwrite previous used (invalid) entry
+                    }
+                }
             }
+        }
             
-            if ((tmp_sec_env.ediv == app_sec_env.ediv) && (!memcmp(&app_sec_env.rand_nb, &tmp_sec_env.rand_nb, RAND_NB_LEN)))
-            {
-                found = true;
-                break; 
-            }
-            else if ((tmp_sec_env.peer_addr_type == app_env.peer_addr_type) && (!memcmp(&app_env.peer_addr, &tmp_sec_env.peer_addr, BD_ADDR_LEN)))
+        if (found_pos != MAX_BOND_PEER)  // entry for peer exists. Overwite only if the peer is not using a Public or Static address (???)
+        {
+            if (app_env.peer_addr_type > GAPM_GEN_STATIC_RND_ADDR) // is it required? if keys are the same then it shouldn't be...
             {
-                empty_pos_addr = addr;  // overwrite previous used (invalid) entry
+                bond_storage_write(found_pos, &app_sec_env);
+                bond_index_set(found_pos, &app_sec_env);
             }
             
-            addr += sizeof(struct app_sec_env_tag);
-        }    
-            
-        if (found)  // entry for peer exists. Overwite only if the peer is not using a Public or Static address (???)
-        {
-            if (app_env.peer_addr_type > GAPM_GEN_STATIC_RND_ADDR) // is it required? if keys are the same then it shouldn't be...
-                i2c_eeprom_write_data((uint8_t *)&app_sec_env, addr, sizeof(struct app_sec_env_tag));
+            bond_index_update(found_pos);
         }
-        else        // entry for peer does not exist. Write to first empty. If there is no space rewrite first entry.
+        else        // entry for peer does not exist. Write to first empty. If there is no space evict the least recently used entry.
         {
-            if (empty_pos_addr == 0)
-                addr = EEPROM_BOND_DATA_ADDR;
-            else
-                addr = empty_pos_addr;
+            if (empty_pos == MAX_BOND_PEER)
+                empty_pos = bond_index_lru();
             
-            i2c_eeprom_write_data((uint8_t *)&app_sec_env, addr, sizeof(struct app_sec_env_tag));
+            bond_storage_write(empty_pos, &app_sec_env);
+            bond_index_set(empty_pos, &app_sec_env);
+            bond_index_update(empty_pos);
             
-            addr -= EEPROM_BOND_DATA_ADDR;          // offset zero
-            addr /= sizeof(struct app_sec_env_tag); // Nth entry
-            multi_bond_status |= (1 << addr);       // update status
-            i2c_eeprom_write_byte(EEPROM_BONDING_STATUS_ADDR, multi_bond_status);
+            multi_bond_status |= (1UL << empty_pos);  // update status
+            bond_storage_write_status();
         }
         
-        i2c_eeprom_release();
+        bond_storage_close();
     }
 }
 
@@ -214,38 +737,36 @@ void app_alt_pair_store_bond_data(void)
  */
 int app_alt_pair_load_bond_data(struct rand_nb *rand_nb, uint16_t ediv)
 {
-    if (HAS_EEPROM)
+    if (HAS_BOND_STORAGE)
     {
         struct app_sec_env_tag tmp_sec_env;
-        int addr = EEPROM_BOND_DATA_ADDR;
         uint32_t i;
         int retval = 0;
 
-        i2c_eeprom_init(I2C_SLAVE_ADDRESS, I2C_SPEED_MODE, I2C_ADDRESS_MODE, I2C_ADRESS_BYTES_CNT);
+        bond_storage_open();
         
-        for (i = 0; i < MAX_BOND_PEER; i++)
+        // no bond is found if the EEPROM does not respond
+        if (bond_index_check())
+            i = bond_index_find_keys(rand_nb, ediv, &tmp_sec_env);
+        else
+            i = MAX_BOND_PEER;
+        
+        if ((i != MAX_BOND_PEER) && (tmp_sec_env.auth & GAP_AUTH_BOND))
         {
-            i2c_eeprom_read_data( (uint8_t *) &tmp_sec_env, addr, sizeof(struct app_sec_env_tag));
+            if ( (app_sec_env.ediv == ediv) && (!memcmp(rand_nb, &app_sec_env.rand_nb, RAND_NB_LEN))
+                  && (app_sec_env.auth & GAP_AUTH_BOND) )
+                retval = 2;
+            else
+                retval = 1;
             
-            if ((tmp_sec_env.ediv == ediv) && (!memcmp(rand_nb, &tmp_sec_env.rand_nb, RAND_NB_LEN))
-                    && (tmp_sec_env.auth & GAP_AUTH_BOND))
-            {
-                if ( (app_sec_env.ediv == ediv) && (!memcmp(rand_nb, &app_sec_env.rand_nb, RAND_NB_LEN))
-                      && (app_sec_env.auth & GAP_AUTH_BOND) )
-                    retval = 2;
-                else
-                    retval = 1;
-                
-                memcpy(&app_sec_env, &tmp_sec_env, sizeof(struct app_sec_env_tag));
-                multi_bond_active_peer_pos = i;
-                multi_bond_next_peer_pos = i + 1;
-                break; 
-            }
+            memcpy(&app_sec_env, &tmp_sec_env, sizeof(struct app_sec_env_tag));
+            multi_bond_active_peer_pos = i;
+            multi_bond_next_peer_pos = i + 1;
             
-            addr += sizeof(struct app_sec_env_tag);
+            bond_index_touch(i);
         }
-        
-        i2c_eeprom_release();
+
+        bond_storage_close();
 
         return retval;
     }
@@ -273,14 +794,16 @@ int app_alt_pair_load_bond_data(struct rand_nb *rand_nb, uint16_t ediv)
  */ 
 bool app_alt_pair_get_next_bond_data(bool init)
 {
-    if (HAS_EEPROM)
+    if (HAS_BOND_STORAGE)
     {
         struct app_sec_env_tag tmp_sec_env;
         uint32_t i;
         bool status = false;
-        uint8_t addr;
+        bool indexed;
 
-        i2c_eeprom_init(I2C_SLAVE_ADDRESS, I2C_SPEED_MODE, I2C_ADDRESS_MODE, I2C_ADRESS_BYTES_CNT);
+        bond_storage_open();
+        
+        indexed = bond_index_check();
         
         // after reset 'multi_bond_next_peer_pos' is 0. if it's not 0 then this is the position we should use
         i = multi_bond_next_peer_pos;
@@ -290,14 +813,15 @@ bool app_alt_pair_get_next_bond_data(bool init)
 
         do
         {
+            // no bond is found if the EEPROM does not respond
+            if (!indexed)
+                break;
+            
             if (i == MAX_BOND_PEER) 
                 i = 0;
                 
-            addr = (i * sizeof(struct app_sec_env_tag)) + EEPROM_BOND_DATA_ADDR;
-
-            i2c_eeprom_read_data((uint8_t *) &tmp_sec_env, addr, sizeof(struct app_sec_env_tag));
-            
-            if (tmp_sec_env.peer_addr_type == 0 && tmp_sec_env.auth & GAP_AUTH_BOND) //used entry (public address)
+            if (((bond_index.entry[i].flags & (BOND_INDEX_PUBLIC | BOND_INDEX_BONDED)) == (BOND_INDEX_PUBLIC | BOND_INDEX_BONDED)) //used entry (public address)
+                    && bond_storage_read(i, &tmp_sec_env))
             { //TODO: Can we do the same for random addresses? (VK)
                memcpy(&app_sec_env, &tmp_sec_env, sizeof(struct app_sec_env_tag));
                multi_bond_next_peer_pos = i + 1;
@@ -332,14 +856,13 @@ bool app_alt_pair_get_next_bond_data(bool init)
                     app_sec_env.auth = GAP_AUTH_REQ_NO_MITM_BOND;
                 }
             }
-            else
+            else if (bond_storage_read(multi_bond_active_peer_pos, &tmp_sec_env))
             {
-                addr = (multi_bond_active_peer_pos * sizeof(struct app_sec_env_tag)) + EEPROM_BOND_DATA_ADDR;
-                i2c_eeprom_read_data( (uint8_t *) &app_sec_env, addr, sizeof(struct app_sec_env_tag));
+                memcpy(&app_sec_env, &tmp_sec_env, sizeof(struct app_sec_env_tag));
             }
         }
             
-        i2c_eeprom_release();
+        bond_storage_close();
 
         return status;
     }
@@ -350,45 +873,41 @@ bool app_alt_pair_get_next_bond_data(bool init)
 
 void app_alt_pair_clear_all_bond_data(void)
 {
-    if (HAS_EEPROM)
+    if (HAS_BOND_STORAGE)
     {
-        uint32_t i;
-        uint8_t zero_data[32] = {0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0,
-                                 0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0,
-                                 0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0,
-                                 0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0};
-            
-        i2c_eeprom_init(I2C_SLAVE_ADDRESS, I2C_SPEED_MODE, I2C_ADDRESS_MODE, I2C_ADRESS_BYTES_CNT);
-                                    
-        for (i = 0; i < 8; i++)
-        {
-            uint8_t addr;
-            addr = i * 32;
-            i2c_eeprom_write_data( zero_data, (uint8_t) addr, 32);
-        }
+        bond_storage_open();
+        
+        bond_storage_erase();
         multi_bond_status = 0;
-
+        
+        // all-zero records
+        memset(&bond_index, 0, sizeof(struct bond_index_block));
+        bond_index.magic = BOND_INDEX_MAGIC;
+        bond_index.peers = MAX_BOND_PEER;
+        bond_index_store(BOND_INDEX_ALL);
+        bond_index_valid = true;
+        bond_seq = 0;
+
+#if !(BOND_STORAGE_FLASH)
         if (DEVELOPMENT__NO_OTP)
         {
-            uint8_t addr;
-            int i, j;
+            uint32_t addr;
+            int j;
             uint8_t read_data[4];
-
-            for (i = 0; i < 64; i++)
+            const uint8_t zero_data[4] = {0x0,0x0,0x0,0x0};
+            
+            for (addr = 0; addr < BOND_DATA_END; addr += 4)
             {
-                addr = i * 4;
-                
                 for (j = 0; j < 4; j++)
                     read_data[j] = 0xFF;
                 
-                i2c_eeprom_read_data(read_data, addr, 4);
-                
-                if (memcmp(zero_data, read_data, 4))
-                    __asm("BKPT #0\n"); 
+                if (!bond_eeprom_read(read_data, addr, 4) || memcmp(zero_data, read_data, 4))
+                    __asm("BKPT #0\n");
             }
         }
-        
-        i2c_eeprom_release();
+#endif
+
+        bond_storage_close();
     }
 }
 
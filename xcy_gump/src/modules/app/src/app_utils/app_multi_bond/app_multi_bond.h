@@ -29,6 +29,12 @@
  *     HAS_EEPROM : if there's no EEPROM then using this module is useless.
  *     HAS_MITM : set to (1) if MITM is used or (0) if no MITM is supported.
  *
+ * Optional:
+ *     CFG_MAX_BOND_PEER : number of bonds kept (7 by default, 32 max), the least recently
+ *         used one is evicted when a new host bonds. An 8K EEPROM holds 32 of them.
+ *     CFG_BOND_STORAGE_FLASH : keep the bonds in the NVDS log in SPI flash
+ *         (CFG_NVDS_READ_WRITE, 15 bonds max) instead of the EEPROM.
+ *
  * Note that the following configuration makes sense:
  *     HAS_MULTI_BOND (0) and HAS_EEPROM (1)
  * meaning that only one bond will exist in EEPROM without the possibility of switching.
@@ -53,10 +59,30 @@
 #define EEPROM_BONDING_STATUS_ADDR  0x00
 #define EEPROM_BOND_DATA_ADDR       0x04
 
+#ifdef CFG_MAX_BOND_PEER
+#define MAX_BOND_PEER               (CFG_MAX_BOND_PEER)
+#else
 #define MAX_BOND_PEER               0x07
+#endif
+
+#ifdef CFG_BOND_STORAGE_FLASH
+#define BOND_STORAGE_FLASH          (1)
+#else
+#define BOND_STORAGE_FLASH          (0)
+#endif
+
+#if (MAX_BOND_PEER > 32)
+ #error "multi_bond_status holds 32 bonds at most!"
+#endif
+
+// one NVDS TAG per bond and one for the bond index in the BLE link key range
+#if (BOND_STORAGE_FLASH) && (MAX_BOND_PEER > 15)
+ #error "The NVDS log holds 15 bonds at most!"
+#endif
 
 extern uint8_t multi_bond_enabled;
-extern uint8_t multi_bond_status;
+/// One bit per slot that has been written since the last clear
+extern uint32_t multi_bond_status;
 
 /*
  * FUNCTION DECLARATIONS
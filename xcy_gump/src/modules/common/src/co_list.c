@@ -0,0 +1,247 @@
+/**
+ ****************************************************************************************
+ *
+ * @file co_list.c
+ *
+ * @brief List management functions
+ *
+ * On target these functions are provided by the ROM. This file is only compiled by the
+ * host build of the kernel (CFG_KE_HOST).
+ *
+ * Copyright (C) RivieraWaves 2009-2013
+ *
+ *
+ ****************************************************************************************
+ */
+
+/**
+ ****************************************************************************************
+ * @addtogroup CO_LIST
+ * @{
+ *****************************************************************************************
+ */
+
+/*
+ * INCLUDE FILES
+ ****************************************************************************************
+ */
+#include <string.h>      // for mem* functions
+#include "rwip_config.h" // stack configuration
+#include "ke_config.h"   // kernel configuration
+#include "co_list.h"     // common list definitions
+
+#if (KE_HOST)
+
+/*
+ * FUNCTION DEFINTIONS
+ ****************************************************************************************
+ */
+
+void co_list_init(struct co_list *list)
+{
+    memset(list, 0, sizeof(struct co_list));
+}
+
+void co_list_pool_init(struct co_list *list,
+                       void *pool,
+                       size_t elmt_size,
+                       uint32_t elmt_cnt,
+                       void *default_value,
+                       uint8_t list_type)
+{
+    uint32_t i;
+
+    // initialize the free list relative to the pool
+    co_list_init(list);
+
+    // Add each element of the pool to this list, and init them one by one
+    for (i = 0; i < elmt_cnt; i++)
+    {
+        if (default_value)
+        {
+            memcpy(pool, default_value, elmt_size);
+        }
+        co_list_push_back(list, (struct co_list_hdr *) pool);
+
+        // move to the next pool element
+        pool = (void *)((uint8_t *)pool + (uint32_t)elmt_size);
+    }
+
+    // Make the list circular if required
+    if (list_type == RING_LINKED_LIST)
+    {
+        list->last->next = list->first;
+    }
+}
+
+void co_list_push_back(struct co_list *list,
+                       struct co_list_hdr *list_hdr)
+{
+    // check if list is empty
+    if (co_list_is_empty(list))
+    {
+        // list empty => pushed element is also head
+        list->first = list_hdr;
+    }
+    else
+    {
+        // list not empty => update next of last
+        list->last->next = list_hdr;
+    }
+
+    // add element at the end of the list
+    list->last = list_hdr;
+    list_hdr->next = NULL;
+
+    #if (KE_PROFILING)
+    list->cnt++;
+    if (list->maxcnt < list->cnt)
+    {
+        list->maxcnt = list->cnt;
+    }
+    #endif //KE_PROFILING
+}
+
+void co_list_push_front(struct co_list *list,
+                        struct co_list_hdr *list_hdr)
+{
+    // check if list is empty
+    if (co_list_is_empty(list))
+    {
+        // list empty => pushed element is also head
+        list->last = list_hdr;
+    }
+
+    // add element at the beginning of the list
+    list_hdr->next = list->first;
+    list->first = list_hdr;
+
+    #if (KE_PROFILING)
+    list->cnt++;
+    if (list->maxcnt < list->cnt)
+    {
+        list->maxcnt = list->cnt;
+    }
+    #endif //KE_PROFILING
+}
+
+struct co_list_hdr *co_list_pop_front(struct co_list *list)
+{
+    struct co_list_hdr *element;
+
+    // check if list is empty
+    element = list->first;
+    if (element != NULL)
+    {
+        // The list isn't empty : extract the first element
+        list->first = list->first->next;
+
+        #if (KE_PROFILING)
+        list->cnt--;
+        if (list->mincnt > list->cnt)
+        {
+            list->mincnt = list->cnt;
+        }
+        #endif //KE_PROFILING
+    }
+    return element;
+}
+
+void co_list_extract(struct co_list *list, struct co_list_hdr *list_hdr)
+{
+    struct co_list_hdr *scan_list;
+
+    scan_list = list->first;
+
+    // Check if list is empty or not
+    if (scan_list == NULL)
+        return;
+
+    // check if searched element is first
+    if (scan_list == list_hdr)
+    {
+        // Extract first element
+        list->first = scan_list->next;
+    }
+    else
+    {
+        // Look for the element in the list
+        while ((scan_list->next != NULL) && (scan_list->next != list_hdr))
+        {
+            scan_list = scan_list->next;
+        }
+
+        // Check if element was found in the list
+        if (scan_list->next == NULL)
+            return;
+
+        // Extract the element from the list
+        scan_list->next = list_hdr->next;
+
+        // Check if the element is the last
+        if (list_hdr == list->last)
+        {
+            // Update last pointer
+            list->last = scan_list;
+        }
+    }
+
+    #if (KE_PROFILING)
+    list->cnt--;
+    if (list->mincnt > list->cnt)
+    {
+        list->mincnt = list->cnt;
+    }
+    #endif //KE_PROFILING
+}
+
+bool co_list_find(struct co_list *list,
+                  struct co_list_hdr *list_hdr)
+{
+    struct co_list_hdr *tmp_list_hdr;
+
+    // Go through the list to find the element
+    tmp_list_hdr = list->first;
+
+    while ((tmp_list_hdr != list_hdr) && (tmp_list_hdr != NULL))
+    {
+        tmp_list_hdr = tmp_list_hdr->next;
+    }
+
+    return (tmp_list_hdr == list_hdr);
+}
+
+void co_list_merge(struct co_list *list1, struct co_list *list2)
+{
+    // Nothing to do if list2 is empty
+    if (list2->first == NULL)
+        return;
+
+    // Check if list1 is empty
+    if (list1->first == NULL)
+    {
+        // If list1 is empty, list1 is now list2
+        *list1 = *list2;
+    }
+    else
+    {
+        // Append list2 to list1
+        list1->last->next = list2->first;
+        list1->last = list2->last;
+
+        #if (KE_PROFILING)
+        list1->cnt += list2->cnt;
+        if (list1->maxcnt < list1->cnt)
+        {
+            list1->maxcnt = list1->cnt;
+        }
+        #endif //KE_PROFILING
+    }
+
+    // Empty list2
+    list2->first = NULL;
+}
+
+#endif //KE_HOST
+
+/// @} CO_LIST
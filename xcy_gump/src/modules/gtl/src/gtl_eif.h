@@ -51,6 +51,28 @@
 #define GTL_NEB_MSG_TYPE                            0x10
 #endif // BLE_APP_NEB
 
+#if (GTL_BATCH)
+/**
+ * Batch of kernel messages type. The type is followed by the number of messages (1 byte),
+ * the length of the messages (2 bytes, little endian) and the messages, each one with its
+ * kernel message header. Both sides may send batches. A message ready while the UART is
+ * idle is sent alone with GTL_KE_MSG_TYPE. The messages queued by the GTL task while a
+ * transfer is ongoing are packed in the next batch when the transfer is done (a single
+ * queued message is still sent alone).
+ */
+#define GTL_BATCH_MSG_TYPE                          0x06
+
+/// Batch header length: type, number of messages, length
+#define GTL_BATCH_HDR_LEN                           4
+
+/// Size of the batch frame (header included)
+#ifdef CFG_GTL_BATCH_BUF_SIZE
+#define GTL_BATCH_BUF_SIZE                          CFG_GTL_BATCH_BUF_SIZE
+#else
+#define GTL_BATCH_BUF_SIZE                          (256)
+#endif
+#endif // GTL_BATCH
+
 /*
  * FUNCTION DECLARATIONS
  ****************************************************************************************
@@ -48,13 +48,69 @@
  * CONSTANT DEFINITIONS
  ****************************************************************************************
  */
+/// Host (off-target) build of the kernel: RAM-only implementation, libc heap
+#if defined(CFG_KE_HOST)
+#define KE_HOST         1
+#else
+#define KE_HOST         0
+#endif //CFG_KE_HOST
+
+#if (KE_HOST)
+#define KE_MEM_RW       0
+#define KE_MEM_LINUX    0
+#define KE_MEM_LIBC     1
+#else
 #define KE_MEM_RW       1
 #define KE_MEM_LINUX    0
 #define KE_MEM_LIBC     0
+#endif //KE_HOST
 
 #define KE_FULL         1
 #define KE_SEND_ONLY    0
 
+/// Number of entries of the message handler lookup cache used by the task scheduler
+/// (power of 2, 0 to always parse the handler tables). Host kernel build only: on target
+/// the scheduler is the patch_code ke_task.obj, which has no cache, see KE_HANDLER_INDEX
+#if defined(CFG_KE_HANDLER_CACHE_SIZE)
+#define KE_HANDLER_CACHE_SIZE   (CFG_KE_HANDLER_CACHE_SIZE)
+#else
+#define KE_HANDLER_CACHE_SIZE   (16)
+#endif //CFG_KE_HANDLER_CACHE_SIZE
+
+/// Binary search of the handler tables through a sorted index built at init (target and
+/// host). The ROM scheduler keeps its linear search, the indexed tasks register a
+/// one-entry default handler that dispatches through the index (ke_handler_index.h)
+#if defined(CFG_KE_HANDLER_INDEX)
+#define KE_HANDLER_INDEX    1
+#else
+#define KE_HANDLER_INDEX    0
+#endif //CFG_KE_HANDLER_INDEX
+
+/// Heap usage instrumentation (only available with the RW heap manager)
+#if defined(CFG_KE_MEM_STATS) && (KE_MEM_RW)
+#define KE_MEM_STATS    1
+#else
+#define KE_MEM_STATS    0
+#endif //CFG_KE_MEM_STATS
+
+/// Hashed timer wheel instead of the sorted timer queue (host kernel build only, the
+/// timer module of the target is in ROM)
+#if defined(CFG_KE_TIMER_WHEEL) && (KE_HOST)
+#define KE_TIMER_WHEEL  1
+#else
+#define KE_TIMER_WHEEL  0
+#endif //CFG_KE_TIMER_WHEEL
+
+/// Number of slots of the timer wheel, one per time unit (power of 2)
+#ifndef KE_TIMER_WHEEL_SIZE
+#define KE_TIMER_WHEEL_SIZE     (256)
+#endif
+
+/// Number of buckets of the timer id/task lookup table (power of 2)
+#ifndef KE_TIMER_HASH_SIZE
+#define KE_TIMER_HASH_SIZE      (32)
+#endif
+
 /// @} CFG
 
 #endif // _KE_CONFIG_H_
@@ -0,0 +1,129 @@
+/**
+ ****************************************************************************************
+ *
+ * @file ke_handler_index.h
+ *
+ * @brief Sorted index of a message handler table.
+ *
+ * Copyright (C) RivieraWaves 2009-2013
+ *
+ *
+ ****************************************************************************************
+ */
+
+#ifndef _KE_HANDLER_INDEX_H_
+#define _KE_HANDLER_INDEX_H_
+
+/**
+ ****************************************************************************************
+ * @defgroup HANDLER_INDEX Handler table index
+ * @ingroup TASK
+ * @brief Binary search of the message handler tables.
+ *
+ * The scheduler of the ROM parses the handler tables linearly, from the end. The tables
+ * are constant and assembled with conditional entries, so they cannot be sorted at build
+ * time: the index keeps the positions of the entries sorted by message id in RAM, built
+ * once at init, and gives the same handler as the linear search in O(log n).
+ *
+ * A task uses it by registering a one-entry default handler table whose
+ * KE_MSG_DEFAULT_HANDLER entry calls ke_handler_index_dispatch(): the ROM scheduler
+ * matches this entry at once and the real table is searched through the index.
+ *
+ * @{
+ ****************************************************************************************
+ */
+
+#include "rwip_config.h"     // IP configuration
+#include <stdint.h>          // standard integer
+#include "ke_config.h"       // kernel configuration
+#include "ke_task.h"         // kernel task
+
+#if (KE_HANDLER_INDEX)
+
+/*
+ * DEFINES
+ ****************************************************************************************
+ */
+
+/// Maximum number of entries of an indexed handler table
+#define KE_HANDLER_INDEX_MAX        (255)
+
+/// No KE_MSG_DEFAULT_HANDLER entry in the table
+#define KE_HANDLER_INDEX_NO_DEFAULT (0xFF)
+
+
+/*
+ * TYPE DEFINITIONS
+ ****************************************************************************************
+ */
+
+/// Index of a message handler table
+struct ke_handler_index
+{
+    /// Indexed handler table
+    struct ke_state_handler const *state_handler;
+    /// Positions of the entries in the table, sorted by message id then by position
+    /// (state_handler->msg_cnt elements, KE_MSG_DEFAULT_HANDLER entries excluded)
+    uint8_t *order;
+    /// Number of elements of order
+    uint8_t cnt;
+    /// Position of the last KE_MSG_DEFAULT_HANDLER entry of the table
+    uint8_t default_pos;
+};
+
+
+/*
+ * FUNCTION DECLARATIONS
+ ****************************************************************************************
+ */
+
+/**
+ ****************************************************************************************
+ * @brief Build the index of a handler table.
+ *
+ * @param[out] index          Index to build.
+ * @param[in]  state_handler  Handler table, at most KE_HANDLER_INDEX_MAX entries.
+ * @param[out] order          Storage of the sorted positions, state_handler->msg_cnt
+ *                            elements.
+ ****************************************************************************************
+ */
+void ke_handler_index_init(struct ke_handler_index *index,
+                           struct ke_state_handler const *state_handler, uint8_t *order);
+
+/**
+ ****************************************************************************************
+ * @brief Search the handler of a message in an indexed table.
+ *
+ * Same result as the linear search of the scheduler: among the entries of the message
+ * and the KE_MSG_DEFAULT_HANDLER entries, the one located last in the table.
+ *
+ * @param[in] index   Index of the table.
+ * @param[in] msg_id  Message identifier.
+ *
+ * @return Pointer to the message handler (NULL if not found).
+ ****************************************************************************************
+ */
+ke_msg_func_t ke_handler_index_search(struct ke_handler_index const *index, ke_msg_id_t const msg_id);
+
+/**
+ ****************************************************************************************
+ * @brief Call the handler of a message found in an indexed table.
+ *
+ * @param[in] index   Index of the table.
+ * @param[in] msgid   Id of the message received.
+ * @param[in] param   Pointer to the parameters of the message.
+ * @param[in] dest_id ID of the receiving task instance.
+ * @param[in] src_id  ID of the sending task instance.
+ *
+ * @return Status of the handler, KE_MSG_CONSUMED if the message has no handler.
+ ****************************************************************************************
+ */
+int ke_handler_index_dispatch(struct ke_handler_index const *index, ke_msg_id_t const msgid,
+                              void const *param, ke_task_id_t const dest_id,
+                              ke_task_id_t const src_id);
+
+#endif // (KE_HANDLER_INDEX)
+
+///@} HANDLER_INDEX
+
+#endif // _KE_HANDLER_INDEX_H_
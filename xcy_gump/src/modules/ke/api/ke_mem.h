@@ -144,12 +144,49 @@ __INLINE void ke_free (void * mem_ptr)
 }
 
 #elif (KE_MEM_LIBC)
-// Wrapper to lib C mem functions here
+// Wrapper to lib C mem functions here, used by the host build of the kernel (KE_HOST).
+// Same API as the KE_MEM_RW heap so that kernel and profile code builds unchanged.
 #include <stdlib.h>
 
-__INLINE void *ke_malloc(uint32_t size) { return malloc(size); }
+/// Number of blocks currently allocated per heap type (only maintained for ke_mem_is_empty)
+extern uint32_t ke_mem_libc_used[KE_MEM_BLOCK_MAX];
 
-__INLINE void ke_free(void * mem_ptr) { free(mem_ptr); }
+__INLINE void ke_mem_init(uint8_t type, uint8_t* heap, uint16_t heap_size)
+{
+    ke_mem_libc_used[type] = 0;
+}
+
+__INLINE void *ke_malloc(uint32_t size, uint8_t type)
+{
+    // Store the heap type in front of the block so that ke_free() can account for it
+    uint32_t *block = (uint32_t *) malloc(size + sizeof(uint32_t) * 2);
+
+    if (block == NULL)
+        return NULL;
+
+    block[0] = type;
+    ke_mem_libc_used[type]++;
+
+    return &block[2];
+}
+
+__INLINE void ke_free(void * mem_ptr)
+{
+    uint32_t *block;
+
+    // Same as free(NULL)
+    if (mem_ptr == NULL)
+        return;
+
+    block = ((uint32_t *) mem_ptr) - 2;
+    ke_mem_libc_used[block[0]]--;
+    free(block);
+}
+
+__INLINE bool ke_mem_is_empty(uint8_t type)
+{
+    return (ke_mem_libc_used[type] == 0);
+}
 
 #endif // KE_MEM_RW
 
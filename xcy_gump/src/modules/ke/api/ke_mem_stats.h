@@ -0,0 +1,137 @@
+/**
+ ****************************************************************************************
+ *
+ * @file ke_mem_stats.h
+ *
+ * @brief Heap usage instrumentation.
+ *
+ * Copyright (C) RivieraWaves 2009-2013
+ *
+ *
+ ****************************************************************************************
+ */
+
+#ifndef _KE_MEM_STATS_H_
+#define _KE_MEM_STATS_H_
+
+/**
+ ****************************************************************************************
+ * @defgroup MEM_STATS Memory statistics
+ * @ingroup MEM
+ * @brief Heap usage instrumentation.
+ *
+ * The heaps are managed by the ROM, so the statistics are built by inspecting them from
+ * RAM: the free list of each heap is walked to get the current usage, the largest free
+ * block and the number of free blocks, and the queued messages and timers are parsed
+ * to find which task holds the memory. The whole inspection runs on demand, when
+ * ke_mem_stats_update() is called (APP_MEM_STATS_REQ, arch_printf_mem_stats()).
+ *
+ * The ROM allocator cannot be hooked, so the allocations of the RAM code go through
+ * ke_mem_stats_malloc(), and KE_MSG_ALLOC() through ke_mem_stats_msg_alloc(): each one
+ * re-walks the free list of its heap only, which keeps the peak usage a high-water mark
+ * of these allocations, and counts the allocations the heap could not serve. The
+ * allocations made inside the ROM are only seen by the updates.
+ *
+ * @{
+ ****************************************************************************************
+ */
+
+#include "rwip_config.h"     // IP configuration
+#include <stdint.h>          // standard integer
+#include <stdbool.h>         // standard includes
+#include "ke_config.h"       // kernel configuration
+
+#if (KE_MEM_STATS)
+
+/*
+ * TYPE DEFINITIONS
+ ****************************************************************************************
+ */
+
+/// Statistics of one heap
+struct ke_mem_heap_stats
+{
+    /// Size of the heap
+    uint16_t heap_size;
+    /// Number of bytes currently allocated
+    uint16_t used;
+    /// Maximum number of bytes allocated at the same time
+    uint16_t max_used;
+    /// Size of the largest free block, i.e. the largest allocation that can succeed
+    uint16_t max_free_blk;
+    /// Number of free blocks, more than one means the heap is fragmented
+    uint16_t free_blk_nb;
+    /// Number of allocations that could not be served by this heap
+    uint16_t alloc_fail;
+    /// Number of bytes held by queued messages and timers located in this heap
+    uint16_t msg_bytes;
+    /// Number of bytes held by the top task
+    uint16_t top_task_bytes;
+    /// Type of the task holding the largest number of bytes in this heap (TASK_NONE if none)
+    uint8_t top_task;
+};
+
+
+/*
+ * FUNCTION DECLARATIONS
+ ****************************************************************************************
+ */
+
+/**
+ ****************************************************************************************
+ * @brief Inspect all the heaps and update their statistics.
+ * Interrupts are disabled while the heaps and the kernel queues are parsed, so it is
+ * only called when the statistics are requested.
+ ****************************************************************************************
+ */
+void ke_mem_stats_update(void);
+
+/**
+ ****************************************************************************************
+ * @brief Retrieve the statistics of a heap, as computed by the last update.
+ *
+ * @param[in]  type   Type of memory heap block.
+ * @param[out] stats  Statistics of the heap.
+ ****************************************************************************************
+ */
+void ke_mem_stats_get(uint8_t type, struct ke_mem_heap_stats *stats);
+
+/**
+ ****************************************************************************************
+ * @brief Retrieve the number of bytes held by a task in all heaps, as computed by the
+ * last update.
+ *
+ * @param[in] task_type Type of the task.
+ *
+ * @return Number of bytes of the queued messages and timers of the task.
+ ****************************************************************************************
+ */
+uint16_t ke_mem_stats_task_bytes_get(uint8_t task_type);
+
+/**
+ ****************************************************************************************
+ * @brief Reset the peak usage and failure counters of all heaps.
+ ****************************************************************************************
+ */
+void ke_mem_stats_reset(void);
+
+/**
+ ****************************************************************************************
+ * @brief Allocation of a block of memory, accounted for in the heap statistics.
+ *
+ * Behaves as ke_malloc(). An allocation that fails, or that the heap manager serves
+ * from another heap because the requested one is exhausted, is counted as a failure.
+ *
+ * @param[in] size Size of the memory area that need to be allocated.
+ * @param[in] type Type of memory block
+ *
+ * @return A pointer to the allocated memory area.
+ ****************************************************************************************
+ */
+void *ke_mem_stats_malloc(uint32_t size, uint8_t type);
+
+#endif // (KE_MEM_STATS)
+
+///@} MEM_STATS
+
+#endif // _KE_MEM_STATS_H_
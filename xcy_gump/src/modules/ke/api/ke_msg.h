@@ -130,6 +130,13 @@ __INLINE void * ke_msg2param(struct ke_msg const *msg)
     return (void*) (((uint8_t*) msg) + offsetof(struct ke_msg, param));
 }
 
+#if (KE_MEM_STATS)
+/// The messages allocated by the RAM code are accounted for in the heap statistics
+#define KE_MSG_ALLOC_FUNC   ke_mem_stats_msg_alloc
+#else
+#define KE_MSG_ALLOC_FUNC   ke_msg_alloc
+#endif //KE_MEM_STATS
+
 /**
  ****************************************************************************************
  * @brief Convenient wrapper to ke_msg_alloc()
@@ -147,7 +154,7 @@ __INLINE void * ke_msg2param(struct ke_msg const *msg)
  ****************************************************************************************
  */
 #define KE_MSG_ALLOC(id, dest, src, param_str) \
-    (struct param_str*) ke_msg_alloc(id, dest, src, sizeof(struct param_str))
+    (struct param_str*) KE_MSG_ALLOC_FUNC(id, dest, src, sizeof(struct param_str))
 
 /**
  ****************************************************************************************
@@ -179,7 +186,7 @@ __INLINE void * ke_msg2param(struct ke_msg const *msg)
  * @return Pointer to the parameter member of the ke_msg.
  ****************************************************************************************
  */
-#define KE_MSG_ALLOC_DYN(id, dest, src, param_str,length)  (struct param_str*)ke_msg_alloc(id, dest, src, \
+#define KE_MSG_ALLOC_DYN(id, dest, src, param_str,length)  (struct param_str*)KE_MSG_ALLOC_FUNC(id, dest, src, \
     (sizeof(struct param_str) + length));
 
 /**
@@ -213,6 +220,25 @@ __INLINE void * ke_msg2param(struct ke_msg const *msg)
 void *ke_msg_alloc(ke_msg_id_t const id, ke_task_id_t const dest_id,
                    ke_task_id_t const src_id, uint16_t const param_len);
 
+#if (KE_MEM_STATS)
+/**
+ ****************************************************************************************
+ * @brief Allocate memory for a message and account for it in the heap statistics.
+ *
+ * Behaves as ke_msg_alloc(), see ke_mem_stats_malloc().
+ *
+ * @param[in] id        Message identifier
+ * @param[in] dest_id   Destination Task Identifier
+ * @param[in] src_id    Source Task Identifier
+ * @param[in] param_len Size of the message parameters to be allocated
+ *
+ * @return Pointer to the parameter member of the ke_msg.
+ ****************************************************************************************
+ */
+void *ke_mem_stats_msg_alloc(ke_msg_id_t const id, ke_task_id_t const dest_id,
+                             ke_task_id_t const src_id, uint16_t const param_len);
+#endif //KE_MEM_STATS
+
 /**
  ****************************************************************************************
  * @brief Message sending.
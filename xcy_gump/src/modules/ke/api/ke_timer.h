@@ -53,6 +53,12 @@ struct ke_timer
     ke_task_id_t    task;
     /// time value
     uint32_t        time;
+    #if (KE_TIMER_WHEEL)
+    /// previous timer of the wheel slot
+    struct ke_timer *prev;
+    /// next timer of the lookup bucket
+    struct ke_timer *hash_next;
+    #endif //KE_TIMER_WHEEL
 };
 
 
@@ -134,6 +140,49 @@ bool ke_timer_active(ke_msg_id_t const timer_id, ke_task_id_t const task_id);
 bool ke_timer_sleep_check(uint32_t *sleep_duration, uint32_t wakeup_delay);
 #endif //DEEP_SLEEP
 
+/**
+ ****************************************************************************************
+ * @brief Retrieve kernel time.
+ *
+ * @return time value (in 10ms units)
+ ****************************************************************************************
+ */
+uint32_t ke_time(void);
+
+#if (KE_HOST)
+/**
+ ****************************************************************************************
+ * @brief Host replacement of the timer interrupt.
+ *
+ * Must be called periodically by the host main loop before ke_event_schedule(). It sets
+ * the KE_EVENT_KE_TIMER event when the first programmed timer has expired.
+ ****************************************************************************************
+ */
+void ke_timer_hw_poll(void);
+
+/**
+ ****************************************************************************************
+ * @brief Run the host kernel on a simulated time instead of the monotonic clock.
+ *
+ * Once called, ke_time() returns the given value until the next call, so benchmarks and
+ * replays control the expiration of the timers. The first call shall be done before
+ * ke_init().
+ *
+ * @param[in] time  Kernel time (in 10ms units)
+ ****************************************************************************************
+ */
+void ke_time_sim_set(uint32_t time);
+#endif //KE_HOST
+
+#if (KE_TIMER_WHEEL)
+/**
+ ****************************************************************************************
+ * @brief Remove and free all the programmed timers.
+ ****************************************************************************************
+ */
+void ke_timer_flush(void);
+#endif //KE_TIMER_WHEEL
+
 /// @} TIMER
 
 #endif // _KE_TIMER_H_
@@ -0,0 +1,130 @@
+/**
+ ****************************************************************************************
+ *
+ * @file ke.c
+ *
+ * @brief This file contains the kernel definition.
+ *
+ * On target the kernel is provided by the ROM. This file is only compiled by the host
+ * build of the kernel (CFG_KE_HOST).
+ *
+ * Copyright (C) RivieraWaves 2009-2013
+ *
+ *
+ ****************************************************************************************
+ */
+
+/**
+ ****************************************************************************************
+ * @addtogroup ENV
+ * @{
+ ****************************************************************************************
+ */
+
+/*
+ * INCLUDE FILES
+ ****************************************************************************************
+ */
+#include "rwip_config.h"       // stack configuration
+
+#include <stddef.h>            // standard definition
+#include <stdint.h>            // standard integer
+#include <stdbool.h>           // standard boolean
+#include <string.h>            // memset definition
+
+#include "ke_config.h"         // kernel configuration
+#include "ke_env.h"            // kernel environment
+#include "ke.h"                // kernel
+#include "ke_event.h"          // kernel event
+#include "ke_task.h"           // kernel task
+#include "ke_timer.h"          // kernel timer
+#include "ke_mem.h"            // kernel memory
+
+#if (KE_HOST)
+
+/*
+ * GLOBAL VARIABLES
+ ****************************************************************************************
+ */
+
+/// Kernel environment
+struct ke_env_tag ke_env;
+
+#if (KE_MEM_LIBC)
+/// Number of blocks currently allocated per heap type
+uint32_t ke_mem_libc_used[KE_MEM_BLOCK_MAX];
+#endif //KE_MEM_LIBC
+
+/*
+ * EXPORTED FUNCTION DEFINITIONS
+ ****************************************************************************************
+ */
+
+void ke_init(void)
+{
+    uint8_t type;
+
+    // initialize the kernel environment
+    memset(&ke_env, 0, sizeof(ke_env));
+
+    for (type = 0; type < KE_MEM_BLOCK_MAX; type++)
+    {
+        ke_mem_init(type, NULL, 0);
+    }
+
+    // initialize the kernel message queues
+    co_list_init(&ke_env.queue_sent);
+    co_list_init(&ke_env.queue_saved);
+    co_list_init(&ke_env.queue_timer);
+
+    // initialize event module
+    ke_event_init();
+
+    // initialize task module
+    ke_task_init();
+
+    // initialize timer module
+    ke_timer_init();
+}
+
+void ke_flush(void)
+{
+    // free all messages
+    while (1)
+    {
+        struct ke_msg *msg = (struct ke_msg*) co_list_pop_front(&ke_env.queue_sent);
+        if (msg == NULL)
+            break;
+        ke_msg_free(msg);
+    }
+    while (1)
+    {
+        struct ke_msg *msg = (struct ke_msg*) co_list_pop_front(&ke_env.queue_saved);
+        if (msg == NULL)
+            break;
+        ke_msg_free(msg);
+    }
+    #if (KE_TIMER_WHEEL)
+    ke_timer_flush();
+    #else
+    while (1)
+    {
+        struct ke_timer *timer = (struct ke_timer*) co_list_pop_front(&ke_env.queue_timer);
+        if (timer == NULL)
+            break;
+        ke_free(timer);
+    }
+    #endif //KE_TIMER_WHEEL
+
+    // flush all pending events
+    ke_event_flush();
+}
+
+bool ke_sleep_check(void)
+{
+    return (ke_event_get_all() == 0);
+}
+
+#endif //KE_HOST
+
+/// @} ENV
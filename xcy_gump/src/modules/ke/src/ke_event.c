@@ -0,0 +1,188 @@
+/**
+ ****************************************************************************************
+ *
+ * @file ke_event.c
+ *
+ * @brief This file contains the event handling primitives.
+ *
+ * On target the kernel is provided by the ROM. This file is only compiled by the host
+ * build of the kernel (CFG_KE_HOST).
+ *
+ * Copyright (C) RivieraWaves 2009-2013
+ *
+ *
+ ****************************************************************************************
+ */
+
+/**
+ ****************************************************************************************
+ * @addtogroup EVT
+ * @{
+ ****************************************************************************************
+ */
+
+/*
+ * INCLUDE FILES
+ ****************************************************************************************
+ */
+#include "rwip_config.h"       // stack configuration
+
+#include <stddef.h>            // standard definition
+#include <stdint.h>            // standard integer
+#include <string.h>            // memset definition
+
+#include "arch.h"              // architecture
+#include "co_math.h"           // maths definitions
+#include "ke_config.h"         // kernel configuration
+#include "ke_event.h"          // kernel event
+
+#if (KE_HOST)
+
+/*
+ * STRUCTURES DEFINTIONS
+ ****************************************************************************************
+ */
+
+/// KE EVENT environment structure
+struct ke_event_env_tag
+{
+    /// Event field
+    volatile uint32_t event_field;
+
+    /// Callback table
+    void (*callback[KE_EVENT_MAX])(void);
+};
+
+
+/*
+ * GLOBAL VARIABLES
+ ****************************************************************************************
+ */
+
+/// KE EVENT environment
+static struct ke_event_env_tag ke_event_env;
+
+
+/*
+ * EXPORTED FUNCTION DEFINITIONS
+ ****************************************************************************************
+ */
+
+void ke_event_init(void)
+{
+    memset(&ke_event_env, 0, sizeof(ke_event_env));
+}
+
+uint8_t ke_event_callback_set(uint8_t event_type, void (*p_callback)(void))
+{
+    uint8_t status = KE_EVENT_CAPA_EXCEEDED;
+
+    ASSERT_INFO((event_type < KE_EVENT_MAX) && (p_callback != NULL), event_type, (p_callback != NULL));
+
+    if (event_type < KE_EVENT_MAX)
+    {
+        // Store callback
+        ke_event_env.callback[event_type] = p_callback;
+
+        // Status OK
+        status = KE_EVENT_OK;
+    }
+
+    return (status);
+}
+
+void ke_event_set(uint8_t event_type)
+{
+    ASSERT_INFO((event_type < KE_EVENT_MAX), event_type, 0);
+
+    GLOBAL_INT_DISABLE();
+
+    if (event_type < KE_EVENT_MAX)
+    {
+        // Set the event in the bit field
+        ke_event_env.event_field |= (1 << event_type);
+    }
+
+    GLOBAL_INT_RESTORE();
+}
+
+void ke_event_clear(uint8_t event_type)
+{
+    ASSERT_INFO((event_type < KE_EVENT_MAX), event_type, 0);
+
+    GLOBAL_INT_DISABLE();
+
+    if (event_type < KE_EVENT_MAX)
+    {
+        // Clear the event in the bit field
+        ke_event_env.event_field &= ~(1 << event_type);
+    }
+
+    GLOBAL_INT_RESTORE();
+}
+
+uint8_t ke_event_get(uint8_t event_type)
+{
+    uint8_t state = 0;
+
+    ASSERT_INFO((event_type < KE_EVENT_MAX), event_type, 0);
+
+    GLOBAL_INT_DISABLE();
+
+    if (event_type < KE_EVENT_MAX)
+    {
+        // Get the event in the bit field
+        state = (ke_event_env.event_field >> event_type) & (0x1);
+    }
+
+    GLOBAL_INT_RESTORE();
+
+    return state;
+}
+
+uint32_t ke_event_get_all(void)
+{
+    return ke_event_env.event_field;
+}
+
+void ke_event_flush(void)
+{
+    ke_event_env.event_field = 0;
+}
+
+void ke_event_schedule(void)
+{
+    uint8_t hdl;
+
+    // Get the volatile value
+    uint32_t field = ke_event_env.event_field;
+
+    while (field)
+    {
+        // Find highest priority event set
+        hdl = 32 - (uint8_t) co_clz(field) - 1;
+
+        // Sanity check
+        ASSERT_INFO(hdl < KE_EVENT_MAX, hdl, field);
+
+        if (ke_event_env.callback[hdl] != NULL)
+        {
+            // Execute corresponding handler
+            (ke_event_env.callback[hdl])();
+        }
+        else
+        {
+            ASSERT_ERR(0);
+
+            // Nobody can consume the event, drop it
+            ke_event_clear(hdl);
+        }
+
+        // Update the volatile value
+        field = ke_event_env.event_field;
+    }
+}
+
+#endif //KE_HOST
+
+/// @} EVT
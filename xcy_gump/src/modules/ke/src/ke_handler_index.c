@@ -0,0 +1,133 @@
+/**
+ ****************************************************************************************
+ *
+ * @file ke_handler_index.c
+ *
+ * @brief Implementation of the sorted index of the message handler tables.
+ *
+ * Copyright (C) RivieraWaves 2009-2013
+ *
+ *
+ ****************************************************************************************
+ */
+
+/**
+ ****************************************************************************************
+ * @addtogroup HANDLER_INDEX
+ * @{
+ ****************************************************************************************
+ */
+
+/*
+ * INCLUDE FILES
+ ****************************************************************************************
+ */
+#include "rwip_config.h"       // stack configuration
+
+#include <stddef.h>            // standard definition
+#include <stdint.h>            // standard integer
+
+#include "arch.h"              // architecture
+#include "ke_config.h"         // kernel configuration
+#include "ke_msg.h"            // kernel message
+#include "ke_task.h"           // kernel task
+#include "ke_handler_index.h"  // handler table index
+
+#if (KE_HANDLER_INDEX)
+
+/*
+ * EXPORTED FUNCTION DEFINITIONS
+ ****************************************************************************************
+ */
+
+void ke_handler_index_init(struct ke_handler_index *index,
+                           struct ke_state_handler const *state_handler, uint8_t *order)
+{
+    struct ke_msg_handler const *table = state_handler->msg_table;
+    uint8_t cnt = 0;
+    int i, j;
+
+    ASSERT_ERR(state_handler->msg_cnt <= KE_HANDLER_INDEX_MAX);
+
+    index->state_handler = state_handler;
+    index->order = order;
+    index->default_pos = KE_HANDLER_INDEX_NO_DEFAULT;
+
+    // Insertion sort, run once: equal ids stay in table order
+    for (i = 0; i < state_handler->msg_cnt; i++)
+    {
+        if (table[i].id == KE_MSG_DEFAULT_HANDLER)
+        {
+            index->default_pos = i;
+            continue;
+        }
+
+        for (j = cnt; (j > 0) && (table[order[j - 1]].id > table[i].id); j--)
+        {
+            order[j] = order[j - 1];
+        }
+        order[j] = i;
+        cnt++;
+    }
+
+    index->cnt = cnt;
+}
+
+ke_msg_func_t ke_handler_index_search(struct ke_handler_index const *index, ke_msg_id_t const msg_id)
+{
+    struct ke_msg_handler const *table = index->state_handler->msg_table;
+    int pos = (index->default_pos != KE_HANDLER_INDEX_NO_DEFAULT) ? index->default_pos : -1;
+    int low = 0;
+    int high = index->cnt;
+
+    // Find the first entry with a greater id, the entry before is the last one of msg_id
+    while (low < high)
+    {
+        int mid = (low + high) >> 1;
+
+        if (table[index->order[mid]].id <= msg_id)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+
+    if ((low > 0) && (table[index->order[low - 1]].id == msg_id) && (index->order[low - 1] > pos))
+    {
+        pos = index->order[low - 1];
+    }
+
+    if (pos < 0)
+    {
+        // If we execute this line of code, it means that we did not find the handler
+        return NULL;
+    }
+
+    // If handler is NULL, message should not have been received in this state
+    ASSERT_ERR(table[pos].func);
+
+    return table[pos].func;
+}
+
+int ke_handler_index_dispatch(struct ke_handler_index const *index, ke_msg_id_t const msgid,
+                              void const *param, ke_task_id_t const dest_id,
+                              ke_task_id_t const src_id)
+{
+    ke_msg_func_t func = ke_handler_index_search(index, msgid);
+
+    if (func == NULL)
+    {
+        // Same as the scheduler for a message without handler
+        ASSERT_WARN(0);
+        return (KE_MSG_CONSUMED);
+    }
+
+    return func(msgid, param, dest_id, src_id);
+}
+
+#endif //KE_HANDLER_INDEX
+
+/// @} HANDLER_INDEX
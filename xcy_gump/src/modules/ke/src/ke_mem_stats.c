@@ -0,0 +1,322 @@
+/**
+ ****************************************************************************************
+ *
+ * @file ke_mem_stats.c
+ *
+ * @brief Implementation of the heap usage instrumentation.
+ *
+ * Copyright (C) RivieraWaves 2009-2013
+ *
+ *
+ ****************************************************************************************
+ */
+
+/**
+ ****************************************************************************************
+ * @addtogroup MEM_STATS
+ * @{
+ ****************************************************************************************
+ */
+
+/*
+ * INCLUDE FILES
+ ****************************************************************************************
+ */
+#include "rwip_config.h"       // stack configuration
+
+#include <stddef.h>            // standard definition
+#include <stdint.h>            // standard integer
+#include <stdbool.h>           // standard boolean
+#include <string.h>            // memset definition
+
+#include "arch.h"              // architecture
+#include "ke_config.h"         // kernel configuration
+#include "ke_env.h"            // kernel environment
+#include "ke_mem.h"            // kernel memory
+#include "ke_msg.h"            // kernel message
+#include "ke_timer.h"          // kernel timer
+#include "ke_mem_stats.h"      // kernel memory statistics
+
+#if (KE_MEM_STATS)
+
+/*
+ * STRUCTURES DEFINTIONS
+ ****************************************************************************************
+ */
+
+/// Free block delimiter, same layout as the one used by the ROM heap manager
+struct ke_mem_stats_free_blk
+{
+    /// Next free block
+    struct ke_mem_stats_free_blk *next;
+    /// Size of the free block, delimiter included
+    uint32_t size;
+};
+
+
+/*
+ * GLOBAL VARIABLES
+ ****************************************************************************************
+ */
+
+/// Position of the heap descriptors in the jump table, indexed by heap type
+static const uint8_t ke_mem_stats_jt_pos[KE_MEM_BLOCK_MAX] =
+{
+    [KE_MEM_ENV]            = rwip_heap_env_pos,
+    #if (BLE_HOST_PRESENT)
+    [KE_MEM_ATT_DB]         = rwip_heap_db_pos,
+    #endif // (BLE_HOST_PRESENT)
+    [KE_MEM_KE_MSG]         = rwip_heap_msg_pos,
+    [KE_MEM_NON_RETENTION]  = rwip_heap_non_ret_pos,
+};
+
+/// Heap statistics, retained so that the peaks survive deep sleep
+static struct ke_mem_heap_stats ke_mem_stats[KE_MEM_BLOCK_MAX] __attribute__((section("retention_mem_area0"), zero_init));
+
+/// Bytes held by each task type, recomputed on each update
+static uint16_t ke_mem_stats_task_bytes[TASK_MAX];
+
+/// Bytes held by each task type in the heap being parsed
+static uint16_t ke_mem_stats_heap_task_bytes[TASK_MAX];
+
+
+/*
+ * LOCAL FUNCTION DEFINITIONS
+ ****************************************************************************************
+ */
+
+/**
+ ****************************************************************************************
+ * @brief Check if a pointer belongs to a heap.
+ *
+ * @param[in] type    Type of memory heap block.
+ * @param[in] mem_ptr Pointer to check.
+ *
+ * @return true if the pointer is inside the heap, false otherwise.
+ ****************************************************************************************
+ */
+static bool ke_mem_stats_in_heap(uint8_t type, void const *mem_ptr)
+{
+    uint32_t start = jump_table_struct[ke_mem_stats_jt_pos[type]];
+    uint32_t size = jump_table_struct[ke_mem_stats_jt_pos[type] + 1];
+
+    return (((uint32_t) mem_ptr >= start) && ((uint32_t) mem_ptr < (start + size)));
+}
+
+/**
+ ****************************************************************************************
+ * @brief Account for the bytes of a queued element in the heap being parsed.
+ *
+ * @param[in] type      Type of memory heap block being parsed.
+ * @param[in] mem_ptr   Pointer to the element.
+ * @param[in] size      Size of the element.
+ * @param[in] task_id   Task holding the element.
+ ****************************************************************************************
+ */
+static void ke_mem_stats_task_account(uint8_t type, void const *mem_ptr, uint16_t size,
+                                      ke_task_id_t task_id)
+{
+    uint8_t task_type = KE_TYPE_GET(task_id);
+
+    if (!ke_mem_stats_in_heap(type, mem_ptr) || (task_type >= TASK_MAX))
+        return;
+
+    ke_mem_stats[type].msg_bytes += size;
+    ke_mem_stats_heap_task_bytes[task_type] += size;
+    ke_mem_stats_task_bytes[task_type] += size;
+}
+
+/**
+ ****************************************************************************************
+ * @brief Parse the kernel queues and attribute the elements of a heap to their tasks.
+ *
+ * Sent messages are attributed to their destination, which is expected to consume them,
+ * saved messages to the task that saved them, and timers to the task they will notify.
+ *
+ * @param[in] type Type of memory heap block.
+ ****************************************************************************************
+ */
+static void ke_mem_stats_task_parse(uint8_t type)
+{
+    struct ke_mem_heap_stats *stats = &ke_mem_stats[type];
+    struct co_list_hdr *hdr;
+    uint8_t task_type;
+
+    memset(ke_mem_stats_heap_task_bytes, 0, sizeof(ke_mem_stats_heap_task_bytes));
+    stats->msg_bytes = 0;
+
+    for (hdr = ke_env.queue_sent.first; hdr != NULL; hdr = hdr->next)
+    {
+        struct ke_msg *msg = (struct ke_msg *) hdr;
+        ke_mem_stats_task_account(type, msg, sizeof(struct ke_msg) - sizeof(uint32_t) + msg->param_len,
+                                  msg->dest_id);
+    }
+
+    for (hdr = ke_env.queue_saved.first; hdr != NULL; hdr = hdr->next)
+    {
+        struct ke_msg *msg = (struct ke_msg *) hdr;
+        ke_mem_stats_task_account(type, msg, sizeof(struct ke_msg) - sizeof(uint32_t) + msg->param_len,
+                                  msg->dest_id);
+    }
+
+    for (hdr = ke_env.queue_timer.first; hdr != NULL; hdr = hdr->next)
+    {
+        struct ke_timer *timer = (struct ke_timer *) hdr;
+        ke_mem_stats_task_account(type, timer, sizeof(struct ke_timer), timer->task);
+    }
+
+    // Elect the task holding the largest part of the heap
+    stats->top_task = TASK_NONE;
+    stats->top_task_bytes = 0;
+    for (task_type = 0; task_type < TASK_MAX; task_type++)
+    {
+        if (ke_mem_stats_heap_task_bytes[task_type] > stats->top_task_bytes)
+        {
+            stats->top_task = task_type;
+            stats->top_task_bytes = ke_mem_stats_heap_task_bytes[task_type];
+        }
+    }
+}
+
+/**
+ ****************************************************************************************
+ * @brief Walk the free list of a heap and update its usage.
+ *
+ * @param[in] type Type of memory heap block.
+ ****************************************************************************************
+ */
+static void ke_mem_stats_heap_parse(uint8_t type)
+{
+    struct ke_mem_heap_stats *stats = &ke_mem_stats[type];
+    struct ke_mem_stats_free_blk *blk = (struct ke_mem_stats_free_blk *) ke_env.heap[type];
+    uint32_t free_size = 0;
+
+    stats->heap_size = ke_env.heap_size[type];
+    stats->max_free_blk = 0;
+    stats->free_blk_nb = 0;
+
+    // Stop on any descriptor outside of the heap, the list is being modified or corrupted
+    while ((blk != NULL) && ke_mem_stats_in_heap(type, blk) && (free_size < stats->heap_size))
+    {
+        free_size += blk->size;
+        stats->free_blk_nb++;
+        if (blk->size > stats->max_free_blk)
+        {
+            stats->max_free_blk = blk->size;
+        }
+        blk = blk->next;
+    }
+
+    stats->used = (free_size < stats->heap_size) ? (stats->heap_size - free_size) : 0;
+    if (stats->used > stats->max_used)
+    {
+        stats->max_used = stats->used;
+    }
+}
+
+/**
+ ****************************************************************************************
+ * @brief Account for an allocation requested in a heap.
+ *
+ * @param[in] type    Type of memory heap block requested.
+ * @param[in] mem_ptr Allocated block (NULL if the allocation failed).
+ ****************************************************************************************
+ */
+static void ke_mem_stats_alloc_account(uint8_t type, void const *mem_ptr)
+{
+    uint8_t heap;
+
+    GLOBAL_INT_DISABLE();
+
+    // The heap manager falls back on the other heaps when the requested one is exhausted
+    if ((mem_ptr == NULL) || !ke_mem_stats_in_heap(type, mem_ptr))
+    {
+        ke_mem_stats[type].alloc_fail++;
+    }
+
+    // Only the heap that served the block has grown
+    for (heap = 0; heap < KE_MEM_BLOCK_MAX; heap++)
+    {
+        if ((mem_ptr != NULL) && ke_mem_stats_in_heap(heap, mem_ptr))
+        {
+            ke_mem_stats_heap_parse(heap);
+        }
+    }
+
+    GLOBAL_INT_RESTORE();
+}
+
+
+/*
+ * EXPORTED FUNCTION DEFINITIONS
+ ****************************************************************************************
+ */
+
+void ke_mem_stats_update(void)
+{
+    uint8_t type;
+
+    GLOBAL_INT_DISABLE();
+
+    memset(ke_mem_stats_task_bytes, 0, sizeof(ke_mem_stats_task_bytes));
+
+    for (type = 0; type < KE_MEM_BLOCK_MAX; type++)
+    {
+        ke_mem_stats_heap_parse(type);
+        ke_mem_stats_task_parse(type);
+    }
+
+    GLOBAL_INT_RESTORE();
+}
+
+void ke_mem_stats_get(uint8_t type, struct ke_mem_heap_stats *stats)
+{
+    ASSERT_ERR(type < KE_MEM_BLOCK_MAX);
+
+    GLOBAL_INT_DISABLE();
+    *stats = ke_mem_stats[type];
+    GLOBAL_INT_RESTORE();
+}
+
+uint16_t ke_mem_stats_task_bytes_get(uint8_t task_type)
+{
+    return (task_type < TASK_MAX) ? ke_mem_stats_task_bytes[task_type] : 0;
+}
+
+void ke_mem_stats_reset(void)
+{
+    uint8_t type;
+
+    GLOBAL_INT_DISABLE();
+
+    for (type = 0; type < KE_MEM_BLOCK_MAX; type++)
+    {
+        ke_mem_stats[type].max_used = ke_mem_stats[type].used;
+        ke_mem_stats[type].alloc_fail = 0;
+    }
+
+    GLOBAL_INT_RESTORE();
+}
+
+void *ke_mem_stats_malloc(uint32_t size, uint8_t type)
+{
+    void *mem_ptr = ke_malloc(size, type);
+
+    ke_mem_stats_alloc_account(type, mem_ptr);
+
+    return mem_ptr;
+}
+
+void *ke_mem_stats_msg_alloc(ke_msg_id_t const id, ke_task_id_t const dest_id,
+                             ke_task_id_t const src_id, uint16_t const param_len)
+{
+    void *param_ptr = ke_msg_alloc(id, dest_id, src_id, param_len);
+
+    ke_mem_stats_alloc_account(KE_MEM_KE_MSG, (param_ptr != NULL) ? ke_param2msg(param_ptr) : NULL);
+
+    return param_ptr;
+}
+
+#endif //KE_MEM_STATS
+
+/// @} MEM_STATS
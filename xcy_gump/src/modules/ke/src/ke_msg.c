@@ -0,0 +1,126 @@
+/**
+ ****************************************************************************************
+ *
+ * @file ke_msg.c
+ *
+ * @brief This file contains the scheduler primitives called to create or delete
+ * a task. It contains also the scheduler itself.
+ *
+ * On target the kernel is provided by the ROM. This file is only compiled by the host
+ * build of the kernel (CFG_KE_HOST).
+ *
+ * Copyright (C) RivieraWaves 2009-2013
+ *
+ *
+ ****************************************************************************************
+ */
+
+/**
+ ****************************************************************************************
+ * @addtogroup MSG
+ * @{
+ ****************************************************************************************
+ */
+
+/*
+ * INCLUDE FILES
+ ****************************************************************************************
+ */
+#include "rwip_config.h"       // stack configuration
+
+#include <stddef.h>            // standard definition
+#include <stdint.h>            // standard integer
+#include <stdbool.h>           // standard boolean
+#include <string.h>            // memset definition
+
+#include "arch.h"              // architecture
+#include "ke_config.h"         // kernel configuration
+#include "ke_msg.h"            // kernel message
+#include "ke_task.h"           // kernel task
+#include "ke_env.h"            // kernel environment
+#include "ke_queue.h"          // kernel queue
+#include "ke_event.h"          // kernel event
+#include "ke_mem.h"            // kernel memory
+
+#if (KE_HOST)
+
+/*
+ * EXPORTED FUNCTION DEFINITIONS
+ ****************************************************************************************
+ */
+
+void *ke_msg_alloc(ke_msg_id_t const id, ke_task_id_t const dest_id,
+                   ke_task_id_t const src_id, uint16_t const param_len)
+{
+    // The parameters start in the last word of the header: allocating the whole header
+    // wastes 4 bytes but keeps every header access inside the block
+    struct ke_msg *msg = (struct ke_msg*) ke_malloc(sizeof(struct ke_msg) + param_len,
+                                                    KE_MEM_KE_MSG);
+    void *param_ptr = NULL;
+
+    ASSERT_ERR(msg != NULL);
+
+    msg->hdr.next  = NULL;
+    msg->id        = id;
+    msg->dest_id   = dest_id;
+    msg->src_id    = src_id;
+    msg->param_len = param_len;
+
+    param_ptr = ke_msg2param(msg);
+
+    memset(param_ptr, 0, param_len);
+
+    return param_ptr;
+}
+
+void ke_msg_send(void const *param_ptr)
+{
+    struct ke_msg * msg = ke_param2msg(param_ptr);
+
+    // Add the message to the sent queue
+    GLOBAL_INT_DISABLE();
+    ke_queue_push(&ke_env.queue_sent, (struct co_list_hdr*)msg);
+    GLOBAL_INT_RESTORE();
+
+    // trigger the event
+    ke_event_set(KE_EVENT_KE_MESSAGE);
+}
+
+void ke_msg_send_basic(ke_msg_id_t const id, ke_task_id_t const dest_id, ke_task_id_t const src_id)
+{
+    void *no_param = ke_msg_alloc(id, dest_id, src_id, 0);
+    ke_msg_send(no_param);
+}
+
+void ke_msg_forward(void const *param_ptr, ke_task_id_t const dest_id, ke_task_id_t const src_id)
+{
+    struct ke_msg * msg = ke_param2msg(param_ptr);
+
+    // update the source and destination of the message
+    msg->dest_id = dest_id;
+    msg->src_id  = src_id;
+
+    // send the message
+    ke_msg_send(param_ptr);
+}
+
+void ke_msg_forward_new_id(void const *param_ptr,
+                           ke_msg_id_t const msg_id, ke_task_id_t const dest_id, ke_task_id_t const src_id)
+{
+    struct ke_msg * msg = ke_param2msg(param_ptr);
+
+    // update the id of the message
+    msg->id = msg_id;
+
+    // send the message
+    ke_msg_forward(param_ptr, dest_id, src_id);
+}
+
+void ke_msg_free(struct ke_msg const *msg)
+{
+    ke_free((void*) msg);
+}
+
+#endif //KE_HOST
+
+/// @} MSG
@@ -0,0 +1,134 @@
+/**
+ ****************************************************************************************
+ *
+ * @file ke_queue.c
+ *
+ * @brief This file contains all the functions that handle the different queues
+ * (timer queue, save queue, user queue)
+ *
+ * On target the kernel is provided by the ROM. This file is only compiled by the host
+ * build of the kernel (CFG_KE_HOST).
+ *
+ * Copyright (C) RivieraWaves 2009-2013
+ *
+ *
+ ****************************************************************************************
+ */
+
+/**
+ ****************************************************************************************
+ * @addtogroup QUEUE
+ * @{
+ ****************************************************************************************
+ */
+
+/*
+ * INCLUDE FILES
+ ****************************************************************************************
+ */
+#include "rwip_config.h"       // stack configuration
+
+#include <stddef.h>            // standard definition
+#include <stdint.h>            // standard integer
+#include <stdbool.h>           // standard boolean
+
+#include "arch.h"              // architecture
+#include "ke_config.h"         // kernel configuration
+#include "ke_queue.h"          // kernel queue
+
+#if (KE_HOST)
+
+/*
+ * EXPORTED FUNCTION DEFINITIONS
+ ****************************************************************************************
+ */
+
+struct co_list_hdr *ke_queue_extract(struct co_list * const queue,
+                                     bool (*func)(struct co_list_hdr const * elmt, uint32_t arg),
+                                     uint32_t arg)
+{
+    struct co_list_hdr *prev = NULL;
+    struct co_list_hdr *curr = queue->first;
+
+    // Search for the element matching the algorithm
+    while (curr)
+    {
+        if (func(curr, arg))
+        {
+            // Element found: unlink it
+            if (prev)
+            {
+                prev->next = curr->next;
+            }
+            else
+            {
+                queue->first = curr->next;
+            }
+
+            // Update the tail if needed
+            if (curr == queue->last)
+            {
+                queue->last = prev;
+            }
+
+            #if (KE_PROFILING)
+            queue->cnt--;
+            if (queue->mincnt > queue->cnt)
+            {
+                queue->mincnt = queue->cnt;
+            }
+            #endif //KE_PROFILING
+
+            curr->next = NULL;
+            break;
+        }
+
+        prev = curr;
+        curr = curr->next;
+    }
+
+    return curr;
+}
+
+void ke_queue_insert(struct co_list * const queue, struct co_list_hdr * const element,
+                     bool (*cmp)(struct co_list_hdr const *elementA,
+                                 struct co_list_hdr const *elementB))
+{
+    struct co_list_hdr *prev = NULL;
+    struct co_list_hdr *scan = queue->first;
+
+    // Search for the first element that must come after the new one
+    while (scan && !cmp(element, scan))
+    {
+        prev = scan;
+        scan = scan->next;
+    }
+
+    element->next = scan;
+
+    if (prev)
+    {
+        prev->next = element;
+    }
+    else
+    {
+        queue->first = element;
+    }
+
+    if (scan == NULL)
+    {
+        queue->last = element;
+    }
+
+    #if (KE_PROFILING)
+    queue->cnt++;
+    if (queue->maxcnt < queue->cnt)
+    {
+        queue->maxcnt = queue->cnt;
+    }
+    #endif //KE_PROFILING
+}
+
+#endif //KE_HOST
+
+/// @} QUEUE
@@ -0,0 +1,504 @@
+/**
+ ****************************************************************************************
+ *
+ * @file ke_task.c
+ *
+ * @brief This file contains the implementation of the kernel task management.
+ *
+ * On target the task management is provided by the ROM and the message scheduler
+ * (ke_task_init_func(), jump table entry 44) comes from the patch_code ke_task.obj
+ * linked by the Keil projects. This file is only compiled by the host build of the
+ * kernel (CFG_KE_HOST).
+ *
+ * Copyright (C) RivieraWaves 2009-2013
+ *
+ *
+ ****************************************************************************************
+ */
+
+/**
+ ****************************************************************************************
+ * @addtogroup TASK
+ * @{
+ ****************************************************************************************
+ */
+
+/*
+ * INCLUDE FILES
+ ****************************************************************************************
+ */
+#include "rwip_config.h"       // stack configuration
+
+#include <stddef.h>            // standard definition
+#include <stdint.h>            // standard integer
+#include <stdbool.h>           // standard boolean
+#include <string.h>            // memcpy defintion
+
+#include "arch.h"              // architecture
+#include "ke_config.h"         // kernel configuration
+#include "ke_task.h"           // kernel task
+#include "ke_env.h"            // kernel environment
+#include "ke_queue.h"          // kernel queue
+#include "ke_event.h"          // kernel event
+#include "ke_mem.h"            // kernel memory
+
+#if (KE_HOST)
+
+/*
+ * DEFINES
+ ****************************************************************************************
+ */
+
+/// Number of tasks that can be registered: one per task type
+#define KE_TASK_LIST_SIZE       (TASK_MAX)
+
+
+/*
+ * STRUCTURES DEFINTIONS
+ ****************************************************************************************
+ */
+
+/// KE TASK element structure
+struct ke_task_elem
+{
+    uint8_t   type;
+    struct ke_task_desc const * p_desc;
+};
+
+/// KE TASK environment structure
+struct ke_task_env_tag
+{
+    uint8_t task_cnt;
+    struct ke_task_elem task_list[KE_TASK_LIST_SIZE];
+};
+
+#if (KE_HANDLER_CACHE_SIZE)
+/// Message handler lookup cache entry
+struct ke_handler_cache_elem
+{
+    /// State handler the lookup was done in (NULL if the entry is empty)
+    struct ke_state_handler const *state_handler;
+    /// Message identifier
+    ke_msg_id_t id;
+    /// Result of the lookup (may be NULL if the message is not handled in this table)
+    ke_msg_func_t func;
+};
+
+/// Message handler lookup cache
+struct ke_handler_cache_tag
+{
+    struct ke_handler_cache_elem elem[KE_HANDLER_CACHE_SIZE];
+
+    #if (KE_PROFILING)
+    /// Number of lookups served by the cache
+    uint32_t hit_cnt;
+    /// Number of lookups that required to parse the handler table
+    uint32_t miss_cnt;
+    #endif //KE_PROFILING
+};
+#endif //KE_HANDLER_CACHE_SIZE
+
+
+/*
+ * GLOBAL VARIABLES
+ ****************************************************************************************
+ */
+
+/// KE TASK environment
+struct ke_task_env_tag ke_task_env;
+
+#if (KE_HANDLER_CACHE_SIZE)
+/// Message handler lookup cache
+static struct ke_handler_cache_tag ke_handler_cache;
+#endif //KE_HANDLER_CACHE_SIZE
+
+
+/*
+ * LOCAL FUNCTION DEFINITIONS
+ ****************************************************************************************
+ */
+
+/**
+ ****************************************************************************************
+ * @brief Search message handler function matching the msg id
+ *
+ * @param[in] msg_id        Message identifier
+ * @param[in] state_handler Pointer to the state handler
+ *
+ * @return                  Pointer to the message handler (NULL if not found)
+ *
+ ****************************************************************************************
+ */
+static ke_msg_func_t ke_handler_search(ke_msg_id_t const msg_id, struct ke_state_handler const *state_handler)
+{
+    // Get the message handler function by parsing the message table
+    for (int i = (state_handler->msg_cnt-1); 0 <= i; i--)
+    {
+        if ((state_handler->msg_table[i].id == msg_id)
+                || (state_handler->msg_table[i].id == KE_MSG_DEFAULT_HANDLER))
+        {
+            // If handler is NULL, message should not have been received in this state
+            ASSERT_ERR(state_handler->msg_table[i].func);
+
+            return state_handler->msg_table[i].func;
+        }
+    }
+
+    // If we execute this line of code, it means that we did not find the handler
+    return NULL;
+}
+
+#if (KE_HANDLER_CACHE_SIZE)
+/**
+ ****************************************************************************************
+ * @brief Search message handler function matching the msg id, using the lookup cache.
+ *
+ * The handler tables are constant, so the result of a lookup only depends on the
+ * state handler and on the message id: it is kept in a direct-mapped cache and the
+ * table is only parsed on a cache miss. Messages that are not handled in the table
+ * are cached too, so falling back to the default handler costs one more cache access.
+ *
+ * @param[in] msg_id        Message identifier
+ * @param[in] state_handler Pointer to the state handler
+ *
+ * @return                  Pointer to the message handler (NULL if not found)
+ ****************************************************************************************
+ */
+static ke_msg_func_t ke_handler_cached_search(ke_msg_id_t const msg_id, struct ke_state_handler const *state_handler)
+{
+    // Mix the message index, the task of the message and the table address
+    uint32_t hash = msg_id ^ (msg_id >> 7) ^ (((uint32_t)(uintptr_t) state_handler) >> 3);
+    struct ke_handler_cache_elem *elem = &ke_handler_cache.elem[hash & (KE_HANDLER_CACHE_SIZE - 1)];
+
+    if ((elem->state_handler != state_handler) || (elem->id != msg_id))
+    {
+        #if (KE_PROFILING)
+        ke_handler_cache.miss_cnt++;
+        #endif //KE_PROFILING
+
+        elem->func = ke_handler_search(msg_id, state_handler);
+        elem->id = msg_id;
+        elem->state_handler = state_handler;
+    }
+    #if (KE_PROFILING)
+    else
+    {
+        ke_handler_cache.hit_cnt++;
+    }
+    #endif //KE_PROFILING
+
+    return elem->func;
+}
+#else
+#define ke_handler_cached_search(msg_id, state_handler)     ke_handler_search(msg_id, state_handler)
+#endif //KE_HANDLER_CACHE_SIZE
+
+/**
+ ****************************************************************************************
+ * @brief Retrieve the descriptor of a task type
+ *
+ * @param[in]  type     Task type
+ *
+ * @return              Pointer to the task descriptor (NULL if not found)
+ ****************************************************************************************
+ */
+static struct ke_task_desc const * ke_task_desc_get(uint8_t const type)
+{
+    uint8_t hdl;
+
+    // Search task handle
+    for(hdl = 0; hdl < ke_task_env.task_cnt; hdl++)
+    {
+        if(ke_task_env.task_list[hdl].type == type)
+        {
+            return ke_task_env.task_list[hdl].p_desc;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ ****************************************************************************************
+ * @brief Retrieve appropriate message handler function of a task
+ *
+ * @param[in]  msg_id   Message identifier
+ * @param[in]  task_id  Task instance identifier
+ *
+ * @return              Pointer to the message handler (NULL if not found)
+ *
+ ****************************************************************************************
+ */
+static ke_msg_func_t ke_task_handler_get(ke_msg_id_t const msg_id, ke_task_id_t const task_id)
+{
+    ke_msg_func_t func = NULL;
+    int idx = KE_IDX_GET(task_id);
+    struct ke_task_desc const * p_task_desc = ke_task_desc_get(KE_TYPE_GET(task_id));
+
+    ASSERT_INFO(p_task_desc != NULL, task_id, msg_id);
+
+    // If the task or the idx found is out of range return NULL
+    if((p_task_desc != NULL) && (idx < p_task_desc->idx_max))
+    {
+        // Retrieve a pointer to the task instance data
+        if (p_task_desc->state_handler)
+        {
+            func = ke_handler_cached_search(msg_id, p_task_desc->state_handler + p_task_desc->state[idx]);
+        }
+
+        // No handler... need to retrieve the default one
+        if (func == NULL && p_task_desc->default_handler)
+        {
+            func = ke_handler_cached_search(msg_id, p_task_desc->default_handler);
+        }
+    }
+
+    return func;
+}
+
+/**
+ ****************************************************************************************
+ * @brief Scheduler entry point.
+ *
+ * This function is the scheduler of messages. It tries to get a message
+ * from the sent queue, then try to get the appropriate message handler
+ * function (from the current state, or the default one). This function
+ * is called, then the message is saved or freed.
+ ****************************************************************************************
+ */
+static void ke_task_schedule(void)
+{
+    // Process one message at a time to ensure that events having higher priority are
+    // handled in time
+    do
+    {
+        int msg_status;
+        struct ke_msg *msg;
+        ke_msg_func_t func;
+
+        // Get a message from the queue
+        GLOBAL_INT_DISABLE();
+        msg = (struct ke_msg*) ke_queue_pop(&ke_env.queue_sent);
+        GLOBAL_INT_RESTORE();
+        if (msg == NULL) break;
+
+        // Retrieve a pointer to the task instance data
+        func = ke_task_handler_get(msg->id, msg->dest_id);
+
+        // sanity check
+        ASSERT_WARN(func != NULL);
+
+        // Call the message handler
+        if (func != NULL)
+        {
+            msg_status = func(msg->id, ke_msg2param(msg), msg->dest_id, msg->src_id);
+        }
+        else
+        {
+            msg_status = KE_MSG_CONSUMED;
+        }
+
+        switch (msg_status)
+        {
+        case KE_MSG_CONSUMED:
+            // Free the message
+            ke_msg_free(msg);
+            break;
+
+        case KE_MSG_NO_FREE:
+            break;
+
+        case KE_MSG_SAVED:
+            // The message has been saved
+            // Insert it at the end of the save queue
+            ke_queue_push(&ke_env.queue_saved, (struct co_list_hdr*) msg);
+            break;
+
+        default:
+            ASSERT_ERR(0);
+            break;
+        } // switch case
+    } while(0);
+
+    // Verify if we can clear the event bit
+    GLOBAL_INT_DISABLE();
+    if (co_list_is_empty(&ke_env.queue_sent))
+        ke_event_clear(KE_EVENT_KE_MESSAGE);
+    GLOBAL_INT_RESTORE();
+}
+
+/**
+ ****************************************************************************************
+ * @brief Compare destination task callback.
+ *
+ * @param[in] msg          kernel message
+ * @param[in] dest_id      destination id
+ *
+ * @return bool
+ ****************************************************************************************
+ */
+static bool cmp_dest_id(struct co_list_hdr const * msg, uint32_t dest_id)
+{
+    return ((struct ke_msg*)msg)->dest_id == dest_id;
+}
+
+/**
+ ****************************************************************************************
+ * @brief Reactivation of saved messages.
+ *
+ * This primitive looks for all the messages destined to the task ke_task_id that
+ * have been saved and inserts them into the sent priority queue. These
+ * messages will be scheduled at the next scheduler pass.
+ *
+ * @param[in] ke_task_id    Destination Identifier
+ ****************************************************************************************
+ */
+static void ke_task_saved_update(ke_task_id_t const ke_task_id)
+{
+    struct ke_msg * msg;
+
+    for(;;)
+    {
+        // if the state has changed look in the Save queue if a message
+        // need to be handled
+        msg = (struct ke_msg*) ke_queue_extract(&ke_env.queue_saved,
+                                                &cmp_dest_id,
+                                                (uint32_t) ke_task_id);
+
+        if (msg == NULL) break;
+
+        // Insert it back in the sent queue
+        GLOBAL_INT_DISABLE();
+        ke_queue_push(&ke_env.queue_sent, (struct co_list_hdr*)msg);
+        GLOBAL_INT_RESTORE();
+
+        // trigger the event
+        ke_event_set(KE_EVENT_KE_MESSAGE);
+    }
+}
+
+
+/*
+ * EXPORTED FUNCTION DEFINITIONS
+ ****************************************************************************************
+ */
+
+void ke_task_init_func(void)
+{
+    memset(&ke_task_env, 0, sizeof(ke_task_env));
+
+    #if (KE_HANDLER_CACHE_SIZE)
+    memset(&ke_handler_cache, 0, sizeof(ke_handler_cache));
+    #endif //KE_HANDLER_CACHE_SIZE
+
+    // Register message event
+    ke_event_callback_set(KE_EVENT_KE_MESSAGE, &ke_task_schedule);
+}
+
+void ke_task_init(void)
+{
+    ke_task_init_func();
+}
+
+uint8_t ke_task_create(uint8_t task_type, struct ke_task_desc const * p_task_desc)
+{
+    uint8_t status = KE_TASK_OK;
+    uint8_t curr_nb = ke_task_env.task_cnt;
+
+    do
+    {
+        if (ke_task_desc_get(task_type) != NULL)
+        {
+            status = KE_TASK_ALREADY_EXISTS;
+            break;
+        }
+
+        ASSERT_INFO(curr_nb < KE_TASK_LIST_SIZE, curr_nb, KE_TASK_LIST_SIZE);
+
+        if(curr_nb >= KE_TASK_LIST_SIZE)
+        {
+            status = KE_TASK_CAPA_EXCEEDED;
+            break;
+        }
+
+        // Save task ID and descriptor
+        ke_task_env.task_list[curr_nb].type = task_type;
+        ke_task_env.task_list[curr_nb].p_desc = p_task_desc;
+
+        // Increment number of tasks
+        ke_task_env.task_cnt = curr_nb + 1;
+
+    } while(0);
+
+    return status;
+}
+
+uint8_t ke_task_delete(uint8_t task_type)
+{
+    uint8_t status = KE_TASK_UNKNOWN;
+    uint8_t hdl;
+
+    for(hdl = 0; hdl < ke_task_env.task_cnt; hdl++)
+    {
+        if(ke_task_env.task_list[hdl].type == task_type)
+        {
+            // Move the last task in the freed slot
+            ke_task_env.task_cnt--;
+            ke_task_env.task_list[hdl] = ke_task_env.task_list[ke_task_env.task_cnt];
+            status = KE_TASK_OK;
+            break;
+        }
+    }
+
+    return status;
+}
+
+void ke_state_set(ke_task_id_t const id, ke_state_t const state_id)
+{
+    int idx = KE_IDX_GET(id);
+    struct ke_task_desc const * p_task_desc = ke_task_desc_get(KE_TYPE_GET(id));
+
+    ASSERT_INFO(p_task_desc != NULL, id, state_id);
+
+    // If the task or the idx found is out of range do nothing
+    if((p_task_desc != NULL) && (idx < p_task_desc->idx_max))
+    {
+        ke_state_t *ke_stateid_ptr = &p_task_desc->state[idx];
+
+        // set the state
+        if (*ke_stateid_ptr != state_id)
+        {
+            *ke_stateid_ptr = state_id;
+
+            // if the state has changed update the SAVE queue
+            ke_task_saved_update(id);
+        }
+    }
+}
+
+ke_state_t ke_state_get(ke_task_id_t const id)
+{
+    int idx = KE_IDX_GET(id);
+    struct ke_task_desc const * p_task_desc = ke_task_desc_get(KE_TYPE_GET(id));
+
+    ASSERT_INFO(p_task_desc != NULL, id, 0);
+    ASSERT_INFO((idx < p_task_desc->idx_max), idx, p_task_desc->idx_max);
+
+    // Get the state
+    return p_task_desc->state[idx];
+}
+
+int ke_msg_discard(ke_msg_id_t const msgid, void const *param,
+                   ke_task_id_t const dest_id, ke_task_id_t const src_id)
+{
+    return KE_MSG_CONSUMED;
+}
+
+int ke_msg_save(ke_msg_id_t const msgid, void const *param,
+                ke_task_id_t const dest_id, ke_task_id_t const src_id)
+{
+    return KE_MSG_SAVED;
+}
+#endif //KE_HOST
+
+/// @} TASK
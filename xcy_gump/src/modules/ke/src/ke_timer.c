@@ -0,0 +1,379 @@
+/**
+ ****************************************************************************************
+ *
+ * @file ke_timer.c
+ *
+ * @brief This file contains the scheduler primitives called to create or delete
+ * a timer.
+ *
+ * On target the kernel is provided by the ROM. This file is only compiled by the host
+ * build of the kernel (CFG_KE_HOST), where the BLE gross target timer is replaced by
+ * the monotonic clock of the host and polled by ke_timer_hw_poll().
+ *
+ * Copyright (C) RivieraWaves 2009-2013
+ *
+ *
+ ****************************************************************************************
+ */
+
+/**
+ ****************************************************************************************
+ * @addtogroup TIMER
+ * @{
+ ****************************************************************************************
+ */
+
+/*
+ * INCLUDE FILES
+ ****************************************************************************************
+ */
+#include "rwip_config.h"       // stack configuration
+
+#include <stddef.h>            // standard definition
+#include <stdint.h>            // standard integer
+#include <stdbool.h>           // standard boolean
+#include <time.h>              // host monotonic clock
+
+#include "arch.h"              // architecture
+#include "ke_config.h"         // kernel configuration
+#include "ke_timer.h"          // kernel timer
+#include "ke_env.h"            // kernel environment
+#include "ke_queue.h"          // kernel queue
+#include "ke_event.h"          // kernel event
+#include "ke_mem.h"            // kernel memory
+#include "ke_task.h"           // kernel task
+
+#if (KE_HOST)
+
+/*
+ * DEFINES
+ ****************************************************************************************
+ */
+
+/// Mask applied on time differences, see cmp_abs_time() patch in arch_main.c
+#define KE_TIMER_TIME_MASK      (0xFFFF)
+
+
+/*
+ * GLOBAL VARIABLES
+ ****************************************************************************************
+ */
+
+/// Simulated kernel time, used instead of the monotonic clock once ke_time_sim_set() is called
+static struct
+{
+    bool enabled;
+    uint32_t time;
+} ke_time_sim;
+
+#if !(KE_TIMER_WHEEL)
+/// Programmed "hardware" target: first timer of the queue (NULL when disarmed)
+static struct ke_timer *ke_timer_hw_target;
+
+
+/*
+ * LOCAL FUNCTION DEFINITIONS
+ ****************************************************************************************
+ */
+
+/**
+ ****************************************************************************************
+ * @brief Compare timer absolute expiration time.
+ *
+ * @param[in] timerA Timer to compare.
+ * @param[in] timerB Timer to compare.
+ *
+ * @return true if timerA will expire before timerB.
+ ****************************************************************************************
+ */
+static bool cmp_abs_time(struct co_list_hdr const * timerA, struct co_list_hdr const * timerB)
+{
+    uint32_t timeA = ((struct ke_timer*)timerA)->time;
+    uint32_t timeB = ((struct ke_timer*)timerB)->time;
+
+    return (((uint32_t)((timeA - timeB) & KE_TIMER_TIME_MASK)) > KE_TIMER_DELAY_MAX);
+}
+
+/**
+ ****************************************************************************************
+ * @brief Compare timer and task IDs callback
+ *
+ * @param[in] timer           Timer value
+ * @param[in] timer_task      Timer task
+ *
+ * @return true if timer ID and task ID match, false otherwise.
+ ****************************************************************************************
+ */
+static bool cmp_timer_id(struct co_list_hdr const * timer, uint32_t timer_task)
+{
+    // trick to pack 2 u16 in u32
+    ke_msg_id_t timer_id = timer_task >> 16;
+    ke_task_id_t task_id = timer_task & 0xFFFF;
+
+    // insert the timer just before the first one older
+    return (timer_id == ((struct ke_timer*)timer)->id)
+        && (task_id == ((struct ke_timer*)timer)->task);
+}
+
+/**
+ ****************************************************************************************
+ * @brief Check if the requested time has already passed.
+ *
+ * @param[in] time  Absolute time in 10ms units.
+ *
+ * @return true if the time is reached.
+ ****************************************************************************************
+ */
+static bool ke_time_past(uint32_t time)
+{
+    return (((ke_time() - time) & KE_TIMER_TIME_MASK) <= KE_TIMER_DELAY_MAX);
+}
+
+/**
+ ****************************************************************************************
+ * @brief Program the timer "hardware" with the first timer of the queue.
+ *
+ * @param[in] timer   First timer of the queue, NULL to disarm.
+ ****************************************************************************************
+ */
+static void ke_timer_hw_set(struct ke_timer *timer)
+{
+    ke_timer_hw_target = timer;
+}
+
+/**
+ ****************************************************************************************
+ * @brief Schedule the next timer(s).
+ *
+ * This function pops the first timer from the timer queue and notifies the appropriate
+ * task by sending a kernel message. The function checks also the next timers
+ * and process them if they have expired.
+ ****************************************************************************************
+ */
+static void ke_timer_schedule(void)
+{
+    for(;;)
+    {
+        struct ke_timer *timer;
+
+        ke_event_clear(KE_EVENT_KE_TIMER);
+
+        // check the next timer
+        timer = (struct ke_timer*) ke_env.queue_timer.first;
+        if (!timer)
+        {
+            // no more timers, disable HW irq and leave
+            ke_timer_hw_set(NULL);
+            break;
+        }
+
+        if (!ke_time_past(timer->time))
+        {
+            // timer will expire later, rearm and leave
+            ke_timer_hw_set(timer);
+            break;
+        }
+
+        // at this point, the next timer in the queue has expired: remove it
+        timer = (struct ke_timer*) ke_queue_pop(&ke_env.queue_timer);
+
+        // notify the task
+        ke_msg_send_basic(timer->id, timer->task, TASK_NONE);
+
+        // free the memory allocated for the timer
+        ke_free(timer);
+    }
+}
+
+#endif //KE_TIMER_WHEEL
+
+
+/*
+ * EXPORTED FUNCTION DEFINITIONS
+ ****************************************************************************************
+ */
+
+void ke_time_sim_set(uint32_t time)
+{
+    ke_time_sim.enabled = true;
+    ke_time_sim.time = time;
+}
+
+uint32_t ke_time(void)
+{
+    struct timespec now;
+
+    if (ke_time_sim.enabled)
+        return ke_time_sim.time;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    // Kernel time is counted in 10ms units
+    return (uint32_t)(now.tv_sec * 100 + now.tv_nsec / 10000000);
+}
+
+#if !(KE_TIMER_WHEEL)
+
+void ke_timer_init(void)
+{
+    ke_timer_hw_target = NULL;
+
+    // Register timer event
+    ke_event_callback_set(KE_EVENT_KE_TIMER, &ke_timer_schedule);
+}
+
+void ke_timer_hw_poll(void)
+{
+    if ((ke_timer_hw_target != NULL) && ke_time_past(ke_timer_hw_target->time))
+    {
+        // Equivalent of the gross target timer interrupt
+        ke_timer_hw_target = NULL;
+        ke_event_set(KE_EVENT_KE_TIMER);
+    }
+}
+
+void ke_timer_set(ke_msg_id_t const timer_id, ke_task_id_t const task_id, uint16_t const delay)
+{
+    // Indicate if the HW will have to be reprogrammed
+    bool hw_prog = false;
+    // Timer time
+    uint32_t abs_time;
+    struct ke_timer *timer;
+
+    // Check if requested timer is first of the list of pending timer
+    struct ke_timer *first = (struct ke_timer *) ke_env.queue_timer.first;
+
+    // Delay shall not be more than maximum allowed
+    ASSERT_ERR(delay <= KE_TIMER_DELAY_MAX);
+
+    // Delay should not be zero
+    ASSERT_WARN(delay != 0);
+
+    if(first != NULL)
+    {
+        if ((first->id == timer_id) && (first->task == task_id))
+        {
+            // Indicate that the HW timer will have to be reprogrammed
+            hw_prog = true;
+        }
+    }
+
+    // Extract the timer from the list if required
+    timer = (struct ke_timer*)
+        ke_queue_extract(&ke_env.queue_timer, cmp_timer_id, (uint32_t)timer_id << 16 | task_id);
+
+    if (timer == NULL)
+    {
+        // Create new one
+        timer = (struct ke_timer*) ke_malloc(sizeof(struct ke_timer), KE_MEM_KE_MSG);
+        ASSERT_ERR(timer);
+        timer->id = timer_id;
+        timer->task = task_id;
+    }
+
+    // update characteristics, a null delay is rounded up to one tick
+    abs_time = ke_time() + ((delay != 0) ? delay : 1);
+    timer->time = abs_time;
+
+    // insert in sorted timer list
+    ke_queue_insert(&ke_env.queue_timer, (struct co_list_hdr*) timer, cmp_abs_time);
+
+    // check if HW timer set needed
+    if (hw_prog || (ke_env.queue_timer.first == (struct co_list_hdr*) timer))
+    {
+        ke_timer_hw_set((struct ke_timer *)ke_env.queue_timer.first);
+    }
+}
+
+void ke_timer_clear(ke_msg_id_t const timer_id, ke_task_id_t const task_id)
+{
+    struct ke_timer *timer = (struct ke_timer *) ke_env.queue_timer.first;
+
+    if (ke_env.queue_timer.first != NULL)
+    {
+        if ((timer->id == timer_id) && (timer->task == task_id))
+        {
+            // timer found and first to expire! pop it
+            ke_queue_pop(&ke_env.queue_timer);
+
+            // and reprogram the HW timer with the next one
+            ke_timer_hw_set((struct ke_timer *)ke_env.queue_timer.first);
+        }
+        else
+        {
+            timer = (struct ke_timer *)
+                ke_queue_extract(&ke_env.queue_timer, cmp_timer_id,
+                        (uint32_t)timer_id << 16 | task_id);
+        }
+
+        if (timer != NULL)
+        {
+            // free the cleared timer
+            ke_free(timer);
+        }
+    }
+}
+
+bool ke_timer_active(ke_msg_id_t const timer_id, ke_task_id_t const task_id)
+{
+    struct ke_timer *timer;
+
+    // check the next timer
+    timer = (struct ke_timer*) ke_env.queue_timer.first;
+
+    // scan the timer queue to look for a message element with the same id and destination
+    while (timer != NULL)
+    {
+        if ((timer->id == timer_id) && (timer->task == task_id))
+        {
+            // Timer has been found
+            return true;
+        }
+
+        // Check the next timer
+        timer = timer->next;
+    }
+
+    return false;
+}
+
+#if (DEEP_SLEEP)
+bool ke_timer_sleep_check(uint32_t *sleep_duration, uint32_t wakeup_delay)
+{
+    bool sleep_allowed = true;
+    struct ke_timer *timer = (struct ke_timer*) ke_env.queue_timer.first;
+
+    if (timer != NULL)
+    {
+        // Remaining time before expiration, converted from 10ms units to 625us slots
+        uint32_t remaining = ((timer->time - ke_time()) & KE_TIMER_TIME_MASK);
+
+        if (remaining > KE_TIMER_DELAY_MAX)
+        {
+            // Timer already expired
+            sleep_allowed = false;
+        }
+        else
+        {
+            remaining *= 16;
+
+            if (remaining <= wakeup_delay)
+            {
+                sleep_allowed = false;
+            }
+            else if ((remaining - wakeup_delay) < *sleep_duration)
+            {
+                *sleep_duration = remaining - wakeup_delay;
+            }
+        }
+    }
+
+    return sleep_allowed;
+}
+#endif //DEEP_SLEEP
+
+#endif //KE_TIMER_WHEEL
+
+#endif //KE_HOST
+
+/// @} TIMER
@@ -0,0 +1,391 @@
+/**
+ ****************************************************************************************
+ *
+ * @file ke_timer_wheel.c
+ *
+ * @brief Hashed timer wheel implementation of the kernel timers.
+ *
+ * Copyright (C) RivieraWaves 2009-2013
+ *
+ *
+ ****************************************************************************************
+ */
+
+/**
+ ****************************************************************************************
+ * @addtogroup TIMER
+ *
+ * Timers are hashed on their expiration time into KE_TIMER_WHEEL_SIZE slots of one time
+ * unit, and on their id/task pair into KE_TIMER_HASH_SIZE lookup buckets. Setting and
+ * clearing a timer is O(1), instead of O(n) for the sorted queue: the slot lists are
+ * doubly linked and the lookup buckets are short. Each elapsed time unit costs one slot
+ * visit; timers set further than one wheel revolution are visited once per revolution.
+ * @{
+ ****************************************************************************************
+ */
+
+/*
+ * INCLUDE FILES
+ ****************************************************************************************
+ */
+#include "rwip_config.h"       // stack configuration
+
+#include <stddef.h>            // standard definition
+#include <stdint.h>            // standard integer
+#include <stdbool.h>           // standard boolean
+#include <string.h>            // memset definition
+
+#include "arch.h"              // architecture
+#include "ke_config.h"         // kernel configuration
+#include "ke_timer.h"          // kernel timer
+#include "ke_event.h"          // kernel event
+#include "ke_mem.h"            // kernel memory
+#include "ke_task.h"           // kernel task
+
+#if (KE_TIMER_WHEEL)
+
+/*
+ * DEFINES
+ ****************************************************************************************
+ */
+
+/// Mask applied on time differences, see cmp_abs_time() patch in arch_main.c
+#define KE_TIMER_TIME_MASK      (0xFFFF)
+
+/// Wheel slot of an absolute time
+#define KE_TIMER_SLOT(time)     ((time) & (KE_TIMER_WHEEL_SIZE - 1))
+
+/// Lookup bucket of a timer id/task pair
+#define KE_TIMER_HASH(id, task) (((id) ^ ((id) >> 8) ^ (task) ^ ((task) >> 8)) & (KE_TIMER_HASH_SIZE - 1))
+
+
+/*
+ * GLOBAL VARIABLES
+ ****************************************************************************************
+ */
+
+/// Timer wheel environment
+static struct
+{
+    /// First timer of each slot
+    struct ke_timer *slot[KE_TIMER_WHEEL_SIZE];
+    /// First timer of each lookup bucket
+    struct ke_timer *bucket[KE_TIMER_HASH_SIZE];
+    /// Last time unit processed
+    uint32_t cursor;
+    /// Number of programmed timers
+    uint16_t nb;
+} ke_timer_wheel;
+
+
+/*
+ * LOCAL FUNCTION DEFINITIONS
+ ****************************************************************************************
+ */
+
+/**
+ ****************************************************************************************
+ * @brief Check if the requested time has already passed.
+ *
+ * @param[in] time  Absolute time in 10ms units.
+ * @param[in] now   Current time in 10ms units.
+ *
+ * @return true if the time is reached.
+ ****************************************************************************************
+ */
+static bool ke_time_past(uint32_t time, uint32_t now)
+{
+    return (((now - time) & KE_TIMER_TIME_MASK) <= KE_TIMER_DELAY_MAX);
+}
+
+/**
+ ****************************************************************************************
+ * @brief Look for a programmed timer.
+ *
+ * @param[in] timer_id  Timer identifier.
+ * @param[in] task_id   Task identifier.
+ *
+ * @return The timer, NULL if not programmed.
+ ****************************************************************************************
+ */
+static struct ke_timer *ke_timer_find(ke_msg_id_t const timer_id, ke_task_id_t const task_id)
+{
+    struct ke_timer *timer = ke_timer_wheel.bucket[KE_TIMER_HASH(timer_id, task_id)];
+
+    while ((timer != NULL) && ((timer->id != timer_id) || (timer->task != task_id)))
+    {
+        timer = timer->hash_next;
+    }
+
+    return timer;
+}
+
+/**
+ ****************************************************************************************
+ * @brief Insert a timer in its wheel slot and lookup bucket.
+ *
+ * @param[in] timer  Timer with its expiration time set.
+ ****************************************************************************************
+ */
+static void ke_timer_link(struct ke_timer *timer)
+{
+    struct ke_timer **slot = &ke_timer_wheel.slot[KE_TIMER_SLOT(timer->time)];
+    struct ke_timer **bucket = &ke_timer_wheel.bucket[KE_TIMER_HASH(timer->id, timer->task)];
+
+    timer->prev = NULL;
+    timer->next = *slot;
+    if (*slot != NULL)
+    {
+        (*slot)->prev = timer;
+    }
+    *slot = timer;
+
+    timer->hash_next = *bucket;
+    *bucket = timer;
+
+    ke_timer_wheel.nb++;
+}
+
+/**
+ ****************************************************************************************
+ * @brief Remove a timer from its wheel slot and lookup bucket.
+ *
+ * @param[in] timer  Programmed timer.
+ ****************************************************************************************
+ */
+static void ke_timer_unlink(struct ke_timer *timer)
+{
+    struct ke_timer **bucket = &ke_timer_wheel.bucket[KE_TIMER_HASH(timer->id, timer->task)];
+
+    if (timer->prev != NULL)
+    {
+        timer->prev->next = timer->next;
+    }
+    else
+    {
+        ke_timer_wheel.slot[KE_TIMER_SLOT(timer->time)] = timer->next;
+    }
+    if (timer->next != NULL)
+    {
+        timer->next->prev = timer->prev;
+    }
+
+    while (*bucket != timer)
+    {
+        bucket = &(*bucket)->hash_next;
+    }
+    *bucket = timer->hash_next;
+
+    ke_timer_wheel.nb--;
+}
+
+/**
+ ****************************************************************************************
+ * @brief Free a timer.
+ *
+ * @param[in] timer  Timer removed from the wheel.
+ ****************************************************************************************
+ */
+static void ke_timer_free(struct ke_timer *timer)
+{
+    ke_free(timer);
+}
+
+/**
+ ****************************************************************************************
+ * @brief Process the wheel slots up to the current time.
+ *
+ * Each time unit elapsed since the last call has its slot visited, and the timers of the
+ * slot that have expired notify their task. When more than one revolution has elapsed,
+ * each slot is visited once.
+ ****************************************************************************************
+ */
+static void ke_timer_schedule(void)
+{
+    uint32_t now = ke_time();
+    uint32_t elapsed = (now - ke_timer_wheel.cursor) & KE_TIMER_TIME_MASK;
+    uint32_t tick;
+
+    ke_event_clear(KE_EVENT_KE_TIMER);
+
+    if (elapsed > KE_TIMER_WHEEL_SIZE)
+    {
+        elapsed = KE_TIMER_WHEEL_SIZE;
+    }
+
+    for (tick = 1; (tick <= elapsed) && (ke_timer_wheel.nb != 0); tick++)
+    {
+        struct ke_timer *timer = ke_timer_wheel.slot[KE_TIMER_SLOT(ke_timer_wheel.cursor + tick)];
+
+        while (timer != NULL)
+        {
+            struct ke_timer *next = timer->next;
+
+            if (ke_time_past(timer->time, now))
+            {
+                ke_timer_unlink(timer);
+
+                // notify the task
+                ke_msg_send_basic(timer->id, timer->task, TASK_NONE);
+
+                // free the memory allocated for the timer
+                ke_timer_free(timer);
+            }
+
+            timer = next;
+        }
+    }
+
+    ke_timer_wheel.cursor = now;
+}
+
+
+/*
+ * EXPORTED FUNCTION DEFINITIONS
+ ****************************************************************************************
+ */
+
+void ke_timer_init(void)
+{
+    memset(&ke_timer_wheel, 0, sizeof(ke_timer_wheel));
+    ke_timer_wheel.cursor = ke_time();
+
+    // Register timer event
+    ke_event_callback_set(KE_EVENT_KE_TIMER, &ke_timer_schedule);
+}
+
+void ke_timer_flush(void)
+{
+    uint16_t slot;
+
+    for (slot = 0; slot < KE_TIMER_WHEEL_SIZE; slot++)
+    {
+        while (ke_timer_wheel.slot[slot] != NULL)
+        {
+            struct ke_timer *timer = ke_timer_wheel.slot[slot];
+
+            ke_timer_unlink(timer);
+            ke_timer_free(timer);
+        }
+    }
+}
+
+void ke_timer_hw_poll(void)
+{
+    // Equivalent of a time unit tick interrupt, only needed while timers are programmed
+    if ((ke_timer_wheel.nb != 0) && (ke_time() != ke_timer_wheel.cursor))
+    {
+        ke_event_set(KE_EVENT_KE_TIMER);
+    }
+}
+
+void ke_timer_set(ke_msg_id_t const timer_id, ke_task_id_t const task_id, uint16_t const delay)
+{
+    struct ke_timer *timer;
+
+    // Delay shall not be more than maximum allowed
+    ASSERT_ERR(delay <= KE_TIMER_DELAY_MAX);
+
+    // Delay should not be zero
+    ASSERT_WARN(delay != 0);
+
+    timer = ke_timer_find(timer_id, task_id);
+
+    if (timer != NULL)
+    {
+        ke_timer_unlink(timer);
+    }
+    else
+    {
+        // Create new one
+        timer = (struct ke_timer*) ke_malloc(sizeof(struct ke_timer), KE_MEM_KE_MSG);
+        ASSERT_ERR(timer);
+        timer->id = timer_id;
+        timer->task = task_id;
+    }
+
+    // update characteristics, a null delay is rounded up to one tick
+    timer->time = ke_time() + ((delay != 0) ? delay : 1);
+
+    ke_timer_link(timer);
+}
+
+void ke_timer_clear(ke_msg_id_t const timer_id, ke_task_id_t const task_id)
+{
+    struct ke_timer *timer = ke_timer_find(timer_id, task_id);
+
+    if (timer != NULL)
+    {
+        ke_timer_unlink(timer);
+
+        // free the cleared timer
+        ke_timer_free(timer);
+    }
+}
+
+bool ke_timer_active(ke_msg_id_t const timer_id, ke_task_id_t const task_id)
+{
+    return (ke_timer_find(timer_id, task_id) != NULL);
+}
+
+#if (DEEP_SLEEP)
+bool ke_timer_sleep_check(uint32_t *sleep_duration, uint32_t wakeup_delay)
+{
+    bool sleep_allowed = true;
+    uint32_t elapsed = (ke_time() - ke_timer_wheel.cursor) & KE_TIMER_TIME_MASK;
+    // First expiration, counted from the last processed time unit
+    uint32_t first = KE_TIMER_TIME_MASK;
+    uint32_t tick;
+
+    if (ke_timer_wheel.nb == 0)
+        return sleep_allowed;
+
+    // Parse the slots in expiration order, so that the search stops at the first timer
+    // found, unless it belongs to a later revolution
+    for (tick = 1; tick <= KE_TIMER_WHEEL_SIZE; tick++)
+    {
+        struct ke_timer *timer;
+
+        for (timer = ke_timer_wheel.slot[KE_TIMER_SLOT(ke_timer_wheel.cursor + tick)];
+             timer != NULL; timer = timer->next)
+        {
+            uint32_t expiry = (timer->time - ke_timer_wheel.cursor) & KE_TIMER_TIME_MASK;
+
+            if (expiry < first)
+            {
+                first = expiry;
+            }
+        }
+
+        // Nothing expires earlier than the slot being parsed
+        if (first <= tick)
+            break;
+    }
+
+    if (first <= elapsed)
+    {
+        // Timer already expired
+        sleep_allowed = false;
+    }
+    else
+    {
+        // Remaining time converted from 10ms units to 625us slots
+        uint32_t remaining = (first - elapsed) * 16;
+
+        if (remaining <= wakeup_delay)
+        {
+            sleep_allowed = false;
+        }
+        else if ((remaining - wakeup_delay) < *sleep_duration)
+        {
+            *sleep_duration = remaining - wakeup_delay;
+        }
+    }
+
+    return sleep_allowed;
+}
+#endif //DEEP_SLEEP
+
+#endif //KE_TIMER_WHEEL
+
+/// @} TIMER
@@ -28,9 +28,11 @@
  *       alignment on 32 bit boundary
  *       if set, all the TAG header structures and TAG data contents are stored
  *       consecutively without gaps (as would be a structure with pragma packed)
- *     + NVDS_READ_WRITE :
+ *     + NVDS_READ_WRITE (CFG_NVDS_READ_WRITE) :
  *       if not set, only GET action on TAGs is provided.
- *       if set, PUT/DEL/LOCK actions are provided in addition of GET action.
+ *       if set, PUT/DEL/LOCK actions are provided in addition of GET action. The TAGs
+ *       written at run time are stored in a log in SPI flash and take precedence over
+ *       the NVDS storage area.
  *
  * @{
  ****************************************************************************************
@@ -50,7 +52,11 @@
  */
 
 /// NVDS is defined as read-write
-#define NVDS_READ_WRITE          0 //1
+#ifdef CFG_NVDS_READ_WRITE
+#define NVDS_READ_WRITE          1
+#else
+#define NVDS_READ_WRITE          0
+#endif
 
 /// NVDS is defined as packed
 #define NVDS_PACKED              0//1
@@ -195,6 +201,10 @@ enum NVDS_TAG
 
     NVDS_TAG_BLE_LINK_KEY_FIRST         = 0x70,
     NVDS_TAG_BLE_LINK_KEY_LAST          = 0x7F,
+
+    /// Attribute database image (CFG_APP_DB_IMAGE): header, then the chunks
+    NVDS_TAG_APP_DB_IMAGE_FIRST         = 0x80,
+    NVDS_TAG_APP_DB_IMAGE_LAST          = 0x90,
 };
 
 /// List of NVDS Tag lengths
@@ -334,20 +344,107 @@ uint8_t nvds_get(uint8_t tag, nvds_tag_len_t * lengthPtr, uint8_t *buf);
 
 uint8_t custom_nvds_get_func(uint8_t tag, nvds_tag_len_t * lengthPtr, uint8_t *buf);
 
+/**
+ ****************************************************************************************
+ * @brief Look for a specific tag and return, if found, a pointer to its DATA part in the
+ *        NVDS storage area (no copy, no check of the caller's buffer length).
+ *
+ * @param[in]  tag        TAG to look for
+ * @param[out] lengthPtr  Actual length of the TAG
+ * @param[out] data       Pointer to the DATA part of the TAG
+ *
+ * @return  NVDS_OK                  The TAG is defined and valid
+ *          NVDS_FAIL                The TAG is not stored or not valid
+ ****************************************************************************************
+ */
+uint8_t nvds_get_ptr(uint8_t tag, nvds_tag_len_t * lengthPtr, uint8_t const **data);
+
 #if (NVDS_READ_WRITE == 1)
 
+/// First address of the NVDS log in SPI flash (sector aligned)
+#ifndef NVDS_FLASH_BASE
+#define NVDS_FLASH_BASE          (0x1C000)
+#endif
+
+/// Number of sectors of the NVDS log (2 at least), used in turn
+#ifndef NVDS_FLASH_SECTORS
+#define NVDS_FLASH_SECTORS       (4)
+#endif
+
+/// SPI flash sector size
+#define NVDS_FLASH_SECTOR_SIZE   (4096)
+
+/// TAGs of the attribute database image, written when CFG_APP_DB_IMAGE is defined
+#ifdef CFG_APP_DB_IMAGE
+#define NVDS_FLASH_TAGS_APP_DB_IMAGE                                                        \
+    , NVDS_TAG_APP_DB_IMAGE_FIRST + 0x0,                                                    \
+    NVDS_TAG_APP_DB_IMAGE_FIRST + 0x1, NVDS_TAG_APP_DB_IMAGE_FIRST + 0x2,                   \
+    NVDS_TAG_APP_DB_IMAGE_FIRST + 0x3, NVDS_TAG_APP_DB_IMAGE_FIRST + 0x4,                   \
+    NVDS_TAG_APP_DB_IMAGE_FIRST + 0x5, NVDS_TAG_APP_DB_IMAGE_FIRST + 0x6,                   \
+    NVDS_TAG_APP_DB_IMAGE_FIRST + 0x7, NVDS_TAG_APP_DB_IMAGE_FIRST + 0x8,                   \
+    NVDS_TAG_APP_DB_IMAGE_FIRST + 0x9, NVDS_TAG_APP_DB_IMAGE_FIRST + 0xA,                   \
+    NVDS_TAG_APP_DB_IMAGE_FIRST + 0xB, NVDS_TAG_APP_DB_IMAGE_FIRST + 0xC,                   \
+    NVDS_TAG_APP_DB_IMAGE_FIRST + 0xD, NVDS_TAG_APP_DB_IMAGE_FIRST + 0xE,                   \
+    NVDS_TAG_APP_DB_IMAGE_FIRST + 0xF, NVDS_TAG_APP_DB_IMAGE_FIRST + 0x10
+#else
+#define NVDS_FLASH_TAGS_APP_DB_IMAGE
+#endif
+
+/// TAGs that can be written, each one costs 2 bytes of retention RAM (index of the log)
+#ifndef NVDS_FLASH_TAGS
+#define NVDS_FLASH_TAGS                                                                     \
+    NVDS_TAG_NEB_ID,                                                                        \
+    NVDS_TAG_BLE_LINK_KEY_FIRST + 0x0, NVDS_TAG_BLE_LINK_KEY_FIRST + 0x1,                   \
+    NVDS_TAG_BLE_LINK_KEY_FIRST + 0x2, NVDS_TAG_BLE_LINK_KEY_FIRST + 0x3,                   \
+    NVDS_TAG_BLE_LINK_KEY_FIRST + 0x4, NVDS_TAG_BLE_LINK_KEY_FIRST + 0x5,                   \
+    NVDS_TAG_BLE_LINK_KEY_FIRST + 0x6, NVDS_TAG_BLE_LINK_KEY_FIRST + 0x7,                   \
+    NVDS_TAG_BLE_LINK_KEY_FIRST + 0x8, NVDS_TAG_BLE_LINK_KEY_FIRST + 0x9,                   \
+    NVDS_TAG_BLE_LINK_KEY_FIRST + 0xA, NVDS_TAG_BLE_LINK_KEY_FIRST + 0xB,                   \
+    NVDS_TAG_BLE_LINK_KEY_FIRST + 0xC, NVDS_TAG_BLE_LINK_KEY_FIRST + 0xD,                   \
+    NVDS_TAG_BLE_LINK_KEY_FIRST + 0xE, NVDS_TAG_BLE_LINK_KEY_FIRST + 0xF                    \
+    NVDS_FLASH_TAGS_APP_DB_IMAGE
+#endif
+
+/**
+ ****************************************************************************************
+ * @brief Mount the NVDS log: find the current sector and index its TAGs. The SPI and the
+ *        SPI flash must have been initialized with spi_init() and spi_flash_init().
+ *        Called by app_init(), the project sets up the SPI flash in periph_init().
+ *
+ * @return NVDS_OK, NVDS_FAIL if the flash cannot be accessed
+ ****************************************************************************************
+ */
+uint8_t nvds_flash_init(void);
+
+/**
+ ****************************************************************************************
+ * @brief Look for a TAG written at run time.
+ *
+ * @param[in]     tag        TAG to look for
+ * @param[in,out] lengthPtr  Size of buf, actual length of the TAG
+ * @param[out]    buf        Buffer filled with the DATA part of the TAG
+ *
+ * @return NVDS_OK                   The TAG was read
+ *         NVDS_TAG_NOT_DEFINED      The TAG has never been written
+ *         NVDS_FAIL                 The TAG has been deleted or cannot be read
+ *         NVDS_LENGTH_OUT_OF_RANGE  buf is too small
+ ****************************************************************************************
+ */
+uint8_t nvds_flash_get(uint8_t tag, nvds_tag_len_t * lengthPtr, uint8_t *buf);
+
 /**
  ****************************************************************************************
  * @brief Look for a specific tag and delete it (Status set to invalid)
  *
- * Implementation notes
- * 1. The write function call return status is not handled
+ * A deletion record is appended to the log, the TAG is then undefined, including when
+ * the NVDS storage area holds a value for it.
  *
  * @param[in]  tag    TAG to mark as deleted
  *
- * @return NVDS_OK                TAG found and deleted
- *         NVDS_PARAM_LOCKED    TAG found but can not be deleted because it is locked
- *         (others)        return values from function call @ref nvds_browse_tag
+ * @return NVDS_OK                  TAG deleted
+ *         NVDS_PARAM_LOCKED        TAG found but can not be deleted because it is locked
+ *         NVDS_NO_SPACE_AVAILABLE  The log is full
+ *         NVDS_FAIL                TAG not in NVDS_FLASH_TAGS or flash error
  ****************************************************************************************
  */
 uint8_t nvds_del(uint8_t tag);
@@ -356,12 +453,15 @@ uint8_t nvds_del(uint8_t tag);
  ****************************************************************************************
  * @brief Look for a specific tag and lock it (Status lock bit set to LOCK).
  *
- * The write function call return status is not handled
+ * The current value (written at run time or from the NVDS storage area) is appended to
+ * the log as locked, it can not be changed or deleted anymore.
  *
  * @param[in]  tag    TAG to mark as locked
  *
- * @return NVDS_OK    TAG found and locked
- *         (others)        return values from function call @ref nvds_browse_tag
+ * @return NVDS_OK                  TAG found and locked
+ *         NVDS_TAG_NOT_DEFINED     TAG not found
+ *         NVDS_NO_SPACE_AVAILABLE  The log is full
+ *         NVDS_FAIL                TAG not in NVDS_FLASH_TAGS or flash error
  ****************************************************************************************
  */
 uint8_t nvds_lock(uint8_t tag);
@@ -370,19 +470,10 @@ uint8_t nvds_lock(uint8_t tag);
  ****************************************************************************************
  * @brief This function adds a specific TAG to the NVDS.
  *
- * Steps:
- * 1) parse all the TAGs to:
- * 1.1) calculate the total size of all the valid TAGs
- * 1.2) erase the existing TAGs that have the same ID
- * 1.3) check if we can use the same TAG area in case of an EEPROM
- * 1.4) check that the TAG is not locked
- * 2) if we have to add the new TAG at the end fo the NVDS (cant use same area):
- * 2.1) allocate the appropriate amount of memory
- * 2.2) purge the NVDS
- * 2.3) free the memory allocated
- * 2.4) check that there is now enough room for the new TAG or return
- *      NO_SPACE_AVAILABLE
- * 3) add the new TAG
+ * The TAG is appended to the log in the current sector. When the sector is full, the
+ * live TAGs are first copied to the next sector (compaction), which then becomes the
+ * current one, and the previous sector is erased in the background. A power failure
+ * at any point leaves either the previous or the new value of the TAG.
  *
  * @param[in]  tag     TAG to look for whose DATA is to be retrieved
  * @param[in]  length  Expected length of the TAG
@@ -391,7 +482,8 @@ uint8_t nvds_lock(uint8_t tag);
  *
  * @return NVDS_OK                  New TAG correctly written to the NVDS
  *         NVDS_PARAM_LOCKED        New TAG is trying to overwrite a TAG that is locked
- *         NO_SPACE_AVAILABLE       New TAG can not fit in the available space in the NVDS
+ *         NVDS_NO_SPACE_AVAILABLE  New TAG can not fit in the available space in the NVDS
+ *         NVDS_FAIL                TAG not in NVDS_FLASH_TAGS or flash error
  ****************************************************************************************
  */
 uint8_t nvds_put(uint8_t tag, nvds_tag_len_t length, uint8_t *buf);
@@ -406,6 +498,8 @@ void nvds_read_bdaddr_from_otp(void);
 
 
 #if 1
+/// Layout of the NVDS storage area (nvds_data_storage_area). utilities/nvds_image parses this
+/// declaration to build images, keep one member per line.
 struct nvds_data_struct {
 
 uint32_t 	NVDS_VALIDATION_FLAG;
@@ -435,22 +529,47 @@ uint8_t		NVDS_TAG_BLE_CA_NB_BAD_PKT;
 /// @} NVDS
 
 
-#define BD_ADDRESS_VALID							0x00000001
-#define DEVICE_NAME_VALID							0x00000002
-#define LPCLK_DRIFT_VALID							0x00000004
-#define APP_BLE_ADV_DATA_VALID				0x00000008
-#define APP_BLE_SCAN_RESP_DATA_VALID	0x00000010
-#define UART_BAUDRATE_VALID						0x00000020
-#define SLEEP_ENABLE_VALID						0x00000040
-#define EXT_WAKEUP_ENABLE_VALID				0x00000080
-#define DIAG_BLE_HW_VALID							0x00000100
-#define DIAG_SW_VALID									0x00000200
-#define SECURITY_ENABLE_VALID					0x00000400
-#define NEB_ID_VALID									0x00000800
-#define NVDS_BLE_CA_TIMER_DUR_VALID		0x00001000
-#define NVDS_BLE_CRA_TIMER_DUR_VALID	0x00002000
-#define NVDS_BLE_CA_MIN_RSSI_VALID		0x00004000
-#define NVDS_BLE_CA_NB_PKT_VALID			0x00008000
-#define NVDS_BLE_CA_NB_BAD_PKT_VALID	0x00010000
+/// Position of the tags in NVDS_VALIDATION_FLAG, also the row of the tag in the lookup table
+enum NVDS_VALID_POS
+{
+    NVDS_POS_BD_ADDRESS,
+    NVDS_POS_DEVICE_NAME,
+    NVDS_POS_LPCLK_DRIFT,
+    NVDS_POS_APP_BLE_ADV_DATA,
+    NVDS_POS_APP_BLE_SCAN_RESP_DATA,
+    NVDS_POS_UART_BAUDRATE,
+    NVDS_POS_SLEEP_ENABLE,
+    NVDS_POS_EXT_WAKEUP_ENABLE,
+    NVDS_POS_DIAG_BLE_HW,
+    NVDS_POS_DIAG_SW,
+    NVDS_POS_SECURITY_ENABLE,
+    NVDS_POS_NEB_ID,
+    NVDS_POS_BLE_CA_TIMER_DUR,
+    NVDS_POS_BLE_CRA_TIMER_DUR,
+    NVDS_POS_BLE_CA_MIN_RSSI,
+    NVDS_POS_BLE_CA_NB_PKT,
+    NVDS_POS_BLE_CA_NB_BAD_PKT,
+
+    /// Number of tags stored in struct nvds_data_struct
+    NVDS_POS_MAX
+};
+
+#define BD_ADDRESS_VALID                (1UL << NVDS_POS_BD_ADDRESS)
+#define DEVICE_NAME_VALID               (1UL << NVDS_POS_DEVICE_NAME)
+#define LPCLK_DRIFT_VALID               (1UL << NVDS_POS_LPCLK_DRIFT)
+#define APP_BLE_ADV_DATA_VALID          (1UL << NVDS_POS_APP_BLE_ADV_DATA)
+#define APP_BLE_SCAN_RESP_DATA_VALID    (1UL << NVDS_POS_APP_BLE_SCAN_RESP_DATA)
+#define UART_BAUDRATE_VALID             (1UL << NVDS_POS_UART_BAUDRATE)
+#define SLEEP_ENABLE_VALID              (1UL << NVDS_POS_SLEEP_ENABLE)
+#define EXT_WAKEUP_ENABLE_VALID         (1UL << NVDS_POS_EXT_WAKEUP_ENABLE)
+#define DIAG_BLE_HW_VALID               (1UL << NVDS_POS_DIAG_BLE_HW)
+#define DIAG_SW_VALID                   (1UL << NVDS_POS_DIAG_SW)
+#define SECURITY_ENABLE_VALID           (1UL << NVDS_POS_SECURITY_ENABLE)
+#define NEB_ID_VALID                    (1UL << NVDS_POS_NEB_ID)
+#define NVDS_BLE_CA_TIMER_DUR_VALID     (1UL << NVDS_POS_BLE_CA_TIMER_DUR)
+#define NVDS_BLE_CRA_TIMER_DUR_VALID    (1UL << NVDS_POS_BLE_CRA_TIMER_DUR)
+#define NVDS_BLE_CA_MIN_RSSI_VALID      (1UL << NVDS_POS_BLE_CA_MIN_RSSI)
+#define NVDS_BLE_CA_NB_PKT_VALID        (1UL << NVDS_POS_BLE_CA_NB_PKT)
+#define NVDS_BLE_CA_NB_BAD_PKT_VALID    (1UL << NVDS_POS_BLE_CA_NB_BAD_PKT)
 
 #endif // _NVDS_H_
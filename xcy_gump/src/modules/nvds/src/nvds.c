@@ -71,308 +71,128 @@ extern const struct bd_addr co_null_bdaddr;
 /// Device BD address
 struct bd_addr dev_bdaddr __attribute__((section("retention_mem_area0"), zero_init));
 
-uint8_t custom_nvds_get_func(uint8_t tag, nvds_tag_len_t * lengthPtr, uint8_t *buf)
+/// Lookup table entry of a tag stored in struct nvds_data_struct
+struct nvds_tag_desc
+{
+    /// Offset of the DATA part in struct nvds_data_struct
+    uint8_t offset;
+    /// Length of the TAG, maximum length of a variable length TAG
+    uint8_t len;
+    /// Offset of the length of a variable length TAG, 0 for a fixed length TAG
+    uint8_t len_offset;
+};
+
+#define NVDS_FIXED(field, length)           {offsetof(struct nvds_data_struct, field), (length), 0}
+#define NVDS_VARIABLE(field, length, len_field) \
+                                            {offsetof(struct nvds_data_struct, field), (length), \
+                                             offsetof(struct nvds_data_struct, len_field)}
+
+/// Tags stored in struct nvds_data_struct, indexed by their validation flag position
+static const struct nvds_tag_desc nvds_tag_desc_table[NVDS_POS_MAX] =
 {
+    [NVDS_POS_BD_ADDRESS]             = NVDS_FIXED(NVDS_TAG_BD_ADDRESS, NVDS_LEN_BD_ADDRESS),
+    [NVDS_POS_DEVICE_NAME]            = NVDS_VARIABLE(NVDS_TAG_DEVICE_NAME, NVDS_LEN_DEVICE_NAME, DEVICE_NAME_TAG_LEN),
+    [NVDS_POS_LPCLK_DRIFT]            = NVDS_FIXED(NVDS_TAG_LPCLK_DRIFT, NVDS_LEN_LPCLK_DRIFT),
+    [NVDS_POS_APP_BLE_ADV_DATA]       = NVDS_VARIABLE(NVDS_TAG_APP_BLE_ADV_DATA, NVDS_LEN_APP_BLE_ADV_DATA, ADV_DATA_TAG_LEN),
+    [NVDS_POS_APP_BLE_SCAN_RESP_DATA] = NVDS_VARIABLE(NVDS_TAG_APP_BLE_SCAN_RESP_DATA, NVDS_LEN_APP_BLE_SCAN_RESP_DATA, SCAN_RESP_DATA_TAG_LEN),
+    [NVDS_POS_UART_BAUDRATE]          = NVDS_FIXED(NVDS_TAG_UART_BAUDRATE, NVDS_LEN_UART_BAUDRATE),
+    [NVDS_POS_SLEEP_ENABLE]           = NVDS_FIXED(NVDS_TAG_SLEEP_ENABLE, NVDS_LEN_SLEEP_ENABLE),
+    [NVDS_POS_EXT_WAKEUP_ENABLE]      = NVDS_FIXED(NVDS_TAG_EXT_WAKEUP_ENABLE, NVDS_LEN_EXT_WAKEUP_ENABLE),
+    [NVDS_POS_DIAG_BLE_HW]            = NVDS_FIXED(NVDS_TAG_DIAG_BLE_HW, NVDS_LEN_DIAG_BLE_HW),
+    [NVDS_POS_DIAG_SW]                = NVDS_FIXED(NVDS_TAG_DIAG_SW, NVDS_LEN_DIAG_SW),
+    [NVDS_POS_SECURITY_ENABLE]        = NVDS_FIXED(NVDS_TAG_SECURITY_ENABLE, NVDS_LEN_SECURITY_ENABLE),
+    [NVDS_POS_NEB_ID]                 = NVDS_FIXED(NVDS_TAG_NEB_ID, NVDS_LEN_NEB_ID),
+    [NVDS_POS_BLE_CA_TIMER_DUR]       = NVDS_FIXED(NVDS_TAG_BLE_CA_TIMER_DUR, NVDS_LEN_BLE_CA_TIMER_DUR),
+    [NVDS_POS_BLE_CRA_TIMER_DUR]      = NVDS_FIXED(NVDS_TAG_BLE_CRA_TIMER_DUR, NVDS_LEN_BLE_CRA_TIMER_DUR),
+    [NVDS_POS_BLE_CA_MIN_RSSI]        = NVDS_FIXED(NVDS_TAG_BLE_CA_MIN_RSSI, NVDS_LEN_BLE_CA_MIN_RSSI),
+    [NVDS_POS_BLE_CA_NB_PKT]          = NVDS_FIXED(NVDS_TAG_BLE_CA_NB_PKT, NVDS_LEN_BLE_CA_NB_PKT),
+    [NVDS_POS_BLE_CA_NB_BAD_PKT]      = NVDS_FIXED(NVDS_TAG_BLE_CA_NB_BAD_PKT, NVDS_LEN_BLE_CA_NB_BAD_PKT),
+};
+
+/// Highest tag stored in struct nvds_data_struct, plus one
+#define NVDS_TAG_INDEX_SIZE                 (NVDS_TAG_BLE_CA_NB_BAD_PKT + 1)
+
+/// Row of each tag in nvds_tag_desc_table plus one, 0 if the tag is not stored
+static const uint8_t nvds_tag_index[NVDS_TAG_INDEX_SIZE] =
+{
+    [NVDS_TAG_BD_ADDRESS]             = NVDS_POS_BD_ADDRESS + 1,
+    [NVDS_TAG_DEVICE_NAME]            = NVDS_POS_DEVICE_NAME + 1,
+    [NVDS_TAG_LPCLK_DRIFT]            = NVDS_POS_LPCLK_DRIFT + 1,
+    [NVDS_TAG_APP_BLE_ADV_DATA]       = NVDS_POS_APP_BLE_ADV_DATA + 1,
+    [NVDS_TAG_APP_BLE_SCAN_RESP_DATA] = NVDS_POS_APP_BLE_SCAN_RESP_DATA + 1,
+    [NVDS_TAG_UART_BAUDRATE]          = NVDS_POS_UART_BAUDRATE + 1,
+    [NVDS_TAG_SLEEP_ENABLE]           = NVDS_POS_SLEEP_ENABLE + 1,
+    [NVDS_TAG_EXT_WAKEUP_ENABLE]      = NVDS_POS_EXT_WAKEUP_ENABLE + 1,
+    [NVDS_TAG_DIAG_BLE_HW]            = NVDS_POS_DIAG_BLE_HW + 1,
+    [NVDS_TAG_DIAG_SW]                = NVDS_POS_DIAG_SW + 1,
+    [NVDS_TAG_SECURITY_ENABLE]        = NVDS_POS_SECURITY_ENABLE + 1,
+    [NVDS_TAG_NEB_ID]                 = NVDS_POS_NEB_ID + 1,
+    [NVDS_TAG_BLE_CA_TIMER_DUR]       = NVDS_POS_BLE_CA_TIMER_DUR + 1,
+    [NVDS_TAG_BLE_CRA_TIMER_DUR]      = NVDS_POS_BLE_CRA_TIMER_DUR + 1,
+    [NVDS_TAG_BLE_CA_MIN_RSSI]        = NVDS_POS_BLE_CA_MIN_RSSI + 1,
+    [NVDS_TAG_BLE_CA_NB_PKT]          = NVDS_POS_BLE_CA_NB_PKT + 1,
+    [NVDS_TAG_BLE_CA_NB_BAD_PKT]      = NVDS_POS_BLE_CA_NB_BAD_PKT + 1,
+};
+
+uint8_t nvds_get_ptr(uint8_t tag, nvds_tag_len_t * lengthPtr, uint8_t const **data)
+{
+    const struct nvds_tag_desc *desc;
+    const uint8_t *storage = (const uint8_t *)nvds_data_ptr;
+    uint8_t row;
 
-uint8_t status = NVDS_FAIL;	
-	
-	switch (tag)
-	{
-    case NVDS_TAG_BD_ADDRESS:
 #ifdef BDADDR_FROM_OTP   //check if dev_bdaddr is not zero
-        {
-        if(memcmp(&dev_bdaddr, &co_null_bdaddr, NVDS_LEN_BD_ADDRESS))
-        {
-			memcpy(buf,&dev_bdaddr,NVDS_LEN_BD_ADDRESS);
-            *lengthPtr = NVDS_LEN_BD_ADDRESS;
-            return NVDS_OK;
-        }
-        }
-#endif    
-			if (nvds_data_ptr->NVDS_VALIDATION_FLAG & BD_ADDRESS_VALID)
-			{
-        if (*lengthPtr < NVDS_LEN_BD_ADDRESS)
-        {		
-						*lengthPtr = 0;
-            status = NVDS_LENGTH_OUT_OF_RANGE;
-        }
-        else 
-        {
-					memcpy(buf,nvds_data_ptr->NVDS_TAG_BD_ADDRESS,NVDS_LEN_BD_ADDRESS);
-          *lengthPtr = NVDS_LEN_BD_ADDRESS;
-					status = NVDS_OK;
-        }
-			}
-		break;
-    case NVDS_TAG_DEVICE_NAME:
-			if (nvds_data_ptr->NVDS_VALIDATION_FLAG & DEVICE_NAME_VALID)
-			{
-        if (*lengthPtr < NVDS_LEN_DEVICE_NAME)
-        {		
-						*lengthPtr = 0;
-            status = NVDS_LENGTH_OUT_OF_RANGE;
-        }
-        else 
-        {
-					memcpy(buf,nvds_data_ptr->NVDS_TAG_DEVICE_NAME,nvds_data_ptr->DEVICE_NAME_TAG_LEN);
-          *lengthPtr = nvds_data_ptr->DEVICE_NAME_TAG_LEN;
-					status = NVDS_OK;
-        }
-			}
-		break;
-		case NVDS_TAG_LPCLK_DRIFT:
-			if (nvds_data_ptr->NVDS_VALIDATION_FLAG & LPCLK_DRIFT_VALID)
-			{
-        if (*lengthPtr < NVDS_LEN_LPCLK_DRIFT)
-        {		
-						*lengthPtr = 0;
-            status = NVDS_LENGTH_OUT_OF_RANGE;
-        }
-        else 
-        {
-					memcpy(buf,&nvds_data_ptr->NVDS_TAG_LPCLK_DRIFT,NVDS_LEN_LPCLK_DRIFT);
-          *lengthPtr = NVDS_LEN_LPCLK_DRIFT;
-					status = NVDS_OK;
-        }
-			}
-		break;
-		case   NVDS_TAG_APP_BLE_ADV_DATA: 
-			if (nvds_data_ptr->NVDS_VALIDATION_FLAG & APP_BLE_ADV_DATA_VALID)
-			{
-        if (*lengthPtr < NVDS_LEN_APP_BLE_ADV_DATA)
-        {		
-						*lengthPtr = 0;
-            status = NVDS_LENGTH_OUT_OF_RANGE;
-        }
-        else 
-        {
-					memcpy(buf,nvds_data_ptr->NVDS_TAG_APP_BLE_ADV_DATA,nvds_data_ptr->ADV_DATA_TAG_LEN);
-          *lengthPtr = nvds_data_ptr->ADV_DATA_TAG_LEN;
-					status = NVDS_OK;
-        }
+    if ((tag == NVDS_TAG_BD_ADDRESS) && memcmp(&dev_bdaddr, &co_null_bdaddr, NVDS_LEN_BD_ADDRESS))
+    {
+        *data = (uint8_t const *)&dev_bdaddr;
+        *lengthPtr = NVDS_LEN_BD_ADDRESS;
+        return NVDS_OK;
+    }
+#endif
+
+    row = (tag < NVDS_TAG_INDEX_SIZE) ? nvds_tag_index[tag] : 0;
+    if ((row == 0) || !(nvds_data_ptr->NVDS_VALIDATION_FLAG & (1UL << (row - 1))))
+        return NVDS_FAIL;
+
+    desc = &nvds_tag_desc_table[row - 1];
+    *data = storage + desc->offset;
+    *lengthPtr = desc->len;
 
-			}
-		break;
-    case NVDS_TAG_APP_BLE_SCAN_RESP_DATA:
-			if (nvds_data_ptr->NVDS_VALIDATION_FLAG & APP_BLE_SCAN_RESP_DATA_VALID)
-			{
-				if (*lengthPtr < NVDS_LEN_APP_BLE_SCAN_RESP_DATA)
-        {		
-						*lengthPtr = 0;
-            status = NVDS_LENGTH_OUT_OF_RANGE;
-        }
-        else 
-        {
-					memcpy(buf,nvds_data_ptr->NVDS_TAG_BD_ADDRESS,nvds_data_ptr->SCAN_RESP_DATA_TAG_LEN);
-          *lengthPtr = nvds_data_ptr->SCAN_RESP_DATA_TAG_LEN;
-					status = NVDS_OK;
-        }
+    // variable length TAG, never beyond its field
+    if ((desc->len_offset != 0) && (storage[desc->len_offset] < desc->len))
+        *lengthPtr = storage[desc->len_offset];
 
-			}
-		break;
-		case    NVDS_TAG_UART_BAUDRATE:
-			if (nvds_data_ptr->NVDS_VALIDATION_FLAG & UART_BAUDRATE_VALID)
-			{
-				if (*lengthPtr < NVDS_LEN_UART_BAUDRATE)
-        {		
-						*lengthPtr = 0;
-            status = NVDS_LENGTH_OUT_OF_RANGE;
-        }
-        else 
-        {
-					memcpy(buf,&nvds_data_ptr->NVDS_TAG_UART_BAUDRATE,NVDS_LEN_UART_BAUDRATE);
-          *lengthPtr = NVDS_LEN_UART_BAUDRATE;
-					status = NVDS_OK;
-        }
-			}
-		break;
-		case   NVDS_TAG_SLEEP_ENABLE:
-			if (nvds_data_ptr->NVDS_VALIDATION_FLAG & SLEEP_ENABLE_VALID)
-			{
-				if (*lengthPtr < NVDS_LEN_SLEEP_ENABLE)
-        {		
-						*lengthPtr = 0;
-            status = NVDS_LENGTH_OUT_OF_RANGE;
-        }
-        else 
-        {
-					memcpy(buf,&nvds_data_ptr->NVDS_TAG_SLEEP_ENABLE,NVDS_LEN_SLEEP_ENABLE);
-          *lengthPtr = NVDS_LEN_LPCLK_DRIFT;
-					status = NVDS_OK;
-        }
+    return NVDS_OK;
+}
 
-			}
-		break;
-		case    NVDS_TAG_EXT_WAKEUP_ENABLE:
-			if (nvds_data_ptr->NVDS_VALIDATION_FLAG & EXT_WAKEUP_ENABLE_VALID)
-			{
-				if (*lengthPtr < NVDS_LEN_EXT_WAKEUP_ENABLE)
-        {		
-						*lengthPtr = 0;
-            status = NVDS_LENGTH_OUT_OF_RANGE;
-        }
-        else 
-        {
-					memcpy(buf,&nvds_data_ptr->NVDS_TAG_EXT_WAKEUP_ENABLE,NVDS_LEN_EXT_WAKEUP_ENABLE);
-          *lengthPtr = NVDS_LEN_LPCLK_DRIFT;
-					status = NVDS_OK;
-        }
-			}
-		break;
-		case    NVDS_TAG_DIAG_BLE_HW:
-			if (nvds_data_ptr->NVDS_VALIDATION_FLAG & DIAG_BLE_HW_VALID)
-			{
-				if (*lengthPtr < NVDS_LEN_DIAG_BLE_HW)
-        {		
-						*lengthPtr = 0;
-            status = NVDS_LENGTH_OUT_OF_RANGE;
-        }
-        else 
-        {
-					memcpy(buf,&nvds_data_ptr->NVDS_TAG_DIAG_BLE_HW,NVDS_LEN_DIAG_BLE_HW);
-          *lengthPtr = NVDS_LEN_DIAG_BLE_HW;
-					status = NVDS_OK;
-        }
-			}
-		break;
-		case    NVDS_TAG_DIAG_SW:
-			if (nvds_data_ptr->NVDS_VALIDATION_FLAG & DIAG_SW_VALID)
-			{
-				if (*lengthPtr < NVDS_LEN_DIAG_SW)
-        {		
-						*lengthPtr = 0;
-            status = NVDS_LENGTH_OUT_OF_RANGE;
-        }
-        else 
-        {
-					memcpy(buf,&nvds_data_ptr->NVDS_TAG_DIAG_SW,NVDS_LEN_DIAG_SW);
-          *lengthPtr = NVDS_LEN_DIAG_SW;
-					status = NVDS_OK;
-        }
-			}
-		break;
-		case    NVDS_TAG_SECURITY_ENABLE:
-			if (nvds_data_ptr->NVDS_VALIDATION_FLAG & SECURITY_ENABLE_VALID)
-			{
-				if (*lengthPtr < NVDS_LEN_SECURITY_ENABLE)
-        {		
-						*lengthPtr = 0;
-            status = NVDS_LENGTH_OUT_OF_RANGE;
-        }
-        else 
-        {
-					memcpy(buf,&nvds_data_ptr->NVDS_TAG_SECURITY_ENABLE,NVDS_LEN_SECURITY_ENABLE);
-          *lengthPtr = NVDS_LEN_SECURITY_ENABLE;
-					status = NVDS_OK;
-        }
-			}
-		break;
-		case    NVDS_TAG_NEB_ID:
-			if (nvds_data_ptr->NVDS_VALIDATION_FLAG & NEB_ID_VALID)
-			{
-				if (*lengthPtr < NVDS_LEN_NEB_ID)
-        {		
-						*lengthPtr = 0;
-            status = NVDS_LENGTH_OUT_OF_RANGE;
-        }
-        else 
-        {
-					memcpy(buf,&nvds_data_ptr->NVDS_TAG_NEB_ID,NVDS_LEN_NEB_ID);
-          *lengthPtr = NVDS_LEN_NEB_ID;
-					status = NVDS_OK;
-        }
-			}
-		break;
-#if 1			
-		/// BLE Channel Assessment tags
-    case NVDS_TAG_BLE_CA_TIMER_DUR:
-			if (nvds_data_ptr->NVDS_VALIDATION_FLAG & NVDS_BLE_CA_TIMER_DUR_VALID)
-			{
-				if (*lengthPtr < NVDS_LEN_BLE_CA_TIMER_DUR)
-        {		
-						*lengthPtr = 0;
-            status = NVDS_LENGTH_OUT_OF_RANGE;
-        }
-        else 
-        {
-					memcpy(buf,&nvds_data_ptr->NVDS_TAG_BLE_CA_TIMER_DUR,NVDS_LEN_BLE_CA_TIMER_DUR);
-          *lengthPtr = NVDS_LEN_BLE_CA_TIMER_DUR;
-					status = NVDS_OK;
-        }
-			}
-		break;
+uint8_t custom_nvds_get_func(uint8_t tag, nvds_tag_len_t * lengthPtr, uint8_t *buf)
+{
+    uint8_t const *data;
+    nvds_tag_len_t length;
+    uint8_t row;
 
-		case NVDS_TAG_BLE_CRA_TIMER_DUR:
-			if (nvds_data_ptr->NVDS_VALIDATION_FLAG & NVDS_BLE_CRA_TIMER_DUR_VALID)
-			{
-				if (*lengthPtr < NVDS_LEN_BLE_CRA_TIMER_DUR)
-        {		
-						*lengthPtr = 0;
-            status = NVDS_LENGTH_OUT_OF_RANGE;
-        }
-        else 
-        {
-					memcpy(buf,&nvds_data_ptr->NVDS_TAG_BLE_CRA_TIMER_DUR,NVDS_LEN_BLE_CRA_TIMER_DUR);
-          *lengthPtr = NVDS_LEN_BLE_CRA_TIMER_DUR;
-					status = NVDS_OK;
-        }
-			}
-		break;
+#if (NVDS_READ_WRITE == 1)
+    // the TAGs written at run time take precedence over the NVDS storage area
+    uint8_t status = nvds_flash_get(tag, lengthPtr, buf);
 
-		case NVDS_TAG_BLE_CA_MIN_RSSI:
-			if (nvds_data_ptr->NVDS_VALIDATION_FLAG & NVDS_BLE_CA_MIN_RSSI_VALID)
-			{
-				if (*lengthPtr < NVDS_LEN_BLE_CA_MIN_RSSI)
-        {		
-						*lengthPtr = 0;
-            status = NVDS_LENGTH_OUT_OF_RANGE;
-        }
-        else 
-        {
-					memcpy(buf,&nvds_data_ptr->NVDS_TAG_BLE_CA_MIN_RSSI,NVDS_LEN_BLE_CA_MIN_RSSI);
-          *lengthPtr = NVDS_LEN_BLE_CA_MIN_RSSI;
-					status = NVDS_OK;
-        }
-			}
-		break;
-		case NVDS_TAG_BLE_CA_NB_PKT:
-			if (nvds_data_ptr->NVDS_VALIDATION_FLAG & NVDS_BLE_CA_NB_PKT_VALID)
-			{
-				if (*lengthPtr < NVDS_LEN_BLE_CA_NB_PKT)
-        {		
-						*lengthPtr = 0;
-            status = NVDS_LENGTH_OUT_OF_RANGE;
-        }
-        else 
-        {
-					memcpy(buf,&nvds_data_ptr->NVDS_TAG_BLE_CA_NB_PKT,NVDS_LEN_BLE_CA_NB_PKT);
-          *lengthPtr = NVDS_LEN_BLE_CA_NB_PKT;
-					status = NVDS_OK;
-        }
-			}
-		break;
+    if (status != NVDS_TAG_NOT_DEFINED)
+        return status;
+#endif //(NVDS_READ_WRITE == 1)
 
-		case NVDS_TAG_BLE_CA_NB_BAD_PKT:
-			if (nvds_data_ptr->NVDS_VALIDATION_FLAG & NVDS_BLE_CA_NB_BAD_PKT_VALID)
-			{
-				if (*lengthPtr < NVDS_LEN_BLE_CA_NB_BAD_PKT)
-        {		
-						*lengthPtr = 0;
-            status = NVDS_LENGTH_OUT_OF_RANGE;
-        }
-        else 
-        {
-					memcpy(buf,&nvds_data_ptr->NVDS_TAG_BLE_CA_NB_BAD_PKT,NVDS_LEN_BLE_CA_NB_BAD_PKT);
-          *lengthPtr = NVDS_LEN_BLE_CA_NB_BAD_PKT;
-					status = NVDS_OK;
-        }
-			}
-		break;
-#endif
+    if (nvds_get_ptr(tag, &length, &data) != NVDS_OK)
+        return NVDS_FAIL;
+
+    // the caller's buffer must hold the longest value of the TAG (not checked for the OTP BD address)
+    row = nvds_tag_index[tag];
+    if ((data != (uint8_t const *)&dev_bdaddr) && (*lengthPtr < nvds_tag_desc_table[row - 1].len))
+    {
+        *lengthPtr = 0;
+        return NVDS_LENGTH_OUT_OF_RANGE;
+    }
 
-	}
+    memcpy(buf, data, length);
+    *lengthPtr = length;
 
-	return status;
+    return NVDS_OK;
 }
 
 void nvds_read_bdaddr_from_otp()
@@ -0,0 +1,724 @@
+/**
+ ****************************************************************************************
+ *
+ * @file nvds_flash.c
+ *
+ * @brief Read-write NVDS, log of the TAGs written at run time in SPI flash
+ *
+ * Copyright (C) 2012. Dialog Semiconductor Ltd, unpublished work. This computer
+ * program includes Confidential, Proprietary Information and is a Trade Secret of
+ * Dialog Semiconductor Ltd.  All use, disclosure, and/or reproduction is prohibited
+ * unless authorized in writing. All Rights Reserved.
+ *
+ * <bluetooth.support@diasemi.com> and contributors.
+ *
+ ****************************************************************************************
+ */
+
+/**
+ ****************************************************************************************
+ * @addtogroup NVDS
+ * @{
+ *
+ * The log uses NVDS_FLASH_SECTORS sectors in turn, one of them is the current sector:
+ *
+ *   sector:  | magic | sequence number | record | record | ... | erased (0xFF) |
+ *   record:  | tag | len | flags | crc | len bytes of DATA |
+ *
+ * Records are only appended, their NVDS_FLASH_REC_UNCOMMITTED flag is cleared once the
+ * DATA is programmed: the CRC alone lets 1 interrupted record in 256 through. The last record of a TAG is its value, a record with the
+ * NVDS_FLASH_REC_DELETED flag deletes it. When the current sector is full, the last
+ * record of each TAG is copied to the next sector, whose header is then programmed with
+ * the next sequence number (the magic last): the previous sector stays the current one
+ * until then. The committed sector with the highest sequence number is the current one.
+ * An interrupted record is uncommitted or fails its CRC, nothing is appended after it anymore.
+ *
+ ****************************************************************************************
+ */
+
+/*
+ * INCLUDE FILES
+ ****************************************************************************************
+ */
+
+#include <stddef.h>      // standard definitions
+#include <string.h>      // string definitions
+#include "nvds.h"        // nvds definitions
+
+#if (NVDS_READ_WRITE == 1)
+
+#include "arch.h"
+#include "spi_flash.h"
+#include "spi_flash_async.h"
+
+#if (NVDS_FLASH_SECTORS < 2) || (NVDS_FLASH_SECTORS > 8)
+#error "NVDS_FLASH_SECTORS must be between 2 and 8"
+#endif
+
+/*
+ * DEFINES
+ ****************************************************************************************
+ */
+
+/// Sector header magic ("NVDS"), programmed after the sequence number
+#define NVDS_FLASH_MAGIC            (0x5344564E)
+
+/// Size of the sector header (magic, sequence number)
+#define NVDS_FLASH_HDR_SIZE         (8)
+
+/// No sector
+#define NVDS_FLASH_NO_SECTOR        (0xFF)
+
+/// TAG that cannot be written
+#define NVDS_FLASH_NO_SLOT          (0xFF)
+
+/// Number of spi_flash_wait_till_ready() before an access fails (covers a sector erase)
+#define NVDS_FLASH_READY_RETRIES    (50)
+
+/// Size of the chunks of the flash to flash copies and checks
+#define NVDS_FLASH_CHUNK_SIZE       (64)
+
+/// Record flags
+enum nvds_flash_rec_flags
+{
+    /// Deletion record
+    NVDS_FLASH_REC_DELETED      = 0x01,
+    /// Locked TAG
+    NVDS_FLASH_REC_LOCKED       = 0x02,
+    /// Record being programmed, cleared after its DATA
+    NVDS_FLASH_REC_UNCOMMITTED  = 0x80,
+};
+
+/*
+ * STRUCTURES DEFINTIONS
+ ****************************************************************************************
+ */
+
+/// Record header, followed by len bytes of DATA
+struct nvds_flash_rec_hdr
+{
+    /// TAG
+    uint8_t tag;
+    /// Length of the DATA
+    uint8_t len;
+    /// Flags (@see enum nvds_flash_rec_flags), not covered by the CRC
+    uint8_t flags;
+    /// CRC-8 of tag, len and DATA
+    uint8_t crc;
+};
+
+/// Log environment
+struct nvds_flash_env_tag
+{
+    /// Sequence number of the current sector
+    uint32_t seq;
+    /// Offset of the next record in the current sector
+    uint16_t wr_offset;
+    /// Current sector
+    uint8_t sector;
+    /// Sectors to erase in the background (one bit per sector)
+    uint8_t erase_pending;
+    /// Sector being erased in the background, NVDS_FLASH_NO_SECTOR if none
+    uint8_t erasing;
+    /// Log mounted by nvds_flash_init()
+    bool mounted;
+};
+
+/*
+ * GLOBAL VARIABLES
+ ****************************************************************************************
+ */
+
+static struct nvds_flash_env_tag nvds_flash_env __attribute__((section("retention_mem_area0"), zero_init)); //@RETENTION MEMORY
+
+/// TAGs that can be written, in the order of their index slot
+static const uint8_t nvds_flash_tags[] = {NVDS_FLASH_TAGS};
+
+/// Number of TAGs that can be written
+#define NVDS_FLASH_TAG_NB           (sizeof(nvds_flash_tags))
+
+/// Offset of the last record of each writable TAG in the current sector, 0 if none
+static uint16_t nvds_flash_index[NVDS_FLASH_TAG_NB] __attribute__((section("retention_mem_area0"), zero_init)); //@RETENTION MEMORY
+
+/*
+ * LOCAL FUNCTION DEFINITIONS
+ ****************************************************************************************
+ */
+
+/// Index slot of a TAG, NVDS_FLASH_NO_SLOT if it cannot be written
+static uint8_t nvds_flash_slot(uint8_t tag)
+{
+    uint8_t slot;
+
+    for (slot = 0; slot < NVDS_FLASH_TAG_NB; slot++)
+    {
+        if (nvds_flash_tags[slot] == tag)
+            return slot;
+    }
+
+    return NVDS_FLASH_NO_SLOT;
+}
+
+static uint32_t nvds_flash_addr(uint8_t sector, uint16_t offset)
+{
+    return NVDS_FLASH_BASE + (uint32_t)sector * NVDS_FLASH_SECTOR_SIZE + offset;
+}
+
+/// CRC-8, polynomial x^8 + x^2 + x + 1
+static uint8_t nvds_flash_crc(uint8_t crc, uint8_t const *data, uint32_t len)
+{
+    uint8_t i;
+
+    while (len--)
+    {
+        crc ^= *data++;
+        for (i = 0; i < 8; i++)
+            crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+    }
+
+    return crc;
+}
+
+/// Wait for the end of a program or erase, a background erase included
+static bool nvds_flash_ready(void)
+{
+    uint8_t retries = NVDS_FLASH_READY_RETRIES;
+
+    while (spi_flash_wait_till_ready() != ERR_OK)
+    {
+        if (--retries == 0)
+            return false;
+    }
+
+    return true;
+}
+
+static bool nvds_flash_read(uint32_t address, void *buf, uint32_t len)
+{
+    return (nvds_flash_ready() && (spi_flash_read_data((uint8_t *)buf, address, len) == len));
+}
+
+static bool nvds_flash_write(uint32_t address, void const *buf, uint32_t len)
+{
+    return (nvds_flash_ready() && (spi_flash_write_data((uint8_t *)buf, address, len) == (int32_t)len));
+}
+
+#if (SPI_FLASH_ASYNC)
+static void nvds_flash_erase_cmp(int32_t status);
+#endif
+
+/**
+ ****************************************************************************************
+ * @brief Start erasing the next stale sector, if the asynchronous SPI flash driver is
+ * free. Without it, sectors are erased when they are needed.
+ ****************************************************************************************
+ */
+static void nvds_flash_erase_background(void)
+{
+#if (SPI_FLASH_ASYNC)
+    uint8_t sector;
+
+    if ((nvds_flash_env.erasing != NVDS_FLASH_NO_SECTOR) || spi_flash_async_busy())
+        return;
+
+    for (sector = 0; sector < NVDS_FLASH_SECTORS; sector++)
+    {
+        if ((nvds_flash_env.erase_pending & (1 << sector)) && (sector != nvds_flash_env.sector))
+        {
+            if (spi_flash_async_block_erase(nvds_flash_addr(sector, 0), SECTOR_ERASE, nvds_flash_erase_cmp) == ERR_OK)
+                nvds_flash_env.erasing = sector;
+            break;
+        }
+    }
+#endif // SPI_FLASH_ASYNC
+}
+
+#if (SPI_FLASH_ASYNC)
+static void nvds_flash_erase_cmp(int32_t status)
+{
+    if (status == ERR_OK)
+        nvds_flash_env.erase_pending &= ~(1 << nvds_flash_env.erasing);
+
+    nvds_flash_env.erasing = NVDS_FLASH_NO_SECTOR;
+
+    // a failed erase is retried with the next write
+    if (status == ERR_OK)
+        nvds_flash_erase_background();
+}
+#endif // SPI_FLASH_ASYNC
+
+/// Get a sector ready for a new log: erased, nothing pending on it
+static bool nvds_flash_prepare(uint8_t sector)
+{
+    uint8_t chunk[NVDS_FLASH_CHUNK_SIZE];
+    uint16_t offset, i;
+    bool blank = true;
+
+#if (SPI_FLASH_ASYNC)
+    // an asynchronous erase not issued yet would wipe the new log: with two sectors, the
+    // target of a compaction is the sector erased in the background, finish that erase
+    if ((nvds_flash_env.erasing == sector) && (spi_flash_async_flush() != ERR_OK))
+        return false;
+#endif // SPI_FLASH_ASYNC
+
+    for (offset = 0; blank && (offset < NVDS_FLASH_SECTOR_SIZE); offset += sizeof(chunk))
+    {
+        if (!nvds_flash_read(nvds_flash_addr(sector, offset), chunk, sizeof(chunk)))
+            return false;
+
+        for (i = 0; i < sizeof(chunk); i++)
+        {
+            if (chunk[i] != 0xFF)
+            {
+                blank = false;
+                break;
+            }
+        }
+    }
+
+    if (!blank)
+    {
+        if (!nvds_flash_ready() || (spi_flash_block_erase_start(nvds_flash_addr(sector, 0), SECTOR_ERASE) != ERR_OK)
+            || !nvds_flash_ready())
+            return false;
+    }
+
+    nvds_flash_env.erase_pending &= ~(1 << sector);
+
+    return true;
+}
+
+/// Make a sector the current one: program its sequence number, then the magic
+static bool nvds_flash_commit(uint8_t sector, uint32_t seq)
+{
+    uint32_t magic = NVDS_FLASH_MAGIC;
+
+    return (nvds_flash_write(nvds_flash_addr(sector, 4), &seq, sizeof(seq))
+            && nvds_flash_write(nvds_flash_addr(sector, 0), &magic, sizeof(magic)));
+}
+
+/// Check the DATA of a record against the CRC of its header
+static bool nvds_flash_rec_check(uint8_t sector, uint16_t offset, struct nvds_flash_rec_hdr const *hdr)
+{
+    uint8_t chunk[NVDS_FLASH_CHUNK_SIZE];
+    uint16_t done, size;
+    uint8_t crc;
+
+    if (offset + sizeof(*hdr) + hdr->len > NVDS_FLASH_SECTOR_SIZE)
+        return false;
+
+    crc = nvds_flash_crc(0, &hdr->tag, 2);
+
+    for (done = 0; done < hdr->len; done += size)
+    {
+        size = hdr->len - done;
+        if (size > sizeof(chunk))
+            size = sizeof(chunk);
+
+        if (!nvds_flash_read(nvds_flash_addr(sector, offset + sizeof(*hdr) + done), chunk, size))
+            return false;
+
+        crc = nvds_flash_crc(crc, chunk, size);
+    }
+
+    return (crc == hdr->crc);
+}
+
+/// Index the records of the current sector and find the end of the log
+static void nvds_flash_scan(void)
+{
+    struct nvds_flash_rec_hdr hdr;
+    uint16_t offset = NVDS_FLASH_HDR_SIZE;
+    uint8_t slot;
+
+    memset(nvds_flash_index, 0, sizeof(nvds_flash_index));
+
+    while (offset + sizeof(hdr) <= NVDS_FLASH_SECTOR_SIZE)
+    {
+        if (!nvds_flash_read(nvds_flash_addr(nvds_flash_env.sector, offset), &hdr, sizeof(hdr)))
+        {
+            offset = NVDS_FLASH_SECTOR_SIZE;
+            break;
+        }
+
+        // erased: end of the log
+        if ((hdr.tag == 0xFF) && (hdr.len == 0xFF) && (hdr.flags == 0xFF) && (hdr.crc == 0xFF))
+            break;
+
+        // interrupted write: nothing is appended after it, the next write compacts the log
+        if ((hdr.flags & NVDS_FLASH_REC_UNCOMMITTED) || !nvds_flash_rec_check(nvds_flash_env.sector, offset, &hdr))
+        {
+            offset = NVDS_FLASH_SECTOR_SIZE;
+            break;
+        }
+
+        // the TAGs removed from NVDS_FLASH_TAGS are dropped by the next compaction
+        slot = nvds_flash_slot(hdr.tag);
+        if (slot != NVDS_FLASH_NO_SLOT)
+            nvds_flash_index[slot] = offset;
+
+        offset += sizeof(hdr) + hdr.len;
+    }
+
+    nvds_flash_env.wr_offset = offset;
+}
+
+/// Commit a record of the current sector, its DATA programmed: clear NVDS_FLASH_REC_UNCOMMITTED
+static bool nvds_flash_rec_commit(uint16_t offset, uint8_t flags)
+{
+    return nvds_flash_write(nvds_flash_addr(nvds_flash_env.sector, offset + offsetof(struct nvds_flash_rec_hdr, flags)),
+                            &flags, sizeof(flags));
+}
+
+/// Get the header of the last record of a TAG, given its index slot
+static uint8_t nvds_flash_rec_get(uint8_t slot, struct nvds_flash_rec_hdr *hdr)
+{
+    if (nvds_flash_index[slot] == 0)
+        return NVDS_TAG_NOT_DEFINED;
+
+    if (!nvds_flash_read(nvds_flash_addr(nvds_flash_env.sector, nvds_flash_index[slot]), hdr, sizeof(*hdr)))
+        return NVDS_FAIL;
+
+    return NVDS_OK;
+}
+
+/**
+ ****************************************************************************************
+ * @brief Append a copy of a record to the current sector, room must have been checked.
+ *
+ * @param[in] src_sector  Sector of the record
+ * @param[in] src_offset  Offset of the record
+ * @param[in] hdr         Header of the record
+ * @param[in] flags       Flags of the copy
+ *
+ * @return true if copied
+ ****************************************************************************************
+ */
+static bool nvds_flash_copy(uint8_t src_sector, uint16_t src_offset, struct nvds_flash_rec_hdr const *hdr, uint8_t flags)
+{
+    struct nvds_flash_rec_hdr copy = *hdr;
+    uint8_t chunk[NVDS_FLASH_CHUNK_SIZE];
+    uint16_t offset = nvds_flash_env.wr_offset;
+    uint16_t done, size;
+    bool ok;
+
+    copy.flags = flags | NVDS_FLASH_REC_UNCOMMITTED;
+
+    // past the record even if it is torn
+    nvds_flash_env.wr_offset += sizeof(copy) + copy.len;
+
+    ok = nvds_flash_write(nvds_flash_addr(nvds_flash_env.sector, offset), &copy, sizeof(copy));
+
+    for (done = 0; ok && (done < copy.len); done += size)
+    {
+        size = copy.len - done;
+        if (size > sizeof(chunk))
+            size = sizeof(chunk);
+
+        ok = nvds_flash_read(nvds_flash_addr(src_sector, src_offset + sizeof(copy) + done), chunk, size)
+             && nvds_flash_write(nvds_flash_addr(nvds_flash_env.sector, offset + sizeof(copy) + done), chunk, size);
+    }
+
+    if (!ok || !nvds_flash_rec_commit(offset, flags))
+    {
+        // never append after a partly programmed record
+        nvds_flash_env.wr_offset = NVDS_FLASH_SECTOR_SIZE;
+        return false;
+    }
+
+    nvds_flash_index[nvds_flash_slot(copy.tag)] = offset;
+
+    return true;
+}
+
+/**
+ ****************************************************************************************
+ * @brief Copy the last record of each TAG to the next sector and make it the current one.
+ * The previous sector is erased in the background.
+ *
+ * @return NVDS_OK, NVDS_NO_SPACE_AVAILABLE if the TAGs do not fit in a sector, NVDS_FAIL
+ ****************************************************************************************
+ */
+static uint8_t nvds_flash_compact(void)
+{
+    struct nvds_flash_rec_hdr hdr;
+    uint8_t old = nvds_flash_env.sector;
+    uint8_t target = (old + 1) % NVDS_FLASH_SECTORS;
+    uint8_t status = NVDS_OK;
+    uint16_t src_offset;
+    uint8_t slot;
+
+    if (!nvds_flash_prepare(target))
+        return NVDS_FAIL;
+
+    // the index follows the records to the target sector
+    nvds_flash_env.sector = target;
+    nvds_flash_env.wr_offset = NVDS_FLASH_HDR_SIZE;
+
+    for (slot = 0; (status == NVDS_OK) && (slot < NVDS_FLASH_TAG_NB); slot++)
+    {
+        src_offset = nvds_flash_index[slot];
+        if (src_offset == 0)
+            continue;
+
+        if (!nvds_flash_read(nvds_flash_addr(old, src_offset), &hdr, sizeof(hdr)))
+            status = NVDS_FAIL;
+        else if (nvds_flash_env.wr_offset + sizeof(hdr) + hdr.len > NVDS_FLASH_SECTOR_SIZE)
+            status = NVDS_NO_SPACE_AVAILABLE;
+        else if (!nvds_flash_copy(old, src_offset, &hdr, hdr.flags))
+            status = NVDS_FAIL;
+    }
+
+    if ((status == NVDS_OK) && !nvds_flash_commit(target, nvds_flash_env.seq + 1))
+        status = NVDS_FAIL;
+
+    if (status != NVDS_OK)
+    {
+        // back to the previous sector, the target is erased before its next use
+        nvds_flash_env.sector = old;
+        nvds_flash_env.erase_pending |= (1 << target);
+        nvds_flash_scan();
+        return status;
+    }
+
+    nvds_flash_env.seq++;
+    nvds_flash_env.erase_pending |= (1 << old);
+
+    return NVDS_OK;
+}
+
+/// Make room for a record of len bytes of DATA in the current sector
+static uint8_t nvds_flash_reserve(nvds_tag_len_t len)
+{
+    uint8_t status;
+
+    if (nvds_flash_env.wr_offset + sizeof(struct nvds_flash_rec_hdr) + len <= NVDS_FLASH_SECTOR_SIZE)
+        return NVDS_OK;
+
+    status = nvds_flash_compact();
+    if (status != NVDS_OK)
+        return status;
+
+    if (nvds_flash_env.wr_offset + sizeof(struct nvds_flash_rec_hdr) + len > NVDS_FLASH_SECTOR_SIZE)
+        return NVDS_NO_SPACE_AVAILABLE;
+
+    return NVDS_OK;
+}
+
+/// Append a record from RAM
+static uint8_t nvds_flash_append(uint8_t tag, uint8_t flags, uint8_t const *data, nvds_tag_len_t len)
+{
+    struct nvds_flash_rec_hdr hdr;
+    uint16_t offset;
+    uint8_t status;
+
+    status = nvds_flash_reserve(len);
+    if (status != NVDS_OK)
+        return status;
+
+    hdr.tag = tag;
+    hdr.len = len;
+    hdr.flags = flags | NVDS_FLASH_REC_UNCOMMITTED;
+    hdr.crc = nvds_flash_crc(nvds_flash_crc(0, &hdr.tag, 2), data, len);
+
+    offset = nvds_flash_env.wr_offset;
+
+    // past the record even if it is torn
+    nvds_flash_env.wr_offset += sizeof(hdr) + len;
+
+    if (!nvds_flash_write(nvds_flash_addr(nvds_flash_env.sector, offset), &hdr, sizeof(hdr))
+        || ((len != 0) && !nvds_flash_write(nvds_flash_addr(nvds_flash_env.sector, offset + sizeof(hdr)), data, len))
+        || !nvds_flash_rec_commit(offset, flags))
+    {
+        // never append after a partly programmed record
+        nvds_flash_env.wr_offset = NVDS_FLASH_SECTOR_SIZE;
+        return NVDS_FAIL;
+    }
+
+    nvds_flash_index[nvds_flash_slot(tag)] = offset;
+
+    return NVDS_OK;
+}
+
+/*
+ * EXPORTED FUNCTION DEFINITIONS
+ ****************************************************************************************
+ */
+
+uint8_t nvds_flash_init(void)
+{
+    uint32_t hdr[2];
+    uint8_t sector;
+
+    nvds_flash_env.mounted = false;
+    nvds_flash_env.erase_pending = 0;
+    nvds_flash_env.erasing = NVDS_FLASH_NO_SECTOR;
+
+    // the current sector is the committed one with the highest sequence number
+    for (sector = 0; sector < NVDS_FLASH_SECTORS; sector++)
+    {
+        if (!nvds_flash_read(nvds_flash_addr(sector, 0), hdr, sizeof(hdr)))
+            return NVDS_FAIL;
+
+        if (hdr[0] != NVDS_FLASH_MAGIC)
+            continue;
+
+        if (!nvds_flash_env.mounted || (hdr[1] > nvds_flash_env.seq))
+        {
+            // the previous candidate is stale
+            if (nvds_flash_env.mounted)
+                nvds_flash_env.erase_pending |= (1 << nvds_flash_env.sector);
+
+            nvds_flash_env.sector = sector;
+            nvds_flash_env.seq = hdr[1];
+            nvds_flash_env.mounted = true;
+        }
+        else
+            nvds_flash_env.erase_pending |= (1 << sector);
+    }
+
+    // empty log
+    if (!nvds_flash_env.mounted)
+    {
+        if (!nvds_flash_prepare(0) || !nvds_flash_commit(0, 1))
+            return NVDS_FAIL;
+
+        nvds_flash_env.sector = 0;
+        nvds_flash_env.seq = 1;
+        nvds_flash_env.mounted = true;
+    }
+
+    nvds_flash_scan();
+
+    nvds_flash_erase_background();
+
+    return NVDS_OK;
+}
+
+uint8_t nvds_flash_get(uint8_t tag, nvds_tag_len_t * lengthPtr, uint8_t *buf)
+{
+    struct nvds_flash_rec_hdr hdr;
+    uint8_t status;
+    uint8_t slot = nvds_flash_slot(tag);
+
+    if (!nvds_flash_env.mounted || (slot == NVDS_FLASH_NO_SLOT))
+        return NVDS_TAG_NOT_DEFINED;
+
+    status = nvds_flash_rec_get(slot, &hdr);
+    if (status != NVDS_OK)
+        return status;
+
+    if (hdr.flags & NVDS_FLASH_REC_DELETED)
+        return NVDS_FAIL;
+
+    if (*lengthPtr < hdr.len)
+    {
+        *lengthPtr = 0;
+        return NVDS_LENGTH_OUT_OF_RANGE;
+    }
+
+    if ((hdr.len != 0) && !nvds_flash_read(nvds_flash_addr(nvds_flash_env.sector, nvds_flash_index[slot] + sizeof(hdr)),
+                                           buf, hdr.len))
+        return NVDS_FAIL;
+
+    *lengthPtr = hdr.len;
+
+    return NVDS_OK;
+}
+
+uint8_t nvds_put(uint8_t tag, nvds_tag_len_t length, uint8_t *buf)
+{
+    struct nvds_flash_rec_hdr hdr;
+    uint8_t status;
+    uint8_t slot = nvds_flash_slot(tag);
+
+    if (!nvds_flash_env.mounted || (slot == NVDS_FLASH_NO_SLOT))
+        return NVDS_FAIL;
+
+    status = nvds_flash_rec_get(slot, &hdr);
+    if (status == NVDS_FAIL)
+        return status;
+
+    if ((status == NVDS_OK) && (hdr.flags & NVDS_FLASH_REC_LOCKED))
+        return NVDS_PARAM_LOCKED;
+
+    status = nvds_flash_append(tag, 0, buf, length);
+
+    nvds_flash_erase_background();
+
+    return status;
+}
+
+uint8_t nvds_del(uint8_t tag)
+{
+    struct nvds_flash_rec_hdr hdr;
+    uint8_t status;
+    uint8_t slot = nvds_flash_slot(tag);
+
+    if (!nvds_flash_env.mounted || (slot == NVDS_FLASH_NO_SLOT))
+        return NVDS_FAIL;
+
+    status = nvds_flash_rec_get(slot, &hdr);
+    if (status == NVDS_FAIL)
+        return status;
+
+    if (status == NVDS_OK)
+    {
+        if (hdr.flags & NVDS_FLASH_REC_LOCKED)
+            return NVDS_PARAM_LOCKED;
+
+        if (hdr.flags & NVDS_FLASH_REC_DELETED)
+            return NVDS_OK;
+    }
+
+    status = nvds_flash_append(tag, NVDS_FLASH_REC_DELETED, NULL, 0);
+
+    nvds_flash_erase_background();
+
+    return status;
+}
+
+uint8_t nvds_lock(uint8_t tag)
+{
+    struct nvds_flash_rec_hdr hdr;
+    uint8_t const *data;
+    nvds_tag_len_t length;
+    uint8_t status;
+    uint8_t slot = nvds_flash_slot(tag);
+
+    if (!nvds_flash_env.mounted || (slot == NVDS_FLASH_NO_SLOT))
+        return NVDS_FAIL;
+
+    status = nvds_flash_rec_get(slot, &hdr);
+
+    if (status == NVDS_OK)
+    {
+        if (hdr.flags & NVDS_FLASH_REC_DELETED)
+            return NVDS_TAG_NOT_DEFINED;
+
+        if (hdr.flags & NVDS_FLASH_REC_LOCKED)
+            return NVDS_OK;
+
+        // locked copy of the last record, which a compaction may move
+        status = nvds_flash_reserve(hdr.len);
+        if ((status == NVDS_OK)
+            && !nvds_flash_copy(nvds_flash_env.sector, nvds_flash_index[slot], &hdr, hdr.flags | NVDS_FLASH_REC_LOCKED))
+            status = NVDS_FAIL;
+    }
+    else if (status == NVDS_TAG_NOT_DEFINED)
+    {
+        // locked copy of the value of the NVDS storage area
+        if (nvds_get_ptr(tag, &length, &data) != NVDS_OK)
+            return NVDS_TAG_NOT_DEFINED;
+
+        status = nvds_flash_append(tag, NVDS_FLASH_REC_LOCKED, data, length);
+    }
+
+    nvds_flash_erase_background();
+
+    return status;
+}
+
+#endif //(NVDS_READ_WRITE == 1)
+
+/// @} NVDS
@@ -118,6 +118,12 @@
 #else // defined(CFG_GTL)
 #define GTL_ITF           0
 #endif // defined(CFG_GTL)
+/// Several kernel messages per GTL frame
+#if defined(CFG_GTL_BATCH)
+#define GTL_BATCH         GTL_ITF
+#else // defined(CFG_GTL_BATCH)
+#define GTL_BATCH         0
+#endif // defined(CFG_GTL_BATCH)
 /// Host Controller Interface (Controller side)
 #define HCIC_ITF        (!BLE_HOST_PRESENT)
 /// Host Controller Interface (Host side)
@@ -302,6 +308,20 @@
 #define HAS_MULTI_BOND          0
 #endif // defined(CFG_MULTI_BOND)
 
+/// Attribute database restored from an image in the NVDS log
+#if defined(CFG_APP_DB_IMAGE)
+#define BLE_APP_DB_IMAGE        1
+#else // defined(CFG_APP_DB_IMAGE)
+#define BLE_APP_DB_IMAGE        0
+#endif // defined(CFG_APP_DB_IMAGE)
+
+/// Time from app_init() to the end of the attribute database creation printed on the console
+#if defined(CFG_APP_DB_TIMING) && defined(CFG_PRINTF)
+#define BLE_APP_DB_TIMING       1
+#else // defined(CFG_APP_DB_TIMING) && defined(CFG_PRINTF)
+#define BLE_APP_DB_TIMING       0
+#endif // defined(CFG_APP_DB_TIMING) && defined(CFG_PRINTF)
+
 /// Accelerometer Application
 #define BLE_APP_ACCEL        0
 
@@ -615,11 +635,13 @@ enum KE_TASK_TYPE
     TASK_APP_NEB      = 53  ,
     TASK_APP_ACCEL    = 54  ,
     TASK_APP_SEC      = 55  ,
+    TASK_I2C_EEPROM   = 62  ,   // Interrupt driven I2C EEPROM driver task
     TASK_GTL          = 63  ,
     
     TASK_SAMPLE128    = 64  ,   // Sample128 Task
     TASK_SPOTAR       = 65  ,   // SPOTA Receiver task
     TASK_STREAMDATAD  = 66  ,   // Stream Data Device Server task
+    TASK_SPI_FLASH    = 67  ,   // Asynchronous SPI Flash driver task
     TASK_APP_BASC     = 68  ,
     TASK_APP_SCPPC    = 69  ,
 
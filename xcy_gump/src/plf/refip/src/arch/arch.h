@@ -118,6 +118,42 @@ typedef enum
 #define PLF_NVDS             0
 #endif // CFG_NVDS
 
+/*
+ * SPI FLASH
+ ****************************************************************************************
+ */
+
+/// Asynchronous SPI Flash operations (spi_flash_async), polled from the kernel
+#ifdef CFG_SPI_FLASH_ASYNC
+#define SPI_FLASH_ASYNC      1
+#else // CFG_SPI_FLASH_ASYNC
+#define SPI_FLASH_ASYNC      0
+#endif // CFG_SPI_FLASH_ASYNC
+
+/*
+ * I2C EEPROM
+ ****************************************************************************************
+ */
+
+/// Interrupt driven I2C EEPROM operations (i2c_eeprom_async)
+#ifdef CFG_I2C_EEPROM_ASYNC
+#define I2C_EEPROM_ASYNC     1
+#else // CFG_I2C_EEPROM_ASYNC
+#define I2C_EEPROM_ASYNC     0
+#endif // CFG_I2C_EEPROM_ASYNC
+
+/*
+ * UART
+ ****************************************************************************************
+ */
+
+/// Continuous UART reception into a ring and queued UART transmissions (uart.c)
+#ifdef CFG_UART_RING
+#define UART_RING            1
+#else // CFG_UART_RING
+#define UART_RING            0
+#endif // CFG_UART_RING
+
 /*
  * LLD ROM defines
  ****************************************************************************************
@@ -0,0 +1,58 @@
+/**
+ ****************************************************************************************
+ *
+ * @file gcc/compiler.h
+ *
+ * @brief Definitions of compiler specific directives for the host (GCC) build.
+ *
+ * Only used when the kernel is built off-target (CFG_KE_HOST), e.g. on x86-64 Linux.
+ *
+ * Copyright (C) RivieraWaves 2009-2013
+ *
+ *
+ ****************************************************************************************
+ */
+
+#ifndef _COMPILER_H_
+#define _COMPILER_H_
+
+#ifndef __GNUC__
+#error "File only included with GCC!"
+#endif // __GNUC__
+
+/// define the force inlining attribute for this compiler
+#define __INLINE static __attribute__((__always_inline__)) inline
+
+/// force inlining keyword of the ARM compiler, used by the application code
+#define __forceinline __attribute__((__always_inline__)) inline
+
+/// count leading zeros intrinsic of the ARM compiler (32 for 0, like the CLZ instruction)
+#define __clz(x) ((x) ? __builtin_clz(x) : 32)
+
+/// define the IRQ handler attribute for this compiler
+#define __IRQ
+
+/// define the BLE IRQ handler attribute for this compiler
+#define __BTIRQ
+
+/// define the BLE IRQ handler attribute for this compiler
+#define __BLEIRQ
+
+/// define the FIQ handler attribute for this compiler
+#define __FIQ
+
+/// define size of an empty array (used to declare structure with an array size not defined)
+#define __ARRAY_EMPTY
+
+/// Put a variable in a memory maintained during deep sleep
+#define __LOWPOWER_SAVED
+
+/// Put a variable in a memory not maintained during deep sleep
+#define __LOWPOWER_UNSAVED
+
+/// Module name used by the assertion macros
+#ifndef __MODULE__
+#define __MODULE__ __FILE__
+#endif // __MODULE__
+
+#endif // _COMPILER_H_
@@ -0,0 +1,54 @@
+/**
+ ****************************************************************************************
+ *
+ * @file host/ll.h
+ *
+ * @brief Declaration of low level functions for the host (off-target) build.
+ *
+ * The host build runs the kernel in a single thread without interrupts, so the
+ * interrupt masking macros only have to keep the same scoping rules as on target.
+ *
+ * Copyright (C) RivieraWaves 2009-2012
+ *
+ *
+ ****************************************************************************************
+ */
+
+#ifndef LL_H_
+#define LL_H_
+
+#ifdef __arm__
+#error "File only included with the host build!"
+#endif // __arm__
+
+#include <stdint.h>
+#include "arch.h"
+
+/** @brief Enable interrupts globally in the system.
+ */
+#define GLOBAL_INT_START()
+
+/** @brief Disable interrupts globally in the system.
+ */
+#define GLOBAL_INT_STOP()
+
+/** @brief Disable interrupts globally in the system.
+ * This macro must be used in conjunction with the @ref GLOBAL_INT_RESTORE macro since this
+ * last one will close the brace that the current macro opens.  This means that both
+ * macros must be located at the same scope level.
+ */
+#define GLOBAL_INT_DISABLE()                                                \
+do {
+
+/** @brief Restore interrupts from the previous global disable.
+ * @sa GLOBAL_INT_DISABLE
+ */
+#define GLOBAL_INT_RESTORE()                                                \
+} while(0)
+
+/** @brief Invoke the wait for interrupt procedure of the processor.
+ * Nothing to wait for on the host: the caller simply polls again.
+ */
+#define WFI()
+
+#endif // LL_H_
@@ -64,6 +64,7 @@
 #if (BLE_APP_PRESENT)
 #include "app.h"       // application functions
 #include "app_sleep.h"
+#include "app_console.h" // console output
 #endif // BLE_APP_PRESENT
 
 #include "gtl_env.h"
@@ -586,9 +587,17 @@ int main_func(void)
                         conditionally_run_radio_cals(); // check time and temperature to run radio calibrations. 
                 }
 
+#if (BLE_APP_PRESENT) && (BLE_STREAMDATA_DEVICE)
+                if (ble_evt_end_set)
+                    app_stream_evt_end(); // refill the TX buffers for the next connection event
+#endif
+
 #endif
                 
 #if (BLE_APP_PRESENT)
+                // XTAL16 is in use while BLE is running, the console can go out
+                arch_printf_process();
+
 				if ( app_asynch_trm() )
 					continue; // so that rwip_schedule() is called again
 #endif
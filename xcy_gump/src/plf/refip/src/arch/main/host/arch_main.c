@@ -0,0 +1,66 @@
+/**
+ ****************************************************************************************
+ *
+ * @file host/arch_main.c
+ *
+ * @brief Platform functions of the host (off-target) build.
+ *
+ * The host build (CFG_KE_HOST) runs the kernel and the application modules as a
+ * regular process: the assertions print on stderr instead of halting the core and
+ * platform_reset() exits the process.
+ *
+ * Copyright (C) RivieraWaves 2009-2013
+ *
+ *
+ ****************************************************************************************
+ */
+
+/**
+ ****************************************************************************************
+ * @addtogroup DRIVERS
+ * @{
+ ****************************************************************************************
+ */
+
+/*
+ * INCLUDE FILES
+ ****************************************************************************************
+ */
+#include <stdio.h>          // fprintf
+#include <stdlib.h>         // abort, exit
+
+#include "rwip_config.h"    // stack configuration
+#include "arch.h"           // architecture
+
+
+/*
+ * EXPORTED FUNCTION DEFINITIONS
+ ****************************************************************************************
+ */
+
+void platform_reset(uint32_t error)
+{
+    fprintf(stderr, "platform_reset(0x%08lx)\n", (unsigned long) error);
+    exit(1);
+}
+
+#if PLF_DEBUG
+void assert_err(const char *condition, const char * file, int line)
+{
+    fprintf(stderr, "%s:%d: assertion \"%s\" failed\n", file, line, condition);
+    abort();
+}
+
+void assert_param(int param0, int param1, const char * file, int line)
+{
+    fprintf(stderr, "%s:%d: assertion failed (param0 %d, param1 %d)\n", file, line, param0, param1);
+    abort();
+}
+
+void assert_warn(const char *condition, const char * file, int line)
+{
+    fprintf(stderr, "%s:%d: warning \"%s\"\n", file, line, condition);
+}
+#endif //PLF_DEBUG
+
+/// @} DRIVERS
@@ -86,6 +86,16 @@ void i2c_eeprom_release(void);
  */
 void i2c_wait_until_eeprom_ready(void);
 
+/**
+ ****************************************************************************************
+ * @brief Send I2C EEPROM's memory address, the device address first for a 2-byte address.
+ *        Used by the asynchronous driver (i2c_eeprom_async.c).
+ *
+ * @param[in] address_to_send  Memory address
+ ****************************************************************************************
+ */
+void i2c_send_address(uint32_t address_to_send);
+
 /**
  ****************************************************************************************
  * @brief Read single byte from I2C EEPROM.
@@ -0,0 +1,614 @@
+/**
+ ****************************************************************************************
+ *
+ * @file i2c_eeprom_async.c
+ *
+ * @brief Interrupt driven I2C EEPROM driver.
+ *
+ * Copyright (C) 2012. Dialog Semiconductor Ltd, unpublished work. This computer
+ * program includes Confidential, Proprietary Information and is a Trade Secret of
+ * Dialog Semiconductor Ltd.  All use, disclosure, and/or reproduction is prohibited
+ * unless authorized in writing. All Rights Reserved.
+ *
+ * <bluetooth.support@diasemi.com> and contributors.
+ *
+ ****************************************************************************************
+ */
+
+/**
+ ****************************************************************************************
+ * @addtogroup I2C_EEPROM_ASYNC
+ * @{
+ ****************************************************************************************
+ */
+
+/*
+ * INCLUDE FILES
+ ****************************************************************************************
+ */
+
+#include "i2c_eeprom_async.h"
+
+#if (I2C_EEPROM_ASYNC)
+
+#include <stddef.h>
+#include "global_io.h"
+#include "ARMCM0.h"
+#include "periph_setup.h"
+#include "ke_msg.h"
+#include "ke_timer.h"
+#include "reg_blecore.h"
+#include "arch_sleep.h"
+
+/*
+ * DEFINES
+ ****************************************************************************************
+ */
+
+#define SEND_I2C_COMMAND(X) SetWord16(I2C_DATA_CMD_REG, (X))
+
+/// Operations
+enum i2c_eeprom_async_op
+{
+    I2C_EEPROM_ASYNC_OP_READ,
+    I2C_EEPROM_ASYNC_OP_WRITE,
+};
+
+/// Progress of the operation at the head of the queue
+enum i2c_eeprom_async_phase
+{
+    /// Not started
+    I2C_EEPROM_ASYNC_PHASE_IDLE,
+    /// Dummy access on the bus, acknowledged once the EEPROM has completed its write cycle
+    I2C_EEPROM_ASYNC_PHASE_ACK_POLL,
+    /// EEPROM busy, ACK polling timer running
+    I2C_EEPROM_ASYNC_PHASE_WAIT,
+    /// Read or write transaction on the bus
+    I2C_EEPROM_ASYNC_PHASE_XFER,
+};
+
+/*
+ * STRUCTURES DEFINTIONS
+ ****************************************************************************************
+ */
+
+/// Queued operation
+struct i2c_eeprom_async_req
+{
+    /// Completion callback
+    i2c_eeprom_async_cb_t cb;
+    /// Destination of a read
+    uint8_t *rd_ptr;
+    /// Source of a write
+    uint8_t const *wr_ptr;
+    /// EEPROM address
+    uint32_t address;
+    /// Size
+    uint32_t size;
+    /// Device (@see i2c_eeprom_init())
+    uint16_t dev_address;
+    uint8_t speed;
+    uint8_t address_mode;
+    uint8_t address_size;
+    /// Operation (@see enum i2c_eeprom_async_op)
+    uint8_t op;
+};
+
+/// Driver environment
+struct i2c_eeprom_async_env_tag
+{
+    /// Queued operations, the first one is in progress
+    struct i2c_eeprom_async_req queue[I2C_EEPROM_ASYNC_QUEUE_SIZE];
+    /// Device of the next operations
+    struct i2c_eeprom_async_req cfg;
+    /// Bytes of the current operation done by the previous transactions
+    uint32_t done;
+    /// Bytes of the current transaction
+    volatile uint32_t chunk;
+    /// Bytes (write) or read commands (read) of the current transaction queued in the Tx FIFO
+    volatile uint32_t pushed;
+    /// Bytes of the current transaction read from the Rx FIFO
+    volatile uint32_t received;
+    /// Tx abort sources of the current transaction
+    volatile uint16_t abort_source;
+    /// STOP condition of the current transaction seen by the interrupt
+    volatile bool stopped;
+    /// Consecutive ACK polls not acknowledged or aborted transactions
+    uint16_t polls;
+    /// Status of the last operation that failed since i2c_eeprom_async_flush() was called
+    int8_t error;
+    /// Index of the first operation
+    uint8_t head;
+    /// Number of operations
+    uint8_t count;
+    /// Phase (@see enum i2c_eeprom_async_phase)
+    uint8_t phase;
+};
+
+/*
+ * GLOBAL VARIABLES
+ ****************************************************************************************
+ */
+
+static struct i2c_eeprom_async_env_tag i2c_eeprom_async_env;
+
+/// Defines the placeholder for the states of all the task instances.
+static ke_state_t i2c_eeprom_async_state[I2C_EEPROM_ASYNC_IDX_MAX];
+
+/*
+ * LOCAL FUNCTION DEFINITIONS
+ ****************************************************************************************
+ */
+
+/**
+ ****************************************************************************************
+ * @brief Queue the next bytes or read commands of the transaction in the Tx FIFO. A read
+ * command is only queued if its byte will fit in the Rx FIFO. Called with the I2C
+ * interrupt masked or from it.
+ ****************************************************************************************
+ */
+static void i2c_eeprom_async_fill(void)
+{
+    struct i2c_eeprom_async_req *req = &i2c_eeprom_async_env.queue[i2c_eeprom_async_env.head];
+    bool room = true;
+
+    while ((i2c_eeprom_async_env.pushed < i2c_eeprom_async_env.chunk) && (GetWord16(I2C_STATUS_REG) & TFNF))
+    {
+        if (req->op == I2C_EEPROM_ASYNC_OP_WRITE)
+        {
+            SEND_I2C_COMMAND(req->wr_ptr[i2c_eeprom_async_env.done + i2c_eeprom_async_env.pushed] & 0xFF);
+        }
+        else
+        {
+            room = (i2c_eeprom_async_env.pushed - i2c_eeprom_async_env.received < I2C_EEPROM_ASYNC_FIFO_DEPTH);
+            if (!room)
+                break;
+
+            SEND_I2C_COMMAND(0x0100);               // read access
+        }
+        i2c_eeprom_async_env.pushed++;
+    }
+
+    // Refill when the Tx FIFO runs low, a read waits for the Rx FIFO to be emptied first
+    if (room && (i2c_eeprom_async_env.pushed < i2c_eeprom_async_env.chunk))
+        SetBits16(I2C_INTR_MASK_REG, M_TX_EMPTY, 1);
+    else
+        SetBits16(I2C_INTR_MASK_REG, M_TX_EMPTY, 0);
+}
+
+/**
+ ****************************************************************************************
+ * @brief Empty the Rx FIFO into the read buffer. Called with the I2C interrupt masked or
+ * from it.
+ ****************************************************************************************
+ */
+static void i2c_eeprom_async_drain(void)
+{
+    struct i2c_eeprom_async_req *req = &i2c_eeprom_async_env.queue[i2c_eeprom_async_env.head];
+
+    while ((i2c_eeprom_async_env.received < i2c_eeprom_async_env.pushed) && GetWord16(I2C_RXFLR_REG))
+    {
+        req->rd_ptr[i2c_eeprom_async_env.done + i2c_eeprom_async_env.received] = 0xFF & GetWord16(I2C_DATA_CMD_REG);
+        i2c_eeprom_async_env.received++;
+    }
+}
+
+/**
+ ****************************************************************************************
+ * @brief Start a new transaction: flag cleared, interrupts unmasked.
+ *
+ * @param[in] phase  I2C_EEPROM_ASYNC_PHASE_ACK_POLL or I2C_EEPROM_ASYNC_PHASE_XFER
+ * @param[in] chunk  Bytes of the transaction
+ ****************************************************************************************
+ */
+static void i2c_eeprom_async_begin(uint8_t phase, uint32_t chunk)
+{
+    i2c_eeprom_async_env.phase = phase;
+    i2c_eeprom_async_env.chunk = chunk;
+    i2c_eeprom_async_env.pushed = 0;
+    i2c_eeprom_async_env.received = 0;
+    i2c_eeprom_async_env.abort_source = 0;
+    i2c_eeprom_async_env.stopped = false;
+
+    GetWord16(I2C_CLR_INTR_REG);
+    SetWord16(I2C_INTR_MASK_REG, M_TX_ABRT | M_STOP_DET | M_RX_FULL);
+}
+
+/**
+ ****************************************************************************************
+ * @brief Send a dummy access to the EEPROM, the interrupt reports if it was acknowledged.
+ ****************************************************************************************
+ */
+static void i2c_eeprom_async_ack_poll(void)
+{
+    GLOBAL_INT_DISABLE();
+    i2c_eeprom_async_begin(I2C_EEPROM_ASYNC_PHASE_ACK_POLL, 0);
+    SEND_I2C_COMMAND(0x08);
+    GLOBAL_INT_RESTORE();
+}
+
+/**
+ ****************************************************************************************
+ * @brief Poll the EEPROM later from the kernel timer.
+ ****************************************************************************************
+ */
+static void i2c_eeprom_async_wait(void)
+{
+    i2c_eeprom_async_env.phase = I2C_EEPROM_ASYNC_PHASE_WAIT;
+    ke_timer_set(I2C_EEPROM_ASYNC_POLL, TASK_I2C_EEPROM, I2C_EEPROM_ASYNC_ACK_POLL);
+}
+
+/**
+ ****************************************************************************************
+ * @brief Start the next transaction of the current operation: the rest of the page for a
+ * write, everything that is left for a read.
+ ****************************************************************************************
+ */
+static void i2c_eeprom_async_xfer(void)
+{
+    struct i2c_eeprom_async_req *req = &i2c_eeprom_async_env.queue[i2c_eeprom_async_env.head];
+    uint32_t address = req->address + i2c_eeprom_async_env.done;
+    uint32_t chunk = req->size - i2c_eeprom_async_env.done;
+
+    if (req->op == I2C_EEPROM_ASYNC_OP_WRITE)
+    {
+        if (chunk > I2C_EEPROM_PAGE - (address % I2C_EEPROM_PAGE))
+            chunk = I2C_EEPROM_PAGE - (address % I2C_EEPROM_PAGE);
+    }
+    else if (chunk > 0x10000 - (address & 0xFFFF))
+    {
+        // the 17th address bit is part of the device address
+        chunk = 0x10000 - (address & 0xFFFF);
+    }
+
+    // The address and the first bytes are queued back to back, the FIFO must not run
+    // empty in between
+    GLOBAL_INT_DISABLE();
+    i2c_send_address(address);
+    i2c_eeprom_async_begin(I2C_EEPROM_ASYNC_PHASE_XFER, chunk);
+    i2c_eeprom_async_fill();
+    GLOBAL_INT_RESTORE();
+}
+
+/**
+ ****************************************************************************************
+ * @brief End the current operation and report it to its owner.
+ *
+ * @param[in] status  Value passed to the completion callback
+ ****************************************************************************************
+ */
+static void i2c_eeprom_async_complete(int32_t status)
+{
+    i2c_eeprom_async_cb_t cb = i2c_eeprom_async_env.queue[i2c_eeprom_async_env.head].cb;
+
+    SetWord16(I2C_INTR_MASK_REG, 0);
+
+    i2c_eeprom_async_env.phase = I2C_EEPROM_ASYNC_PHASE_IDLE;
+    i2c_eeprom_async_env.head = (i2c_eeprom_async_env.head + 1) % I2C_EEPROM_ASYNC_QUEUE_SIZE;
+    i2c_eeprom_async_env.count--;
+
+    if (status < 0)
+        i2c_eeprom_async_env.error = (int8_t)status;
+
+    if (i2c_eeprom_async_env.count == 0)
+    {
+        i2c_eeprom_release();
+        app_restore_sleep_mode();
+    }
+    else
+    {
+        ke_msg_send_basic(I2C_EEPROM_ASYNC_POLL, TASK_I2C_EEPROM, TASK_I2C_EEPROM);
+    }
+
+    if (cb != NULL)
+        cb(status);
+}
+
+/**
+ ****************************************************************************************
+ * @brief Move the current operation to its next phase.
+ ****************************************************************************************
+ */
+static void i2c_eeprom_async_step(void)
+{
+    struct i2c_eeprom_async_req *req = &i2c_eeprom_async_env.queue[i2c_eeprom_async_env.head];
+
+    switch (i2c_eeprom_async_env.phase)
+    {
+        case I2C_EEPROM_ASYNC_PHASE_IDLE:
+        {
+            if (i2c_eeprom_async_env.count == 0)
+                break;
+
+            i2c_eeprom_init(req->dev_address, req->speed, req->address_mode, req->address_size);
+            SetWord16(I2C_RX_TL_REG, I2C_EEPROM_ASYNC_FIFO_DEPTH / 2 - 1);
+            SetWord16(I2C_TX_TL_REG, I2C_EEPROM_ASYNC_FIFO_DEPTH / 4);
+
+            i2c_eeprom_async_env.done = 0;
+            i2c_eeprom_async_env.polls = 0;
+
+            // a write cycle may be running
+            i2c_eeprom_async_ack_poll();
+        } break;
+
+        case I2C_EEPROM_ASYNC_PHASE_WAIT:
+        {
+            i2c_eeprom_async_ack_poll();
+        } break;
+
+        case I2C_EEPROM_ASYNC_PHASE_ACK_POLL:
+        {
+            if (!i2c_eeprom_async_env.stopped)
+                break;
+
+            if (i2c_eeprom_async_env.abort_source)
+            {
+                // not acknowledged, the EEPROM is busy
+                if (++i2c_eeprom_async_env.polls > I2C_EEPROM_ASYNC_MAX_POLLS)
+                    i2c_eeprom_async_complete(I2C_EEPROM_ASYNC_ERR_TIMEOUT);
+                else
+                    i2c_eeprom_async_wait();
+                break;
+            }
+
+            i2c_eeprom_async_env.polls = 0;
+
+            if (i2c_eeprom_async_env.done == req->size)
+                i2c_eeprom_async_complete(i2c_eeprom_async_env.done);
+            else
+                i2c_eeprom_async_xfer();
+        } break;
+
+        case I2C_EEPROM_ASYNC_PHASE_XFER:
+        {
+            if (!i2c_eeprom_async_env.stopped)
+                break;
+
+            if (i2c_eeprom_async_env.abort_source)
+            {
+                // the bytes read are kept, a page write is done again
+                if (req->op == I2C_EEPROM_ASYNC_OP_READ)
+                    i2c_eeprom_async_env.done += i2c_eeprom_async_env.received;
+
+                if (++i2c_eeprom_async_env.polls > I2C_EEPROM_ASYNC_MAX_POLLS)
+                    i2c_eeprom_async_complete(I2C_EEPROM_ASYNC_ERR_TIMEOUT);
+                else
+                    i2c_eeprom_async_wait();
+            }
+            else if (req->op == I2C_EEPROM_ASYNC_OP_WRITE)
+            {
+                // The STOP is only issued on an empty Tx FIFO: all the queued bytes have
+                // been sent, the EEPROM is programming them
+                i2c_eeprom_async_env.done += i2c_eeprom_async_env.pushed;
+
+                if (i2c_eeprom_async_env.done == req->size)
+                    i2c_eeprom_async_complete(i2c_eeprom_async_env.done);
+                else
+                    i2c_eeprom_async_wait();
+            }
+            else
+            {
+                i2c_eeprom_async_env.done += i2c_eeprom_async_env.received;
+
+                // the interrupt could not keep the Tx FIFO fed, the rest is read after
+                // sending the address again
+                if (i2c_eeprom_async_env.done == req->size)
+                    i2c_eeprom_async_complete(i2c_eeprom_async_env.done);
+                else
+                    i2c_eeprom_async_xfer();
+            }
+        } break;
+
+        default:
+            break;
+    }
+}
+
+/**
+ ****************************************************************************************
+ * @brief Queue an operation, started from the kernel if the driver is idle.
+ *
+ * @return I2C_EEPROM_ASYNC_OK if queued, I2C_EEPROM_ASYNC_ERR_BUSY if the queue is full
+ ****************************************************************************************
+ */
+static int8_t i2c_eeprom_async_submit(uint8_t op, uint8_t *rd_ptr, uint8_t const *wr_ptr,
+                                      uint32_t address, uint32_t size, i2c_eeprom_async_cb_t cb)
+{
+    struct i2c_eeprom_async_req *req;
+
+    if (i2c_eeprom_async_env.count == I2C_EEPROM_ASYNC_QUEUE_SIZE)
+        return I2C_EEPROM_ASYNC_ERR_BUSY;
+
+    // limit to the EEPROM address space
+    if (address >= I2C_EEPROM_SIZE)
+        size = 0;
+    else if (size > I2C_EEPROM_SIZE - address)
+        size = I2C_EEPROM_SIZE - address;
+
+    req = &i2c_eeprom_async_env.queue[(i2c_eeprom_async_env.head + i2c_eeprom_async_env.count) % I2C_EEPROM_ASYNC_QUEUE_SIZE];
+    *req = i2c_eeprom_async_env.cfg;
+    req->op = op;
+    req->cb = cb;
+    req->rd_ptr = rd_ptr;
+    req->wr_ptr = wr_ptr;
+    req->address = address;
+    req->size = size;
+
+    if (i2c_eeprom_async_env.count++ == 0)
+    {
+        // The I2C is in the peripheral power domain, keep it on until the queue is empty
+        app_force_active_mode();
+
+        // The first step runs from the kernel, the callback is never called from here
+        ke_msg_send_basic(I2C_EEPROM_ASYNC_POLL, TASK_I2C_EEPROM, TASK_I2C_EEPROM);
+    }
+
+    return I2C_EEPROM_ASYNC_OK;
+}
+
+/**
+ ****************************************************************************************
+ * @brief Handles the @ref I2C_EEPROM_ASYNC_POLL message (interrupt, timer or new operation).
+ * @param[in] msgid Id of the message received (probably unused).
+ * @param[in] param Pointer to the parameters of the message.
+ * @param[in] dest_id ID of the receiving task instance (probably unused).
+ * @param[in] src_id ID of the sending task instance.
+ * @return If the message was consumed or not.
+ ****************************************************************************************
+ */
+static int i2c_eeprom_async_poll_handler(ke_msg_id_t const msgid,
+                                         void const *param,
+                                         ke_task_id_t const dest_id,
+                                         ke_task_id_t const src_id)
+{
+    i2c_eeprom_async_step();
+
+    return (KE_MSG_CONSUMED);
+}
+
+/*
+ * TASK DESCRIPTOR DEFINITIONS
+ ****************************************************************************************
+ */
+
+/// Specifies the message handler structure for every input state
+static const struct ke_state_handler i2c_eeprom_async_state_handler[I2C_EEPROM_ASYNC_STATE_MAX] =
+{
+    [I2C_EEPROM_ASYNC_IDLE] = KE_STATE_HANDLER_NONE,
+};
+
+/// Default State handlers definition
+static const struct ke_msg_handler i2c_eeprom_async_default_state[] =
+{
+    {I2C_EEPROM_ASYNC_POLL,  (ke_msg_func_t)i2c_eeprom_async_poll_handler},
+};
+
+/// Specifies the message handlers that are common to all states.
+static const struct ke_state_handler i2c_eeprom_async_default_handler = KE_STATE_HANDLER(i2c_eeprom_async_default_state);
+
+static const struct ke_task_desc TASK_DESC_I2C_EEPROM = {i2c_eeprom_async_state_handler, &i2c_eeprom_async_default_handler,
+                                                         i2c_eeprom_async_state, I2C_EEPROM_ASYNC_STATE_MAX, I2C_EEPROM_ASYNC_IDX_MAX};
+
+/*
+ * EXPORTED FUNCTION DEFINITIONS
+ ****************************************************************************************
+ */
+
+/**
+ ****************************************************************************************
+ * @brief I2C IRQ Handler: moves the data between the FIFOs and the buffers, reports the
+ * end of the transactions to the kernel.
+ ****************************************************************************************
+ */
+void I2C_Handler(void)
+{
+    uint16_t status = GetWord16(I2C_INTR_STAT_REG);
+
+    if (status & R_TX_ABRT)
+    {
+        // the Tx FIFO has been flushed, a STOP follows
+        i2c_eeprom_async_env.abort_source |= GetWord16(I2C_TX_ABRT_SOURCE_REG);
+        GetWord16(I2C_CLR_TX_ABRT_REG);
+    }
+
+    if (i2c_eeprom_async_env.queue[i2c_eeprom_async_env.head].op == I2C_EEPROM_ASYNC_OP_READ)
+        i2c_eeprom_async_drain();
+
+    if (status & R_STOP_DET)
+    {
+        GetWord16(I2C_CLR_STOP_DET_REG);
+        SetWord16(I2C_INTR_MASK_REG, 0);
+
+        i2c_eeprom_async_env.stopped = true;
+        ke_msg_send_basic(I2C_EEPROM_ASYNC_POLL, TASK_I2C_EEPROM, TASK_I2C_EEPROM);
+    }
+    else if (i2c_eeprom_async_env.abort_source == 0)
+    {
+        i2c_eeprom_async_fill();
+    }
+}
+
+void i2c_eeprom_async_init(void)
+{
+    i2c_eeprom_async_env.head = 0;
+    i2c_eeprom_async_env.count = 0;
+    i2c_eeprom_async_env.phase = I2C_EEPROM_ASYNC_PHASE_IDLE;
+
+    ke_task_create(TASK_I2C_EEPROM, &TASK_DESC_I2C_EEPROM);
+
+    ke_state_set(TASK_I2C_EEPROM, I2C_EEPROM_ASYNC_IDLE);
+
+    NVIC_EnableIRQ(I2C_IRQn);
+}
+
+void i2c_eeprom_async_config(uint16_t dev_address, uint8_t speed, uint8_t address_mode, uint8_t address_size)
+{
+    i2c_eeprom_async_env.cfg.dev_address = dev_address;
+    i2c_eeprom_async_env.cfg.speed = speed;
+    i2c_eeprom_async_env.cfg.address_mode = address_mode;
+    i2c_eeprom_async_env.cfg.address_size = address_size;
+}
+
+bool i2c_eeprom_async_busy(void)
+{
+    return (i2c_eeprom_async_env.count != 0);
+}
+
+int8_t i2c_eeprom_async_flush(void)
+{
+    uint32_t since = ke_time();
+    uint32_t done = i2c_eeprom_async_env.done;
+    uint8_t head = i2c_eeprom_async_env.head;
+
+    i2c_eeprom_async_env.error = I2C_EEPROM_ASYNC_OK;
+
+    while (i2c_eeprom_async_env.count != 0)
+    {
+        // time since the current operation last made progress
+        if ((head != i2c_eeprom_async_env.head) || (done != i2c_eeprom_async_env.done))
+        {
+            head = i2c_eeprom_async_env.head;
+            done = i2c_eeprom_async_env.done;
+            since = ke_time();
+        }
+
+        if (i2c_eeprom_async_env.phase == I2C_EEPROM_ASYNC_PHASE_WAIT)
+        {
+            // Poll now instead of waiting for the timer. The polls run back to back, a
+            // write cycle takes many of them: the operation is given the same time as
+            // from the timer instead of the same number of polls.
+            ke_timer_clear(I2C_EEPROM_ASYNC_POLL, TASK_I2C_EEPROM);
+
+            if (((ke_time() - since) & BLE_GROSSTARGET_MASK) > I2C_EEPROM_ASYNC_MAX_POLLS * I2C_EEPROM_ASYNC_ACK_POLL)
+            {
+                i2c_eeprom_async_complete(I2C_EEPROM_ASYNC_ERR_TIMEOUT);
+            }
+            else
+            {
+                i2c_eeprom_async_env.polls = 0;
+                i2c_eeprom_async_ack_poll();
+            }
+        }
+        else if ((i2c_eeprom_async_env.phase == I2C_EEPROM_ASYNC_PHASE_IDLE) || i2c_eeprom_async_env.stopped)
+        {
+            i2c_eeprom_async_step();
+        }
+        // else the transaction is moved by the interrupt
+    }
+
+    return i2c_eeprom_async_env.error;
+}
+
+int8_t i2c_eeprom_async_read(uint8_t *rd_data_ptr, uint32_t address, uint32_t size, i2c_eeprom_async_cb_t cb)
+{
+    return i2c_eeprom_async_submit(I2C_EEPROM_ASYNC_OP_READ, rd_data_ptr, NULL, address, size, cb);
+}
+
+int8_t i2c_eeprom_async_write(uint8_t const *wr_data_ptr, uint32_t address, uint32_t size, i2c_eeprom_async_cb_t cb)
+{
+    return i2c_eeprom_async_submit(I2C_EEPROM_ASYNC_OP_WRITE, NULL, wr_data_ptr, address, size, cb);
+}
+
+#endif //I2C_EEPROM_ASYNC
+
+/// @} I2C_EEPROM_ASYNC
@@ -0,0 +1,196 @@
+/**
+ ****************************************************************************************
+ *
+ * @file i2c_eeprom_async.h
+ *
+ * @brief Interrupt driven I2C EEPROM driver header file.
+ *
+ * Copyright (C) 2012. Dialog Semiconductor Ltd, unpublished work. This computer
+ * program includes Confidential, Proprietary Information and is a Trade Secret of
+ * Dialog Semiconductor Ltd.  All use, disclosure, and/or reproduction is prohibited
+ * unless authorized in writing. All Rights Reserved.
+ *
+ * <bluetooth.support@diasemi.com> and contributors.
+ *
+ ****************************************************************************************
+ */
+
+#ifndef _I2C_EEPROM_ASYNC_
+#define _I2C_EEPROM_ASYNC_
+
+/**
+ ****************************************************************************************
+ * @addtogroup I2C_EEPROM_ASYNC Interrupt driven I2C EEPROM
+ * @brief Read and write operations that do not block the main loop nor the interrupts.
+ *
+ * Operations are queued and return immediately. The bytes are moved between the I2C
+ * FIFOs and the buffers by the I2C interrupt, the TASK_I2C_EEPROM task starts the
+ * transactions and calls the completion callbacks from the kernel context. The end of
+ * the EEPROM write cycles is polled (ACK polling) from a kernel timer. A read is a single
+ * sequential read of any length, the address is only sent again if the interrupt could
+ * not keep the FIFO fed.
+ *
+ * The controller is configured by the driver for each operation and released when the
+ * queue is empty. The blocking functions of i2c_eeprom.h can only be used when
+ * i2c_eeprom_async_busy() is false (see i2c_eeprom_async_flush()).
+ *
+ * @{
+ ****************************************************************************************
+ */
+
+/*
+ * INCLUDE FILES
+ ****************************************************************************************
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "arch.h"
+#include "rwip_config.h"
+#include "ke_task.h"
+#include "i2c_eeprom.h"
+
+#if (I2C_EEPROM_ASYNC)
+
+/*
+ * DEFINES
+ ****************************************************************************************
+ */
+
+/// Number of operations that can be queued
+#ifndef I2C_EEPROM_ASYNC_QUEUE_SIZE
+#define I2C_EEPROM_ASYNC_QUEUE_SIZE     (4)
+#endif
+
+/// ACK polling period (in 10ms unit)
+#ifndef I2C_EEPROM_ASYNC_ACK_POLL
+#define I2C_EEPROM_ASYNC_ACK_POLL       (1)
+#endif
+
+/// Maximum number of ACK polls or aborted transactions before an operation fails (from
+/// i2c_eeprom_async_flush(), the time of as many ACK polling periods)
+#ifndef I2C_EEPROM_ASYNC_MAX_POLLS
+#define I2C_EEPROM_ASYNC_MAX_POLLS      (20)
+#endif
+
+/// Depth of the I2C Tx and Rx FIFOs
+#define I2C_EEPROM_ASYNC_FIFO_DEPTH     (32)
+
+/// Status codes (same values as the SPI Flash driver)
+#define I2C_EEPROM_ASYNC_OK             (0)
+#define I2C_EEPROM_ASYNC_ERR_TIMEOUT    (-1)
+#define I2C_EEPROM_ASYNC_ERR_BUSY       (-9)
+
+/// Number of task instances
+#define I2C_EEPROM_ASYNC_IDX_MAX        (1)
+
+/// States of the I2C EEPROM task
+enum
+{
+    /// Only state
+    I2C_EEPROM_ASYNC_IDLE,
+
+    /// Number of states
+    I2C_EEPROM_ASYNC_STATE_MAX
+};
+
+/// Messages of the I2C EEPROM task
+enum
+{
+    /// Internal: end of a transaction (interrupt), ACK polling timer or new operation
+    I2C_EEPROM_ASYNC_POLL = KE_FIRST_MSG(TASK_I2C_EEPROM),
+};
+
+/*
+ * TYPE DEFINITIONS
+ ****************************************************************************************
+ */
+
+/**
+ ****************************************************************************************
+ * @brief Completion callback
+ *
+ * @param[in] status  Number of bytes read or written, negative error code on failure
+ ****************************************************************************************
+ */
+typedef void (*i2c_eeprom_async_cb_t)(int32_t status);
+
+/*
+ * FUNCTION DECLARATIONS
+ ****************************************************************************************
+ */
+
+/**
+ ****************************************************************************************
+ * @brief Create the I2C EEPROM task and enable the I2C interrupt.
+ ****************************************************************************************
+ */
+void i2c_eeprom_async_init(void);
+
+/**
+ ****************************************************************************************
+ * @brief Select the EEPROM of the next operations (same parameters as i2c_eeprom_init()).
+ ****************************************************************************************
+ */
+void i2c_eeprom_async_config(uint16_t dev_address, uint8_t speed, uint8_t address_mode, uint8_t address_size);
+
+/**
+ ****************************************************************************************
+ * @brief Check if operations are pending.
+ *
+ * @return true if an operation has been queued and its callback not called yet
+ ****************************************************************************************
+ */
+bool i2c_eeprom_async_busy(void);
+
+/**
+ ****************************************************************************************
+ * @brief Run the queued operations to completion from the caller (ACK polling included),
+ * the callbacks are called from here. The controller is released on return.
+ *
+ * An operation fails if the EEPROM does not acknowledge it for
+ * I2C_EEPROM_ASYNC_MAX_POLLS * I2C_EEPROM_ASYNC_ACK_POLL, as when it runs from the kernel.
+ *
+ * @return I2C_EEPROM_ASYNC_OK if all the operations succeeded, else the status of the last
+ * one that failed
+ ****************************************************************************************
+ */
+int8_t i2c_eeprom_async_flush(void);
+
+/**
+ ****************************************************************************************
+ * @brief Read data from I2C EEPROM (up to the end of the EEPROM).
+ *
+ * @param[in] rd_data_ptr     Read data pointer.
+ * @param[in] address         Starting memory address.
+ * @param[in] size            Size of the data to be read.
+ * @param[in] cb              Completion callback (can be NULL), receives the number of
+ *                            bytes read
+ *
+ * @return I2C_EEPROM_ASYNC_OK if queued, I2C_EEPROM_ASYNC_ERR_BUSY if the queue is full
+ ****************************************************************************************
+ */
+int8_t i2c_eeprom_async_read(uint8_t *rd_data_ptr, uint32_t address, uint32_t size, i2c_eeprom_async_cb_t cb);
+
+/**
+ ****************************************************************************************
+ * @brief Write data to I2C EEPROM, across pages. The data must stay valid until the
+ * callback is called. The write cycle of the last page may still be running then, the
+ * next operation waits for it.
+ *
+ * @param[in] wr_data_ptr     Pointer to the first of bytes to be written.
+ * @param[in] address         Starting address of the write process.
+ * @param[in] size            Size of the data to be written.
+ * @param[in] cb              Completion callback (can be NULL), receives the number of
+ *                            bytes written
+ *
+ * @return I2C_EEPROM_ASYNC_OK if queued, I2C_EEPROM_ASYNC_ERR_BUSY if the queue is full
+ ****************************************************************************************
+ */
+int8_t i2c_eeprom_async_write(uint8_t const *wr_data_ptr, uint32_t address, uint32_t size, i2c_eeprom_async_cb_t cb);
+
+#endif //I2C_EEPROM_ASYNC
+
+/// @} I2C_EEPROM_ASYNC
+
+#endif //_I2C_EEPROM_ASYNC_
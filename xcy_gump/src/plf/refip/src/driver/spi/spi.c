@@ -184,4 +184,91 @@ uint32_t spi_transaction(uint32_t dataToSend)
 	return dataRead;							            // return data read from spi slave
 }
 
+/**
+****************************************************************************************
+* @brief Wait for the end of the current SPI transfer and clear the pending flag
+****************************************************************************************
+*/
+static inline void spi_wait_and_clear(void)
+{
+	while (GetBits16(SPI_CTRL_REG, SPI_INT_BIT) == 0);	// polling to wait for spi transmission
+	SetWord16(SPI_CLEAR_INT_REG, 0x01);						// clear pending flag
+}
+
+/**
+****************************************************************************************
+* @brief Read a block of bytes from slave without acting on CS
+* @param[out] data: buffer receiving the bytes
+* @param[in] size: number of bytes to read
+****************************************************************************************
+*/
+void spi_read_block(uint8_t *data, uint32_t size)
+{
+	uint32_t word;
+	uint32_t words = size >> 2;
+
+	if (words)
+	{
+		spi_set_bitmode(SPI_MODE_32BIT);
+
+		while (words--)
+		{
+			SetWord16(SPI_RX_TX_REG1, 0x0000);
+			SetWord16(SPI_RX_TX_REG0, 0x0000);
+			spi_wait_and_clear();
+
+			word = ((uint32_t)GetWord16(SPI_RX_TX_REG1) << 16) | GetWord16(SPI_RX_TX_REG0);
+			data[0] = (uint8_t)(word >> 24);			// first byte on the bus is the MSB
+			data[1] = (uint8_t)(word >> 16);
+			data[2] = (uint8_t)(word >> 8);
+			data[3] = (uint8_t)word;
+			data += 4;
+		}
+	}
+
+	spi_set_bitmode(SPI_MODE_8BIT);
+
+	size &= 3;
+	while (size--)
+	{
+		SetWord16(SPI_RX_TX_REG0, 0x0000);
+		spi_wait_and_clear();
+		*data++ = (uint8_t)GetWord16(SPI_RX_TX_REG0);
+	}
+}
+
+/**
+****************************************************************************************
+* @brief Write a block of bytes to slave without acting on CS
+* @param[in] data: bytes to write
+* @param[in] size: number of bytes to write
+****************************************************************************************
+*/
+void spi_write_block(uint8_t const *data, uint32_t size)
+{
+	uint32_t words = size >> 2;
+
+	if (words)
+	{
+		spi_set_bitmode(SPI_MODE_32BIT);
+
+		while (words--)
+		{
+			SetWord16(SPI_RX_TX_REG1, ((uint16_t)data[0] << 8) | data[1]);	// first byte on the bus is the MSB
+			SetWord16(SPI_RX_TX_REG0, ((uint16_t)data[2] << 8) | data[3]);
+			data += 4;
+			spi_wait_and_clear();
+		}
+	}
+
+	spi_set_bitmode(SPI_MODE_8BIT);
+
+	size &= 3;
+	while (size--)
+	{
+		SetWord16(SPI_RX_TX_REG0, *data++);
+		spi_wait_and_clear();
+	}
+}
+
 
@@ -136,4 +136,26 @@ uint32_t spi_access(uint32_t dataToSend);
 */
 uint32_t spi_transaction(uint32_t dataToSend);
 
+/**
+****************************************************************************************
+* @brief Read a block of bytes from slave without acting on CS. The bytes are clocked in
+*        32-bit words (most significant byte first) and the remaining 0..3 bytes in
+*        8-bit mode. 0x00 is sent while reading. The SPI is left in 8-bit mode.
+* @param[out] data: buffer receiving the bytes
+* @param[in] size: number of bytes to read
+****************************************************************************************
+*/
+void spi_read_block(uint8_t *data, uint32_t size);
+
+/**
+****************************************************************************************
+* @brief Write a block of bytes to slave without acting on CS. The bytes are clocked out
+*        in 32-bit words (most significant byte first) and the remaining 0..3 bytes in
+*        8-bit mode. The data read is discarded. The SPI is left in 8-bit mode.
+* @param[in] data: bytes to write
+* @param[in] size: number of bytes to write
+****************************************************************************************
+*/
+void spi_write_block(uint8_t const *data, uint32_t size);
+
 #endif // _SPI_
@@ -186,7 +186,7 @@ int32_t spi_flash_write_status_reg(uint8_t dataToWrite)
 uint32_t spi_flash_read_data (uint8_t *rd_data_ptr, uint32_t address, uint32_t size)
 {
     int8_t spi_flash_status;
-	uint32_t bytes_read, i, temp_size;
+	uint32_t bytes_read, temp_size;
 	
 	// check that all bytes to be retrieved are located in valid flash memory address space
 	if (size + address > spi_flash_size)
@@ -212,12 +212,7 @@ uint32_t spi_flash_read_data (uint8_t *rd_data_ptr, uint32_t address, uint32_t s
     
     spi_access( (READ_DATA<<24) | address);             // Command for sequencial reading from memory
       
-    spi_set_bitmode(SPI_MODE_8BIT);
-    
-    for(i=0; i<temp_size; i++)
-    {
-		*rd_data_ptr++ = (uint8_t)spi_access(0x0000);   // bare SPI transaction
-    }
+    spi_read_block(rd_data_ptr, temp_size);             // bulk read, leaves the SPI in 8-bit mode
 	
 	spi_cs_high();               			            // push CS high
 	
@@ -238,15 +233,38 @@ uint32_t spi_flash_read_data (uint8_t *rd_data_ptr, uint32_t address, uint32_t s
 int32_t spi_flash_page_program(uint8_t *wr_data_ptr, uint32_t address, uint16_t size)
 {
     int8_t spi_flash_status;
-	uint16_t temp_size = size;
-    	
-	if (temp_size > spi_flash_page_size)                // check for max page size
-		temp_size = spi_flash_page_size;
 	
     spi_flash_status = spi_flash_wait_till_ready();
     if (spi_flash_status != ERR_OK)
         return spi_flash_status; // an error has occured   
   
+    spi_flash_status = spi_flash_page_program_start(wr_data_ptr, address, size);
+    if (spi_flash_status != ERR_OK)  
+        return spi_flash_status; // an error has occured       
+    
+    return spi_flash_wait_till_ready();
+}
+
+
+/**
+ ****************************************************************************************
+ * @brief Start programming a page (up to <SPI Flash page size> bytes) at given address,
+ *        without waiting for the end of the programming. The flash must be ready.
+ *
+ * @param[in] *wr_data_ptr:  Pointer to the data to be written
+ * @param[in] address:       Starting address of data to be written
+ * @param[in] size:          Size of the data to be written (should not be larger than SPI Flash page size)
+ * @return error code or success (ERR_OK)
+ ****************************************************************************************
+ */
+int8_t spi_flash_page_program_start(uint8_t const *wr_data_ptr, uint32_t address, uint16_t size)
+{
+    int8_t spi_flash_status;
+	uint16_t temp_size = size;
+    	
+	if (temp_size > spi_flash_page_size)                // check for max page size
+		temp_size = spi_flash_page_size;
+	
     spi_flash_status = spi_flash_set_write_enable();    // send [Write Enable] instruction
     if (spi_flash_status != ERR_OK)  
         return spi_flash_status; // an error has occured       
@@ -259,15 +277,10 @@ int32_t spi_flash_page_program(uint8_t *wr_data_ptr, uint32_t address, uint16_t
     
     //for (i=0; i<2000; i++);
     
-    spi_set_bitmode(SPI_MODE_8BIT);           
-	while(temp_size>0)                                  // Write data bytes
-    {
-		spi_access(*wr_data_ptr++);
-		temp_size--;
-	}
+    spi_write_block(wr_data_ptr, temp_size);            // Write data bytes, leaves the SPI in 8-bit mode
 	
     spi_cs_high();                                      // push CS high  
-  	return spi_flash_wait_till_ready();
+  	return ERR_OK;
 }
 
 
@@ -281,6 +294,23 @@ int32_t spi_flash_page_program(uint8_t *wr_data_ptr, uint32_t address, uint16_t
  ****************************************************************************************
  */
 int8_t spi_flash_block_erase(uint32_t address, SPI_erase_module_t spiEraseModule)
+{
+ 	if (spi_flash_block_erase_start(address, spiEraseModule) != ERR_OK)
+		return ERR_TIMEOUT;
+   
+  	return spi_flash_wait_till_ready();                 
+ }
+
+/**
+ ****************************************************************************************
+ * @brief Issue a command to Erase a given address, without waiting for the end of the erase
+ *
+ * @param[in] address:  Address that belongs to the block64/block32/sector range
+ * @param[in] spiEraseModule: BLOCK_ERASE_64, BLOCK_ERASE_32, SECTOR_ERASE
+ * @return error code or success (ERR_OK)
+ ****************************************************************************************
+ */
+int8_t spi_flash_block_erase_start(uint32_t address, SPI_erase_module_t spiEraseModule)
 {
  	if (spi_flash_set_write_enable() != ERR_OK)         // send [Write Enable] instruction
 		return ERR_TIMEOUT;
@@ -289,7 +319,7 @@ int8_t spi_flash_block_erase(uint32_t address, SPI_erase_module_t spiEraseModule
 	
     spi_transaction( (spiEraseModule<<24) | address);   // Command for erasing a sector    
    
-  	return spi_flash_wait_till_ready();                 
+  	return ERR_OK;
  }
 
 /**
@@ -303,6 +333,22 @@ int8_t spi_flash_chip_erase(void)
 	//TI GINETAI SE AN H MNIMI EINAI PROTECTED
     uint8_t status;
     
+    if (spi_flash_chip_erase_start() != ERR_OK)
+		return ERR_TIMEOUT;
+    
+    status = spi_flash_wait_till_ready();
+    
+    return status;
+}
+
+/**
+ ****************************************************************************************
+ * @brief Issue a command to Erase the chip, without waiting for the end of the erase
+ * @return error code or success (ERR_OK)
+ ****************************************************************************************
+ */
+int8_t spi_flash_chip_erase_start(void)
+{
     if (spi_flash_set_write_enable() != ERR_OK)         // send [Write Enable] instruction
 		return ERR_TIMEOUT;
     
@@ -310,9 +356,7 @@ int8_t spi_flash_chip_erase(void)
         
     spi_transaction(CHIP_ERASE);                    // Command for Chip Erase    
     
-    status = spi_flash_wait_till_ready();
-    
-    return status;
+    return ERR_OK;
 }
 
 
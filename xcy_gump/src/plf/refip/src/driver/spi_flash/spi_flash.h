@@ -54,6 +54,7 @@ typedef enum SPI_ERASE_MODULE
 #define ERR_UNKNOWN_FLASH_VENDOR -6
 #define ERR_UNKNOWN_FLASH_TYPE	 -7
 #define ERR_PROG_ERROR			 -8
+#define ERR_BUSY			     -9
 
 /* commands */
 #define WRITE_ENABLE      0x06 
@@ -154,6 +155,18 @@ uint32_t spi_flash_read_data (uint8_t *rd_data_ptr, uint32_t address, uint32_t s
  ****************************************************************************************
  */
 int32_t spi_flash_page_program(uint8_t *wr_data_ptr, uint32_t address, uint16_t size);
+/**
+ ****************************************************************************************
+ * @brief Start programming a page (up to <SPI Flash page size> bytes) at given address,
+ *        without waiting for the end of the programming. The flash must be ready.
+ *
+ * @param[in] *wr_data_ptr:  Pointer to the data to be written
+ * @param[in] address:       Starting address of data to be written
+ * @param[in] size:          Size of the data to be written (should not be larger than SPI Flash page size)
+ * @return error code or success (ERR_OK)
+ ****************************************************************************************
+ */
+int8_t spi_flash_page_program_start(uint8_t const *wr_data_ptr, uint32_t address, uint16_t size);
 
  /**
  ****************************************************************************************
@@ -165,6 +178,16 @@ int32_t spi_flash_page_program(uint8_t *wr_data_ptr, uint32_t address, uint16_t
  ****************************************************************************************
  */
 int8_t spi_flash_block_erase(uint32_t address, SPI_erase_module_t spiEraseModule);
+ /**
+ ****************************************************************************************
+ * @brief Issue a command to Erase a given address, without waiting for the end of the erase
+ *
+ * @param[in] address:  Address that belongs to the block64/block32/sector range
+ * @param[in] spiEraseModule: BLOCK_ERASE_64, BLOCK_ERASE_32, SECTOR_ERASE
+ * @return error code or success (ERR_OK)
+ ****************************************************************************************
+ */
+int8_t spi_flash_block_erase_start(uint32_t address, SPI_erase_module_t spiEraseModule);
  /**
  ****************************************************************************************
  * @brief Erase chip
@@ -172,6 +195,13 @@ int8_t spi_flash_block_erase(uint32_t address, SPI_erase_module_t spiEraseModule
  ****************************************************************************************
  */
 int8_t spi_flash_chip_erase(void);
+ /**
+ ****************************************************************************************
+ * @brief Issue a command to Erase the chip, without waiting for the end of the erase
+ * @return error code or success (ERR_OK)
+ ****************************************************************************************
+ */
+int8_t spi_flash_chip_erase_start(void);
 /**
  ****************************************************************************************
  * @brief verify erasure
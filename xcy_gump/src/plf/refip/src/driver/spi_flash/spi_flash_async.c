@@ -0,0 +1,392 @@
+/**
+ ****************************************************************************************
+ *
+ * @file spi_flash_async.c
+ *
+ * @brief Asynchronous SPI Flash driver.
+ *
+ * Copyright (C) 2012. Dialog Semiconductor Ltd, unpublished work. This computer
+ * program includes Confidential, Proprietary Information and is a Trade Secret of
+ * Dialog Semiconductor Ltd.  All use, disclosure, and/or reproduction is prohibited
+ * unless authorized in writing. All Rights Reserved.
+ *
+ * <bluetooth.support@diasemi.com> and contributors.
+ *
+ ****************************************************************************************
+ */
+
+/**
+ ****************************************************************************************
+ * @addtogroup SPI_FLASH_ASYNC
+ * @{
+ ****************************************************************************************
+ */
+
+/*
+ * INCLUDE FILES
+ ****************************************************************************************
+ */
+
+#include "spi_flash_async.h"
+
+#if (SPI_FLASH_ASYNC)
+
+#include <stddef.h>
+#include "ke_msg.h"
+#include "ke_timer.h"
+#include "arch_sleep.h"
+
+/*
+ * DEFINES
+ ****************************************************************************************
+ */
+
+/// Operations
+enum spi_flash_async_op
+{
+    SPI_FLASH_ASYNC_OP_NONE,
+    SPI_FLASH_ASYNC_OP_READ,
+    SPI_FLASH_ASYNC_OP_WRITE,
+    SPI_FLASH_ASYNC_OP_ERASE,
+    SPI_FLASH_ASYNC_OP_CHIP_ERASE,
+};
+
+/*
+ * STRUCTURES DEFINTIONS
+ ****************************************************************************************
+ */
+
+/// Pending operation
+struct spi_flash_async_env_tag
+{
+    /// Completion callback
+    spi_flash_async_cb_t cb;
+    /// Destination of a read
+    uint8_t *rd_ptr;
+    /// Source of a write
+    uint8_t const *wr_ptr;
+    /// Next flash address
+    uint32_t address;
+    /// Bytes left
+    uint32_t size;
+    /// Bytes done
+    uint32_t done;
+    /// WIP polls of the current step
+    uint16_t polls;
+    /// Operation (@see enum spi_flash_async_op), SPI_FLASH_ASYNC_OP_NONE if idle
+    uint8_t op;
+    /// Erase command of SPI_FLASH_ASYNC_OP_ERASE
+    uint8_t erase_module;
+};
+
+/*
+ * GLOBAL VARIABLES
+ ****************************************************************************************
+ */
+
+// local copy of FLASH setup parameters (spi_flash.c)
+extern uint32_t spi_flash_size;
+extern uint32_t spi_flash_page_size;
+
+static struct spi_flash_async_env_tag spi_flash_async_env;
+
+/// Defines the placeholder for the states of all the task instances.
+static ke_state_t spi_flash_async_state[SPI_FLASH_ASYNC_IDX_MAX];
+
+/*
+ * LOCAL FUNCTION DEFINITIONS
+ ****************************************************************************************
+ */
+
+/**
+ ****************************************************************************************
+ * @brief End the pending operation and report it to its owner.
+ *
+ * @param[in] status  Value passed to the completion callback
+ ****************************************************************************************
+ */
+static void spi_flash_async_complete(int32_t status)
+{
+    spi_flash_async_cb_t cb = spi_flash_async_env.cb;
+
+    // Idle before the callback, so that it can submit the next operation
+    spi_flash_async_env.op = SPI_FLASH_ASYNC_OP_NONE;
+    spi_flash_async_env.cb = NULL;
+
+    app_restore_sleep_mode();
+
+    if (cb != NULL)
+        cb(status);
+}
+
+/**
+ ****************************************************************************************
+ * @brief Schedule the next poll of the flash on a timer, so that the system can sleep
+ * while the flash is busy. A page program completes within a few ms, erases take tens
+ * of ms to seconds.
+ ****************************************************************************************
+ */
+static void spi_flash_async_poll_later(void)
+{
+    if (spi_flash_async_env.op == SPI_FLASH_ASYNC_OP_WRITE)
+        ke_timer_set(SPI_FLASH_ASYNC_POLL, TASK_SPI_FLASH, SPI_FLASH_ASYNC_WRITE_POLL);
+    else
+        ke_timer_set(SPI_FLASH_ASYNC_POLL, TASK_SPI_FLASH, SPI_FLASH_ASYNC_ERASE_POLL);
+}
+
+/**
+ ****************************************************************************************
+ * @brief Run the pending operation as far as possible without waiting for the flash.
+ ****************************************************************************************
+ */
+static void spi_flash_async_step(void)
+{
+    int8_t status = ERR_OK;
+
+    if (spi_flash_async_env.op == SPI_FLASH_ASYNC_OP_NONE)
+        return;
+
+    // Wait for the end of the previous program or erase
+    if (spi_flash_read_status_reg() & STATUS_BUSY)
+    {
+        if (++spi_flash_async_env.polls > SPI_FLASH_ASYNC_MAX_POLLS)
+            spi_flash_async_complete(ERR_TIMEOUT);
+        else
+            spi_flash_async_poll_later();
+        return;
+    }
+    spi_flash_async_env.polls = 0;
+
+    switch (spi_flash_async_env.op)
+    {
+        case SPI_FLASH_ASYNC_OP_READ:
+        {
+            // Reads do not set WIP, completed at once
+            spi_flash_async_complete(spi_flash_read_data(spi_flash_async_env.rd_ptr,
+                                                         spi_flash_async_env.address,
+                                                         spi_flash_async_env.size));
+        } break;
+
+        case SPI_FLASH_ASYNC_OP_WRITE:
+        {
+            uint32_t page_left;
+
+            if (spi_flash_async_env.size == 0)
+            {
+                spi_flash_async_complete(spi_flash_async_env.done);
+                break;
+            }
+
+            // limit the program to the upper limit of the current page
+            page_left = spi_flash_page_size - (spi_flash_async_env.address % spi_flash_page_size);
+            if (page_left > spi_flash_async_env.size)
+                page_left = spi_flash_async_env.size;
+
+            status = spi_flash_page_program_start(spi_flash_async_env.wr_ptr, spi_flash_async_env.address, page_left);
+            if (status != ERR_OK)
+            {
+                spi_flash_async_complete(status);
+                break;
+            }
+
+            spi_flash_async_env.wr_ptr += page_left;
+            spi_flash_async_env.address += page_left;
+            spi_flash_async_env.size -= page_left;
+            spi_flash_async_env.done += page_left;
+
+            spi_flash_async_poll_later();
+        } break;
+
+        case SPI_FLASH_ASYNC_OP_ERASE:
+        case SPI_FLASH_ASYNC_OP_CHIP_ERASE:
+        {
+            // size is used as the "command issued" flag
+            if (spi_flash_async_env.size == 0)
+            {
+                spi_flash_async_complete(ERR_OK);
+                break;
+            }
+
+            if (spi_flash_async_env.op == SPI_FLASH_ASYNC_OP_ERASE)
+                status = spi_flash_block_erase_start(spi_flash_async_env.address,
+                                                     (SPI_erase_module_t)spi_flash_async_env.erase_module);
+            else
+                status = spi_flash_chip_erase_start();
+
+            if (status != ERR_OK)
+            {
+                spi_flash_async_complete(status);
+                break;
+            }
+
+            spi_flash_async_env.size = 0;
+            spi_flash_async_poll_later();
+        } break;
+
+        default:
+            break;
+    }
+}
+
+/**
+ ****************************************************************************************
+ * @brief Register an operation and start it from the kernel.
+ *
+ * @return ERR_OK if submitted, ERR_BUSY if an operation is pending
+ ****************************************************************************************
+ */
+static int8_t spi_flash_async_submit(uint8_t op, uint32_t address, uint32_t size, spi_flash_async_cb_t cb)
+{
+    if (spi_flash_async_env.op != SPI_FLASH_ASYNC_OP_NONE)
+        return ERR_BUSY;
+
+    spi_flash_async_env.op = op;
+    spi_flash_async_env.cb = cb;
+    spi_flash_async_env.address = address;
+    spi_flash_async_env.size = size;
+    spi_flash_async_env.done = 0;
+    spi_flash_async_env.polls = 0;
+
+    // The SPI is in the peripheral power domain, keep it on until completion
+    app_force_active_mode();
+
+    // The first step runs from the kernel, the callback is never called from here
+    ke_msg_send_basic(SPI_FLASH_ASYNC_POLL, TASK_SPI_FLASH, TASK_SPI_FLASH);
+
+    return ERR_OK;
+}
+
+/**
+ ****************************************************************************************
+ * @brief Handles the @ref SPI_FLASH_ASYNC_POLL message (kick or timer).
+ * @param[in] msgid Id of the message received (probably unused).
+ * @param[in] param Pointer to the parameters of the message.
+ * @param[in] dest_id ID of the receiving task instance (probably unused).
+ * @param[in] src_id ID of the sending task instance.
+ * @return If the message was consumed or not.
+ ****************************************************************************************
+ */
+static int spi_flash_async_poll_handler(ke_msg_id_t const msgid,
+                                        void const *param,
+                                        ke_task_id_t const dest_id,
+                                        ke_task_id_t const src_id)
+{
+    spi_flash_async_step();
+
+    return (KE_MSG_CONSUMED);
+}
+
+/*
+ * TASK DESCRIPTOR DEFINITIONS
+ ****************************************************************************************
+ */
+
+/// Specifies the message handler structure for every input state
+static const struct ke_state_handler spi_flash_async_state_handler[SPI_FLASH_ASYNC_STATE_MAX] =
+{
+    [SPI_FLASH_ASYNC_IDLE] = KE_STATE_HANDLER_NONE,
+};
+
+/// Default State handlers definition
+static const struct ke_msg_handler spi_flash_async_default_state[] =
+{
+    {SPI_FLASH_ASYNC_POLL,  (ke_msg_func_t)spi_flash_async_poll_handler},
+};
+
+/// Specifies the message handlers that are common to all states.
+static const struct ke_state_handler spi_flash_async_default_handler = KE_STATE_HANDLER(spi_flash_async_default_state);
+
+static const struct ke_task_desc TASK_DESC_SPI_FLASH = {spi_flash_async_state_handler, &spi_flash_async_default_handler,
+                                                        spi_flash_async_state, SPI_FLASH_ASYNC_STATE_MAX, SPI_FLASH_ASYNC_IDX_MAX};
+
+/*
+ * EXPORTED FUNCTION DEFINITIONS
+ ****************************************************************************************
+ */
+
+void spi_flash_async_init(void)
+{
+    spi_flash_async_env.op = SPI_FLASH_ASYNC_OP_NONE;
+    spi_flash_async_env.cb = NULL;
+
+    ke_task_create(TASK_SPI_FLASH, &TASK_DESC_SPI_FLASH);
+
+    ke_state_set(TASK_SPI_FLASH, SPI_FLASH_ASYNC_IDLE);
+}
+
+bool spi_flash_async_busy(void)
+{
+    return (spi_flash_async_env.op != SPI_FLASH_ASYNC_OP_NONE);
+}
+
+int8_t spi_flash_async_flush(void)
+{
+    uint16_t retries = SPI_FLASH_ASYNC_MAX_POLLS;
+
+    // The poll message or timer still pending finds the driver idle, or polls the next operation early
+    while (spi_flash_async_env.op != SPI_FLASH_ASYNC_OP_NONE)
+    {
+        if (spi_flash_wait_till_ready() != ERR_OK)
+        {
+            if (--retries == 0)
+            {
+                spi_flash_async_complete(ERR_TIMEOUT);
+                return ERR_TIMEOUT;
+            }
+            continue;
+        }
+
+        spi_flash_async_step();
+    }
+
+    return ERR_OK;
+}
+
+int8_t spi_flash_async_read(uint8_t *rd_data_ptr, uint32_t address, uint32_t size, spi_flash_async_cb_t cb)
+{
+    int8_t status = spi_flash_async_submit(SPI_FLASH_ASYNC_OP_READ, address, size, cb);
+
+    if (status == ERR_OK)
+        spi_flash_async_env.rd_ptr = rd_data_ptr;
+
+    return status;
+}
+
+int8_t spi_flash_async_write(uint8_t const *wr_data_ptr, uint32_t address, uint32_t size, spi_flash_async_cb_t cb)
+{
+    int8_t status;
+
+    // limit to the maximum count of bytes that can be written to a (SPI_FLASH_SIZE x 8) flash
+    if (address >= spi_flash_size)
+        size = 0;
+    else if (size > spi_flash_size - address)
+        size = spi_flash_size - address;
+
+    status = spi_flash_async_submit(SPI_FLASH_ASYNC_OP_WRITE, address, size, cb);
+
+    if (status == ERR_OK)
+        spi_flash_async_env.wr_ptr = wr_data_ptr;
+
+    return status;
+}
+
+int8_t spi_flash_async_block_erase(uint32_t address, SPI_erase_module_t spiEraseModule, spi_flash_async_cb_t cb)
+{
+    // size != 0 until the command is issued
+    int8_t status = spi_flash_async_submit(SPI_FLASH_ASYNC_OP_ERASE, address, 1, cb);
+
+    if (status == ERR_OK)
+        spi_flash_async_env.erase_module = (uint8_t)spiEraseModule;
+
+    return status;
+}
+
+int8_t spi_flash_async_chip_erase(spi_flash_async_cb_t cb)
+{
+    // size != 0 until the command is issued
+    return spi_flash_async_submit(SPI_FLASH_ASYNC_OP_CHIP_ERASE, 0, 1, cb);
+}
+
+#endif //SPI_FLASH_ASYNC
+
+/// @} SPI_FLASH_ASYNC
@@ -0,0 +1,192 @@
+/**
+ ****************************************************************************************
+ *
+ * @file spi_flash_async.h
+ *
+ * @brief Asynchronous SPI Flash driver header file.
+ *
+ * Copyright (C) 2012. Dialog Semiconductor Ltd, unpublished work. This computer
+ * program includes Confidential, Proprietary Information and is a Trade Secret of
+ * Dialog Semiconductor Ltd.  All use, disclosure, and/or reproduction is prohibited
+ * unless authorized in writing. All Rights Reserved.
+ *
+ * <bluetooth.support@diasemi.com> and contributors.
+ *
+ ****************************************************************************************
+ */
+
+#ifndef _SPI_FLASH_ASYNC_
+#define _SPI_FLASH_ASYNC_
+
+/**
+ ****************************************************************************************
+ * @addtogroup SPI_FLASH_ASYNC Asynchronous SPI Flash
+ * @brief Read, program and erase operations that do not block the main loop.
+ *
+ * An operation is submitted and returns immediately. The WIP bit of the flash is then
+ * polled from the kernel by the TASK_SPI_FLASH task: page programs yield to the scheduler
+ * between two polls, erases are polled from a kernel timer. The completion callback is
+ * called from the kernel context. One operation can be pending at a time, the SPI and
+ * the flash must have been initialized with spi_init() and spi_flash_init().
+ *
+ * @{
+ ****************************************************************************************
+ */
+
+/*
+ * INCLUDE FILES
+ ****************************************************************************************
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "arch.h"
+#include "rwip_config.h"
+#include "ke_task.h"
+#include "spi_flash.h"
+
+#if (SPI_FLASH_ASYNC)
+
+/*
+ * DEFINES
+ ****************************************************************************************
+ */
+
+/// Page program WIP polling period (in 10ms unit)
+#ifndef SPI_FLASH_ASYNC_WRITE_POLL
+#define SPI_FLASH_ASYNC_WRITE_POLL      (1)
+#endif
+
+/// Erase WIP polling period (in 10ms unit)
+#ifndef SPI_FLASH_ASYNC_ERASE_POLL
+#define SPI_FLASH_ASYNC_ERASE_POLL      (1)
+#endif
+
+/// Maximum number of WIP polls before an operation fails with ERR_TIMEOUT
+#ifndef SPI_FLASH_ASYNC_MAX_POLLS
+#define SPI_FLASH_ASYNC_MAX_POLLS       (MAX_READY_WAIT_COUNT)
+#endif
+
+/// Number of task instances
+#define SPI_FLASH_ASYNC_IDX_MAX         (1)
+
+/// States of the asynchronous SPI Flash task
+enum
+{
+    /// Only state
+    SPI_FLASH_ASYNC_IDLE,
+
+    /// Number of states
+    SPI_FLASH_ASYNC_STATE_MAX
+};
+
+/// Messages of the asynchronous SPI Flash task
+enum
+{
+    /// Internal: poll the flash and continue the pending operation
+    SPI_FLASH_ASYNC_POLL = KE_FIRST_MSG(TASK_SPI_FLASH),
+};
+
+/*
+ * TYPE DEFINITIONS
+ ****************************************************************************************
+ */
+
+/**
+ ****************************************************************************************
+ * @brief Completion callback
+ *
+ * @param[in] status  Number of bytes read or written, ERR_OK for an erase, negative
+ *                    error code on failure
+ ****************************************************************************************
+ */
+typedef void (*spi_flash_async_cb_t)(int32_t status);
+
+/*
+ * FUNCTION DECLARATIONS
+ ****************************************************************************************
+ */
+
+/**
+ ****************************************************************************************
+ * @brief Create the asynchronous SPI Flash task.
+ ****************************************************************************************
+ */
+void spi_flash_async_init(void);
+
+/**
+ ****************************************************************************************
+ * @brief Check if an operation is pending.
+ *
+ * @return true if an operation has been submitted and its callback not called yet
+ ****************************************************************************************
+ */
+bool spi_flash_async_busy(void);
+
+/**
+ ****************************************************************************************
+ * @brief Run the pending operation to completion without the kernel, for a caller that
+ * cannot return to the scheduler first. The completion callback is called from here.
+ * @return ERR_OK, ERR_TIMEOUT if the flash stayed busy
+ ****************************************************************************************
+ */
+int8_t spi_flash_async_flush(void);
+
+/**
+ ****************************************************************************************
+ * @brief Read data from a given starting address (up to the end of the flash)
+ *
+ * @param[in] *rd_data_ptr:  Points to the position the read data will be stored
+ * @param[in] address:       Starting address of data to be read
+ * @param[in] size:          Size of the data to be read
+ * @param[in] cb:            Completion callback, receives the number of bytes read
+ *
+ * @return ERR_OK if submitted, ERR_BUSY if an operation is pending
+ ****************************************************************************************
+ */
+int8_t spi_flash_async_read(uint8_t *rd_data_ptr, uint32_t address, uint32_t size, spi_flash_async_cb_t cb);
+
+/**
+ ****************************************************************************************
+ * @brief Write data to flash across page boundaries and at any starting address. The data
+ * must stay valid until the callback is called.
+ *
+ * @param[in] *wr_data_ptr:  Pointer to the data to be written
+ * @param[in] address:       Starting address of data to be written
+ * @param[in] size:          Size of the data to be written (can be larger than SPI Flash page size)
+ * @param[in] cb:            Completion callback, receives the number of bytes written
+ *
+ * @return ERR_OK if submitted, ERR_BUSY if an operation is pending
+ ****************************************************************************************
+ */
+int8_t spi_flash_async_write(uint8_t const *wr_data_ptr, uint32_t address, uint32_t size, spi_flash_async_cb_t cb);
+
+/**
+ ****************************************************************************************
+ * @brief Erase a given address
+ *
+ * @param[in] address:        Address that belongs to the block64/block32/sector range
+ * @param[in] spiEraseModule: BLOCK_ERASE_64, BLOCK_ERASE_32, SECTOR_ERASE
+ * @param[in] cb:             Completion callback
+ *
+ * @return ERR_OK if submitted, ERR_BUSY if an operation is pending
+ ****************************************************************************************
+ */
+int8_t spi_flash_async_block_erase(uint32_t address, SPI_erase_module_t spiEraseModule, spi_flash_async_cb_t cb);
+
+/**
+ ****************************************************************************************
+ * @brief Erase chip
+ *
+ * @param[in] cb:  Completion callback
+ *
+ * @return ERR_OK if submitted, ERR_BUSY if an operation is pending
+ ****************************************************************************************
+ */
+int8_t spi_flash_async_chip_erase(spi_flash_async_cb_t cb);
+
+#endif //SPI_FLASH_ASYNC
+
+/// @} SPI_FLASH_ASYNC
+
+#endif //_SPI_FLASH_ASYNC_
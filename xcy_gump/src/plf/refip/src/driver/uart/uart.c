@@ -23,6 +23,7 @@
  ****************************************************************************************
  */
 #include <stddef.h>     // standard definition
+#include <string.h>     // memcpy definition
 #include "timer.h"      // timer definition
 #include "uart.h"       // uart definition
 #include "reg_uart.h"   // uart register
@@ -61,15 +62,6 @@ enum UART_ID
     UART_TIMEOUT       = 12
 };
 
-/// RX_LVL values
-enum UART_RXLVL
-{
-    UART_RXLVL_1,
-    UART_RXLVL_4,
-    UART_RXLVL_8,
-    UART_RXLVL_14
-};
-
 /// WORD_LEN values
 enum UART_WORDLEN
 {
@@ -115,6 +107,20 @@ struct uart_env_tag
     struct uart_txrxchannel rx;
     /// error detect
     uint8_t errordetect;
+#if (UART_RING)
+    /// tx requests waiting behind the one in tx
+    struct uart_txrxchannel tx_queue[UART_TX_QUEUE_SIZE];
+    /// first waiting tx request
+    uint8_t tx_queue_head;
+    /// number of waiting tx requests
+    uint8_t tx_queue_count;
+    /// rx ring write index (free running), moved by the interrupt
+    uint16_t rx_ring_head;
+    /// rx ring read index (free running), moved by the interrupt
+    uint16_t rx_ring_tail;
+    /// RX FIFO overruns
+    uint32_t rx_overrun;
+#endif // UART_RING
 };
 
 /*
@@ -124,6 +130,18 @@ struct uart_env_tag
 /// uart environment structure
 static struct uart_env_tag uart_env __attribute__((section("retention_mem_area0"),zero_init)); //@RETENTION MEMORY
 
+#if (UART_RING)
+// The RX ring is not retained: the bytes still in it when the system goes to deep sleep
+// are lost, uart_init() empties it when the peripherals are set up again on wake-up.
+
+/// RX ring
+static uint8_t uart_rx_ring[UART_RX_RING_SIZE];
+
+#define UART_RX_RING_MASK       (UART_RX_RING_SIZE - 1)
+// free running indexes, used bytes
+#define UART_RX_RING_USED()     ((uint16_t)(uart_env.rx_ring_head - uart_env.rx_ring_tail))
+#endif // UART_RING
+
 /*
  * LOCAL FUNCTION DEFINITIONS
  ****************************************************************************************
@@ -135,7 +153,7 @@ static struct uart_env_tag uart_env __attribute__((section("retention_mem_area0"
  *
  ****************************************************************************************
  */
-
+#if !(UART_RING)
 static void uart_rec_data_avail_isr(void)
 {
     void (*callback) (uint8_t) = NULL;
@@ -179,6 +197,109 @@ static void uart_rec_data_avail_isr(void)
         }
     }
 }
+#else // UART_RING
+/**
+ ****************************************************************************************
+ * @brief Moves the received bytes from the RX FIFO to the RX ring. The RX interrupt is
+ *        disabled while the ring is full.
+ *
+ ****************************************************************************************
+ */
+static void uart_rx_ring_fill(void)
+{
+    uint32_t lsr;
+
+    while (UART_RX_RING_USED() < UART_RX_RING_SIZE)
+    {
+        lsr = uart_lsr_get();
+
+        if (lsr & UART_OVERRUN_BIT)
+        {
+            uart_env.rx_overrun++;
+        }
+
+        if ((lsr & UART_DATA_RDY_BIT) == 0)
+        {
+            return;
+        }
+
+        uart_rx_ring[uart_env.rx_ring_head & UART_RX_RING_MASK] = uart_rxdata_getf();
+        uart_env.rx_ring_head++;
+    }
+
+    // Ring full: the RX FIFO fills up and the auto RTS holds the peer
+    uart_rec_data_avail_setf(0);
+}
+
+/**
+ ****************************************************************************************
+ * @brief Serves the pending read request from the RX ring and executes its callback when
+ *        complete. A request started by the callback is served by the same loop.
+ *
+ ****************************************************************************************
+ */
+static void uart_rx_ring_serve(void)
+{
+    void (*callback) (uint8_t) = NULL;
+    uint16_t tail;
+    uint32_t len, first;
+
+    while ((uart_env.rx.bufptr != NULL) && (UART_RX_RING_USED() != 0))
+    {
+        tail = uart_env.rx_ring_tail;
+
+        len = UART_RX_RING_USED();
+        if (len > uart_env.rx.size)
+        {
+            len = uart_env.rx.size;
+        }
+
+        // at most two copies: up to the end of the ring, then from its start
+        first = UART_RX_RING_SIZE - (tail & UART_RX_RING_MASK);
+        if (first > len)
+        {
+            first = len;
+        }
+
+        memcpy(uart_env.rx.bufptr, &uart_rx_ring[tail & UART_RX_RING_MASK], first);
+        memcpy(uart_env.rx.bufptr + first, &uart_rx_ring[0], len - first);
+
+        // Update RX parameters
+        uart_env.rx_ring_tail = tail + len;
+        uart_env.rx.size -= len;
+        uart_env.rx.bufptr += len;
+
+        // Check if all expected data have been received
+        if (uart_env.rx.size == 0)
+        {
+            // Reset RX parameters
+            uart_env.rx.bufptr = NULL;
+
+            // Retrieve callback pointer
+            callback = uart_env.rx.callback;
+
+            if(callback != NULL)
+            {
+                // Clear callback pointer
+                uart_env.rx.callback = NULL;
+
+                // Call handler
+                callback(UART_STATUS_OK);
+            }
+            else
+            {
+                ASSERT_ERR(0);
+            }
+        }
+    }
+
+    // Room again in the ring, collect the RX FIFO
+    if (!uart_rec_data_avail_getf() && (UART_RX_RING_USED() < UART_RX_RING_SIZE))
+    {
+        uart_rec_data_avail_setf(1);
+    }
+}
+#endif // UART_RING
 
 /**
  ****************************************************************************************
@@ -195,8 +316,10 @@ static void uart_rec_error_isr(void)
     uart_env.rx.size = 0;
     uart_env.rx.bufptr = NULL;
 
+#if !(UART_RING)
     // Disable RX interrupt
     SetBits16(UART_IER_DLH_REG, ERBFI_dlh0, 0); // uart_rec_data_avail_setf(0);
+#endif // UART_RING
 
     // Reset RX FIFO
     // uart_rxfifo_res_setf(1); @WIK commented
@@ -242,20 +365,30 @@ static void uart_thr_empty_isr(void)
 
         if (uart_env.tx.size == 0)
         {
-            // Reset TX parameters
-            uart_env.tx.bufptr = NULL;
+            // Retrieve and clear callback pointer
+            callback = uart_env.tx.callback;
+            uart_env.tx.callback = NULL;
 
-            // Disable TX interrupt
-            uart_thr_empty_setf(0);
+            #if (UART_RING)
+            if (uart_env.tx_queue_count != 0)
+            {
+                // Chain the next request, the FIFO does not run empty in between
+                uart_env.tx = uart_env.tx_queue[uart_env.tx_queue_head];
+                uart_env.tx_queue_head = (uart_env.tx_queue_head + 1) % UART_TX_QUEUE_SIZE;
+                uart_env.tx_queue_count--;
+            }
+            else
+            #endif // UART_RING
+            {
+                // Reset TX parameters
+                uart_env.tx.bufptr = NULL;
 
-            // Retrieve callback pointer
-            callback = uart_env.tx.callback;
+                // Disable TX interrupt
+                uart_thr_empty_setf(0);
+            }
 
             if(callback != NULL)
             {
-                // Clear callback pointer
-                uart_env.tx.callback = NULL;
-
                 // Call handler
                 callback(UART_STATUS_OK);
             }
@@ -264,6 +397,14 @@ static void uart_thr_empty_isr(void)
                 ASSERT_ERR(0);
             }
 
+            #if (UART_RING)
+            if (uart_env.tx.bufptr != NULL)
+            {
+                // Go on with the next request
+                continue;
+            }
+            #endif // UART_RING
+
             // Exit loop
             break;
         }
@@ -305,7 +446,12 @@ void uart_init_func(uint8_t baudr, uint8_t mode )
     //ENABLE FIFO, REGISTER FCR IF UART_LCR_REG.DLAB=0
     // XMIT FIFO RESET, RCVR FIFO RESET, FIFO ENABLED
     SetBits16(UART_LCR_REG, UART_DLAB, 0);
+#if (UART_RING)
+    // RX and TX FIFO trigger levels
+    SetWord16(UART_IIR_FCR_REG, (UART_RX_TRIGGER << 6) | (UART_TX_TRIGGER << 4) | 7);
+#else
     SetWord16(UART_IIR_FCR_REG,7); 
+#endif // UART_RING
 
     //DISABLE INTERRUPTS, REGISTER IER IF UART_LCR_REG.DLAB=0
     SetWord16(UART_IER_DLH_REG, 0);
@@ -335,6 +481,18 @@ void uart_init_func(uint8_t baudr, uint8_t mode )
     uart_env.tx.bufptr = NULL;
     uart_env.tx.size = 0;
 
+#if (UART_RING)
+    uart_env.tx_queue_head = 0;
+    uart_env.tx_queue_count = 0;
+    uart_env.rx_ring_head = 0;
+    uart_env.rx_ring_tail = 0;
+    uart_env.rx_overrun = 0;
+
+    // Programmable THRE interrupt mode (TX trigger level), reception always on
+    SetBits16(UART_IER_DLH_REG, PTIME_dlh7, 1);
+    uart_rec_data_avail_setf(1);
+#endif // UART_RING
+
     //SetWord32(UART_MCR_REG, UART_AFCE|UART_RTS); //Enable RTS/CTS handshake
 //uart_write("uart_is_initialised",19);
 }
@@ -452,15 +610,26 @@ void uart_read_func(uint8_t *bufptr, uint32_t size,void (*callback) (uint8_t))
     ASSERT_ERR(size != 0);
     ASSERT_ERR(uart_env.rx.bufptr == NULL);
 
+#if (UART_RING)
+    // The RX interrupt is always enabled
+    GLOBAL_INT_DISABLE();
+#endif // UART_RING
+
     // Prepare RX parameters
     uart_env.rx.size = size;
     uart_env.rx.bufptr = bufptr;
 	uart_env.rx.callback = callback; 
 	
 	
+#if (UART_RING)
+    GLOBAL_INT_RESTORE();
 
+    // Served from the RX ring by the interrupt, also if the data have already been received
+    NVIC_SetPendingIRQ(UART_IRQn);
+#else
     // Start data transaction
     uart_rec_data_avail_setf(1); //=SetBits16(UART_IER_DLH_REG, ETBEI_dlh0, 1); 
+#endif // UART_RING
 }
 
 void uart_write(uint8_t *bufptr, uint32_t size, void (*callback) (uint8_t))
@@ -480,6 +649,39 @@ void uart_write_func(uint8_t *bufptr, uint32_t size, void (*callback) (uint8_t))
     // Sanity check
     ASSERT_ERR(bufptr != NULL);
     ASSERT_ERR(size != 0);
+
+#if (UART_RING)
+    GLOBAL_INT_DISABLE();
+
+    if (uart_env.tx.bufptr != NULL)
+    {
+        struct uart_txrxchannel *tx;
+
+        // Sent after the previous requests by the TX interrupt
+        ASSERT_ERR(uart_env.tx_queue_count < UART_TX_QUEUE_SIZE);
+
+        tx = &uart_env.tx_queue[(uart_env.tx_queue_head + uart_env.tx_queue_count) % UART_TX_QUEUE_SIZE];
+        tx->size = size;
+        tx->bufptr = bufptr;
+        tx->callback = callback;
+        uart_env.tx_queue_count++;
+    }
+    else
+    {
+        // Prepare TX parameters
+        uart_env.tx.size = size;
+        uart_env.tx.bufptr = bufptr;
+        uart_env.tx.callback = callback;
+
+        uart_thr_empty_isr();
+        if (uart_env.tx.bufptr != NULL)
+        {
+            uart_thr_empty_setf(1);
+        }
+    }
+
+    GLOBAL_INT_RESTORE();
+#else
     ASSERT_ERR(uart_env.tx.bufptr == NULL);
 
     // Prepare TX parameters
@@ -497,6 +699,7 @@ void uart_write_func(uint8_t *bufptr, uint32_t size, void (*callback) (uint8_t))
     {
         uart_thr_empty_setf(1);
     }
+#endif // UART_RING
 }
 
 
@@ -522,9 +725,17 @@ void UART_Handler_func(void)
             {
                 uart_rec_error_isr();
             }
+            #if (UART_RING)
+            // Bytes below the RX trigger level
+            uart_rx_ring_fill();
+            #endif // UART_RING
             break;
           case RECEIVED_AVAILABLE:
+            #if (UART_RING)
+            uart_rx_ring_fill();
+            #else
             uart_rec_data_avail_isr();               
+            #endif // UART_RING
             break;
 
           case THR_EMPTY:
@@ -536,6 +747,17 @@ void UART_Handler_func(void)
         }
     }
 
+    #if (UART_RING)
+    // Also pended by uart_read_func()
+    uart_rx_ring_serve();
+    #endif // UART_RING
+}
+
+#if (UART_RING)
+uint32_t uart_rx_overrun_get(void)
+{
+    return uart_env.rx_overrun;
 }
+#endif // UART_RING
 
 /// @} UART
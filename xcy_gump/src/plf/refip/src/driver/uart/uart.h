@@ -33,6 +33,7 @@
  */
 #include <stdint.h>       // integer definition
 #include <stdbool.h>      // boolean definition
+#include "arch.h"         // UART_RING
 
 /*
  * DEFINES
@@ -141,6 +142,66 @@ enum
     UART_STATUS_ERROR
 };
 
+/// RX_LVL values (RX FIFO trigger level)
+enum UART_RXLVL
+{
+    UART_RXLVL_1,
+    UART_RXLVL_4,
+    UART_RXLVL_8,
+    UART_RXLVL_14
+};
+
+/// TX_LVL values (TX FIFO empty trigger level, programmable THRE interrupt mode)
+enum UART_TXLVL
+{
+    UART_TXLVL_0,
+    UART_TXLVL_2,
+    UART_TXLVL_4,
+    UART_TXLVL_8
+};
+
+#if (UART_RING)
+/*
+ * In ring mode the RX interrupt stays enabled: received bytes are stored in a ring and
+ * uart_read() requests are served from it, nothing is lost between two requests. When
+ * the ring is full the RX interrupt is masked until a request frees some room, the RX
+ * FIFO then fills up and the auto RTS flow control holds the peer. uart_write() requests
+ * are queued and sent back to back from the TX interrupt.
+ */
+
+/// Size of the RX ring (power of 2)
+#ifdef CFG_UART_RX_RING_SIZE
+#define UART_RX_RING_SIZE           CFG_UART_RX_RING_SIZE
+#else
+#define UART_RX_RING_SIZE           (256)
+#endif
+
+#if (UART_RX_RING_SIZE & (UART_RX_RING_SIZE - 1))
+ #error "UART_RX_RING_SIZE must be a power of 2"
+#endif
+
+/// Number of uart_write() requests that can wait behind the one being sent
+#ifdef CFG_UART_TX_QUEUE_SIZE
+#define UART_TX_QUEUE_SIZE          CFG_UART_TX_QUEUE_SIZE
+#else
+#define UART_TX_QUEUE_SIZE          (4)
+#endif
+
+/// RX FIFO trigger level (enum UART_RXLVL), the character timeout collects what is left
+#ifdef CFG_UART_RX_TRIGGER
+#define UART_RX_TRIGGER             CFG_UART_RX_TRIGGER
+#else
+#define UART_RX_TRIGGER             (UART_RXLVL_8)
+#endif
+
+/// TX FIFO empty trigger level (enum UART_TXLVL)
+#ifdef CFG_UART_TX_TRIGGER
+#define UART_TX_TRIGGER             CFG_UART_TX_TRIGGER
+#else
+#define UART_TX_TRIGGER             (UART_TXLVL_4)
+#endif
+#endif // UART_RING
+
 /*
  * FUNCTION DECLARATIONS
  ****************************************************************************************
@@ -181,7 +242,8 @@ void uart_finish_transfers(void);
  * @brief Starts a data reception.
  *
  * As soon as the end of the data transfer or a buffer overflow is detected,
- * the hci_uart_rx_done function is executed.
+ * the hci_uart_rx_done function is executed. In ring mode (UART_RING) the bytes already
+ * received are used first and the callback is always called from the UART interrupt.
  *
  * @param[in,out]  bufptr Pointer to the RX buffer
  * @param[in]      size   Size of the expected reception
@@ -195,7 +257,8 @@ void uart_read(uint8_t *bufptr, uint32_t size, void (*callback) (uint8_t));
  * @brief Starts a data transmission.
  *
  * As soon as the end of the data transfer is detected, the hci_uart_tx_done function is
- * executed.
+ * executed. In ring mode (UART_RING) up to UART_TX_QUEUE_SIZE more transmissions can be
+ * requested before the first one ends, the buffers must stay valid until their callback.
  *
  * @param[in]  bufptr Pointer to the TX buffer
  * @param[in]  size   Size of the transmission
@@ -213,5 +276,15 @@ void uart_write(uint8_t *bufptr, uint32_t size, void (*callback) (uint8_t));
  */
 void uart_isr(void);
 
+#if (UART_RING)
+/**
+ ****************************************************************************************
+ * @brief Number of received bytes dropped because the RX ring was full and the RX FIFO
+ * overran (flow control not used by the peer).
+ *****************************************************************************************
+ */
+uint32_t uart_rx_overrun_get(void);
+#endif // UART_RING
+
 /// @} UART
 #endif /* _UART_H_ */
@@ -0,0 +1,193 @@
+#!/usr/bin/env python3
+"""
+Host side of the GTL transport of the DA14580 firmware, kernel messages and batches.
+
+Packets (all the fields are little endian, see gtl_eif.h):
+    0x05, id, dest_id, src_id, param_len, param_len x byte           kernel message
+    0x06, count, length, count x (id, dest_id, src_id, param_len,    batch (CFG_GTL_BATCH)
+          param_len x byte)
+
+The ids and the lengths are 16-bit. The firmware only sends a batch when messages are
+ready while the UART is still busy, a message sent on an idle UART stays a 0x05 packet.
+The firmware also accepts batches from the host.
+
+Usage:
+    gtl_host.py capture.bin                              print the messages of a capture
+    gtl_host.py --port COM5                              print the messages of a UART
+    gtl_host.py --port COM5 --send 0x3401,0x3f,0x3e      send a message, then print
+    gtl_host.py --port COM5 --batch --send A --send B    send the messages in one batch
+    gtl_host.py --port COM5 --sync                       send the resynchronization pattern
+
+A message is given as id,dest_id,src_id[,hex parameters].
+
+Only the Python standard library is needed (pyserial for --port).
+"""
+
+import argparse
+import binascii
+import struct
+import sys
+
+GTL_KE_MSG_TYPE = 0x05
+GTL_BATCH_MSG_TYPE = 0x06
+KE_MSG_HDR_LEN = 8
+GTL_BATCH_HDR_LEN = 4
+GTL_SYNC_PATTERN = b'RW!'
+
+# Largest message accepted while decoding, anything bigger is treated as noise
+PARAM_LEN_MAX = 1024
+
+
+def encode_msg(msg_id, dest_id, src_id, param=b''):
+    """Kernel message without packet type."""
+    return struct.pack('<4H', msg_id, dest_id, src_id, len(param)) + param
+
+
+def encode_ke(msg):
+    """Kernel message packet."""
+    return bytes([GTL_KE_MSG_TYPE]) + encode_msg(*msg)
+
+
+def encode_batch(msgs):
+    """Batch packet of up to 255 kernel messages."""
+    if not 0 < len(msgs) <= 255:
+        raise ValueError('a batch holds 1 to 255 messages')
+    body = b''.join(encode_msg(*msg) for msg in msgs)
+    return struct.pack('<BBH', GTL_BATCH_MSG_TYPE, len(msgs), len(body)) + body
+
+
+def parse_msg(text):
+    """id,dest_id,src_id[,hex parameters]"""
+    fields = text.split(',')
+    if not 3 <= len(fields) <= 4:
+        raise argparse.ArgumentTypeError('expected id,dest_id,src_id[,hex parameters]: %s' % text)
+    param = binascii.unhexlify(fields[3]) if len(fields) == 4 else b''
+    return (int(fields[0], 0), int(fields[1], 0), int(fields[2], 0), param)
+
+
+def format_msg(msg, batch=None):
+    msg_id, dest_id, src_id, param = msg
+    text = 'KE  id 0x%04x dest 0x%04x src 0x%04x len %3d' % (msg_id, dest_id, src_id, len(param))
+    if batch is not None:
+        text = 'B%-2d' % batch + text[3:]
+    if param:
+        text += '  ' + binascii.hexlify(param).decode('ascii')
+    return text
+
+
+class Decoder(object):
+    """Incremental packet decoder, resynchronizes on the packet types."""
+
+    def __init__(self):
+        self.buf = bytearray()
+        self.skipped = 0
+        self.batches = 0
+
+    def unpack_msgs(self, offset, count, end):
+        """count kernel messages between offset and end, None if they do not fill it exactly."""
+        msgs = []
+        for i in range(count):
+            if offset + KE_MSG_HDR_LEN > end:
+                return None
+            msg_id, dest_id, src_id, param_len = struct.unpack_from('<4H', bytes(self.buf), offset)
+            offset += KE_MSG_HDR_LEN
+            if offset + param_len > end:
+                return None
+            msgs.append((msg_id, dest_id, src_id, bytes(self.buf[offset:offset + param_len])))
+            offset += param_len
+        return msgs if offset == end else None
+
+    def feed(self, data):
+        """Returns the complete messages received as (msg, batch size or None) tuples."""
+        self.buf.extend(data)
+        out = []
+
+        while self.buf:
+            msg_type = self.buf[0]
+
+            if msg_type == GTL_KE_MSG_TYPE:
+                if len(self.buf) < 1 + KE_MSG_HDR_LEN:
+                    break
+                param_len, = struct.unpack_from('<H', bytes(self.buf), 7)
+                if param_len <= PARAM_LEN_MAX:
+                    size = 1 + KE_MSG_HDR_LEN + param_len
+                    if len(self.buf) < size:
+                        break
+                    out.append((self.unpack_msgs(1, 1, size)[0], None))
+                    del self.buf[:size]
+                    continue
+
+            elif msg_type == GTL_BATCH_MSG_TYPE:
+                if len(self.buf) < GTL_BATCH_HDR_LEN:
+                    break
+                count, length = struct.unpack_from('<BH', bytes(self.buf), 1)
+                if count and count * KE_MSG_HDR_LEN <= length <= count * (KE_MSG_HDR_LEN + PARAM_LEN_MAX):
+                    size = GTL_BATCH_HDR_LEN + length
+                    if len(self.buf) < size:
+                        break
+                    msgs = self.unpack_msgs(GTL_BATCH_HDR_LEN, count, size)
+                    if msgs is not None:
+                        out.extend((msg, count) for msg in msgs)
+                        self.batches += 1
+                        del self.buf[:size]
+                        continue
+
+            # Not a packet (dropped bytes or noise): skip one byte and look for the next one
+            del self.buf[0]
+            self.skipped += 1
+
+        return out
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Send and print GTL kernel messages (CFG_GTL, CFG_GTL_BATCH).')
+    parser.add_argument('capture', nargs='?', default='-', help='binary capture file, - for stdin')
+    parser.add_argument('--port', help='use this serial port instead of a capture')
+    parser.add_argument('--baud', type=int, default=115200, help='serial port baud rate')
+    parser.add_argument('--send', type=parse_msg, action='append', default=[], metavar='MSG',
+                        help='message to send first: id,dest_id,src_id[,hex parameters]')
+    parser.add_argument('--batch', action='store_true', help='send the messages in one batch packet')
+    parser.add_argument('--sync', action='store_true', help='send the resynchronization pattern first')
+    args = parser.parse_args()
+
+    if (args.send or args.sync) and not args.port:
+        parser.error('--send and --sync need --port')
+
+    decoder = Decoder()
+
+    if args.port:
+        import serial
+        source = serial.Serial(args.port, args.baud, timeout=0.1)
+        if args.sync:
+            source.write(GTL_SYNC_PATTERN)
+        if args.batch and args.send:
+            source.write(encode_batch(args.send))
+        else:
+            for msg in args.send:
+                source.write(encode_ke(msg))
+    elif args.capture == '-':
+        source = sys.stdin.buffer if hasattr(sys.stdin, 'buffer') else sys.stdin
+    else:
+        source = open(args.capture, 'rb')
+
+    try:
+        while True:
+            data = source.read(256)
+            if not data:
+                if args.port:
+                    continue
+                break
+            for msg, batch in decoder.feed(data):
+                sys.stdout.write(format_msg(msg, batch) + '\n')
+            sys.stdout.flush()
+    except KeyboardInterrupt:
+        pass
+
+    if decoder.batches:
+        sys.stderr.write('%d batch packet(s) received\n' % decoder.batches)
+    if decoder.skipped:
+        sys.stderr.write('%d byte(s) skipped while resynchronizing\n' % decoder.skipped)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,267 @@
+#!/usr/bin/env python3
+"""
+NVDS image builder and checker for the DA14580 firmware.
+
+The NVDS storage area (nvds_data_storage_area, struct nvds_data_struct) is part of the
+firmware image. This tool builds that area from a configuration file, checks it, and can
+patch it into a firmware binary, so that the parameters of a device can be changed without
+a rebuild. The layout is read from the sources, nothing is duplicated here:
+    - struct nvds_data_struct and enum NVDS_VALID_POS from src/modules/nvds/api/nvds.h
+    - the length field of the variable length tags from src/modules/nvds/src/nvds.c
+
+Configuration file, one tag per line, the name is the tag name without NVDS_TAG_:
+    # comment
+    BD_ADDRESS          = {0x01, 0x23, 0x45, 0x55, 0x89, 0x11}
+    DEVICE_NAME         = "MISSMEC"
+    APP_BLE_ADV_DATA    = "\\x02\\x01\\x06\\x03\\x03\\xa0\\xff"
+    UART_BAUDRATE       = 115200
+The validation flag and the lengths of the variable length tags are computed, the tags
+that are not listed are left invalid.
+
+Usage:
+    nvds_image.py build config.txt -o nvds.bin                 build the area
+    nvds_image.py build config.txt --patch fw.bin [--offset N]  build it into a firmware
+    nvds_image.py check nvds.bin                               check and print an area
+    nvds_image.py check fw.bin --offset 0x340                  ... in a firmware binary
+
+The default offset (0x340) is the one of the scatter files (0x20000340 - 0x20000000).
+"""
+
+import argparse
+import ast
+import os
+import re
+import struct
+import sys
+
+SRC_DIR = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', '..', 'src')
+NVDS_H = os.path.join(SRC_DIR, 'modules', 'nvds', 'api', 'nvds.h')
+NVDS_C = os.path.join(SRC_DIR, 'modules', 'nvds', 'src', 'nvds.c')
+
+AREA_SIZE = 0x100
+AREA_OFFSET = 0x340
+
+# Maximum length of the advertising and scan response data
+ADV_DATA_MAX = 31
+
+TYPES = {'uint8_t': 1, 'int8_t': 1, 'uint16_t': 2, 'int16_t': 2, 'uint32_t': 4, 'int32_t': 4}
+
+
+class NvdsError(Exception):
+    pass
+
+
+class Layout(object):
+    """struct nvds_data_struct, its tags and their validation bits, parsed from the sources."""
+
+    def __init__(self, header=NVDS_H, source=NVDS_C):
+        with open(header) as f:
+            h = f.read()
+        with open(source) as f:
+            c = f.read()
+
+        # without the comments (a previous layout is commented out in nvds.h)
+        h = re.sub(r'/\*.*?\*/|//[^\n]*', '', h, flags=re.S)
+        c = re.sub(r'/\*.*?\*/|//[^\n]*', '', c, flags=re.S)
+
+        body = re.search(r'struct\s+nvds_data_struct\s*\{(.*?)\};', h, re.S)
+        if body is None:
+            raise NvdsError('%s: struct nvds_data_struct not found' % header)
+
+        # name -> (offset, element size, count), natural alignment as armcc
+        self.fields = {}
+        offset = 0
+        for m in re.finditer(r'(\w+)\s+(\w+)\s*(?:\[(\w+)\])?\s*;', body.group(1)):
+            ctype, name, count = m.group(1), m.group(2), m.group(3)
+            if ctype not in TYPES:
+                raise NvdsError('%s: unsupported type %s of %s' % (header, ctype, name))
+            size = TYPES[ctype]
+            offset = (offset + size - 1) // size * size
+            count = int(count, 0) if count else 1
+            self.fields[name] = (offset, size, count)
+            offset += size * count
+        self.size = (offset + 3) // 4 * 4
+
+        pos = re.search(r'enum\s+NVDS_VALID_POS\s*\{(.*?)\};', h, re.S)
+        if pos is None:
+            raise NvdsError('%s: enum NVDS_VALID_POS not found' % header)
+        names = re.findall(r'NVDS_POS_(\w+)', pos.group(1))
+        self.valid_bit = dict((n, i) for i, n in enumerate(names) if n != 'MAX')
+
+        lens = re.search(r'enum\s+NVDS_LEN\s*\{(.*?)\};', h, re.S)
+        self.max_len = dict((n, int(v, 0)) for n, v in re.findall(r'NVDS_LEN_(\w+)\s*=\s*(\w+)', lens.group(1)))
+
+        # tag -> length field of the variable length tags
+        self.len_field = dict(re.findall(r'NVDS_VARIABLE\(NVDS_TAG_(\w+),\s*\w+,\s*(\w+)\)', c))
+
+        for tag in self.valid_bit:
+            if 'NVDS_TAG_' + tag not in self.fields:
+                raise NvdsError('%s: NVDS_POS_%s has no NVDS_TAG_%s member' % (header, tag, tag))
+
+    def field_bytes(self, name):
+        offset, size, count = self.fields[name]
+        return offset, size * count
+
+
+def parse_value(text):
+    """Integer, "string" (C escapes) or {byte, byte, ...}."""
+    text = text.strip()
+    if text.startswith('"'):
+        return ast.literal_eval('b' + text)
+    if text.startswith('{'):
+        items = [x.strip() for x in text.strip('{}').split(',') if x.strip()]
+        return bytes(int(x, 0) & 0xFF for x in items)
+    return int(text, 0)
+
+
+def check_ad_structures(tag, data):
+    """Advertising and scan response data are a chain of length prefixed AD structures."""
+    i = 0
+    while i < len(data):
+        if data[i] == 0:
+            raise NvdsError('%s: empty AD structure at offset %d' % (tag, i))
+        i += 1 + data[i]
+    if i != len(data):
+        raise NvdsError('%s: the last AD structure overruns the data' % tag)
+
+
+def build(layout, config):
+    area = bytearray(layout.size)
+    flag = 0
+
+    for lineno, line in enumerate(config.splitlines(), 1):
+        line = line.strip()
+        if not line or line.startswith('#'):
+            continue
+        if '=' not in line:
+            raise NvdsError('line %d: expected TAG = value' % lineno)
+        tag, value = [x.strip() for x in line.split('=', 1)]
+        if tag not in layout.valid_bit:
+            raise NvdsError('line %d: %s is not stored in the NVDS area (known: %s)'
+                            % (lineno, tag, ', '.join(sorted(layout.valid_bit))))
+        try:
+            value = parse_value(value)
+        except (ValueError, SyntaxError):
+            raise NvdsError('line %d: bad value for %s' % (lineno, tag))
+
+        offset, size = layout.field_bytes('NVDS_TAG_' + tag)
+        max_len = min(size, layout.max_len.get(tag, size))
+
+        if tag in layout.len_field:
+            if isinstance(value, int):
+                raise NvdsError('line %d: %s is a string or a byte list' % (lineno, tag))
+            if tag in ('APP_BLE_ADV_DATA', 'APP_BLE_SCAN_RESP_DATA'):
+                max_len = min(max_len, ADV_DATA_MAX)
+                check_ad_structures(tag, value)
+            if len(value) > max_len:
+                raise NvdsError('line %d: %s is %d bytes long, %d max' % (lineno, tag, len(value), max_len))
+            len_offset, _ = layout.field_bytes(layout.len_field[tag])
+            area[len_offset] = len(value)
+        elif isinstance(value, int):
+            if value < 0 or value >= 1 << (8 * size):
+                raise NvdsError('line %d: %s does not fit in %d byte(s)' % (lineno, tag, size))
+            value = value.to_bytes(size, 'little')
+        elif len(value) != size:
+            raise NvdsError('line %d: %s is %d bytes long, %d expected' % (lineno, tag, len(value), size))
+
+        area[offset:offset + len(value)] = value
+        flag |= 1 << layout.valid_bit[tag]
+
+    if flag & (1 << layout.valid_bit['BD_ADDRESS']):
+        offset, size = layout.field_bytes('NVDS_TAG_BD_ADDRESS')
+        bdaddr = bytes(area[offset:offset + size])
+        if bdaddr in (b'\x00' * size, b'\xff' * size):
+            raise NvdsError('BD_ADDRESS: %s is not a valid address' % bdaddr.hex())
+
+    flag_offset, _ = layout.field_bytes('NVDS_VALIDATION_FLAG')
+    area[flag_offset:flag_offset + 4] = struct.pack('<I', flag)
+
+    if len(area) > AREA_SIZE:
+        raise NvdsError('struct nvds_data_struct is %d bytes, the area is %d' % (len(area), AREA_SIZE))
+    return bytes(area) + bytes(AREA_SIZE - len(area))
+
+
+def check(layout, area):
+    """Check an NVDS area, return its description."""
+    if len(area) < layout.size:
+        raise NvdsError('the image is %d bytes, struct nvds_data_struct is %d' % (len(area), layout.size))
+
+    flag, = struct.unpack_from('<I', area, layout.fields['NVDS_VALIDATION_FLAG'][0])
+    unknown = flag & ~((1 << len(layout.valid_bit)) - 1)
+    if unknown:
+        raise NvdsError('NVDS_VALIDATION_FLAG 0x%08x: unknown bits 0x%08x' % (flag, unknown))
+
+    lines = ['NVDS_VALIDATION_FLAG = 0x%08x' % flag]
+    for tag, bit in sorted(layout.valid_bit.items(), key=lambda x: x[1]):
+        if not flag & (1 << bit):
+            lines.append('# %s not valid' % tag)
+            continue
+        offset, size = layout.field_bytes('NVDS_TAG_' + tag)
+        data = area[offset:offset + size]
+        if tag in layout.len_field:
+            length = area[layout.fields[layout.len_field[tag]][0]]
+            if length > min(size, layout.max_len.get(tag, size)):
+                raise NvdsError('%s: length %d out of range' % (tag, length))
+            data = data[:length]
+            if tag in ('APP_BLE_ADV_DATA', 'APP_BLE_SCAN_RESP_DATA'):
+                check_ad_structures(tag, data)
+            lines.append('%-24s = "%s"' % (tag, ''.join('\\x%02x' % b for b in data)))
+        elif layout.fields['NVDS_TAG_' + tag][2] > 1:
+            lines.append('%-24s = {%s}' % (tag, ', '.join('0x%02x' % b for b in data)))
+        else:
+            lines.append('%-24s = %d' % (tag, int.from_bytes(data, 'little')))
+    return '\n'.join(lines)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Build and check the NVDS storage area.')
+    sub = parser.add_subparsers(dest='cmd')
+
+    b = sub.add_parser('build', help='build the area from a configuration file')
+    b.add_argument('config')
+    b.add_argument('-o', '--output', help='raw area (%d bytes)' % AREA_SIZE)
+    b.add_argument('--patch', help='firmware binary to patch in place')
+    b.add_argument('--offset', type=lambda x: int(x, 0), default=AREA_OFFSET,
+                   help='offset of the area in the firmware binary')
+
+    c = sub.add_parser('check', help='check and print an area')
+    c.add_argument('image')
+    c.add_argument('--offset', type=lambda x: int(x, 0), default=0,
+                   help='offset of the area in the image (0x%x for a firmware binary)' % AREA_OFFSET)
+
+    args = parser.parse_args()
+    if args.cmd is None:
+        parser.error('build or check expected')
+
+    try:
+        layout = Layout()
+
+        if args.cmd == 'build':
+            with open(args.config) as f:
+                area = build(layout, f.read())
+            check(layout, area)
+            if args.output:
+                with open(args.output, 'wb') as f:
+                    f.write(area)
+            if args.patch:
+                with open(args.patch, 'r+b') as f:
+                    f.seek(0, os.SEEK_END)
+                    if f.tell() < args.offset + AREA_SIZE:
+                        raise NvdsError('%s: too short for an area at 0x%x' % (args.patch, args.offset))
+                    f.seek(args.offset)
+                    f.write(area)
+            if not args.output and not args.patch:
+                sys.stdout.write(check(layout, area) + '\n')
+        else:
+            with open(args.image, 'rb') as f:
+                f.seek(args.offset)
+                area = f.read(AREA_SIZE)
+            sys.stdout.write(check(layout, area) + '\n')
+
+    except NvdsError as e:
+        sys.stderr.write('error: %s\n' % e)
+        sys.exit(1)
+
+
+if __name__ == '__main__':
+    main()
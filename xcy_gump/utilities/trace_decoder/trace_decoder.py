@@ -0,0 +1,289 @@
+#!/usr/bin/env python3
+"""
+Decoder for the binary console trace of the DA14580 firmware (CFG_PRINTF_BINARY).
+
+With CFG_PRINTF_BINARY, arch_printf() does not format anything on target: it sends the
+address of its format string and its raw 32-bit arguments. This tool reads the format
+strings back from the image that is running (the .axf produced by the build) and prints
+the text.
+
+Frames (all the fields are little endian, see app_console.h):
+    0xA5, nargs, format address (4 bytes), nargs x argument (4 bytes)   TRACE
+    0xA6, length, length x character, 0x00                              TEXT (arch_puts)
+
+nargs has bit 7 set when the target dropped the arguments above 12: the text is then
+followed by TRUNCATED_MARK. Conversions without an argument print MISSING_ARG.
+
+Usage:
+    trace_decoder.py image.axf capture.bin        decode a capture
+    trace_decoder.py image.axf -                  decode stdin
+    trace_decoder.py image.axf --port COM5        decode a UART (needs pyserial)
+
+Only the Python standard library is needed (pyserial for --port).
+"""
+
+import argparse
+import struct
+import sys
+
+TRACE_SYNC = 0xA5
+TEXT_SYNC = 0xA6
+TRACE_ARGS_MAX = 12
+TRACE_TRUNCATED = 0x80
+
+TRUNCATED_MARK = ' <arguments dropped>'
+MISSING_ARG = '<?>'
+
+SHT_PROGBITS = 1
+SHF_ALLOC = 0x2
+
+
+class Image(object):
+    """Allocated sections of a 32-bit little endian ELF image, looked up by address."""
+
+    def __init__(self, path):
+        with open(path, 'rb') as f:
+            data = f.read()
+
+        if data[:4] != b'\x7fELF' or data[4] != 1 or data[5] != 1:
+            raise ValueError('%s: not a 32-bit little endian ELF file' % path)
+
+        e_shoff, = struct.unpack_from('<I', data, 0x20)
+        e_shentsize, e_shnum = struct.unpack_from('<HH', data, 0x2E)
+
+        self.sections = []
+        for i in range(e_shnum):
+            (name, sh_type, flags, addr, offset, size,
+             link, info, align, entsize) = struct.unpack_from('<10I', data, e_shoff + i * e_shentsize)
+            if sh_type == SHT_PROGBITS and (flags & SHF_ALLOC) and size:
+                self.sections.append((addr, data[offset:offset + size]))
+
+    def string(self, address, max_len=256):
+        """NUL terminated string at address, None if the address is not in the image."""
+        for base, content in self.sections:
+            if base <= address < base + len(content):
+                start = address - base
+                end = content.find(b'\x00', start, start + max_len)
+                if end < 0:
+                    end = min(len(content), start + max_len)
+                return content[start:end].decode('latin-1')
+        return None
+
+
+def itoa(value, radix, uppercase, pad):
+    digits = '0123456789ABCDEF' if uppercase else '0123456789abcdef'
+    negative = value < 0
+    value = -value if negative else value
+    out = ''
+    while True:
+        out = digits[value % radix] + out
+        value //= radix
+        if value == 0:
+            break
+    out = out.rjust(pad, '0')
+    return ('-' + out) if negative else out
+
+
+class MissingArg(Exception):
+    pass
+
+
+def format_trace(image, fmt, args):
+    """Same conversions as arch_vsnprintf(): %[0N][l|h](d|i|u|x|X|c|s).
+
+    Returns the text and the number of conversions that had no argument.
+    """
+    out = []
+    args = list(args)
+    missing = [0]
+    i = 0
+
+    def next_arg():
+        if not args:
+            missing[0] += 1
+            raise MissingArg()
+        return args.pop(0)
+
+    while i < len(fmt):
+        ch = fmt[i]
+        i += 1
+        if ch != '%':
+            out.append(ch)
+            continue
+
+        pad = 0
+        if i < len(fmt) and fmt[i] == '0':
+            i += 1
+            if i < len(fmt) and fmt[i].isdigit():
+                pad = int(fmt[i])
+                i += 1
+        if i < len(fmt) and fmt[i] in 'lh':
+            i += 1
+        if i >= len(fmt):
+            break
+
+        ch = fmt[i]
+        i += 1
+        try:
+            out.append(convert(image, ch, pad, next_arg))
+        except MissingArg:
+            out.append(MISSING_ARG)
+
+    return ''.join(out), missing[0]
+
+
+def convert(image, ch, pad, next_arg):
+    """One conversion of format_trace()."""
+    if ch in 'di':
+        val = next_arg()
+        return itoa(val - (1 << 32) if val & 0x80000000 else val, 10, False, pad)
+    if ch == 'u':
+        return itoa(next_arg(), 10, False, pad)
+    if ch in 'xX':
+        return itoa(next_arg(), 16, ch == 'X', pad)
+    if ch == 'c':
+        return chr(next_arg() & 0xFF)
+    if ch == 's':
+        ptr = next_arg()
+        s = image.string(ptr)
+        return s if s is not None else '<0x%08x>' % ptr
+    return 'FATAL: unsupported printf character: %s.\n' % ch
+
+
+class Decoder(object):
+    """Incremental frame decoder, resynchronizes on the sync bytes.
+
+    A candidate frame is accepted only if it is complete and valid: a TRACE frame must
+    have a known format address, a TEXT frame its NUL terminator and no other NUL. A
+    sync byte that is only part of another frame (after dropped bytes) is skipped.
+    """
+
+    def __init__(self, image):
+        self.image = image
+        self.buf = bytearray()
+        self.skipped = 0
+        self.truncated = 0
+        self.missing = 0
+
+    def _text(self):
+        """Length of the TEXT frame at the start of the buffer, 0 if invalid, None if incomplete."""
+        if len(self.buf) < 2:
+            return None
+        size = 2 + self.buf[1] + 1
+        # a NUL before the end rejects the frame without waiting for the rest of it
+        if 0 in self.buf[2:size - 1]:
+            return 0
+        if len(self.buf) < size:
+            return None
+        if self.buf[size - 1] != 0:
+            return 0
+        return size
+
+    def _trace(self):
+        """Length of the TRACE frame at the start of the buffer, 0 if invalid, None if incomplete."""
+        if len(self.buf) < 2:
+            return None
+        nargs = self.buf[1] & ~TRACE_TRUNCATED
+        if nargs > TRACE_ARGS_MAX or ((self.buf[1] & TRACE_TRUNCATED) and nargs != TRACE_ARGS_MAX):
+            return 0
+        size = 2 + 4 * (nargs + 1)
+        if len(self.buf) < size:
+            return None
+        address, = struct.unpack_from('<I', bytes(self.buf), 2)
+        if self.image.string(address) is None:
+            return 0
+        return size
+
+    def feed(self, data):
+        self.buf.extend(data)
+        out = []
+
+        while self.buf:
+            sync = self.buf[0]
+
+            if sync == TEXT_SYNC:
+                size = self._text()
+            elif sync == TRACE_SYNC:
+                size = self._trace()
+            else:
+                size = 0
+
+            if size is None:
+                # wait for the rest of the frame
+                break
+
+            if size == 0:
+                # Not a frame (dropped bytes or noise): skip one byte and look for the next sync
+                del self.buf[0]
+                self.skipped += 1
+                continue
+
+            if sync == TEXT_SYNC:
+                out.append(bytes(self.buf[2:size - 1]).decode('latin-1'))
+            else:
+                nargs = self.buf[1] & ~TRACE_TRUNCATED
+                words = struct.unpack_from('<%dI' % (nargs + 1), bytes(self.buf), 2)
+                text, missing = format_trace(self.image, self.image.string(words[0]), words[1:])
+                self.missing += missing
+                if self.buf[1] & TRACE_TRUNCATED:
+                    self.truncated += 1
+                    body = text.rstrip('\r\n')
+                    text = body + TRUNCATED_MARK + text[len(body):]
+                out.append(text)
+            del self.buf[:size]
+
+        return ''.join(out)
+
+    def flush(self):
+        """End of the input: decode what is left, skipping the incomplete frames."""
+        out = [self.feed(b'')]
+        while self.buf:
+            del self.buf[0]
+            self.skipped += 1
+            out.append(self.feed(b''))
+        return ''.join(out)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Decode the binary console trace (CFG_PRINTF_BINARY).')
+    parser.add_argument('image', help='.axf (ELF) image running on the target')
+    parser.add_argument('capture', nargs='?', default='-', help='binary capture file, - for stdin')
+    parser.add_argument('--port', help='read from this serial port instead of a capture')
+    parser.add_argument('--baud', type=int, default=115200, help='serial port baud rate')
+    args = parser.parse_args()
+
+    decoder = Decoder(Image(args.image))
+
+    if args.port:
+        import serial
+        source = serial.Serial(args.port, args.baud, timeout=0.1)
+    elif args.capture == '-':
+        source = sys.stdin.buffer if hasattr(sys.stdin, 'buffer') else sys.stdin
+    else:
+        source = open(args.capture, 'rb')
+
+    try:
+        while True:
+            data = source.read(256)
+            if not data:
+                if args.port:
+                    continue
+                break
+            sys.stdout.write(decoder.feed(data))
+            sys.stdout.flush()
+    except KeyboardInterrupt:
+        pass
+
+    sys.stdout.write(decoder.flush())
+
+    if decoder.skipped:
+        sys.stderr.write('%d byte(s) skipped while resynchronizing\n' % decoder.skipped)
+    if decoder.truncated:
+        sys.stderr.write('%d message(s) with more than %d arguments, marked%s\n'
+                         % (decoder.truncated, TRACE_ARGS_MAX, TRUNCATED_MARK))
+    if decoder.missing:
+        sys.stderr.write('%d conversion(s) without argument, printed as %s\n' % (decoder.missing, MISSING_ARG))
+
+
+if __name__ == '__main__':
+    main()